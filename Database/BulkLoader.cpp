@@ -0,0 +1,442 @@
+#include "BulkLoader.h"
+
+using namespace std;
+
+//an istream over a range of memory, without copying it
+class MemoryBuf : public streambuf
+{
+public:
+	MemoryBuf(char* _begin, char* _end)
+	{
+		this->setg(_begin, _begin, _end);
+	}
+};
+
+BulkLoader::BulkLoader(unsigned _parallelism) : parse_pool(_parallelism), encode_pool(_parallelism)
+{
+	this->triple_num = 0;
+	this->subject_num = 0;
+	this->line_num = 0;
+}
+
+BulkLoader::~BulkLoader()
+{
+}
+
+void
+BulkLoader::report(const char* _stage, unsigned long long _num, const char* _unit, long _ms)
+{
+	cout << _stage << ": " << _num << " " << _unit << " in " << _ms << "ms";
+	if (_ms > 0)
+		cout << ", " << (unsigned long long)(_num * 1000.0 / _ms) << " " << _unit << "/s";
+	cout << endl;
+}
+
+unsigned
+BulkLoader::partitionOf(const string& _str)
+{
+	return (hash<string>()(_str) * 0x9E3779B97F4A7C15ULL) >> (64 - BulkLoader::PARTITION_BITS);
+}
+
+//read the next BATCH_BYTES of the file, cut them into ranges at line ends and parse the ranges in parallel
+bool
+BulkLoader::parseRanges(FILE* _fp, Batch& _batch)
+{
+	_batch.triples.clear();
+	_batch.errors.clear();
+	string buffer;
+	buffer.swap(this->carry);
+	size_t old_size = buffer.size();
+	buffer.resize(old_size + BulkLoader::BATCH_BYTES);
+	size_t read_size = fread(&buffer[old_size], 1, BulkLoader::BATCH_BYTES, _fp);
+	buffer.resize(old_size + read_size);
+	_batch.bytes = read_size;
+	if (read_size == BulkLoader::BATCH_BYTES)
+	{
+		size_t end = buffer.rfind('\n');
+		if (end != string::npos)
+		{
+			this->carry = buffer.substr(end + 1);
+			buffer.resize(end + 1);
+		}
+	}
+	if (buffer.empty())
+		return false;
+
+	unsigned range_num = this->parse_pool.getWorkerNum() * BulkLoader::RANGES_PER_WORKER;
+	vector<size_t> begins(1, 0);
+	for (unsigned r = 1; r < range_num; ++r)
+	{
+		size_t pos = buffer.find('\n', max(begins.back(), buffer.size() * r / range_num));
+		if (pos == string::npos || pos + 1 >= buffer.size())
+			break;
+		begins.push_back(pos + 1);
+	}
+	begins.push_back(buffer.size());
+	range_num = begins.size() - 1;
+
+	//the lines before each range, for the line numbers in the errors
+	vector<int> lines(range_num + 1, 0);
+	this->parse_pool.run(range_num, [&](unsigned _worker, unsigned long _r)
+	{
+		lines[_r + 1] = count(buffer.begin() + begins[_r], buffer.begin() + begins[_r + 1], '\n');
+	});
+	lines[0] = this->line_num;
+	for (unsigned r = 0; r < range_num; ++r)
+		lines[r + 1] += lines[r];
+	this->line_num = lines[range_num];
+
+	vector< vector<TripleWithObjType> > triples(range_num);
+	vector<string> errors(range_num);
+	this->parse_pool.run(range_num, [&](unsigned _worker, unsigned long _r)
+	{
+		MemoryBuf buf(&buffer[0] + begins[_r], &buffer[0] + begins[_r + 1]);
+		istream in(&buf);
+		ostringstream err;
+		RDFParser parser(in);
+		const int group = 4096;
+		TripleWithObjType* group_array = new TripleWithObjType[group];
+		int line = lines[_r];
+		while (true)
+		{
+			int num = 0;
+			line = parser.parseStream(group_array, num, group, err, line);
+			triples[_r].insert(triples[_r].end(), group_array, group_array + num);
+			if (num < group)
+				break;
+		}
+		delete[] group_array;
+		errors[_r] = err.str();
+	});
+
+	for (unsigned r = 0; r < range_num; ++r)
+	{
+		_batch.triples.insert(_batch.triples.end(), triples[r].begin(), triples[r].end());
+		vector<TripleWithObjType>().swap(triples[r]);
+		_batch.errors += errors[r];
+	}
+	return true;
+}
+
+//parse the next BATCH_TRIPLES triples with one parser
+bool
+BulkLoader::parseStream(RDFParser& _parser, Batch& _batch)
+{
+	ostringstream err;
+	_batch.triples.resize(BulkLoader::BATCH_TRIPLES);
+	int num = 0;
+	this->line_num = _parser.parseStream(&_batch.triples[0], num, BulkLoader::BATCH_TRIPLES, err, this->line_num);
+	_batch.triples.resize(num);
+	_batch.errors = err.str();
+	_batch.bytes = 0;
+	return num > 0;
+}
+
+//give the strings of a batch temporary IDs and append its tuples to _fp: each task first lists the
+//positions of the strings of a chunk of triples by partition, then each partition is encoded by one task
+bool
+BulkLoader::encodeBatch(Batch& _batch, FILE* _fp)
+{
+	vector<TripleWithObjType>& triples = _batch.triples;
+	size_t num = triples.size();
+	if (num == 0)
+		return true;
+	vector<ID_TUPLE> tuples(num);
+	unsigned long chunk_num = (num + BulkLoader::CHUNK_TRIPLES - 1) / BulkLoader::CHUNK_TRIPLES;
+	vector< vector<unsigned> > lists(chunk_num * BulkLoader::PARTITION_NUM);
+	this->encode_pool.run(chunk_num, [&](unsigned _worker, unsigned long _c)
+	{
+		size_t end = min(num, (size_t)(_c + 1) * BulkLoader::CHUNK_TRIPLES);
+		for (size_t i = _c * BulkLoader::CHUNK_TRIPLES; i < end; ++i)
+		{
+			lists[_c * BulkLoader::PARTITION_NUM + BulkLoader::partitionOf(triples[i].subject)].push_back(i * 3);
+			lists[_c * BulkLoader::PARTITION_NUM + BulkLoader::partitionOf(triples[i].predicate)].push_back(i * 3 + 1);
+			lists[_c * BulkLoader::PARTITION_NUM + BulkLoader::partitionOf(triples[i].object)].push_back(i * 3 + 2);
+		}
+	});
+
+	atomic<bool> overflow(false);
+	TYPE_TRIPLE_NUM base = this->triple_num * 3;
+	this->encode_pool.run(BulkLoader::PARTITION_NUM, [&](unsigned _worker, unsigned long _p)
+	{
+		Partition& part = this->partitions[_p];
+		for (unsigned long c = 0; c < chunk_num; ++c)
+		{
+			const vector<unsigned>& list = lists[c * BulkLoader::PARTITION_NUM + _p];
+			for (unsigned pos : list)
+			{
+				TripleWithObjType& triple = triples[pos / 3];
+				unsigned role = pos % 3;
+				string& str = role == 0 ? triple.subject : (role == 1 ? triple.predicate : triple.object);
+				int kind = role == 1 ? BulkLoader::Predicate : (role == 2 && triple.isObjLiteral() ? BulkLoader::Literal : BulkLoader::Entity);
+				unordered_map<string, unsigned>::iterator it = part.index[kind].find(str);
+				unsigned local;
+				if (it != part.index[kind].end())
+					local = it->second;
+				else
+				{
+					local = part.first[kind].size();
+					if (local >> BulkLoader::LOCAL_BITS)
+					{
+						overflow = true;
+						return;
+					}
+					part.first[kind].push_back(base + pos);
+					part.index[kind].insert(make_pair(std::move(str), local));
+				}
+				unsigned id = (_p << BulkLoader::LOCAL_BITS) | local;
+				if (role == 0)
+					tuples[pos / 3].subid = id;
+				else if (role == 1)
+					tuples[pos / 3].preid = id;
+				else
+					tuples[pos / 3].objid = kind == BulkLoader::Literal ? (id | BulkLoader::LITERAL_FLAG) : id;
+			}
+		}
+	});
+	if (overflow)
+	{
+		cout << "too many distinct strings in a partition @BulkLoader::encodeBatch" << endl;
+		return false;
+	}
+
+	if (fwrite(&tuples[0], sizeof(ID_TUPLE), num, _fp) != num)
+	{
+		cout << "failed to write the id tuples @BulkLoader::encodeBatch" << endl;
+		return false;
+	}
+	this->triple_num += num;
+	return true;
+}
+
+bool
+BulkLoader::encode(const string& _rdf_file, const string& _error_log, const string& _tuple_file)
+{
+	FILE* fp = fopen(_tuple_file.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "unable to open " << _tuple_file << " @BulkLoader::encode" << endl;
+		return false;
+	}
+	ifstream fin;
+	FILE* rdf_fp = NULL;
+	RDFParser* parser = NULL;
+	bool ntriples = _rdf_file.length() > 3 && _rdf_file.substr(_rdf_file.length() - 3) == ".nt";
+	if (ntriples)
+		rdf_fp = fopen(_rdf_file.c_str(), "rb");
+	else
+	{
+		fin.open(_rdf_file.c_str());
+		if (fin)
+			parser = new RDFParser(fin);
+	}
+	if (rdf_fp == NULL && parser == NULL)
+	{
+		cout << "unable to open " << _rdf_file << " @BulkLoader::encode" << endl;
+		fclose(fp);
+		return false;
+	}
+	ofstream error_out(_error_log.c_str(), ios::app);
+
+	//parse batch i while batch i-1 is encoded
+	Batch batches[2];
+	unsigned cur = 0;
+	thread encoder;
+	bool encoded = true;
+	long parse_ms = 0, encode_ms = 0;
+	unsigned long long bytes = 0;
+	long begin_time = Util::get_cur_time();
+	while (true)
+	{
+		long parse_begin = Util::get_cur_time();
+		bool more = ntriples ? this->parseRanges(rdf_fp, batches[cur]) : this->parseStream(*parser, batches[cur]);
+		parse_ms += Util::get_cur_time() - parse_begin;
+		bytes += batches[cur].bytes;
+		if (!batches[cur].errors.empty())
+			error_out << batches[cur].errors;
+		if (encoder.joinable())
+			encoder.join();
+		if (!encoded || !more)
+			break;
+		Batch& batch = batches[cur];
+		cout << "parsed " << this->triple_num + batch.triples.size() << " triples" << endl;
+		encoder = thread([this, &batch, fp, &encoded, &encode_ms]()
+		{
+			long encode_begin = Util::get_cur_time();
+			encoded = this->encodeBatch(batch, fp);
+			encode_ms += Util::get_cur_time() - encode_begin;
+			vector<TripleWithObjType>().swap(batch.triples);
+		});
+		cur = 1 - cur;
+	}
+
+	delete parser;
+	if (rdf_fp != NULL)
+		fclose(rdf_fp);
+	fclose(fp);
+	this->carry.clear();
+	if (ntriples)
+		BulkLoader::report("parse", bytes >> 20, "MB", parse_ms);
+	BulkLoader::report("parse", this->triple_num, "triples", parse_ms);
+	BulkLoader::report("encode", this->triple_num, "triples", encode_ms);
+	BulkLoader::report("parse and encode", this->triple_num, "triples", Util::get_cur_time() - begin_time);
+	return encoded;
+}
+
+bool
+BulkLoader::assignIDs()
+{
+	long begin_time = Util::get_cur_time();
+	TYPE_TRIPLE_NUM limits[3] = { Util::LITERAL_FIRST_ID, (TYPE_TRIPLE_NUM)INVALID_ENTITY_LITERAL_ID - Util::LITERAL_FIRST_ID,
+		Util::LITERAL_FIRST_ID };
+	TYPE_TRIPLE_NUM string_num = 0;
+	for (int kind = 0; kind < 3; ++kind)
+	{
+		vector< pair<TYPE_TRIPLE_NUM, unsigned> > order;
+		for (unsigned p = 0; p < BulkLoader::PARTITION_NUM; ++p)
+		{
+			const vector<TYPE_TRIPLE_NUM>& first = this->partitions[p].first[kind];
+			for (unsigned local = 0; local < first.size(); ++local)
+				order.push_back(make_pair(first[local], (p << BulkLoader::LOCAL_BITS) | local));
+		}
+		if (order.size() >= limits[kind])
+		{
+			cout << "too many " << (kind == BulkLoader::Entity ? "entities" : (kind == BulkLoader::Literal ? "literals" : "predicates"))
+				<< " @BulkLoader::assignIDs" << endl;
+			return false;
+		}
+		//the positions are distinct, so the order is the one the strings first appear in
+		omp_set_num_threads(this->encode_pool.getWorkerNum());
+		__gnu_parallel::sort(order.begin(), order.end());
+
+		for (unsigned p = 0; p < BulkLoader::PARTITION_NUM; ++p)
+			this->partitions[p].id[kind].resize(this->partitions[p].first[kind].size());
+		for (unsigned i = 0; i < order.size(); ++i)
+		{
+			unsigned p = order[i].second >> BulkLoader::LOCAL_BITS;
+			unsigned local = order[i].second & ((1U << BulkLoader::LOCAL_BITS) - 1);
+			this->partitions[p].id[kind][local] = i;
+			if (kind == BulkLoader::Entity && order[i].first % 3 == 0)
+				this->subject_num++;
+		}
+		this->strings[kind].resize(order.size());
+		for (unsigned p = 0; p < BulkLoader::PARTITION_NUM; ++p)
+		{
+			Partition& part = this->partitions[p];
+			for (unordered_map<string, unsigned>::const_iterator it = part.index[kind].begin(); it != part.index[kind].end(); ++it)
+				this->strings[kind][part.id[kind][it->second]] = &it->first;
+			vector<TYPE_TRIPLE_NUM>().swap(part.first[kind]);
+		}
+		string_num += order.size();
+	}
+	BulkLoader::report("assign IDs", string_num, "strings", Util::get_cur_time() - begin_time);
+	return true;
+}
+
+void
+BulkLoader::releaseStrings()
+{
+	for (int kind = 0; kind < 3; ++kind)
+	{
+		vector<const string*>().swap(this->strings[kind]);
+		for (unsigned p = 0; p < BulkLoader::PARTITION_NUM; ++p)
+			unordered_map<string, unsigned>().swap(this->partitions[p].index[kind]);
+	}
+}
+
+ID_TUPLE*
+BulkLoader::readTuples(const string& _tuple_file)
+{
+	long begin_time = Util::get_cur_time();
+	FILE* fp = fopen(_tuple_file.c_str(), "rb");
+	if (fp == NULL)
+	{
+		cout << "unable to open " << _tuple_file << " @BulkLoader::readTuples" << endl;
+		return NULL;
+	}
+	ID_TUPLE* tuples = new ID_TUPLE[this->triple_num];
+	size_t read_num = fread(tuples, sizeof(ID_TUPLE), this->triple_num, fp);
+	fclose(fp);
+	Util::empty_file(_tuple_file.c_str());
+	if (read_num != this->triple_num)
+	{
+		cout << "the id tuples are incomplete @BulkLoader::readTuples" << endl;
+		delete[] tuples;
+		return NULL;
+	}
+
+	this->mapIDs(tuples, this->triple_num);
+	this->releaseIDs();
+	BulkLoader::report("read id tuples", this->triple_num, "triples", Util::get_cur_time() - begin_time);
+	return tuples;
+}
+
+//replace the temporary IDs by the ones given by assignIDs()
+void
+BulkLoader::mapIDs(ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num)
+{
+	const unsigned mask = (1U << BulkLoader::LOCAL_BITS) - 1;
+	unsigned long chunk_num = (_num + BulkLoader::CHUNK_TRIPLES - 1) / BulkLoader::CHUNK_TRIPLES;
+	this->encode_pool.run(chunk_num, [&](unsigned _worker, unsigned long _c)
+	{
+		TYPE_TRIPLE_NUM end = min(_num, (TYPE_TRIPLE_NUM)(_c + 1) * BulkLoader::CHUNK_TRIPLES);
+		for (TYPE_TRIPLE_NUM i = _c * BulkLoader::CHUNK_TRIPLES; i < end; ++i)
+		{
+			ID_TUPLE& t = _tuples[i];
+			t.subid = this->partitions[t.subid >> BulkLoader::LOCAL_BITS].id[BulkLoader::Entity][t.subid & mask];
+			t.preid = this->partitions[t.preid >> BulkLoader::LOCAL_BITS].id[BulkLoader::Predicate][t.preid & mask];
+			if (t.objid & BulkLoader::LITERAL_FLAG)
+			{
+				unsigned id = t.objid & ~BulkLoader::LITERAL_FLAG;
+				t.objid = Util::LITERAL_FIRST_ID + this->partitions[id >> BulkLoader::LOCAL_BITS].id[BulkLoader::Literal][id & mask];
+			}
+			else
+				t.objid = this->partitions[t.objid >> BulkLoader::LOCAL_BITS].id[BulkLoader::Entity][t.objid & mask];
+		}
+	});
+}
+
+void
+BulkLoader::releaseIDs()
+{
+	for (unsigned p = 0; p < BulkLoader::PARTITION_NUM; ++p)
+	{
+		for (int kind = 0; kind < 3; ++kind)
+			vector<unsigned>().swap(this->partitions[p].id[kind]);
+	}
+}
+
+bool
+BulkLoader::remapTuples(const string& _tuple_file, unsigned long long _memory_budget)
+{
+	long begin_time = Util::get_cur_time();
+	FILE* fp = fopen(_tuple_file.c_str(), "rb+");
+	if (fp == NULL)
+	{
+		cout << "unable to open " << _tuple_file << " @BulkLoader::remapTuples" << endl;
+		return false;
+	}
+	vector<ID_TUPLE> chunk(max(1ULL, min((unsigned long long)this->triple_num, _memory_budget / sizeof(ID_TUPLE))));
+	bool ok = true;
+	for (TYPE_TRIPLE_NUM done = 0; ok && done < this->triple_num;)
+	{
+		size_t num = min((TYPE_TRIPLE_NUM)chunk.size(), this->triple_num - done);
+		fseeko(fp, (off_t)done * sizeof(ID_TUPLE), SEEK_SET);
+		ok = fread(chunk.data(), sizeof(ID_TUPLE), num, fp) == num;
+		if (!ok)
+			break;
+		this->mapIDs(chunk.data(), num);
+		fseeko(fp, (off_t)done * sizeof(ID_TUPLE), SEEK_SET);
+		ok = fwrite(chunk.data(), sizeof(ID_TUPLE), num, fp) == num;
+		done += num;
+	}
+	fclose(fp);
+	this->releaseIDs();
+	if (!ok)
+	{
+		cout << "unable to rewrite the id tuples @BulkLoader::remapTuples" << endl;
+		return false;
+	}
+	BulkLoader::report("remap id tuples", this->triple_num, "triples", Util::get_cur_time() - begin_time);
+	return true;
+}
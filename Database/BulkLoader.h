@@ -0,0 +1,82 @@
+#ifndef _DATABASE_BULKLOADER_H
+#define _DATABASE_BULKLOADER_H
+
+#include "../Util/Util.h"
+#include "../Util/Triple.h"
+#include "../Util/WorkStealingPool.h"
+#include "../Parser/RDFParser.h"
+
+//One thread parses a batch of triples while another encodes the last one, each with its own pool.
+//N-Triples files(*.nt) are parsed in byte ranges cut at line ends; other files need the prefixes
+//and go through one parser. The strings are encoded in hash partitions, keeping where each one first
+//appears, and assignIDs() gives the IDs in that order, the same ones as the sequential build.
+class BulkLoader
+{
+public:
+	enum Kind { Entity = 0, Literal = 1, Predicate = 2 };
+
+	//_parallelism threads for each stage, 0 for the number of cores
+	BulkLoader(unsigned _parallelism);
+	~BulkLoader();
+
+	//Parse _rdf_file into tuples of temporary IDs in _tuple_file, the parse errors go to _error_log
+	bool encode(const std::string& _rdf_file, const std::string& _error_log, const std::string& _tuple_file);
+	bool assignIDs();
+	//The strings of a kind by ID(minus LITERAL_FIRST_ID for literals), valid until releaseStrings()
+	const std::vector<const std::string*>& getStrings(Kind _kind) const { return this->strings[_kind]; }
+	void releaseStrings();
+	TYPE_TRIPLE_NUM getTripleNum() const { return this->triple_num; }
+	TYPE_ENTITY_LITERAL_ID getSubjectNum() const { return this->subject_num; }	//Entities first seen as subjects
+	//Read _tuple_file back with the IDs given by assignIDs() and empty it
+	ID_TUPLE* readTuples(const std::string& _tuple_file);
+	//Or give _tuple_file the final IDs in place, _memory_budget bytes at a time
+	bool remapTuples(const std::string& _tuple_file, unsigned long long _memory_budget);
+
+	//Print the time and throughput of a stage
+	static void report(const char* _stage, unsigned long long _num, const char* _unit, long _ms);
+
+private:
+	//A temporary ID is the partition and the index in it, with the literal flag for objects
+	static const unsigned PARTITION_BITS = 6;
+	static const unsigned PARTITION_NUM = 1 << PARTITION_BITS;
+	static const unsigned LOCAL_BITS = 25;
+	static const unsigned LITERAL_FLAG = 1U << 31;
+	static const size_t BATCH_BYTES = 256 << 20;	//Bytes of an N-Triples batch
+	static const int BATCH_TRIPLES = 2 << 20;	//Triples of a batch from one parser
+	static const unsigned RANGES_PER_WORKER = 4;
+	static const unsigned CHUNK_TRIPLES = 1 << 16;	//Triples per task when partitioning a batch
+
+	struct Partition
+	{
+		std::unordered_map<std::string, unsigned> index[3];	//String to index, for each kind
+		std::vector<TYPE_TRIPLE_NUM> first[3];	//Position first seen(triple * 3 + 0/1/2 for s/p/o)
+		std::vector<unsigned> id[3];	//Final ID, by index
+	};
+	struct Batch
+	{
+		std::vector<TripleWithObjType> triples;
+		std::string errors;
+		unsigned long long bytes;
+	};
+
+	BulkLoader(const BulkLoader&);
+	BulkLoader& operator=(const BulkLoader&);
+
+	bool parseRanges(FILE* _fp, Batch& _batch);
+	bool parseStream(RDFParser& _parser, Batch& _batch);
+	bool encodeBatch(Batch& _batch, FILE* _fp);
+	void mapIDs(ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num);
+	void releaseIDs();
+	static unsigned partitionOf(const std::string& _str);
+
+	WorkStealingPool parse_pool;
+	WorkStealingPool encode_pool;
+	Partition partitions[PARTITION_NUM];
+	std::vector<const std::string*> strings[3];
+	TYPE_TRIPLE_NUM triple_num;
+	TYPE_ENTITY_LITERAL_ID subject_num;
+	std::string carry;	//The incomplete line at the end of the last N-Triples batch
+	int line_num;
+};
+
+#endif //_DATABASE_BULKLOADER_H
@@ -1,39 +1,322 @@
 #include "CSR.h"
+#include "../KVstore/KVstore.h"
+#include "../Util/WorkStealingPool.h"
 
 using namespace std;
 
-CSR::CSR()
+static const char CSR_MAGIC[8] = { 'G', 'C', 'S', 'R', '0', '0', '0', '1' };
+
+void CSRArray::assign(vector<unsigned> &v)
+{
+	owned.swap(v);
+	v.clear();
+	data = owned.empty() ? NULL : &owned[0];
+	len = owned.size();
+}
+
+void CSRArray::map(const unsigned *_data, size_t _len)
+{
+	vector<unsigned>().swap(owned);
+	data = _data;
+	len = _len;
+}
+
+NeighborCache::NeighborCache(unsigned long long _capacity)
+{
+	this->shard_capacity = _capacity / NeighborCache::SHARD_NUM;
+	for (unsigned i = 0; i < NeighborCache::SHARD_NUM; i++)
+		this->shards[i].bytes = 0;
+}
+
+NeighborCache::List NeighborCache::get(unsigned vid)
+{
+	Shard &s = this->shards[vid % NeighborCache::SHARD_NUM];
+	s.lock.lock();
+	unordered_map<unsigned, list<Entry>::iterator>::iterator it = s.index.find(vid);
+	if (it == s.index.end())
+	{
+		s.lock.unlock();
+		return List();
+	}
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+	List ret = it->second->list;
+	s.lock.unlock();
+	return ret;
+}
+
+void NeighborCache::put(unsigned vid, const List &list)
+{
+	unsigned long long size = list->size() * sizeof(unsigned) + NeighborCache::ENTRY_OVERHEAD;
+	if (size > this->shard_capacity)
+		return;
+	Shard &s = this->shards[vid % NeighborCache::SHARD_NUM];
+	s.lock.lock();
+	if (s.index.find(vid) == s.index.end())
+	{
+		while (s.bytes + size > this->shard_capacity)
+		{
+			// Readers still holding the list keep it alive
+			Entry &victim = s.lru.back();
+			s.bytes -= victim.list->size() * sizeof(unsigned) + NeighborCache::ENTRY_OVERHEAD;
+			s.index.erase(victim.vid);
+			s.lru.pop_back();
+		}
+		s.lru.push_front(Entry());
+		s.lru.front().vid = vid;
+		s.lru.front().list = list;
+		s.index[vid] = s.lru.begin();
+		s.bytes += size;
+	}
+	s.lock.unlock();
+}
+
+void NeighborCache::clear()
 {
+	for (unsigned i = 0; i < NeighborCache::SHARD_NUM; i++)
+	{
+		Shard &s = this->shards[i];
+		s.lock.lock();
+		s.lru.clear();
+		s.index.clear();
+		s.bytes = 0;
+		s.lock.unlock();
+	}
+}
 
+CSR::CSR()
+{
+	this->pre_num = 0;
+	this->id2vid = NULL;
+	this->offset_list = NULL;
+	this->adjacency_list = NULL;
+	this->mmap_addr = NULL;
+	this->mmap_len = 0;
+	this->neighbors = NULL;
 }
 
 CSR::CSR(unsigned pnum)
 {
-	this->w = 4;
-	this->pre_num = pnum;
-	this->id2vid = new vector<unsigned>[this->pre_num];
-	this->vid2id = new map<unsigned, unsigned>[this->pre_num];
-	this->offset_list = new vector<unsigned>[this->pre_num];
-	this->adjacency_list = new vector<unsigned>[this->pre_num];
-	// this->valid = new bool[this->pre_num];
+	this->id2vid = NULL;
+	this->offset_list = NULL;
+	this->adjacency_list = NULL;
+	this->mmap_addr = NULL;
+	this->mmap_len = 0;
+	this->neighbors = NULL;
+	this->init(pnum);
 }
 
 CSR::~CSR()
 {
-	
+	this->release();
+}
+
+void CSR::release()
+{
+	delete[] this->id2vid;
+	delete[] this->offset_list;
+	delete[] this->adjacency_list;
+	this->id2vid = NULL;
+	this->offset_list = NULL;
+	this->adjacency_list = NULL;
+	if (this->mmap_addr != NULL)
+		munmap(this->mmap_addr, this->mmap_len);
+	this->mmap_addr = NULL;
+	this->mmap_len = 0;
+	delete this->neighbors;
+	this->neighbors = NULL;
+	lock_guard<mutex> guard(this->walk_index_lock);
+	this->walk_indexes.clear();
 }
 
 void CSR::init(unsigned pnum)
 {
+	this->release();
 	this->w = 4;
 	this->pre_num = pnum;
-	this->id2vid = new vector<unsigned>[this->pre_num];
-	this->vid2id = new map<unsigned, unsigned>[this->pre_num];
-	this->offset_list = new vector<unsigned>[this->pre_num];
-	this->adjacency_list = new vector<unsigned>[this->pre_num];
+	this->id2vid = new CSRArray[this->pre_num];
+	this->offset_list = new CSRArray[this->pre_num];
+	this->adjacency_list = new CSRArray[this->pre_num];
+	string cache_size = Util::getConfigureValue("neighbor_cache_size");
+	this->neighbors = new NeighborCache((cache_size.empty() ? 256 : atoll(cache_size.c_str())) << 20);
 	// this->valid = new bool[this->pre_num];
 }
 
+int CSR::getIndex(unsigned vid, unsigned pred) const
+{
+	const unsigned *first = this->id2vid[pred].begin(), *last = this->id2vid[pred].end();
+	const unsigned *it = lower_bound(first, last, vid);
+	if (it == last || *it != vid)
+		return -1;
+	return it - first;
+}
+
+// Fill csr[0] and csr[1] for one predicate from its (subject, object) pairs
+static void buildPredicate(CSR *csr, KVstore *kvstore, unsigned pred)
+{
+	unsigned *so = NULL;
+	unsigned len = 0;
+	kvstore->getsubIDobjIDlistBypreID(pred, so, len);
+	unsigned num = len / 2;
+	vector<unsigned long long> pairs;
+	pairs.reserve(num);
+	for (int dir = 0; dir < 2; dir++)
+	{
+		// (source, neighbor) in the high and low halves, sorted
+		pairs.clear();
+		for (unsigned i = 0; i < num; i++)
+		{
+			unsigned sub = so[2 * i], obj = so[2 * i + 1];
+			if (obj >= Util::LITERAL_FIRST_ID)
+				continue;
+			if (dir == 0)
+				pairs.push_back(((unsigned long long)sub << 32) | obj);
+			else
+				pairs.push_back(((unsigned long long)obj << 32) | sub);
+		}
+		if (!is_sorted(pairs.begin(), pairs.end()))
+			sort(pairs.begin(), pairs.end());
+
+		vector<unsigned> ids, offsets, adjacency;
+		adjacency.reserve(pairs.size());
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			unsigned vid = pairs[i] >> 32;
+			if (ids.empty() || ids.back() != vid)
+			{
+				ids.push_back(vid);
+				offsets.push_back(adjacency.size());
+			}
+			adjacency.push_back((unsigned)pairs[i]);
+		}
+		offsets.push_back(adjacency.size());
+		ids.shrink_to_fit();
+		offsets.shrink_to_fit();
+		csr[dir].id2vid[pred].assign(ids);
+		csr[dir].offset_list[pred].assign(offsets);
+		csr[dir].adjacency_list[pred].assign(adjacency);
+	}
+	delete[] so;
+}
+
+bool CSR::build(CSR *csr, KVstore *kvstore, unsigned pnum)
+{
+	csr[0].init(pnum);
+	csr[1].init(pnum);
+	WorkStealingPool pool(0);
+	pool.run(pnum, [csr, kvstore](unsigned, unsigned long pred)
+	{
+		buildPredicate(csr, kvstore, pred);
+	});
+	return true;
+}
+
+bool CSR::save(CSR *csr, const string &file, TYPE_TRIPLE_NUM triple_num)
+{
+	string tmp = file + "_tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "error, can not create CSR file. @CSR::save" << endl;
+		return false;
+	}
+	unsigned pnum = csr[0].pre_num;
+	fwrite(CSR_MAGIC, sizeof(CSR_MAGIC), 1, fp);
+	fwrite(&triple_num, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+	fwrite(&pnum, sizeof(unsigned), 1, fp);
+	for (int dir = 0; dir < 2; dir++)
+	{
+		for (unsigned i = 0; i < pnum; i++)
+		{
+			unsigned num[2] = { (unsigned)csr[dir].id2vid[i].size(), (unsigned)csr[dir].adjacency_list[i].size() };
+			fwrite(num, sizeof(unsigned), 2, fp);
+		}
+	}
+	bool ok = true;
+	for (int dir = 0; dir < 2; dir++)
+	{
+		for (unsigned i = 0; i < pnum; i++)
+		{
+			const CSRArray *arrays[3] = { &csr[dir].id2vid[i], &csr[dir].offset_list[i], &csr[dir].adjacency_list[i] };
+			for (int k = 0; k < 3; k++)
+			{
+				if (!arrays[k]->empty())
+					ok = ok && fwrite(arrays[k]->begin(), sizeof(unsigned), arrays[k]->size(), fp) == arrays[k]->size();
+			}
+		}
+	}
+	Util::Csync(fp);
+	fclose(fp);
+	if (!ok || rename(tmp.c_str(), file.c_str()) != 0)
+	{
+		cout << "error, can not write CSR file. @CSR::save" << endl;
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool CSR::load(CSR *csr, const string &file, TYPE_TRIPLE_NUM triple_num)
+{
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	size_t header = sizeof(CSR_MAGIC) + sizeof(TYPE_TRIPLE_NUM) + sizeof(unsigned);
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < header)
+	{
+		close(fd);
+		return false;
+	}
+	size_t len = st.st_size;
+	char *addr = (char *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+
+	TYPE_TRIPLE_NUM file_triple_num;
+	unsigned pnum;
+	memcpy(&file_triple_num, addr + sizeof(CSR_MAGIC), sizeof(TYPE_TRIPLE_NUM));
+	memcpy(&pnum, addr + sizeof(CSR_MAGIC) + sizeof(TYPE_TRIPLE_NUM), sizeof(unsigned));
+	// The arrays start right after the counts, all of unsigned
+	const unsigned *num = (const unsigned *)(addr + header);
+	size_t pos = header + 4 * (size_t)pnum * sizeof(unsigned);
+	bool ok = memcmp(addr, CSR_MAGIC, sizeof(CSR_MAGIC)) == 0 && file_triple_num == triple_num && pos <= len;
+	if (!ok)
+	{
+		cout << "the CSR file is out of date, it will be built again" << endl;
+		munmap(addr, len);
+		return false;
+	}
+	size_t total = pos;
+	for (size_t i = 0; i < 2 * (size_t)pnum; i++)
+		total += (2 * (size_t)num[2 * i] + 1 + num[2 * i + 1]) * sizeof(unsigned);
+	if (total != len)
+	{
+		cout << "error, broken CSR file. @CSR::load" << endl;
+		munmap(addr, len);
+		return false;
+	}
+
+	csr[0].init(pnum);
+	csr[1].init(pnum);
+	for (int dir = 0; dir < 2; dir++)
+	{
+		for (unsigned i = 0; i < pnum; i++)
+		{
+			size_t vnum = num[2 * (dir * pnum + i)], enum_ = num[2 * (dir * pnum + i) + 1];
+			csr[dir].id2vid[i].map((const unsigned *)(addr + pos), vnum);
+			pos += vnum * sizeof(unsigned);
+			csr[dir].offset_list[i].map((const unsigned *)(addr + pos), vnum + 1);
+			pos += (vnum + 1) * sizeof(unsigned);
+			csr[dir].adjacency_list[i].map((const unsigned *)(addr + pos), enum_);
+			pos += enum_ * sizeof(unsigned);
+		}
+	}
+	csr[0].mmap_addr = addr;
+	csr[0].mmap_len = len;
+	return true;
+}
+
 // void CSR::compress(unsigned w)
 // {
 // 	for(unsigned i=0; i<this->pre_num; ++i)
@@ -87,6 +370,44 @@ void CSR::init(unsigned pnum)
 // 	}
 // }
 
+NeighborCache::List CSR::getDistinctNeighbors(unsigned vid)
+{
+	NeighborCache::List ret;
+	if (this->neighbors != NULL && (ret = this->neighbors->get(vid)))
+		return ret;
+	// Built outside the lock, two threads may build the same list at the same time
+	vector<unsigned> *nbrs = new vector<unsigned>;
+	for (unsigned pred = 0; pred < this->pre_num; pred++)
+	{
+		int index = this->getIndex(vid, pred);
+		if (index != -1)
+			nbrs->insert(nbrs->end(), this->adjacency_list[pred].begin() + this->offset_list[pred][index], \
+				this->adjacency_list[pred].begin() + this->offset_list[pred][index + 1]);
+	}
+	sort(nbrs->begin(), nbrs->end());
+	nbrs->erase(unique(nbrs->begin(), nbrs->end()), nbrs->end());
+	nbrs->shrink_to_fit();
+	ret.reset(nbrs);
+	if (this->neighbors != NULL)
+		this->neighbors->put(vid, ret);
+	return ret;
+}
+
+shared_ptr<const PPRWalkIndex> CSR::getPPRWalkIndex(const vector<int> &preds)
+{
+	lock_guard<mutex> guard(this->walk_index_lock);
+	map<vector<int>, shared_ptr<const PPRWalkIndex> >::iterator it = this->walk_indexes.find(preds);
+	if (it == this->walk_indexes.end())
+		return shared_ptr<const PPRWalkIndex>();
+	return it->second;
+}
+
+void CSR::putPPRWalkIndex(const vector<int> &preds, const shared_ptr<const PPRWalkIndex> &index)
+{
+	lock_guard<mutex> guard(this->walk_index_lock);
+	this->walk_indexes[preds] = index;
+}
+
 void CSR::print()
 {
 	int i, j;
@@ -118,7 +439,7 @@ long long CSR::sizeInBytes()
 {
 	long long sz = 0;
 	for (int i = 0; i < pre_num; i++)
-		sz += 2 * id2vid[i].size() + offset_list[i].size() + adjacency_list[i].size();
-	sz *= 8;
+		sz += id2vid[i].size() + offset_list[i].size() + adjacency_list[i].size();
+	sz *= sizeof(unsigned);
 	return sz;
 }
\ No newline at end of file
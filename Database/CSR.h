@@ -1,4 +1,5 @@
 #include "../Util/Util.h"
+#include "../Util/SpinLock.h"
 // #include <unordered_map>
 // #include <set>
 // #include <ctime>
@@ -12,7 +13,67 @@
 // #include <cmath>
 
 #ifndef _DATABASE_CSR_H
-#define _DATABASE_CSR_H 
+#define _DATABASE_CSR_H
+
+class KVstore;
+
+// A read-only array of unsigned, either owned or pointing into the mapped CSR file
+class CSRArray
+{
+public:
+	CSRArray() : data(NULL), len(0) {}
+	unsigned operator[](size_t i) const { return data[i]; }
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	const unsigned *begin() const { return data; }
+	const unsigned *end() const { return data + len; }
+	void assign(std::vector<unsigned> &v);	// Take over the content of v
+	void map(const unsigned *_data, size_t _len);
+private:
+	CSRArray(const CSRArray&);
+	CSRArray& operator=(const CSRArray&);
+	std::vector<unsigned> owned;
+	const unsigned *data;
+	size_t len;
+};
+
+// Distinct neighbors of vertices over all predicates, in increasing order, kept
+// up to a capacity in bytes(evicting the least recently used) and shared by queries
+class NeighborCache
+{
+public:
+	typedef std::shared_ptr<const std::vector<unsigned> > List;
+	NeighborCache(unsigned long long _capacity);
+	List get(unsigned vid);	// NULL if not cached
+	void put(unsigned vid, const List &list);
+	void clear();
+private:
+	static const unsigned SHARD_NUM = 64;
+	static const unsigned ENTRY_OVERHEAD = 64;	// Bookkeeping bytes counted for each entry
+	struct Entry
+	{
+		unsigned vid;
+		List list;
+	};
+	struct Shard
+	{
+		spinlock lock;
+		std::list<Entry> lru;	// Most recently used first
+		std::unordered_map<unsigned, std::list<Entry>::iterator> index;
+		unsigned long long bytes;
+	};
+	NeighborCache(const NeighborCache&);
+	NeighborCache& operator=(const NeighborCache&);
+	Shard shards[SHARD_NUM];
+	unsigned long long shard_capacity;
+};
+
+// Random walks for SSPPR over one predicate set, a fixed number from each vertex
+struct PPRWalkIndex
+{
+	std::vector<unsigned long long> offset;	// Walks from vertex v end at dest[offset[v]] to dest[offset[v + 1] - 1]
+	std::vector<int> dest;
+};
 
 class CSR
 {
@@ -21,10 +82,9 @@ public:
 	unsigned w;
 
 	// One for each predicate
-	std::vector<unsigned> *id2vid;	// Index to subject/object ID
-    std::map<unsigned, unsigned> *vid2id;	// Subject/object ID to index
-	std::vector<unsigned> *offset_list;	// Offset in adjacency list
-	std::vector<unsigned> *adjacency_list;
+	CSRArray *id2vid;	// Index to subject/object ID, in increasing order
+	CSRArray *offset_list;	// Offset in adjacency list, one more at the end
+	CSRArray *adjacency_list;
 	// bool *valid;
 	CSR();
 	CSR(unsigned pnum);
@@ -32,9 +92,36 @@ public:
 	void init(unsigned pnum);
 	// void compress(unsigned w);
 
+	int getIndex(unsigned vid, unsigned pred) const;	// Index of vid in id2vid[pred], -1 if not there
+	unsigned getDegree(int index, unsigned pred) const
+	{ return offset_list[pred][index + 1] - offset_list[pred][index]; }
+	// Neighbors of vid by any predicate, built on first use and cached(neighbor_cache_size in init.conf),
+	// safe to call from many threads
+	NeighborCache::List getDistinctNeighbors(unsigned vid);
+	// Walk indexes built by PathQueryHandler, by the sorted predicate set, kept until release
+	std::shared_ptr<const PPRWalkIndex> getPPRWalkIndex(const std::vector<int> &preds);
+	void putPPRWalkIndex(const std::vector<int> &preds, const std::shared_ptr<const PPRWalkIndex> &index);
+
 	void print();	// Feel free to modify this for testing
 	long long sizeInBytes();
+
+	// csr[0] holds the out-edges and csr[1] the in-edges, both between entities.
+	// build() reads each predicate's list in preID2values, in parallel;
+	// save() writes them to one file and load() maps that file read-only,
+	// failing if it is missing or was written for another triple number.
+	static bool build(CSR *csr, KVstore *kvstore, unsigned pnum);
+	static bool save(CSR *csr, const std::string &file, TYPE_TRIPLE_NUM triple_num);
+	static bool load(CSR *csr, const std::string &file, TYPE_TRIPLE_NUM triple_num);
+
+private:
+	void release();
+
+	// The file mapped by load(), shared by csr[0] and csr[1] and unmapped by csr[0]
+	char *mmap_addr;
+	size_t mmap_len;
+	NeighborCache *neighbors;
+	std::mutex walk_index_lock;
+	std::map<std::vector<int>, std::shared_ptr<const PPRWalkIndex> > walk_indexes;
 };
 
 #endif //_DATABASE_CSR_H
-
@@ -7,6 +7,7 @@
 =============================================================================*/
 
 #include "Database.h"
+#include "BulkLoader.h"
 
 using namespace rapidjson;
 using namespace std;
@@ -20,8 +21,9 @@ Database::Database()
 	this->six_tuples_file = "six_tuples";
 	this->db_info_file = "db_info_file.dat";
 	this->id_tuples_file = "id_tuples";
-	this->update_log = "update.log";
-	this->update_log_since_backup = "update_since_backup.log";
+	this->update_log = "update.wal";
+	this->update_log_since_backup = "update_since_backup.wal";
+	this->update_wal = new UpdateLog();
 	// this->csr = new CSR[2];
 
 	string kv_store_path = store_path + "/kv_store";
@@ -35,6 +37,7 @@ Database::Database()
 	this->stringindex->SetTrie(this->kvstore->getTrie());
 	//this->encode_mode = Database::STRING_MODE;
 	this->encode_mode = Database::ID_MODE;
+	this->value_format = KVstore::VALUE_FORMAT_RAW;
 	this->is_active = false;
 	this->sub_num = 0;
 	this->pre_num = 0;
@@ -46,12 +49,15 @@ Database::Database()
 	this->pre2num = NULL;
 	this->pre2sub = NULL;
 	this->pre2obj = NULL;
+	this->statistics = NULL;
+	this->csr = NULL;
 	this->entity_buffer = NULL;
 	this->entity_buffer_size = 0;
 	this->literal_buffer = NULL;
 	this->literal_buffer_size = 0;
 
 	this->query_cache = new QueryCache();
+	this->plan_cache = new PlanCache();
 
 	this->if_loaded = false;
 
@@ -59,6 +65,7 @@ Database::Database()
 
 	//this->resetIDinfo();
 	this->initIDinfo();
+	this->values_read_only = false;
 
 	pthread_rwlock_init(&(this->update_lock), NULL);
 }
@@ -77,8 +84,9 @@ Database::Database(string _name)
 	this->six_tuples_file = "six_tuples";
 	this->db_info_file = "db_info_file.dat";
 	this->id_tuples_file = "id_tuples";
-	this->update_log = "update.log";
-	this->update_log_since_backup = "update_since_backup.log";
+	this->update_log = "update.wal";
+	this->update_log_since_backup = "update_since_backup.wal";
+	this->update_wal = new UpdateLog();
 	// this->csr = new CSR[2];
 
 	string kv_store_path = store_path + "/kv_store";
@@ -91,6 +99,7 @@ Database::Database(string _name)
 	this->stringindex->SetTrie(this->kvstore->getTrie());
 	//this->encode_mode = Database::STRING_MODE;
 	this->encode_mode = Database::ID_MODE;
+	this->value_format = KVstore::VALUE_FORMAT_RAW;
 	this->is_active = false;
 	this->sub_num = 0;
 	this->pre_num = 0;
@@ -104,17 +113,21 @@ Database::Database(string _name)
 	this->pre2num = NULL;
 	this->pre2sub = NULL;
 	this->pre2obj = NULL;
+	this->statistics = NULL;
+	this->csr = NULL;
 	this->entity_buffer = NULL;
 	this->entity_buffer_size = 0;
 	this->literal_buffer = NULL;
 	this->literal_buffer_size = 0;
 
 	this->query_cache = new QueryCache();
+	this->plan_cache = new PlanCache();
 
 	//this->trie = NULL;
 
 	//this->resetIDinfo();
 	this->initIDinfo();
+	this->values_read_only = false;
 
 	pthread_rwlock_init(&(this->update_lock), NULL);
 }
@@ -552,6 +565,8 @@ Database::~Database()
 {
 	pthread_rwlock_destroy(&(this->update_lock));
 	this->unload();
+	delete this->plan_cache;
+	delete this->update_wal;
 	//fclose(Util::debug_database);
 	//Util::debug_database = NULL;	//debug: when multiple databases
 }
@@ -621,6 +636,66 @@ Database::setPreMap()
 
 }
 
+void
+Database::loadStatistics()
+{
+	delete this->statistics;
+	this->statistics = new Statistics;
+	if (this->statistics->load(this->getStatisticsFile()))
+	{
+		cout << "load statistics successfully!" << endl;
+		return;
+	}
+	//built by older versions, joins keep the greedy order
+	delete this->statistics;
+	this->statistics = NULL;
+}
+
+//keep the updates counted since the build, so they are still stale after a reload
+void
+Database::saveStatistics()
+{
+	if (this->statistics != NULL && this->statistics->isChanged())
+		this->statistics->save(this->getStatisticsFile());
+}
+
+void
+Database::loadCSR()
+{
+	long begin_time = Util::get_cur_time();
+	delete[] this->csr;
+	this->csr = new CSR[2];
+	if (CSR::load(this->csr, this->getCSRFile(), this->triples_num))
+	{
+		cout << "CSR is mapped from " << this->getCSRFile() << ", used " << Util::get_cur_time() - begin_time << "ms" << endl;
+		return;
+	}
+	unsigned pre_num = this->getStringIndex()->getNum(StringIndexFile::Predicate);
+	cout << "pre_num: " << pre_num << endl;
+	CSR::build(this->csr, this->kvstore, pre_num);
+	cout << "after creating CSR, used " << Util::get_cur_time() - begin_time << "ms" << endl;
+	cout << "CSR size = " << csr[0].sizeInBytes() + csr[1].sizeInBytes() << " (bytes)" << endl;
+	//map it in the next loads
+	CSR::save(this->csr, this->getCSRFile(), this->triples_num);
+}
+
+//the saved CSR does not follow updates, it is built again at the next load
+void
+Database::invalidateCSR()
+{
+	unlink(this->getCSRFile().c_str());
+}
+
+//the cached results which read the predicates of the updated triples are dropped, the others are kept
+void
+Database::invalidateQueryCache(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num)
+{
+	set<string> predicates;
+	for (TYPE_TRIPLE_NUM i = 0; i < _triple_num; ++i)
+		predicates.insert(_triples[i].predicate);
+	this->query_cache->invalidate(vector<string>(predicates.begin(), predicates.end()));
+}
+
 void
 Database::setStringBuffer()
 {
@@ -722,9 +797,14 @@ Database::load(bool loadCSR)
 #ifndef ONLY_READ
 	thread id2predicate_thread(&Database::load_id2predicate, this, kv_mode);
 #endif
-	thread sub2values_thread(&Database::load_sub2values, this, kv_mode);
-	thread obj2values_thread(&Database::load_obj2values, this, kv_mode);
-	thread pre2values_thread(&Database::load_pre2values, this, kv_mode);
+	//for query servers, map the values laid out contiguously instead of caching them
+	int values_mode = kv_mode;
+	this->values_read_only = Util::getConfigureValue("value_mmap") == "true";
+	if (this->values_read_only)
+		values_mode = KVstore::READ_ONLY_MODE;
+	thread sub2values_thread(&Database::load_sub2values, this, values_mode);
+	thread obj2values_thread(&Database::load_obj2values, this, values_mode);
+	thread pre2values_thread(&Database::load_pre2values, this, values_mode);
 #endif
 	
 	//this is very fast
@@ -759,6 +839,7 @@ Database::load(bool loadCSR)
 #endif
 	this->setPreMap();
 	//cout<<"set Pre Map Successfully!"<<endl;
+	this->loadStatistics();
 
 #ifdef THREAD_ON
 	id2entity_thread.join();
@@ -820,6 +901,11 @@ Database::load(bool loadCSR)
 		return false;
 	}*/
 
+	if (!this->update_wal->open(this->store_path + '/' + this->update_log, this->store_path + '/' + this->update_log_since_backup))
+	{
+		return false;
+	}
+
 	this->if_loaded = true;
 
 	cout << "finish load" << endl;
@@ -836,122 +922,7 @@ Database::load(bool loadCSR)
 #endif
 
 	if (loadCSR)
-	{
-		this->csr = new CSR[2];
-		unsigned pre_num = this->getStringIndex()->getNum(StringIndexFile::Predicate);
-		this->csr[0].init(pre_num);
-		this->csr[1].init(pre_num);	
-		cout<<"pre_num: "<<pre_num<<endl;
-		long begin_time = Util::get_cur_time();
-
-		// Process out-edges (csr[0])
-		// i: predicate; j: subject; k: object
-		for(unsigned i = 0;i<pre_num;i++)
-		{
-			string pre = (this->getKVstore())->getPredicateByID(i);
-			cout<<"pid: "<<i<<"    pre: "<<pre<<endl;
-			unsigned* sublist = NULL;
-			unsigned sublist_len = 0;
-			bool ret = (this->getKVstore())->getsubIDlistBypreID(i, sublist, sublist_len, true);
-			//cout<<"    sub_num: "<<sublist_len<<endl;
-			unsigned offset = 0;
-			unsigned index = 0;
-			for(unsigned j=0;j<sublist_len;j++)
-			{
-				string sub = (this->getKVstore())->getEntityByID(sublist[j]);
-				//cout<<"    sid: "<<sublist[j]<<"    sub: "<<sub<<endl;
-				unsigned* objlist = NULL;
-				unsigned objlist_len = 0;
-				bool ret = (this->getKVstore())->getobjIDlistBysubIDpreID(sublist[j], i, objlist, objlist_len); 
-				unsigned len = objlist_len;	// the real object list length
-				for(unsigned k=0;k<objlist_len;k++)
-				{
-					if(objlist[k]>=2000000000)
-					{
-						--len;
-						continue;
-					}
-					string obj = (this->getKVstore())->getEntityByID(objlist[k]);
-					//cout<<"        oid: "<<objlist[k]<<"    obj: "<<obj<<endl;
-					this->csr[0].adjacency_list[i].push_back(objlist[k]);
-				}
-				//cout<<"        obj_num: "<<len<<endl;
-				if(len > 0)
-				{
-					this->csr[0].id2vid[i].push_back(sublist[j]);
-					this->csr[0].vid2id[i].insert(pair<unsigned, unsigned>(sublist[j], index));
-					this->csr[0].offset_list[i].push_back(offset);
-					index++;
-					offset += len;
-				}
-			}
-			// if(this->csr[0].offset_list[i].size() == 0)
-			// 	this->csr[0].valid[i] = false;
-			// else
-			// {
-			// 	if((i==3)||(i==4))
-			// 		this->csr[0].valid[i] = true;
-			// 	else
-			// 		this->csr[0].valid[i] = false;
-			// }
-			cout<<this->csr[0].offset_list[i].size()<<endl;	// # of this predicate's subjects
-			cout<<this->csr[0].adjacency_list[i].size()<<endl;	// # of this predicate's objects
-		}
-
-		// Process out-edges (csr[1])
-		// i: predicate; j: object; k: subject
-		for(unsigned i = 0;i<pre_num;i++)
-		{
-			string pre = (this->getKVstore())->getPredicateByID(i);
-			cout<<"pid: "<<i<<"    pre: "<<pre<<endl;
-			unsigned* objlist = NULL;
-			unsigned objlist_len = 0;
-			bool ret = (this->getKVstore())->getobjIDlistBypreID(i, objlist, objlist_len, true);
-			//cout<<"    obj_num: "<<objlist_len<<endl;
-			unsigned offset = 0;
-			unsigned index = 0;
-			for(unsigned j=0;j<objlist_len;j++)
-			{
-				if(objlist[j]>=2000000000)
-					continue;
-				string obj = (this->getKVstore())->getEntityByID(objlist[j]);
-				//cout<<"    oid: "<<objlist[j]<<"    obj: "<<obj<<endl;
-				unsigned* sublist = NULL;
-				unsigned sublist_len = 0;
-				bool ret = (this->getKVstore())->getsubIDlistByobjIDpreID(objlist[j], i, sublist, sublist_len); 
-				unsigned len = sublist_len;
-				for(unsigned k=0;k<sublist_len;k++)
-				{
-					string sub = (this->getKVstore())->getEntityByID(sublist[k]);
-					//cout<<"        sid: "<<sublist[k]<<"    sub: "<<sub<<endl;
-					this->csr[1].adjacency_list[i].push_back(sublist[k]);
-				}
-				//cout<<"        sub_num: "<<len<<endl;
-				if(len > 0)
-				{
-					this->csr[1].id2vid[i].push_back(objlist[j]);
-					this->csr[1].vid2id[i].insert(pair<unsigned, unsigned>(objlist[j], index));
-					this->csr[1].offset_list[i].push_back(offset);
-					index++;
-					offset += len;
-				}
-			}
-			// if(this->csr[1].offset_list[i].size() == 0)
-			// 	this->csr[1].valid[i] = false;
-			// else
-			// {
-			// 	if((i==5)||(i==13)||(i==14)||(i==15))
-			// 		this->csr[1].valid[i] = true;
-			// 	else
-			// 		this->csr[1].valid[i] = false;
-			// }
-			cout<<this->csr[1].offset_list[i].size()<<endl;
-			cout<<this->csr[1].adjacency_list[i].size()<<endl;
-		}
-		long end_time = Util::get_cur_time();
-		cout << "after creating CSR, used " << (end_time - begin_time) << "ms" << endl;
-		cout << "CSR size = " << csr[0].sizeInBytes() + csr[1].sizeInBytes() << " (bytes)" << endl;
-	}
+		this->loadCSR();
 
 	return true;
 }
@@ -1019,6 +990,7 @@ Database::load_cache()
 		tmp = predicate->Mmap[off];
 	}
 	cout << "Value File Preload used " << Util::get_cur_time() - t0 << " ms" << endl;
+	this->warm_string_cache();
 	/*
 	cerr << "Get in" << endl;
 	{
@@ -1171,6 +1143,7 @@ Database::build_CacheOfObj2values()
 	while (!important_objID.empty())
 	{
 		this->kvstore->AddIntoObjCache(important_objID.top().key);
+		this->hot_string_ids.push_back(important_objID.top().key);
 		important_objID.pop();
 	}
 }
@@ -1182,10 +1155,25 @@ Database::build_CacheOfSub2values()
 	while (!important_subID.empty())
 	{
 		this->kvstore->AddIntoSubCache(important_subID.top().key);
+		this->hot_string_ids.push_back(important_subID.top().key);
 		important_subID.pop();
 	}
 }
 
+void
+Database::warm_string_cache()
+{
+	long t0 = Util::get_cur_time();
+	vector<unsigned> pre_ids(this->important_preID.begin(), this->important_preID.end());
+	unsigned warmed = this->stringindex->warmCache(pre_ids, false);
+	//the most important ones were popped last, an id both important as
+	//subject and object is only cached once
+	vector<unsigned> ids(this->hot_string_ids.rbegin(), this->hot_string_ids.rend());
+	warmed += this->stringindex->warmCache(ids, true);
+	this->hot_string_ids.clear();
+	cout << "string cache warmed with " << warmed << " strings, used " << Util::get_cur_time() - t0 << " ms" << endl;
+}
+
 void
 Database::get_important_subID()
 {
@@ -1529,6 +1517,13 @@ Database::unload()
 	this->pre2sub = NULL;
 	delete[] this->pre2obj;
 	this->pre2obj = NULL;
+	this->saveStatistics();
+	delete this->statistics;
+	this->statistics = NULL;
+	this->plan_cache->invalidateJoinPlans();
+	this->query_cache->clear();
+	delete[] this->csr;
+	this->csr = NULL;
 	//cout << "delete entity buffer" << endl;
 	delete this->entity_buffer;
 	this->entity_buffer = NULL;
@@ -1552,6 +1547,7 @@ Database::unload()
 
 	this->if_loaded = false;
 	this->clear_update_log();
+	this->update_wal->close();
 
 	/*if (this->trie != NULL)
 	{
@@ -1572,6 +1568,7 @@ bool Database::save()
 	this->saveIDinfo();
 
 	this->stringindex->flush();
+	this->saveStatistics();
 	this->clear_update_log();
 
 	//cerr<<"database checkpoint: "<<this->getName()<<endl;
@@ -1587,6 +1584,8 @@ void Database::clear()
 	this->pre2sub = NULL;
 	delete[] this->pre2obj;
 	this->pre2obj = NULL;
+	delete this->statistics;
+	this->statistics = NULL;
 	delete this->entity_buffer;
 	this->entity_buffer = NULL;
 	delete this->literal_buffer;
@@ -1704,40 +1703,127 @@ Database::get_query_parse_lock()
 
 int
 Database::query(const string _query, ResultSet& _result_set, FILE* _fp, bool update_flag, bool export_flag, shared_ptr<Transaction> txn)
+{
+	return this->evaluate(_query, NULL, _result_set, _fp, update_flag, export_flag, txn);
+}
+
+bool
+Database::prepare(const string& _query, string& _statement_id, vector<string>& _parameters)
+{
+	string plan_key = PlanCache::normalize(_query);
+	PlanCache::Plan plan;
+	if (!this->plan_cache->get(plan_key, plan))
+	{
+		//parse errors are thrown as in query()
+		QueryParser query_parser;
+		query_parser.setQueryTree(&plan.query_tree);
+		try
+		{
+			query_parser.SPARQLParse(_query);
+		}
+		catch (const char* e)
+		{
+			cout << e << " @Database::prepare" << endl;
+			return false;
+		}
+		catch (const runtime_error& e)
+		{
+			throw runtime_error(e.what());
+		}
+		catch (...)
+		{
+			throw runtime_error("Some syntax errors in sparql");
+		}
+		plan.query_tree.getParameters(plan.parameters);
+		this->plan_cache->put(plan_key, plan);
+	}
+	_statement_id = this->plan_cache->addStatement(_query);
+	_parameters = plan.parameters;
+	return true;
+}
+
+int
+Database::execute(const string& _statement_id, const map<string, string>& _parameters, ResultSet& _result_set, FILE* _fp,
+	bool update_flag, bool export_flag, shared_ptr<Transaction> txn)
+{
+	string query;
+	if (!this->plan_cache->getStatement(_statement_id, query))
+	{
+		cout << "no prepared statement " << _statement_id << " @Database::execute" << endl;
+		return -101;
+	}
+	return this->evaluate(query, &_parameters, _result_set, _fp, update_flag, export_flag, txn);
+}
+
+bool
+Database::closeStatement(const string& _statement_id)
+{
+	return this->plan_cache->removeStatement(_statement_id);
+}
+
+PlanCache*
+Database::getPlanCache()
+{
+	return this->plan_cache;
+}
+
+int
+Database::evaluate(const string& _query, const map<string, string>* _parameters, ResultSet& _result_set, FILE* _fp,
+	bool update_flag, bool export_flag, shared_ptr<Transaction> txn)
 {
 	string dictionary_store_path = this->store_path + "/dictionary.dc"; 	
 
 	this->stringindex->SetTrie(this->kvstore->getTrie());
-	GeneralEvaluation general_evaluation(this->vstree, this->kvstore, this->stringindex, this->query_cache, \
+	//a transaction sees its own updates, which the others do not, so it does not share the query cache
+	GeneralEvaluation general_evaluation(this->vstree, this->kvstore, this->stringindex, txn == nullptr ? this->query_cache : NULL, \
 		this->pre2num, this->pre2sub, this->pre2obj, this->limitID_predicate, this->limitID_literal, \
-		this->limitID_entity, this->csr, txn);
+		this->limitID_entity, this->csr, txn, this->statistics);
 	if(txn != nullptr)
 	cout << "query in transaction............................................" << endl;
 	long tv_begin = Util::get_cur_time();
 
-	//this->query_parse_lock.lock();
-	bool parse_ret=false;
-	try
-	{
-		/* code */
-		parse_ret = general_evaluation.parseQuery(_query);
-	}
-	catch(const std::runtime_error& e2)
+	//a query parsed before is taken from the plan cache, with the join orders chosen for it
+	string plan_key = PlanCache::normalize(_query);
+	PlanCache::Plan plan;
+	bool parse_ret = this->plan_cache->get(plan_key, plan);
+	if (parse_ret)
 	{
-		cout<<"catch run_time error exception"<<endl;
-		throw std::runtime_error(e2.what());
-		std::cerr<<e2.what()<<"\n";
+		general_evaluation.setQueryTree(plan.query_tree);
+		cout << "the parsed query is taken from the plan cache" << endl;
 	}
-	catch(const std::exception& e)
+	else
 	{
-		std::cerr << e.what() << '\n';
+		//this->query_parse_lock.lock();
+		try
+		{
+			/* code */
+			parse_ret = general_evaluation.parseQuery(_query);
+		}
+		catch(const std::runtime_error& e2)
+		{
+			cout<<"catch run_time error exception"<<endl;
+			throw std::runtime_error(e2.what());
+			std::cerr<<e2.what()<<"\n";
+		}
+		catch(const std::exception& e)
+		{
+			std::cerr << e.what() << '\n';
+		}
+		//this->query_parse_lock.unlock();
+		if (!parse_ret)
+			return -101;
+		//the triples of INSERT/DELETE DATA are rarely the same again and may be many
+		QueryTree::UpdateType update_type = general_evaluation.getQueryTree().getUpdateType();
+		if (update_type != QueryTree::Insert_Data && update_type != QueryTree::Delete_Data)
+		{
+			plan.query_tree = general_evaluation.getQueryTree();
+			plan.query_tree.getParameters(plan.parameters);
+			this->plan_cache->put(plan_key, plan);
+		}
 	}
-	
-	
-	
-	//this->query_parse_lock.unlock();
-	if (!parse_ret)
+	if (_parameters != NULL && !general_evaluation.getQueryTree().bindParameters(*_parameters))
 		return -101;
+	general_evaluation.setJoinPlans(&plan.join_plans);
 	long tv_parse = Util::get_cur_time();
 	cout << "after Parsing, used " << (tv_parse - tv_begin) << "ms." << endl;
 	// cout << "QueryTree:" << endl;
@@ -1769,36 +1855,66 @@ Database::query(const string _query, ResultSet& _result_set, FILE* _fp, bool upd
 		//general_evaluation.setStringIndexPointer(&tmpsi);
 
 	//	this->debug_lock.lock();
-		if(export_flag)
+		//a query asked again before any update of its predicates is answered from the query cache
+		string result_key;
+		if (txn == nullptr && !export_flag && this->query_cache != NULL && !general_evaluation.getQueryTree().checkNondeterministic())
 		{
-			general_evaluation.fp = _fp;
-			general_evaluation.export_flag = export_flag;
+			result_key = plan_key;
+			if (_parameters != NULL)
+				for (map<string, string>::const_iterator it = _parameters->begin(); it != _parameters->end(); ++it)
+				{
+					result_key += '\0';
+					result_key += it->first;
+					result_key += '\0';
+					result_key += it->second;
+				}
 		}
-		bool query_ret = general_evaluation.doQuery();
-		if(!query_ret)
+		if (!result_key.empty() && this->query_cache->checkCachedResult(result_key, _result_set))
 		{
-			success_num = -101;
+			cout << "QueryCache hit the result" << endl;
 		}
-	//	this->debug_lock.unlock();
-
-		long tv_bfget = Util::get_cur_time();
-		//NOTICE: this lock lock ensures that StringIndex is visited sequentially
-		//this->getFinalResult_lock.lock();
-		/*
-		if (trie == NULL)
+		else
 		{
-			trie = new Trie;
-			string dictionary_path = this->store_path + "/dictionary.dc";
-			if (!trie->LoadTrie(dictionary_path))
+			vector<string> predicates;
+			bool all_predicates = !general_evaluation.getQueryTree().getPredicates(predicates);
+			unsigned long long cache_generation = this->query_cache != NULL ? this->query_cache->getGeneration() : 0;
+			long tv_bfquery = Util::get_cur_time();
+
+			if(export_flag)
 			{
-				exit(0);
+				general_evaluation.fp = _fp;
+				general_evaluation.export_flag = export_flag;
 			}
-			trie->LoadDictionary();
-		}*/
-		general_evaluation.getFinalResult(_result_set);
-		//this->getFinalResult_lock.unlock();
-		long tv_afget = Util::get_cur_time();
-		cout << "during getFinalResult, used " << (tv_afget - tv_bfget) << "ms." << endl;
+			bool query_ret = general_evaluation.doQuery();
+			if(!query_ret)
+			{
+				success_num = -101;
+			}
+		//	this->debug_lock.unlock();
+
+			long tv_bfget = Util::get_cur_time();
+			//NOTICE: this lock lock ensures that StringIndex is visited sequentially
+			//this->getFinalResult_lock.lock();
+			/*
+			if (trie == NULL)
+			{
+				trie = new Trie;
+				string dictionary_path = this->store_path + "/dictionary.dc";
+				if (!trie->LoadTrie(dictionary_path))
+				{
+					exit(0);
+				}
+				trie->LoadDictionary();
+			}*/
+			general_evaluation.getFinalResult(_result_set);
+			//this->getFinalResult_lock.unlock();
+			long tv_afget = Util::get_cur_time();
+			cout << "during getFinalResult, used " << (tv_afget - tv_bfget) << "ms." << endl;
+
+			if (!result_key.empty() && query_ret && this->query_cache->tryCachingResult(result_key, predicates, all_predicates,
+				_result_set, tv_afget - tv_bfquery, cache_generation))
+				cout << "QueryCache cached the result" << endl;
+		}
 
 		if(_fp != NULL)
 			need_output_answer = true;
@@ -1823,6 +1939,11 @@ Database::query(const string _query, ResultSet& _result_set, FILE* _fp, bool upd
 		//invalid query because updates are not allowed in ONLY_READ mode
 		return -101;
 #endif
+		if (this->values_read_only)
+		{
+			cout << "the values are mapped read-only(value_mmap), updates are not allowed" << endl;
+			return -101;
+		}
 		if(txn == nullptr && pthread_rwlock_trywrlock(&(this->update_lock)) != 0)
 		{
 			cout<<"unable to write lock"<<endl;
@@ -1917,16 +2038,12 @@ Database::query(const string _query, ResultSet& _result_set, FILE* _fp, bool upd
 		general_evaluation.releaseResult();
 		delete[] update_triple;
 
-		//NOTICE: maybe no updates are really done!
-		if(success_num > 0 && query_cache != nullptr)
-		{
-			this->query_cache->clear();
-			cout<<"QueryCache cleared"<<endl;
-		}
 		if(txn == nullptr)
 			pthread_rwlock_unlock(&(this->update_lock));
 	}
 
+	this->plan_cache->putJoinPlans(plan_key, plan);
+
 	long tv_final = Util::get_cur_time();
 	cout << "Query time used (minus parsing): " << tv_final - tv_parse << "ms." << endl;
 	cout << "Total time used: " << (tv_final - tv_begin) << "ms." << endl;
@@ -2147,6 +2264,18 @@ Database::getIDTuplesFile()
 	return this->getStorePath() + "/" + this->id_tuples_file;
 }
 
+string
+Database::getStatisticsFile()
+{
+	return this->getStorePath() + "/statistics.dat";
+}
+
+string
+Database::getCSRFile()
+{
+	return this->getStorePath() + "/csr.dat";
+}
+
 bool
 Database::saveDBInfoFile()
 {
@@ -2166,6 +2295,7 @@ Database::saveDBInfoFile()
 	fwrite(&this->pre_num, sizeof(TYPE_PREDICATE_ID), 1, filePtr);
 	fwrite(&this->literal_num, sizeof(TYPE_ENTITY_LITERAL_ID), 1, filePtr);
 	fwrite(&this->encode_mode, sizeof(int), 1, filePtr);
+	fwrite(&this->value_format, sizeof(int), 1, filePtr);
 
 	Util::Csync(filePtr);
 	fclose(filePtr);
@@ -2197,7 +2327,11 @@ Database::loadDBInfoFile()
 	fread(&this->pre_num, sizeof(TYPE_PREDICATE_ID), 1, filePtr);
 	fread(&this->literal_num, sizeof(TYPE_ENTITY_LITERAL_ID), 1, filePtr);
 	fread(&this->encode_mode, sizeof(int), 1, filePtr);
+	//db built by older versions has no value format
+	if (fread(&this->value_format, sizeof(int), 1, filePtr) != 1)
+		this->value_format = KVstore::VALUE_FORMAT_RAW;
 	fclose(filePtr);
+	this->kvstore->set_value_format(this->value_format);
 
 	//Util::triple_num = this->triples_num;
 	//Util::pre_num = this->pre_num;
@@ -2207,6 +2341,12 @@ Database::loadDBInfoFile()
 	return true;
 }
 
+void
+Database::setValueFormat(int _format)
+{
+	this->value_format = _format;
+}
+
 string
 Database::getStorePath()
 {
@@ -2514,6 +2654,14 @@ Database::encodeRDF_new(const string _rdf_file)
 	long t9 = Util::get_cur_time();
 	cout << "db info saved, used " << (t9 - t8) << "ms." << endl;
 
+	//the statistics are collected by build_s2xx and build_o2xx
+	if (this->statistics != NULL)
+	{
+		this->statistics->save(this->getStatisticsFile());
+		delete this->statistics;
+		this->statistics = NULL;
+	}
+
 	//Util::logging("finish encodeRDF_new");
 
 	return true;
@@ -2541,7 +2689,22 @@ Database::encodeRDF_new(const string _rdf_file,const string _error_log)
 	//(one way is to add a more structure to tell us which is entity, but this is costly)
 
 	//map sub2id, pre2id, entity/literal in obj2id, store in kvstore, encode RDF data into signature
-	if (!this->sub2id_pre2id_obj2id_RDFintoSignature(_rdf_file,_error_log))
+	//build_parallelism other than 1 uses the pipelined loader(0 for all cores)
+	unsigned parallelism = 1;
+	string parallelism_value = Util::getConfigureValue("build_parallelism");
+	if (!parallelism_value.empty() && atoi(parallelism_value.c_str()) >= 0)
+		parallelism = atoi(parallelism_value.c_str());
+	BulkLoader* loader = NULL;
+	if (parallelism != 1)
+	{
+		loader = new BulkLoader(parallelism);
+		if (!this->sub2id_pre2id_obj2id_parallel(_rdf_file, _error_log, *loader))
+		{
+			delete loader;
+			return false;
+		}
+	}
+	else if (!this->sub2id_pre2id_obj2id_RDFintoSignature(_rdf_file,_error_log))
 	{
 		return false;
 	}
@@ -2586,34 +2749,76 @@ Database::encodeRDF_new(const string _rdf_file,const string _error_log)
 	//after closing the 6 trees, read the id tuples again, and remove the file     given num, a dimension,return a pointer
 	//NOTICE: the file can also be used for debugging, and a program can start just from the id tuples file
 	//(if copy the 6 id2string trees, no need to parse each time)
-	this->readIDTuples(_p_id_tuples);
+	//build_memory(in MB) other than 0 sorts the id tuples on disk within it instead of reading them all
+	unsigned long long memory_budget = 0;
+	string memory_value = Util::getConfigureValue("build_memory");
+	if (!memory_value.empty() && atoll(memory_value.c_str()) > 0)
+		memory_budget = (unsigned long long)atoll(memory_value.c_str()) << 20;
+	long t8;
+	if (memory_budget > 0)
+	{
+		if (loader != NULL)
+		{
+			bool remapped = loader->remapTuples(this->getIDTuplesFile(), memory_budget);
+			delete loader;
+			if (!remapped)
+				return false;
+		}
+		if (!this->build_s2xx_o2xx_p2xx_external(memory_budget, parallelism))
+			return false;
 
-	//NOTICE: we can also build the signature when we are reading triples, and 
-	//update to the corresponding position in the signature file
-	//However, this may be costly due to frequent read/write
+		t8 = Util::get_cur_time();
+		cout << "after s2xx, o2xx and p2xx, used " << (t8 - t4) << "ms." << endl;
+	}
+	else
+	{
+		if (loader != NULL)
+		{
+			_p_id_tuples = loader->readTuples(this->getIDTuplesFile());
+			delete loader;
+			if (_p_id_tuples == NULL)
+				return false;
+		}
+		else
+			this->readIDTuples(_p_id_tuples);
 
-	long t5 = Util::get_cur_time();
-	cout << "id tuples read, used " << (t5 - t4) << "ms." << endl;
+		//NOTICE: we can also build the signature when we are reading triples, and 
+		//update to the corresponding position in the signature file
+		//However, this may be costly due to frequent read/write
 
-	//TODO: how to set the buffer of trees is a big question, fully utilize the availiable memory
+		long t5 = Util::get_cur_time();
+		cout << "id tuples read, used " << (t5 - t4) << "ms." << endl;
 
-	//this->kvstore->build_subID2values(_p_id_tuples, this->triples_num);
-	this->build_s2xx(_p_id_tuples);
+		//TODO: how to set the buffer of trees is a big question, fully utilize the availiable memory
 
-	long t6 = Util::get_cur_time();
-	cout << "after s2xx, used " << (t6 - t5) << "ms." << endl;
+		if (parallelism != 1)
+		{
+			this->build_s2xx_o2xx_p2xx(_p_id_tuples);
 
-	//this->kvstore->build_objID2values(_p_id_tuples, this->triples_num);
-	this->build_o2xx(_p_id_tuples);
+			t8 = Util::get_cur_time();
+			cout << "after s2xx, o2xx and p2xx, used " << (t8 - t5) << "ms." << endl;
+		}
+		else
+		{
+			//this->kvstore->build_subID2values(_p_id_tuples, this->triples_num);
+			this->build_s2xx(_p_id_tuples);
 
-	long t7 = Util::get_cur_time();
-	cout << "after o2xx, used " << (t7 - t6) << "ms." << endl;
+			long t6 = Util::get_cur_time();
+			cout << "after s2xx, used " << (t6 - t5) << "ms." << endl;
 
-	//this->kvstore->build_preID2values(_p_id_tuples, this->triples_num);
-	this->build_p2xx(_p_id_tuples);
+			//this->kvstore->build_objID2values(_p_id_tuples, this->triples_num);
+			this->build_o2xx(_p_id_tuples);
 
-	long t8 = Util::get_cur_time();
-	cout << "after p2xx, used " << (t8 - t7) << "ms." << endl;
+			long t7 = Util::get_cur_time();
+			cout << "after o2xx, used " << (t7 - t6) << "ms." << endl;
+
+			//this->kvstore->build_preID2values(_p_id_tuples, this->triples_num);
+			this->build_p2xx(_p_id_tuples);
+
+			t8 = Util::get_cur_time();
+			cout << "after p2xx, used " << (t8 - t7) << "ms." << endl;
+		}
+	}
 
 	//WARN:we must free the memory for id_tuples array
 	delete[] _p_id_tuples;
@@ -2635,6 +2840,14 @@ Database::encodeRDF_new(const string _rdf_file,const string _error_log)
 	long t9 = Util::get_cur_time();
 	cout << "db info saved, used " << (t9 - t8) << "ms." << endl;
 
+	//the statistics are collected by build_s2xx and build_o2xx
+	if (this->statistics != NULL)
+	{
+		this->statistics->save(this->getStatisticsFile());
+		delete this->statistics;
+		this->statistics = NULL;
+	}
+
 	//Util::logging("finish encodeRDF_new");
 
 	return true;
@@ -2692,7 +2905,12 @@ Database::build_s2xx(ID_TUPLE* _p_id_tuples)
 		}
 	}
 	this->triples_num = j;	// NOTE: triples_num set here
+
+	delete this->statistics;
+	this->statistics = new Statistics;
+	this->statistics->collectSubjects(_p_id_tuples, this->triples_num, this->limitID_predicate);
 	
+	this->kvstore->set_value_format(this->value_format);
 	this->kvstore->build_subID2values(_p_id_tuples, this->triples_num, this->entity_num);
 
 	//save all entity_signature into binary file
@@ -2783,6 +3001,9 @@ Database::build_o2xx(ID_TUPLE* _p_id_tuples)
 	__gnu_parallel::sort(_p_id_tuples, _p_id_tuples + this->triples_num, Util::ops_cmp_idtuple);
 #endif
 	//qsort(_p_id_tuples, this->triples_num, sizeof(int*), Util::_ops_cmp);
+	if (this->statistics != NULL)
+		this->statistics->collectObjects(_p_id_tuples, this->triples_num);
+	this->kvstore->set_value_format(this->value_format);
 	this->kvstore->build_objID2values(_p_id_tuples, this->triples_num, this->entity_num, this->literal_num);
 
 	//save all entity_signature into binary file
@@ -2906,9 +3127,139 @@ Database::build_p2xx(ID_TUPLE* _p_id_tuples)
 	__gnu_parallel::sort(_p_id_tuples, _p_id_tuples + this->triples_num, Util::pso_cmp_idtuple);
 #endif
 	//qsort(_p_id_tuples, this->triples_num, sizeof(int*), Util::_pso_cmp);
+	this->kvstore->set_value_format(this->value_format);
 	this->kvstore->build_preID2values(_p_id_tuples, this->triples_num, this->pre_num);
 }
 
+//passes the merged tuples on to a builder, collecting the statistics on the way
+class StatisticsReader : public IDTupleReader
+{
+public:
+	StatisticsReader(IDTupleReader& _source, Statistics* _statistics, bool _subjects)
+		: source(_source), statistics(_statistics), subjects(_subjects) {}
+	bool next(ID_TUPLE& _tuple)
+	{
+		if (!this->source.next(_tuple))
+			return false;
+		if (this->subjects)
+			this->statistics->addSubject(_tuple);
+		else
+			this->statistics->addObject(_tuple);
+		return true;
+	}
+
+private:
+	IDTupleReader& source;
+	Statistics* statistics;
+	bool subjects;
+};
+
+//sort the id tuples file in each order by IDTupleSorter, within _memory_budget bytes, and build
+//the trees from the merged runs one after another
+bool
+Database::build_s2xx_o2xx_p2xx_external(unsigned long long _memory_budget, unsigned _parallelism)
+{
+	string tuple_file = this->getIDTuplesFile();
+	string run_prefix = tuple_file + "_run";
+	IDTupleSorter::Compare cmps[3] = { Util::spo_cmp_idtuple, Util::ops_cmp_idtuple, Util::pso_cmp_idtuple };
+	const char* names[3] = { "s2xx", "o2xx", "p2xx" };
+	delete this->statistics;
+	this->statistics = new Statistics;
+	this->kvstore->set_value_format(this->value_format);
+	for (int order = 0; order < 3; ++order)
+	{
+		long begin_time = Util::get_cur_time();
+		IDTupleSorter sorter(run_prefix, _memory_budget, cmps[order], _parallelism);
+		if (!sorter.addFile(tuple_file) || !sorter.finish())
+			return false;
+		cout << names[order] << ": " << sorter.getRunNum() << " runs sorted, used " << (Util::get_cur_time() - begin_time) << "ms." << endl;
+		if (order == 0)
+		{
+			this->statistics->beginSubjects(this->limitID_predicate);
+			StatisticsReader reader(sorter, this->statistics, true);
+			this->kvstore->build_subID2values(reader, this->entity_num);
+			this->statistics->endSubjects();
+			cout << "triples_num before removing duplicates: " << this->triples_num << endl;
+			this->triples_num = sorter.getOutputNum();	// NOTE: triples_num set here
+		}
+		else if (order == 1)
+		{
+			this->statistics->beginObjects();
+			StatisticsReader reader(sorter, this->statistics, false);
+			this->kvstore->build_objID2values(reader, this->entity_num, this->literal_num);
+			this->statistics->endObjects();
+		}
+		else
+			this->kvstore->build_preID2values(sorter, this->pre_num);
+		cout << "after " << names[order] << ", used " << (Util::get_cur_time() - begin_time) << "ms." << endl;
+	}
+	Util::empty_file(tuple_file.c_str());
+	return true;
+}
+
+void
+Database::build_s2xx_o2xx_p2xx(ID_TUPLE* _p_id_tuples)
+{
+	string parallelism_value = Util::getConfigureValue("build_parallelism");
+	int parallelism = parallelism_value.empty() ? 0 : atoi(parallelism_value.c_str());
+	if (parallelism <= 0)
+		parallelism = max(1U, std::thread::hardware_concurrency());
+	long begin_time = Util::get_cur_time();
+	omp_set_num_threads(parallelism);
+	__gnu_parallel::sort(_p_id_tuples, _p_id_tuples + this->triples_num, Util::spo_cmp_idtuple);
+
+	cout << "triples_num before removing duplicates: " << this->triples_num << endl;
+	TYPE_TRIPLE_NUM j = 1;
+	for(TYPE_TRIPLE_NUM i = 1; i < this->triples_num; ++i)
+	{
+		if(!Util::equal(_p_id_tuples[i], _p_id_tuples[i-1]))
+		{
+			_p_id_tuples[j] = _p_id_tuples[i];
+			++j;
+		}
+	}
+	this->triples_num = j;	// NOTE: triples_num set here
+	BulkLoader::report("sort spo", this->triples_num, "triples", Util::get_cur_time() - begin_time);
+
+	delete this->statistics;
+	this->statistics = new Statistics;
+	this->statistics->collectSubjects(_p_id_tuples, this->triples_num, this->limitID_predicate);
+	this->kvstore->set_value_format(this->value_format);
+
+	//each tree is built from its own order of the tuples, collectObjects only touches the object part of the statistics
+	ID_TUPLE* ops_tuples = new ID_TUPLE[this->triples_num];
+	ID_TUPLE* pso_tuples = new ID_TUPLE[this->triples_num];
+	memcpy(ops_tuples, _p_id_tuples, sizeof(ID_TUPLE) * this->triples_num);
+	memcpy(pso_tuples, _p_id_tuples, sizeof(ID_TUPLE) * this->triples_num);
+	//the sorts of the other two share the threads
+	int sort_threads = max(1, (parallelism - 1) / 2);
+	thread s2xx([this, _p_id_tuples, begin_time]()
+	{
+		this->kvstore->build_subID2values(_p_id_tuples, this->triples_num, this->entity_num);
+		BulkLoader::report("s2xx", this->triples_num, "triples", Util::get_cur_time() - begin_time);
+	});
+	thread o2xx([this, ops_tuples, sort_threads, begin_time]()
+	{
+		omp_set_num_threads(sort_threads);
+		__gnu_parallel::sort(ops_tuples, ops_tuples + this->triples_num, Util::ops_cmp_idtuple);
+		this->statistics->collectObjects(ops_tuples, this->triples_num);
+		this->kvstore->build_objID2values(ops_tuples, this->triples_num, this->entity_num, this->literal_num);
+		BulkLoader::report("o2xx", this->triples_num, "triples", Util::get_cur_time() - begin_time);
+	});
+	thread p2xx([this, pso_tuples, sort_threads, begin_time]()
+	{
+		omp_set_num_threads(sort_threads);
+		__gnu_parallel::sort(pso_tuples, pso_tuples + this->triples_num, Util::pso_cmp_idtuple);
+		this->kvstore->build_preID2values(pso_tuples, this->triples_num, this->pre_num);
+		BulkLoader::report("p2xx", this->triples_num, "triples", Util::get_cur_time() - begin_time);
+	});
+	s2xx.join();
+	o2xx.join();
+	p2xx.join();
+	delete[] ops_tuples;
+	delete[] pso_tuples;
+}
+
 //NOTICE:in here and there in the insert/delete, we may get the maxium tuples num first
 //and so we can avoid the cost of memcpy(scan quickly or use wc -l)
 //However, if use compressed RDF format, how can we do it fi not using parser?
@@ -3601,6 +3952,70 @@ Database::sub2id_pre2id_obj2id_RDFintoSignature(const string _rdf_file,const str
 }
 
 
+bool
+Database::sub2id_pre2id_obj2id_parallel(const string _rdf_file, const string _error_log, BulkLoader& _loader)
+{
+	//no trie pass as in sub2id_pre2id_obj2id_RDFintoSignature, the trie is not used(TRIE_FORBIDDEN)
+	this->sub_num = 0;
+	this->pre_num = 0;
+	this->entity_num = 0;
+	this->literal_num = 0;
+	this->triples_num = 0;
+	(this->kvstore)->open_entity2id(KVstore::CREATE_MODE);
+	(this->kvstore)->open_id2entity(KVstore::CREATE_MODE);
+	(this->kvstore)->open_predicate2id(KVstore::CREATE_MODE);
+	(this->kvstore)->open_id2predicate(KVstore::CREATE_MODE);
+	(this->kvstore)->open_literal2id(KVstore::CREATE_MODE);
+	(this->kvstore)->open_id2literal(KVstore::CREATE_MODE);
+	(this->kvstore)->load_trie(KVstore::CREATE_MODE);
+	cout << "finish initial sub2id_pre2id_obj2id" << endl;
+
+	if (!_loader.encode(_rdf_file, _error_log, this->getIDTuplesFile()) || !_loader.assignIDs())
+		return false;
+
+	//the IDs are given in order from 0, as allocEntityID() and others do in a new database
+	this->triples_num = _loader.getTripleNum();
+	this->sub_num = _loader.getSubjectNum();
+	this->entity_num = this->limitID_entity = _loader.getStrings(BulkLoader::Entity).size();
+	this->literal_num = this->limitID_literal = _loader.getStrings(BulkLoader::Literal).size();
+	this->pre_num = this->limitID_predicate = _loader.getStrings(BulkLoader::Predicate).size();
+
+	//the three kinds are in different trees
+	long begin_time = Util::get_cur_time();
+	thread entity_writer([this, &_loader]()
+	{
+		const vector<const string*>& strings = _loader.getStrings(BulkLoader::Entity);
+		for (TYPE_ENTITY_LITERAL_ID i = 0; i < strings.size(); ++i)
+		{
+			(this->kvstore)->setIDByEntity(*strings[i], i);
+			(this->kvstore)->setEntityByID(i, *strings[i]);
+		}
+	});
+	thread literal_writer([this, &_loader]()
+	{
+		const vector<const string*>& strings = _loader.getStrings(BulkLoader::Literal);
+		for (TYPE_ENTITY_LITERAL_ID i = 0; i < strings.size(); ++i)
+		{
+			(this->kvstore)->setIDByLiteral(*strings[i], Util::LITERAL_FIRST_ID + i);
+			(this->kvstore)->setLiteralByID(Util::LITERAL_FIRST_ID + i, *strings[i]);
+		}
+	});
+	const vector<const string*>& predicates = _loader.getStrings(BulkLoader::Predicate);
+	for (TYPE_PREDICATE_ID i = 0; i < (TYPE_PREDICATE_ID)predicates.size(); ++i)
+	{
+		(this->kvstore)->setIDByPredicate(*predicates[i], i);
+		(this->kvstore)->setPredicateByID(i, *predicates[i]);
+	}
+	entity_writer.join();
+	literal_writer.join();
+	this->kvstore->set_if_single_thread(false);
+	BulkLoader::report("dictionary", (unsigned long long)this->entity_num + this->literal_num + this->pre_num,
+		"strings", Util::get_cur_time() - begin_time);
+	_loader.releaseStrings();
+
+	return true;
+}
+
 bool
 Database::insertTriple(const TripleWithObjType& _triple, vector<unsigned>* _vertices, vector<unsigned>* _predicates, shared_ptr<Transaction> txn)
 {
@@ -4132,36 +4547,11 @@ unsigned
 Database::insert(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, bool _is_restore, shared_ptr<Transaction> txn)
 {
 	vector<TYPE_ENTITY_LITERAL_ID> vertices, predicates;
+	this->invalidateCSR();
+	this->plan_cache->invalidateJoinPlans();
 	TYPE_TRIPLE_NUM valid_num = 0;
-	bool logging = false;
-	if (!_is_restore) {
-		if(logging)
-			write_update_log(_triples, _triple_num, 1, txn);
-
-		// string path = this->getStorePath() + '/' + this->update_log;
-		// string path_all = this->getStorePath() + '/' + this->update_log_since_backup;
-		// ofstream out;
-		// ofstream out_all;
-		// out.open(path.c_str(), ios::out | ios::app);
-		// out_all.open(path_all.c_str(), ios::out | ios::app);
-		// if (!out || !out_all) {
-		// 	cerr << "Failed to open update log. Insertion aborted." << endl;
-		// 	return 0;
-		// }
-		// for (int i = 0; i < _triple_num; i++) {
-		// 	if (exist_triple(_triples[i], txn)) {
-		// 		continue;
-		// 	}
-		// 	stringstream ss;
-		// 	ss << "I\t" << Util::node2string(_triples[i].getSubject().c_str()) << '\t';
-		// 	ss << Util::node2string(_triples[i].getPredicate().c_str()) << '\t';
-		// 	ss << Util::node2string(_triples[i].getObject().c_str()) << '\t' << Util::get_cur_time() << '.' << endl;
-		// 	out << ss.str();
-		// 	out_all << ss.str();
-		// }
-		// out.close();
-		// out_all.close();
-	}
+	if (!_is_restore && !this->write_update_log(_triples, _triple_num, 1, txn))
+		return 0;
 
 #ifdef USE_GROUP_INSERT
 	//NOTICE:this is called by insert(file) or query()(but can not be too large),
@@ -4645,6 +5035,12 @@ Database::insert(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num,
 	this->stringindex->change(vertices, *this->kvstore, true);
 	this->stringindex->change(predicates, *this->kvstore, false);
 
+	if (valid_num > 0)
+	{
+		this->invalidateQueryCache(_triples, _triple_num);
+		if (this->statistics != NULL)
+			this->statistics->addUpdates(valid_num);
+	}
 	return valid_num;
 }
 
@@ -4652,34 +5048,12 @@ unsigned
 Database::remove(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, bool _is_restore, shared_ptr<Transaction> txn)
 {
 	vector<TYPE_ENTITY_LITERAL_ID> vertices, predicates;
+	this->invalidateCSR();
+	this->plan_cache->invalidateJoinPlans();
 	TYPE_TRIPLE_NUM valid_num = 0;
 
-	if (!_is_restore) {
-		write_update_log(_triples, _triple_num, 0, txn);
-		// string path = this->getStorePath() + '/' + this->update_log;
-		// string path_all = this->getStorePath() + '/' + this->update_log_since_backup;
-		// ofstream out;
-		// ofstream out_all;
-		// out.open(path.c_str(), ios::out | ios::app);
-		// out_all.open(path_all.c_str(), ios::out | ios::app);
-		// if (!out || !out_all) {
-		// 	cerr << "Failed to open update log. Removal aborted." << endl;
-		// 	return 0;
-		// }
-		// for (int i = 0; i < _triple_num; i++) {
-		// 	if (!exist_triple(_triples[i], txn)) {
-		// 		continue;
-		// 	}
-		// 	stringstream ss;
-		// 	ss << "R\t" << Util::node2string(_triples[i].getSubject().c_str()) << '\t';
-		// 	ss << Util::node2string(_triples[i].getPredicate().c_str()) << '\t';
-		// 	ss << Util::node2string(_triples[i].getObject().c_str()) << '\t' << Util::get_cur_time() << '.' << endl;
-		// 	out << ss.str();
-		// 	out_all << ss.str();
-		// }
-		// out.close();
-		// out_all.close();
-	}
+	if (!_is_restore && !this->write_update_log(_triples, _triple_num, 0, txn))
+		return 0;
 
 #ifdef USE_GROUP_DELETE
 	//NOTICE:this is called by remove(file) or query()(but can not be too large),
@@ -5063,6 +5437,12 @@ Database::remove(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num,
 		this->resetIDinfo();
 	}
 
+	if (valid_num > 0)
+	{
+		this->invalidateQueryCache(_triples, _triple_num);
+		if (this->statistics != NULL)
+			this->statistics->addUpdates(valid_num);
+	}
 	return valid_num;
 }
 
@@ -5182,15 +5562,16 @@ unsigned
 Database::batch_insert(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, bool _is_restore, shared_ptr<Transaction> txn)
 {
 	if(_triple_num == 0) return 0;
+	this->invalidateCSR();
+	this->plan_cache->invalidateJoinPlans();
 	TYPE_TRIPLE_NUM valid_num = 0;
 	vector<TYPE_ENTITY_LITERAL_ID> vertices, predicates;
 	unsigned update_num_s = 0;
 	unsigned update_num_p = 0;
 	unsigned update_num_o = 0;
 	
-	if (!_is_restore) {
-		write_update_log(_triples, _triple_num, 1, txn);
-	}
+	if (!_is_restore && !this->write_update_log(_triples, _triple_num, 1, txn))
+		return 0;
 	bool is_obj_entity;
 	vector<ID_TUPLE> id_tuples(_triple_num);
 	for (int i = 0; i < _triple_num; ++i)
@@ -5295,6 +5676,12 @@ Database::batch_insert(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _tripl
 	this->stringindex->change(vertices, *this->kvstore, true);
 	this->stringindex->change(predicates, *this->kvstore, false);
 
+	if (update_num_s > 0)
+	{
+		this->invalidateQueryCache(_triples, _triple_num);
+		if (this->statistics != NULL)
+			this->statistics->addUpdates(update_num_s);
+	}
 	return update_num_s;
 }
 
@@ -5303,6 +5690,8 @@ unsigned
 Database::batch_remove(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, bool _is_restore, shared_ptr<Transaction> txn)
 {
 	if(_triple_num == 0) return 0;
+	this->invalidateCSR();
+	this->plan_cache->invalidateJoinPlans();
 	TYPE_TRIPLE_NUM valid_num = 0;
 	unsigned update_num_s = 0;
 	unsigned update_num_p = 0;
@@ -5310,9 +5699,8 @@ Database::batch_remove(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _tripl
 
 	vector<TYPE_ENTITY_LITERAL_ID> vertices, predicates;
 	set<unsigned> sub_ids, pre_ids, obj_ids;
-	if (!_is_restore) {
-		write_update_log(_triples, _triple_num, 0, txn);
-	}
+	if (!_is_restore && !this->write_update_log(_triples, _triple_num, 0, txn))
+		return 0;
 
 	vector<ID_TUPLE> id_tuples(_triple_num);
 	for (int i = 0; i < _triple_num; ++i)
@@ -5437,6 +5825,12 @@ Database::batch_remove(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _tripl
 		this->stringindex->disable(vertices, true);
 		this->stringindex->disable(predicates, false);
 	}
+	if (update_num_s > 0)
+	{
+		this->invalidateQueryCache(_triples, _triple_num);
+		if (this->statistics != NULL)
+			this->statistics->addUpdates(update_num_s);
+	}
 	return update_num_s;
 }
 
@@ -5582,10 +5976,7 @@ Database::backup()
 	this->kvstore->flush();
 
 	this->clear_update_log();
-	string update_log_path = this->store_path + '/' + this->update_log_since_backup;
-	sys_cmd = "rm " + update_log_path;
-	system(sys_cmd.c_str());
-	Util::create_file(update_log_path);
+	this->update_wal->truncate(true);
 
 	cout << "Backup completed!" << endl;
 	return true;
@@ -5597,10 +5988,8 @@ Database::restore()
 	cout << "Begining restore." << endl;
 	string sys_cmd;
 
-	multiset<string> insertions;
-	multiset<string> removals;
-
-	int num_update = 0;
+	vector<UpdateLog::Record> records;
+	bool from_backup = false;
 	if (!this->load()) 
 	{
 		this->clear();
@@ -5612,7 +6001,7 @@ Database::restore()
 			return false;
 		}
 
-		num_update += Database::read_update_log(this->store_path + '/' + this->update_log_since_backup, insertions, removals);
+		Database::read_update_log(this->store_path + '/' + this->update_log_since_backup, records);
 
 		cout << "Failed to restore from original db file, trying to restore from backup file." << endl;
 		cout << "Your old db file will be stored at " << this->store_path << ".bad" << endl;
@@ -5625,7 +6014,6 @@ Database::restore()
 		system(sys_cmd.c_str());
 		sys_cmd = "cp -r " + backup_path + ' ' + this->store_path;
 		system(sys_cmd.c_str());
-		Util::create_file(this->store_path + '/' + this->update_log);
 
 		if (!this->load()) 
 		{
@@ -5633,17 +6021,14 @@ Database::restore()
 			cerr << "Failed to restore from backup file." << endl;
 			return false;
 		}
-
-		num_update += Database::read_update_log(this->store_path + '/' + this->update_log_since_backup, insertions, removals);
+		from_backup = true;
 	}
 	else 
 	{
-		num_update += Database::read_update_log(this->store_path + '/' + this->update_log, insertions, removals);
+		Database::read_update_log(this->store_path + '/' + this->update_log, records);
 	}
 
-	cout << "Restoring " << num_update << " updates." << endl;
-
-	if (!this->restore_update(insertions, removals)) 
+	if (!this->restore_update(records, from_backup)) 
 	{
 		cerr << "Failed to restore updates" << endl;
 		return false;
@@ -5655,155 +6040,64 @@ Database::restore()
 }
 
 int 
-Database::read_update_log(const string _path, multiset<string>& _i, multiset<string>& _r) 
+Database::read_update_log(const string _path, vector<UpdateLog::Record>& _records) 
 {
-	ifstream in;
 #ifdef DEBUG
 	cout<<_path<<endl;
 #endif
-	in.open(_path.c_str(), ios::in);
-	if (!in) {
+	size_t num = _records.size();
+	if (!UpdateLog::read(_path, _records, 0))
+	{
 		cerr << "Failed to read update log." << endl;
 		return 0;
 	}
-	
-	int ret = 0;
-	int buffer_size = 1024 + 2;
-	char buffer[buffer_size];
-	in.getline(buffer, buffer_size);
-	while (!in.eof() && buffer[0]) {
-		string triple;
-		switch (buffer[0]) {
-		case 'I':
-			triple = string(buffer + 2);
-			ret++;
-			_i.insert(triple);
-			break;
-		case 'R':
-			triple = string(buffer + 2);
-			ret++;
-			_r.insert(triple);
-			break;
-		default:
-			cerr << "Bad line in update log!" << endl;
-		}
-		in.getline(buffer, buffer_size);
-	}
-
-	return ret;
+	return _records.size() - num;
 }
 
 bool 
-Database::restore_update(multiset<string>& _i, multiset<string>& _r) 
+Database::restore_update(vector<UpdateLog::Record>& _records, bool _relog) 
 {
-	multiset<string>::iterator pos;
-	multiset<string>::iterator it_to_erase = _r.end();
-	for (multiset<string>::iterator it = _r.begin(); it != _r.end(); it++) 
-	{
-		//NOTICE: check the intersect of insert_set and remove_set
-		if (it_to_erase != _r.end()) {
-			_r.erase(it_to_erase);
-		}
-		pos = _i.find(*it);
-		if (pos != _i.end()) {
-			_i.erase(pos);
-			it_to_erase = it;
-		}
-		else {
-			it_to_erase = _r.end();
-		}
-	}
-	if (it_to_erase != _r.end()) {
-		_r.erase(it_to_erase);
-	}
+	//only the last operation on each triple is redone, which is what the log ends with
+	vector<TripleWithObjType> insertions, removals;
+	UpdateLog::replay(_records, insertions, removals, 0);
+	_records.clear();
+	cout << "Restoring " << insertions.size() << " insertions and " << removals.size() << " removals." << endl;
 
-	string tmp_path = this->store_path + "/.update_tmp";
-
-	ofstream out_i;
-	out_i.open(tmp_path.c_str(), ios::out);
-	if (!out_i) {
-		cerr << "Failed to open temp file, restore failed!" << endl;
-		return false;
-	}
-	for (multiset<string>::iterator it = _i.begin(); it != _i.end(); it++) {
-		out_i << *it << endl;
-	}
-	out_i.close();
-	if (!this->insert(tmp_path, true)) 
-	//if (!this->remove(tmp_path, true)) 
+	//the log of the backup copy does not have them, so they are logged again
+	if (_relog)
 	{
-		return false;
-	}
-
-	ofstream out_r;
-	out_r.open(tmp_path.c_str(), ios::out);
-	if (!out_r) {
-		cerr << "Failed to open temp file!" << endl;
-		return false;
-	}
-	for (multiset<string>::iterator it = _r.begin(); it != _r.end(); it++) {
-		out_r << *it << endl;
-	}
-	out_r.close();
-	if (!this->remove(tmp_path, true)) 
-	//if (!this->insert(tmp_path, true)) 
-	{
-		return false;
+		if ((!removals.empty() && !this->update_wal->append(UpdateLog::Remove, 0, &removals[0], removals.size()))
+			|| (!insertions.empty() && !this->update_wal->append(UpdateLog::Insert, 0, &insertions[0], insertions.size())))
+		{
+			cerr << "Failed to log the updates restored!" << endl;
+			return false;
+		}
 	}
 
-	string cmd = "rm " + tmp_path;
-	system(cmd.c_str());
+	//NOTICE: the triples not there or there already are skipped, so redoing one twice does no harm
+	TYPE_TRIPLE_NUM group = RDFParser::TRIPLE_NUM_PER_GROUP;
+	for (size_t i = 0; i < removals.size(); i += group)
+		this->remove(&removals[i], min((size_t)group, removals.size() - i), true);
+	for (size_t i = 0; i < insertions.size(); i += group)
+		this->insert(&insertions[i], min((size_t)group, insertions.size() - i), true);
 	return true;
 }
 
 void 
 Database::clear_update_log() 
 {
-	string path = this->getStorePath() + '/' + this->update_log;
-	ofstream out;
-	out.open(path.c_str(), ios::out);
-	out.close();
+	this->update_wal->truncate();
 }
 
 bool 
 Database::write_update_log(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, int type, shared_ptr<Transaction> txn)
 {
-	log_lock.lock();
-	string path = this->getStorePath() + '/' + this->update_log;
-	string path_all = this->getStorePath() + '/' + this->update_log_since_backup;
-	ofstream out;
-	ofstream out_all;
-	out.open(path.c_str(), ios::out | ios::app);
-	out_all.open(path_all.c_str(), ios::out | ios::app);
-	if (!out || !out_all) {
-		cerr << "Failed to open update log. Insertion aborted." << endl;
-		log_lock.unlock();
+	UpdateLog::RecordType record_type = type == 1 ? UpdateLog::Insert : UpdateLog::Remove;
+	if (!this->update_wal->append(record_type, txn == nullptr ? 0 : txn->GetTID(), _triples, _triple_num))
+	{
+		cerr << "Failed to write update log. Update aborted." << endl;
 		return false;
 	}
-	
-	for (int i = 0; i < _triple_num; i++) {
-		// if (type == 1 && exist_triple(_triples[i], txn)) {
-		//	continue;
-		// }
-		// else if(type == 0 && !exist_triple(_triples[i], txn))
-		// {
-		//	continue;
-		// }
-		stringstream ss;
-		if(type == 1){
-			ss << "I\t" << Util::node2string(_triples[i].getSubject().c_str()) << '\t';
-		}
-		else{
-			ss << "R\t" << Util::node2string(_triples[i].getSubject().c_str()) << '\t';
-		}
-		ss << Util::node2string(_triples[i].getPredicate().c_str()) << '\t';
-		ss << Util::node2string(_triples[i].getObject().c_str()) << '\t' << Util::get_cur_time() << '.' << endl;
-		out << ss.str();
-		out_all << ss.str();
-	}
-	out.close();
-	out_all.close();
-	log_lock.unlock();
 	return true;
 }
 
@@ -6274,22 +6568,34 @@ Database::TransactionRollback(shared_ptr<Transaction> txn)
 		cerr << "WARNING: transaction rollback exception! " << endl;
 		cerr << "Please REBOOT service!" << endl;
 	}
+	//the updates of the transaction are undone, which may change what other queries have seen
+	this->query_cache->clear();
+	this->update_wal->append(UpdateLog::Abort, txn->GetTID());
 }
 
-void 
+bool 
 Database::TransactionCommit(shared_ptr<Transaction> txn)
 {
 	//cout << "transaction_commit ........" << endl;
+	//the commit is durable once its record is written, with the updates logged before it
+	if (!this->update_wal->append(UpdateLog::Commit, txn->GetTID()))
+	{
+		cerr << "Failed to log the commit of transaction " << txn->GetTID() << endl;
+		return false;
+	}
 	if((this->kvstore)->ReleaseAllLocks(txn) == false)
 	{
 		cerr << "WARNING: not all latches get unlatched! " << endl;
 		cerr << "Please REBOOT service!" << endl;
 	}
+	//the updates of the transaction are seen by other queries from now on
+	this->query_cache->clear();
 	// if((this->kvstore)->releaseAllExclusiveLocks(txn) == false)
 	// {
 	// 	cerr << "WARNING: not all lockes get unlocked! " << endl;
 	// 	cerr << "Please REBOOT service!" << endl;
 	// }
+	return true;
 }
 
 std::string
@@ -23,10 +23,14 @@
 #include "../Parser/RDFParser.h"
 #include "../Parser/SPARQL/SPARQLParser.h"
 #include "../Query/QueryCache.h"
+#include "../Query/PlanCache.h"
 #include "../Query/GeneralEvaluation.h"
+#include "UpdateLog.h"
 #include "../Server/Socket.h"
 #include "CSR.h"
 
+class BulkLoader;
+
 class Database
 {
 public:
@@ -54,6 +58,12 @@ public:
 	bool unload();
 	void clear();
 	int query(const string _query, ResultSet& _result_set, FILE* _fp = stdout, bool update_flag = true, bool export_flag = false, shared_ptr<Transaction> txn = nullptr);
+	//prepared statements: the query is parsed once, and its $name placeholders are bound to RDF terms
+	//(<iri> or "literal" as in N-Triples) at each execution, which returns as query()
+	bool prepare(const string& _query, string& _statement_id, vector<string>& _parameters);
+	int execute(const string& _statement_id, const map<string, string>& _parameters, ResultSet& _result_set, FILE* _fp = stdout,
+		bool update_flag = true, bool export_flag = false, shared_ptr<Transaction> txn = nullptr);
+	bool closeStatement(const string& _statement_id);
 	//1. if subject of _triple doesn't exist,
 	//then assign a new subid, and insert a new SigEntry
 	//2. assign new tuple_id to tuple, if predicate or object doesn't exist before too;
@@ -61,6 +71,8 @@ public:
 
 	bool build(const string& _rdf_file, Socket& socket);
 	bool build(const string& _rdf_file);
+	//must be called before build()
+	void setValueFormat(int _format);
 	//interfaces to insert/delete from given rdf file
 	bool insert(std::string _rdf_file, bool _is_restore = false, shared_ptr<Transaction> txn = nullptr);
 	bool remove(std::string _rdf_file, bool _is_restore = false, shared_ptr<Transaction> txn = nullptr);
@@ -91,11 +103,14 @@ public:
 
 	//id tuples file
 	string getIDTuplesFile();
+	string getStatisticsFile();
+	string getCSRFile();
 
 	VSTree* getVSTree();
 	KVstore* getKVstore();
 	StringIndex* getStringIndex();
 	QueryCache* getQueryCache();
+	PlanCache* getPlanCache();
 	TYPE_TRIPLE_NUM* getpre2num();
 	TYPE_TRIPLE_NUM* getpre2sub();
 	TYPE_TRIPLE_NUM* getpre2obj();
@@ -106,7 +121,8 @@ public:
 	
 	//MVCC
 	void TransactionRollback(shared_ptr<Transaction> txn);
-	void TransactionCommit(shared_ptr<Transaction> txn);
+	//false if the commit could not be logged, then the transaction is still running
+	bool TransactionCommit(shared_ptr<Transaction> txn);
 	void VersionClean(vector<unsigned> &sub_ids ,vector<unsigned>& obj_ids, vector<unsigned>& obj_literal_ids, vector<unsigned> &pre_ids);
 	std::string CreateJson(int StatusCode, std::string StatusMsg, std::string ResponseBody);
 private:
@@ -121,7 +137,11 @@ private:
 	TYPE_ENTITY_LITERAL_ID literal_num;
 
 	int encode_mode;
+	//KVstore::VALUE_FORMAT_RAW or KVstore::VALUE_FORMAT_COMPRESSED, fixed when building
+	int value_format;
 	bool if_loaded;
+	//id2values are mapped read-only(value_mmap in init.conf), updates are refused
+	bool values_read_only;
 
 	//locks
 	mutex query_parse_lock;
@@ -137,8 +157,6 @@ private:
 	mutex allocLiteralID_lock;
 	//for allocPredicateID
 	mutex allocPredicateID_lock;
-	//for log file
-	mutex log_lock;
 	
 	VSTree* vstree;
 	KVstore* kvstore;
@@ -159,6 +177,7 @@ private:
 	string id_tuples_file;
 	string update_log;
 	string update_log_since_backup;
+	UpdateLog* update_wal;
 
 	//pre2num mapping
 	TYPE_TRIPLE_NUM* pre2num;
@@ -169,6 +188,13 @@ private:
 	//valid: check from minNumPID to maxNumPID
 	TYPE_PREDICATE_ID maxNumPID, minNumPID;
 	void setPreMap();
+	//cardinality statistics for the join order, NULL if the database has none
+	Statistics* statistics;
+	void loadStatistics();
+	void saveStatistics();
+	void loadCSR();
+	void invalidateCSR();
+	void invalidateQueryCache(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num);
 
 	//TODO: set the buffer capacity as dynamic according to the current memory usage
 	//string buffer
@@ -179,6 +205,9 @@ private:
 	unsigned literal_buffer_size;
 
 	QueryCache *query_cache;
+	PlanCache *plan_cache;
+	int evaluate(const string& _query, const map<string, string>* _parameters, ResultSet& _result_set, FILE* _fp,
+		bool update_flag, bool export_flag, shared_ptr<Transaction> txn);
 
 	//Trie *trie;
 
@@ -217,6 +246,9 @@ private:
 	std::priority_queue <KEY_SIZE_VALUE> candidate_preID;
 	std::priority_queue <KEY_SIZE_VALUE> important_subID;
 	std::priority_queue <KEY_SIZE_VALUE> important_objID;
+	//important sub/obj IDs, least important first, to warm the string cache
+	std::vector <TYPE_ENTITY_LITERAL_ID> hot_string_ids;
+	void warm_string_cache();
 	
 	//triple num per group for insert/delete
 	//can not be too high, otherwise the heap will over
@@ -291,6 +323,10 @@ private:
 	void build_s2xx(ID_TUPLE*);
 	void build_o2xx(ID_TUPLE*);
 	void build_p2xx(ID_TUPLE*);
+	//the three above at the same time, on copies of the id tuples(build_parallelism in init.conf)
+	void build_s2xx_o2xx_p2xx(ID_TUPLE*);
+	//the three above from the id tuples file sorted on disk, within _memory_budget bytes(build_memory in init.conf)
+	bool build_s2xx_o2xx_p2xx_external(unsigned long long _memory_budget, unsigned _parallelism);
 
 	//insert and delete, notice that modify is not needed here
 	//we can read from file or use sparql syntax
@@ -310,6 +346,8 @@ private:
 
 	bool sub2id_pre2id_obj2id_RDFintoSignature(const string _rdf_file);
 	bool sub2id_pre2id_obj2id_RDFintoSignature(const string _rdf_file,const string _error_log);
+	//the same with the pipelined BulkLoader, the id tuples are then read by _loader.readTuples()
+	bool sub2id_pre2id_obj2id_parallel(const string _rdf_file, const string _error_log, BulkLoader& _loader);
 	//bool literal2id_RDFintoSignature(const string _rdf_file, int** _p_id_tuples, TYPE_TRIPLE_NUM _id_tuples_max);
 
 	bool objIDIsEntityID(TYPE_ENTITY_LITERAL_ID _id);
@@ -324,8 +362,9 @@ private:
 	//get the final string result_set from SPARQLquery 
 	bool getFinalResult(SPARQLquery& _sparql_q, ResultSet& _result_set);
 
-	static int read_update_log(const string _path, multiset<string>& _i, multiset<string>& _r);
-	bool restore_update(multiset<string>& _i, multiset<string>& _r);
+	static int read_update_log(const string _path, vector<UpdateLog::Record>& _records);
+	//_relog when the updates are not in the log of the db restored from
+	bool restore_update(vector<UpdateLog::Record>& _records, bool _relog);
 	void clear_update_log();
 	bool write_update_log(const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num, int type, shared_ptr<Transaction> txn);
 };
@@ -15,10 +15,18 @@ Join::Join()
 	this->kvstore = NULL;
 	this->result_list = NULL;
 	this->txn = nullptr;
+	this->use_leapfrog = true;
+	this->parallelism = 1;
+	this->pool = NULL;
+	this->statistics = NULL;
+	this->join_plan = NULL;
+	this->row_limit = 0;
+	this->stream_result = false;
+	this->result_copied = false;
 }
 
 Join::Join(KVstore* _kvstore, TYPE_TRIPLE_NUM* _pre2num, TYPE_PREDICATE_ID _limitID_predicate, TYPE_ENTITY_LITERAL_ID _limitID_literal,
-	TYPE_ENTITY_LITERAL_ID _limitID_entity, shared_ptr<Transaction> _txn)
+	TYPE_ENTITY_LITERAL_ID _limitID_entity, shared_ptr<Transaction> _txn, Statistics* _statistics)
 {
 	this->kvstore = _kvstore;
 	this->result_list = NULL;
@@ -27,11 +35,24 @@ Join::Join(KVstore* _kvstore, TYPE_TRIPLE_NUM* _pre2num, TYPE_PREDICATE_ID _limi
 	this->limitID_literal = _limitID_literal;
 	this->limitID_entity = _limitID_entity;
 	this->txn = _txn;
+	this->use_leapfrog = Util::getConfigureValue("leapfrog_join") != "false";
+	this->parallelism = 1;
+	string parallelism = Util::getConfigureValue("query_parallelism");
+	if (!parallelism.empty() && atoi(parallelism.c_str()) >= 0)
+		this->parallelism = atoi(parallelism.c_str());
+	this->pool = NULL;
+	this->statistics = _statistics;
+	this->join_plan = NULL;
+	this->row_limit = 0;
+	this->stream_result = false;
+	this->result_copied = false;
 }
 
 Join::~Join()
 {
-	//noting to do necessarily
+	delete this->pool;
+	for (unsigned i = 0; i < this->worker_tables.size(); ++i)
+		delete this->worker_tables[i];
 }
 
 void
@@ -66,12 +87,15 @@ Join::clear()
 	free(this->id2pos);
 	free(this->pos2id);
 	//NOTICE:maybe many BasicQuery
-	this->current_table.clear();
+	this->current_table.reset(0);
+	this->next_table.reset(0);
 	while (this->mystack.empty() == false) this->mystack.pop();
 	free(this->dealed_triple);
 	//NULL if using multi-join method
 	this->result_list = NULL;
 	this->satellites.clear();
+	this->satellite_lists.clear();
+	this->leapfrog_edges.clear();
 }
 
 //the return value should be non-negative
@@ -239,6 +263,8 @@ Join::join_basic(BasicQuery* _basic_query, bool* d_triple)
 		return false;
 	}
 	*/
+	this->stream_result = this->row_limit > 0 && this->can_stream();
+	this->result_copied = false;
 	bool ret3 = this->join();
 	long after_joinbasic = Util::get_cur_time();
 	cout << "during join_basic: used " << (after_joinbasic - begin) << " ms" << endl;
@@ -268,7 +294,11 @@ Join::join_basic(BasicQuery* _basic_query, bool* d_triple)
 	long after_pre_var = Util::get_cur_time();
 	cout << "during pre var: used " << (after_pre_var - after_only_pre_filter) << " ms" << endl;
 
-	this->copyToResult();
+	//already copied if the join was streamed
+	if (!this->result_copied)
+	{
+		this->copyToResult();
+	}
 	long after_copy = Util::get_cur_time();
 	cout << "during copy to result list: used " << (after_copy - after_pre_var) << " ms" << endl;
 
@@ -319,10 +349,13 @@ Join::pre_var_handler()
 		//}
 		//cout<<"id 1 pos "<<this->id2pos[1]<<endl;
 
-		bool if_new_start = false;
+		//each record is extended by the candidates of this pre var into next_table
+		this->next_table.reset(this->current_table.getColNum() + 1);
+		RecordType rec(this->current_table.getColNum());
 		//for each record, use s/o2p for each triple containing this pre var to filter
-		for (TableIterator it = this->current_table.begin(); it != this->new_start;)
+		for (unsigned long row = 0; row < this->current_table.size(); ++row)
 		{
+			this->current_table.getRow(row, &rec[0]);
 			IDList valid_ans;
 			//bool ok = true;
 			unsigned triple_num = pre_var.triples.size();
@@ -403,11 +436,11 @@ Join::pre_var_handler()
 						//Otherwise, predicates are all variables, and this is a star graph:
 						//if it connected with other parts(not included in this star), either ?si or ?o(as subject), then join can be started
 						//else, this can be pasred as a single BGP, and we shall deal with this special star graph in toStartJoin()
-						this->kvstore->getpreIDlistByobjID((*it)[this->id2pos[var2]], id_list, id_list_len, true, txn);
+						this->kvstore->getpreIDlistByobjID(rec[this->id2pos[var2]], id_list, id_list_len, true, txn);
 					}
 					else if (var1 != -1 && var2 == -1)
 					{
-						this->kvstore->getpreIDlistBysubID((*it)[this->id2pos[var1]], id_list, id_list_len, true, txn);
+						this->kvstore->getpreIDlistBysubID(rec[this->id2pos[var1]], id_list, id_list_len, true, txn);
 					}
 					else if (var1 != -1 && var2 != -1)
 					{
@@ -415,13 +448,13 @@ Join::pre_var_handler()
 						//{
 						//int* oid_list = NULL;
 						//int oid_list_len = 0;
-						//this->kvstore->getobjIDlistBysubID((*it)[this->id2pos[var1]], oid_list, oid_list_len);
-						//this->kvstore->getpreIDlistBysubID((*it)[this->id2pos[var1]], id_list, id_list_len);
+						//this->kvstore->getobjIDlistBysubID(rec[this->id2pos[var1]], oid_list, oid_list_len);
+						//this->kvstore->getpreIDlistBysubID(rec[this->id2pos[var1]], id_list, id_list_len);
 						//}
-						//cout<<"sub str: "<<this->kvstore->getEntityByID((*it)[this->id2pos[var1]])<<endl;
-						//cout<<"obj str: "<<this->kvstore->getEntityByID((*it)[this->id2pos[var2]])<<endl;
-						//this->kvstore->getpreIDlistBysubIDobjID((*it)[this->id2pos[var1]], (*it)[this->id2pos[var2]], id_list, id_list_len);
-						int sid = (*it)[this->id2pos[var1]], oid = (*it)[this->id2pos[var2]];
+						//cout<<"sub str: "<<this->kvstore->getEntityByID(rec[this->id2pos[var1]])<<endl;
+						//cout<<"obj str: "<<this->kvstore->getEntityByID(rec[this->id2pos[var2]])<<endl;
+						//this->kvstore->getpreIDlistBysubIDobjID(rec[this->id2pos[var1]], rec[this->id2pos[var2]], id_list, id_list_len);
+						int sid = rec[this->id2pos[var1]], oid = rec[this->id2pos[var2]];
 						this->kvstore->getpreIDlistBysubIDobjID(sid, oid, id_list, id_list_len, true, txn);
 						//NOTICE:no need to add literals here because they are added when join using s2o
 					}
@@ -443,8 +476,8 @@ Join::pre_var_handler()
 					}
 					else
 					{
-						this->kvstore->getpreIDlistBysubIDobjID((*it)[this->id2pos[var1]], obj_id, id_list, id_list_len, true, txn);
-						TYPE_ENTITY_LITERAL_ID sid = (*it)[this->id2pos[var1]], oid = obj_id;
+						this->kvstore->getpreIDlistBysubIDobjID(rec[this->id2pos[var1]], obj_id, id_list, id_list_len, true, txn);
+						TYPE_ENTITY_LITERAL_ID sid = rec[this->id2pos[var1]], oid = obj_id;
 						this->kvstore->getpreIDlistBysubIDobjID(sid, oid, id_list, id_list_len, true, txn);
 					}
 				}
@@ -458,8 +491,8 @@ Join::pre_var_handler()
 					else
 					{
 						//NOTICE:no need to add literals here because they are added in add_literal_candidate using s2o
-						//this->kvstore->getpreIDlistBysubIDobjID(sub_id, (*it)[this->id2pos[var2]], id_list, id_list_len);
-						TYPE_ENTITY_LITERAL_ID sid = sub_id, oid = (*it)[this->id2pos[var2]];
+						//this->kvstore->getpreIDlistBysubIDobjID(sub_id, rec[this->id2pos[var2]], id_list, id_list_len);
+						TYPE_ENTITY_LITERAL_ID sid = sub_id, oid = rec[this->id2pos[var2]];
 						this->kvstore->getpreIDlistBysubIDobjID(sid, oid, id_list, id_list_len, true, txn);
 					}
 				}
@@ -505,33 +538,14 @@ Join::pre_var_handler()
 			{
 				//if(!is_selected)
 				//{
-					//it++;
 					//continue;
 				//}
-				it->push_back(valid_ans[0]);
-				unsigned begin = 1;
-				if (!if_new_start && size > 1)
-				{
-					this->add_new_to_results(it, valid_ans[1]);
-					if_new_start = true;
-					//iterator it scan loop, to set the border to avoid going to the newly added ones
-					this->new_start = this->current_table.end();
-					this->new_start--;
-					begin = 2;
-				}
-				for (unsigned j = begin; j < size; ++j)
-				{
-					this->add_new_to_results(it, valid_ans[j]);
-				}
-				it++;
-			}
-			else
-			{
-				it = this->current_table.erase(it);
+				this->next_table.appendExtend(this->current_table, row, &(*valid_ans.getList())[0], size);
 			}
 		}
 
-		this->new_start = this->current_table.end();
+		this->current_table.swap(this->next_table);
+		this->next_table.reset(0);
 	}
 
 	cout << "table size after pre_var " << this->current_table.size() << endl;
@@ -544,6 +558,22 @@ Join::pre_var_handler()
 
 void
 Join::copyToResult()
+{
+	if (!this->begin_copy())
+	{
+		return;
+	}
+	RecordType rec(this->current_table.getColNum());
+	for (unsigned long row = 0; row < this->current_table.size() && !this->reached_limit(); ++row)
+	{
+		this->current_table.getRow(row, &rec[0]);
+		this->copy_row(&rec[0]);
+	}
+	this->end_copy();
+}
+
+bool
+Join::begin_copy()
 {
 	//copy to result list, adjust the vars order
 	this->result_list->clear();
@@ -556,7 +586,7 @@ Join::copyToResult()
 	if (this->id_pos != core_var_num + pre_var_num)
 	{
 		cout << "terrible error in copyToResult!" << endl;
-		return;
+		return false;
 	}
 
 #ifdef DEBUG_JOIN
@@ -564,135 +594,140 @@ Join::copyToResult()
 #endif
 	this->record_len = select_var_num + selected_pre_var_num;
 	this->record = new unsigned[this->record_len];
+	return true;
+}
 
-	for (TableIterator it = this->current_table.begin(); it != this->current_table.end(); ++it)
+//copy a row of the joined table, with the columns in id2pos order, and the satellites it generates
+void
+Join::copy_row(const unsigned* _rec)
+{
+	int select_var_num = this->basic_query->getSelectVarNum();
+	int core_var_num = this->basic_query->getRetrievedVarNum();
+	int i = 0;
+	for (; i < core_var_num; ++i)
 	{
-		int i = 0;
-		for (; i < core_var_num; ++i)
+		//This is because sleect var id is always smaller
+		if (this->pos2id[i] < select_var_num)
 		{
-			//This is because sleect var id is always smaller
-			if (this->pos2id[i] < select_var_num)
-			{
-				int vpos = this->basic_query->getSelectedVarPosition(this->pos2id[i]);
-				this->record[vpos] = (*it)[i];
-			}
+			int vpos = this->basic_query->getSelectedVarPosition(this->pos2id[i]);
+			this->record[vpos] = _rec[i];
 		}
+	}
 
 #ifdef DEBUG_JOIN
-		//cout<<"current id_pos: "<<this->id_pos<<endl;
+	//cout<<"current id_pos: "<<this->id_pos<<endl;
 #endif
-		//below are for selected pre vars
-		while (i < this->id_pos)
+	//below are for selected pre vars
+	while (i < this->id_pos)
+	{
+		//only add selected ones
+		int pre_var_id = this->pos2id[i] - this->var_num;
+		int pvpos = this->basic_query->getSelectedPreVarPosition(pre_var_id);
+		if(pvpos >= 0)
 		{
-			//only add selected ones
-			int pre_var_id = this->pos2id[i] - this->var_num;
-			int pvpos = this->basic_query->getSelectedPreVarPosition(pre_var_id);
-			if(pvpos >= 0)
-			{
-				this->record[pvpos] = (*it)[i];
-			}
-			++i;
+			this->record[pvpos] = _rec[i];
 		}
+		++i;
+	}
 
-		bool valid = true;
-		//generate satellites when constructing records
-		//NOTICE: satellites in join must be selected
-		//core vertex maybe not in select
-		for (i = 0; i < core_var_num; ++i)
+	bool valid = true;
+	//generate satellites when constructing records
+	//NOTICE: satellites in join must be selected
+	//core vertex maybe not in select
+	for (i = 0; i < core_var_num; ++i)
+	{
+		int id = this->pos2id[i];
+		unsigned ele = _rec[i];
+		int degree = this->basic_query->getVarDegree(id);
+		for (int j = 0; j < degree; ++j)
 		{
-			int id = this->pos2id[i];
-			unsigned ele = (*it)[i];
-			int degree = this->basic_query->getVarDegree(id);
-			for (int j = 0; j < degree; ++j)
-			{
-				int id2 = this->basic_query->getEdgeNeighborID(id, j);
-				if (this->basic_query->isSatelliteInJoin(id2) == false)
-					continue;
+			int id2 = this->basic_query->getEdgeNeighborID(id, j);
+			if (this->basic_query->isSatelliteInJoin(id2) == false)
+				continue;
 #ifdef DEBUG_JOIN
-				//cout << "to generate "<<id2<<endl;
+			//cout << "to generate "<<id2<<endl;
 #endif
-				unsigned* idlist = NULL;
-				unsigned idlist_len = 0;
-				int triple_id = this->basic_query->getEdgeID(id, j);
-				Triple triple = this->basic_query->getTriple(triple_id);
-
-				TYPE_PREDICATE_ID preid = this->basic_query->getEdgePreID(id, j);
-				if (preid == -2)  //?p
-				{
-					string predicate = triple.predicate;
-					int pre_var_id = this->basic_query->getPreVarID(predicate);
-					//if(this->basic_query->isPreVarSelected(pre_var_id))
-					//{
-					preid = (*it)[this->id2pos[pre_var_id+this->var_num]];
-					//}
-				}
-				else if (preid == -1)  //INVALID_PREDICATE_ID
-				{
-					//ERROR
-				}
+			this->satellite_lists.emplace_back();
+			IDListView& idlist = this->satellite_lists.back();
+			int triple_id = this->basic_query->getEdgeID(id, j);
+			Triple triple = this->basic_query->getTriple(triple_id);
 
-				char edge_type = this->basic_query->getEdgeType(id, j);
-				if (edge_type == Util::EDGE_OUT)
-				{
-					//if(preid < 0)
-					//{
-						//this->kvstore->getobjIDlistBysubID(ele, idlist, idlist_len, true);
-					//}
-					//else
-					//{
-					this->kvstore->getobjIDlistBysubIDpreID(ele, preid, idlist, idlist_len, true, txn);
-					//}
-				}
-				else
-				{
-					//if(preid < 0)
-					//{
-						//this->kvstore->getsubIDlistByobjID(ele, idlist, idlist_len, true);
-					//}
-					//else
-					//{
-					this->kvstore->getsubIDlistByobjIDpreID(ele, preid, idlist, idlist_len, true, txn);
-					//}
-				}
+			TYPE_PREDICATE_ID preid = this->basic_query->getEdgePreID(id, j);
+			if (preid == -2)  //?p
+			{
+				string predicate = triple.predicate;
+				int pre_var_id = this->basic_query->getPreVarID(predicate);
+				//if(this->basic_query->isPreVarSelected(pre_var_id))
+				//{
+				preid = _rec[this->id2pos[pre_var_id+this->var_num]];
+				//}
+			}
+			else if (preid == -1)  //INVALID_PREDICATE_ID
+			{
+				//ERROR
+			}
 
-				if(idlist_len == 0)
-				{
-					valid = false;
-					break;
-				}
-				this->satellites.push_back(Satellite(id2, idlist, idlist_len));
-#ifdef DEBUG_JOIN
-				//cout<<"push a new satellite in"<<endl;
-#endif
+			char edge_type = this->basic_query->getEdgeType(id, j);
+			if (edge_type == Util::EDGE_OUT)
+			{
+				//if(preid < 0)
+				//{
+					//this->kvstore->getobjIDlistBysubID(ele, idlist, idlist_len, true);
+				//}
+				//else
+				//{
+				this->kvstore->getobjIDlistBysubIDpreID(ele, preid, idlist, txn);
+				//}
+			}
+			else
+			{
+				//if(preid < 0)
+				//{
+					//this->kvstore->getsubIDlistByobjID(ele, idlist, idlist_len, true);
+				//}
+				//else
+				//{
+				this->kvstore->getsubIDlistByobjIDpreID(ele, preid, idlist, txn);
+				//}
 			}
-			if(!valid)
+
+			if(idlist.empty())
 			{
+				valid = false;
 				break;
 			}
-		}
+			this->satellites.push_back(Satellite(id2, idlist.getList(), idlist.getLen()));
 #ifdef DEBUG_JOIN
-		//cout<<"satellites all prepared!"<<endl;
+			//cout<<"push a new satellite in"<<endl;
 #endif
-		int size = satellites.size();
-		if(valid)
-		{
-			this->cartesian(0, size);
 		}
-#ifdef DEBUG_JOIN
-		//cout<<"after cartesian"<<endl;
-#endif
-		for (int k = 0; k < size; ++k)
+		if(!valid)
 		{
-			delete[] this->satellites[k].idlist;
-			//this->satellites[k].idlist = NULL;
+			break;
 		}
-		//WARN:use this to avoid influence on the next loop
-		this->satellites.clear();
+	}
 #ifdef DEBUG_JOIN
-		//cout<<"after clear the satellites"<<endl;
+	//cout<<"satellites all prepared!"<<endl;
 #endif
+	int size = satellites.size();
+	if(valid)
+	{
+		this->cartesian(0, size);
 	}
+#ifdef DEBUG_JOIN
+	//cout<<"after cartesian"<<endl;
+#endif
+	//WARN:use this to avoid influence on the next loop
+	this->satellites.clear();
+	this->satellite_lists.clear();
+#ifdef DEBUG_JOIN
+	//cout<<"after clear the satellites"<<endl;
+#endif
+}
 
+void
+Join::end_copy()
+{
 	delete[] this->record;
 #ifdef DEBUG_JOIN
 	//cout<<"after delete the record"<<endl;
@@ -706,7 +741,7 @@ Join::cartesian(int pos, int end)
 {
 	if (pos == end)
 	{
-		unsigned* new_record = new unsigned[this->record_len];
+		unsigned* new_record = this->basic_query->newResultRow(this->record_len);
 		memcpy(new_record, this->record, sizeof(unsigned) * this->record_len);
 		this->result_list->push_back(new_record);
 		return;
@@ -715,8 +750,8 @@ Join::cartesian(int pos, int end)
 	unsigned size = this->satellites[pos].idlist_len;
 	int id = this->satellites[pos].id;
 	int vpos = this->basic_query->getSelectedVarPosition(id);
-	unsigned* list = this->satellites[pos].idlist;
-	for (unsigned i = 0; i < size; ++i)
+	const unsigned* list = this->satellites[pos].idlist;
+	for (unsigned i = 0; i < size && !this->reached_limit(); ++i)
 	{
 		this->record[vpos] = list[i];
 		this->cartesian(pos + 1, end);
@@ -884,6 +919,11 @@ Join::join()
 	}
 
 	int method = this->judge(smallest, biggest);
+	//binary joins may produce huge intermediate tables on cycles(i.e. triangles)
+	if (method == 0 && this->use_leapfrog && this->is_cyclic())
+	{
+		method = 2;
+	}
 	bool ret = true;
 	switch (method)
 	{
@@ -892,6 +932,10 @@ Join::join()
 		cout << "use multi-join here!" << endl;
 		ret = this->multi_join();
 		break;
+	case 2:
+		cout << "use leapfrog-join here!" << endl;
+		ret = this->leapfrog_join();
+		break;
 	case 1:
 		//printf("use index-join here!\n");
 		cout << "use index-join here!" << endl;
@@ -973,18 +1017,9 @@ Join::is_literal_var(int _id)
 //Below are functions to do multi-join method
 //===================================================================================================
 
-void
-Join::add_new_to_results(TableIterator it, unsigned id)
-{
-	//NTC:already have one more in *it if need to push back
-	RecordType tmp(*it);
-	*(tmp.rbegin()) = id;
-	this->current_table.push_back(tmp);
-}
-
 //after remove VSTREE, modify here
 void
-Join::update_answer_list(IDList*& valid_ans_list, IDList& _can_list, unsigned* id_list, unsigned id_list_len, bool _is_ready)
+Join::update_answer_list(IDList*& valid_ans_list, IDList& _can_list, const unsigned* id_list, unsigned id_list_len, bool _is_ready)
 {
 	if (valid_ans_list == NULL)
 	{
@@ -1026,34 +1061,76 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 	{
 		return false;   //empty result
 	}
+	//each matched record is extended by its valid ids into next_table
+	unsigned long morsel_num = (this->current_table.size() + Join::MORSEL_ROWS - 1) / Join::MORSEL_ROWS;
+	this->next_table.reset(this->current_table.getColNum() + 1);
+	bool found = this->join_morsels(_edges, _can_list, _id, _is_ready, 0, morsel_num);
+	this->current_table.swap(this->next_table);
+	this->next_table.reset(0);
+	return found;
+}
+
+//extend the morsels _first to _last-1 of current_table by _id, appending to next_table
+bool
+Join::join_morsels(vector< vector<int> >& _edges, IDList& _can_list, int _id, bool _is_ready, unsigned long _first, unsigned long _last)
+{
 	bool found = false;
-	bool if_new_start = false; //the first to add to end in while
-	for(TableIterator it0 = this->current_table.begin(); it0 != this->new_start;)
+	unsigned col_num = this->current_table.getColNum();
+	unsigned long row_num = this->current_table.size();
+	unsigned long morsel_num = _last - _first;
+	if (this->parallelism != 1 && morsel_num > 1)
 	{
+		if (this->pool == NULL)
+		{
+			this->pool = new WorkStealingPool(this->parallelism);
+			for (unsigned i = 0; i < this->pool->getWorkerNum(); ++i)
+				this->worker_tables.push_back(new IDTable());
+		}
+		unsigned worker_num = this->pool->getWorkerNum();
+		//each worker extends the morsels it takes into its own table, no lock is needed
+		vector<char> worker_found(worker_num, 0);
+		for (unsigned i = 0; i < worker_num; ++i)
+			this->worker_tables[i]->reset(col_num + 1);
+		this->pool->run(morsel_num, [&](unsigned _worker, unsigned long _morsel)
+		{
+			unsigned long begin = (_first + _morsel) * Join::MORSEL_ROWS;
+			unsigned long end = begin + Join::MORSEL_ROWS < row_num ? begin + Join::MORSEL_ROWS : row_num;
+			if (this->join_rows(_edges, _can_list, _id, _is_ready, begin, end, *this->worker_tables[_worker]))
+				worker_found[_worker] = 1;
+		});
 #ifdef DEBUG_JOIN
-		if (this->new_start != this->current_table.end())
+		cout << "parallel join_two: " << morsel_num << " morsels, " << this->pool->getStealNum() << " stolen" << endl;
+#endif
+		for (unsigned i = 0; i < worker_num; ++i)
 		{
-			//printf("now the new_start is:");
-			cout << "now the new_start is:";
-			for (RecordIterator it1 = this->new_start->begin(); it1 != this->new_start->end(); ++it1)
-			{
-				//printf(" %d", *it1);
-				cout << " " << *it1;
-			}
-			//printf("\n");
-			cout << endl;
+			this->next_table.append(*this->worker_tables[i]);
+			this->worker_tables[i]->reset(0);
+			found = found || worker_found[i];
 		}
-		else
-			//printf("new_start still in end?!\n");
-			cout << "new_start still in end?!" << endl;
-		//printf("now the record is:");
+	}
+	else
+	{
+		unsigned long end = _last * Join::MORSEL_ROWS < row_num ? _last * Join::MORSEL_ROWS : row_num;
+		found = this->join_rows(_edges, _can_list, _id, _is_ready, _first * Join::MORSEL_ROWS, end, this->next_table);
+	}
+	return found;
+}
+
+//extend rows _begin to _end-1 of current_table by _id into _out
+//NOTICE: called by several threads at a time in parallel join, only read the members here
+bool
+Join::join_rows(vector< vector<int> >& _edges, IDList& _can_list, int _id, bool _is_ready, unsigned long _begin, unsigned long _end, IDTable& _out)
+{
+	bool found = false;
+	unsigned col_num = this->current_table.getColNum();
+	for (unsigned long row = _begin; row < _end; ++row)
+	{
+#ifdef DEBUG_JOIN
 		cout << "now the record is:";
-		for (RecordIterator it1 = it0->begin(); it1 != it0->end(); ++it1)
+		for (unsigned i = 0; i < col_num; ++i)
 		{
-			//printf(" %d", *it1);
-			cout << " " << *it1;
+			cout << " " << this->current_table.get(row, i);
 		}
-		//printf("\n");
 		cout << endl;
 #endif
 
@@ -1065,7 +1142,7 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 		//list<int> valid_ans_list;
 		bool matched = true;
 		//NOTICE:we can generate cans from either direction, but this way is convenient and better
-		for (RecordIterator it1 = it0->begin(); it1 != it0->end(); ++it1, ++cnt)
+		for (; cnt < (int)col_num; ++cnt)
 		{
 #ifdef DEBUG_JOIN
 			//printf("cnt is: %d\n", cnt);
@@ -1079,7 +1156,7 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 #ifdef DEBUG_JOIN
 			cout << "edge exists!" << endl;
 #endif
-			unsigned ele = *it1;
+			unsigned ele = this->current_table.get(row, cnt);
 			bool exist_constant_pre = false;
 			bool s2o_pre_var = false;
 			bool o2s_pre_var = false;
@@ -1117,23 +1194,23 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 					break;
 				}
 
-				unsigned* id_list;
-				unsigned id_list_len;
+				//refer to the list in kvstore directly, no copy is needed
+				IDListView id_list;
 				if (edge_type == Util::EDGE_IN)
 				{
 #ifdef DEBUG_JOIN
 					cout << "this is an edge to our id to join!" << endl;
 #endif
-					this->kvstore->getobjIDlistBysubIDpreID(ele, pre_id, id_list, id_list_len, true, txn);
+					this->kvstore->getobjIDlistBysubIDpreID(ele, pre_id, id_list, txn);
 				}
 				else
 				{
 #ifdef DEBUG_JOIN
 					cout << "this is an edge from our id to join!" << endl;
 #endif
-					this->kvstore->getsubIDlistByobjIDpreID(ele, pre_id, id_list, id_list_len, true, txn);
+					this->kvstore->getsubIDlistByobjIDpreID(ele, pre_id, id_list, txn);
 				}
-				if (id_list_len == 0)
+				if (id_list.empty())
 				{
 					//id_list == NULL in this case, no need to free
 					matched = false;
@@ -1150,8 +1227,8 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 
 				//only can occur the first time, means cnt == 0
 				//if(valid_ans_list.size() == 0)
-				update_answer_list(valid_ans_list, _can_list, id_list, id_list_len, _is_ready);
-				delete[] id_list;
+				update_answer_list(valid_ans_list, _can_list, id_list.getList(), id_list.getLen(), _is_ready);
+				id_list.release();
 				if (valid_ans_list->size() == 0)
 				{
 					matched = false;
@@ -1204,34 +1281,15 @@ Join::join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_l
 			cout << "this record is matched!!" << endl;
 #endif
 			found = true;
-			unsigned size = valid_ans_list->size();
-
-			it0->push_back((*valid_ans_list)[0]);
-			unsigned begin = 1;
-			if (!if_new_start && size > 1)
-			{
-				this->add_new_to_results(it0, (*valid_ans_list)[1]);
-				if_new_start = true;
-				//this->new_start = this->current_table.rbegin().base();
-				this->new_start = this->current_table.end();
-				this->new_start--; //-1 is not allowed
-				begin = 2;
-			}
-
-			for (unsigned i = begin; i < size; ++i)
-			{
-				//WARN+NOTICE:this strategy may cause that duplicates are not together!
-				this->add_new_to_results(it0, (*valid_ans_list)[i]);
-			}
-			it0++;
+			//WARN+NOTICE:this strategy may cause that duplicates are not together!
+			_out.appendExtend(this->current_table, row, &(*valid_ans_list->getList())[0], valid_ans_list->size());
 		}
+#ifdef DEBUG_JOIN
 		else
 		{
-			it0 = this->current_table.erase(it0);
-#ifdef DEBUG_JOIN
 			cout << "this record is not matched!" << endl;
-#endif
 		}
+#endif
 		delete valid_ans_list;
 		valid_ans_list = NULL;
 	}
@@ -1258,15 +1316,193 @@ Join::reset_id_pos_mapping()
 //should not filter for literal var and just generate when join?
 //QUERY:is the allFilterBySatellites sometimes costly if candidate list is too large?
 //in this case we can join first and filter by edge later
+
+//extend current_table by the var _id2, which must be linked to a var in it
+bool
+Join::join_var(int _id2)
+{
+	vector< vector<int> > edges; //the edge index for table column in _id2
+					   // the outer is node-loop, inner is canlist-loop
+	vector< vector<int*> > id_lists;
+	vector< vector<int> > id_lists_len;
+	//int* tmp_id_list;
+	//int tmp_id_list_len;
+	IDList& can_list = this->basic_query->getCandidateList(_id2);
+	unsigned can_list_size = can_list.size();
+
+	for (int i = 0; i < this->id_pos; ++i)
+	{
+		vector<int> edge_index = this->basic_query->getEdgeIndex(_id2, this->pos2id[i]);
+		edges.push_back(edge_index);
+	}
+	//NOTICE: there are several ways to join two tables
+	//h is the cost to search kvstore, m is the returned list size
+	//n is the normal can_list_size, k is the vars num to
+	//consider now, r is the record num
+	//0. expand and intersect with another table: not ok!
+	//1. given two node to find if exist right pre:
+	//O(1) space, O(rhknlogn) time,
+	//2. bsearch in can_list: O(mk+n) space, O(rmkhlogn) time
+	//3. bsearch in id_list: O(nkm) space, O(rnklogm+knh)
+	//
+	//most queries will contain many constants(entity/literal)
+	//var's can_list with one constant neighbor will be small,
+	//otherwise will be big compared with id_list
+	//the can_list of var representing literals is not valid,
+	//must use kvstore->get...() to join
+
+	//NOTICE: not cancle the followings, to be used for later
+	//TODO: if queries contain predicate variables, it may be hard to prepare candidates for a node
+	//(so it is not ready, can also be represented by is_literal_var())
+	/*
+	bool is_literal = this->is_literal_var(_id2);
+	if(is_literal)
+	{
+#ifdef DEBUG_PRECISE
+		cout << "this var may contain literals: " << _id2 << endl;
+#endif
+		this->basic_query->setReady(_id2);
+	}
+	else
+	{
+#ifdef DEBUG_PRECISE
+		cout << "this var not contain literals: " << _id2 << endl;
+#endif
+	}
+	*/
+	bool flag = false;
+#ifdef DEBUG_PRECISE
+		cout << "this edge uses not-prepared-join way" << endl;
+#endif
+	//the last var of a streamed join is copied to the result as it is joined
+	bool last = this->stream_result && this->id_pos + 1 == this->basic_query->getRetrievedVarNum();
+	if (last)
+		flag = this->stream_var(edges, can_list, can_list_size, _id2);
+	else
+		flag = this->join_two(edges, can_list, can_list_size, _id2, this->basic_query->isReady(_id2));
+
+	//if current_table is empty, ends directly
+	if (!flag)
+	{
+#ifdef DEBUG_JOIN
+		cout << "the result is already empty!!" << endl;
+#endif
+		//break;
+		return false; //to avoid later invalid copy
+	}
+
+	//stream_var() has mapped _id2 already, edges only covers the columns before it
+	for (unsigned i = 0; i < edges.size(); ++i)
+	{
+		vector<int> edge_index = edges[i];
+		for(vector<int>::iterator it = edge_index.begin(); it != edge_index.end(); ++it)
+		{
+			int edge_id = this->basic_query->getEdgeID(_id2, *it);
+			dealed_triple[edge_id] = true;
+		}
+	}
+
+	if (!last)
+	{
+		this->add_id_pos_mapping(_id2);
+	}
+	return true;
+}
+
+//join the last var _id wave by wave, each wave a morsel for each worker, and copy the rows
+//to the result until there are row_limit ones, so the rest of current_table is never joined
+bool
+Join::stream_var(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_list_size, int _id)
+{
+	bool is_ready = this->basic_query->isReady(_id);
+	if (_can_list_size == 0 && is_ready)
+	{
+		return false;
+	}
+	this->add_id_pos_mapping(_id);
+	if (!this->begin_copy())
+	{
+		return false;
+	}
+	this->result_copied = true;
+
+	unsigned col_num = this->current_table.getColNum();
+	unsigned long morsel_num = (this->current_table.size() + Join::MORSEL_ROWS - 1) / Join::MORSEL_ROWS;
+	unsigned long wave = this->parallelism;
+	if (wave == 0)
+		wave = max(1U, thread::hardware_concurrency());
+	bool found = false;
+	unsigned long first = 0;
+	RecordType rec(col_num + 1);
+	while (first < morsel_num && !this->reached_limit())
+	{
+		unsigned long last = first + wave < morsel_num ? first + wave : morsel_num;
+		this->next_table.reset(col_num + 1);
+		if (this->join_morsels(_edges, _can_list, _id, is_ready, first, last))
+		{
+			found = true;
+			for (unsigned long row = 0; row < this->next_table.size() && !this->reached_limit(); ++row)
+			{
+				this->next_table.getRow(row, &rec[0]);
+				this->copy_row(&rec[0]);
+			}
+		}
+		first = last;
+	}
+	this->end_copy();
+	cout << "streamed join: " << first << " of " << morsel_num << " morsels for " << this->result_list->size() << " rows" << endl;
+
+	this->current_table.swap(this->next_table);
+	this->next_table.reset(0);
+	return found;
+}
+
+//whether every row joined becomes at least one result row, so the join can stop at row_limit:
+//pre vars and the pre filters of one-degree vars in only_pre_filter_after_join() drop rows later
+bool
+Join::can_stream()
+{
+	if (this->basic_query->getPreVarNum() > 0)
+	{
+		return false;
+	}
+	for (int var_id = 0; var_id < this->var_num; ++var_id)
+	{
+		int var_degree = this->basic_query->getVarDegree(var_id);
+		for (int i = 0; i < var_degree; ++i)
+		{
+			int triple_id = this->basic_query->getEdgeID(var_id, i);
+			if (this->dealed_triple[triple_id])
+			{
+				continue;
+			}
+			Triple triple = this->basic_query->getTriple(triple_id);
+			string neighbor_name = this->basic_query->getEdgeType(var_id, i) == Util::EDGE_OUT ? triple.object : triple.subject;
+			if (this->basic_query->isOneDegreeNotJoinVar(neighbor_name))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 bool
 Join::multi_join()
 {
-	this->select();
+	bool planned = this->reuse_join_order() || this->plan_join_order();
+	if (planned)
+	{
+		this->start_id = this->join_order[0];
+	}
+	else
+	{
+		this->select();
+	}
 
 	//keep an increasing vector for temp results, not in id order
 	//vals num generally < 10, so just enum them and check if conncted
 	//finally, copy in order to result_list in BasicQuery
-	TableIterator it0;
 	list<int>::iterator it1;
 	vector<int>::iterator it2;
 	//list<bool>::iterator it3;
@@ -1285,18 +1521,33 @@ Join::multi_join()
 #ifdef DEBUG_JOIN
 	cout << "the start size " << start_size << endl;
 #endif
-	for (unsigned i = 0; i < start_size; ++i)
+	this->current_table.reset(1);
+	if (start_size > 0)
 	{
-		unsigned ele = start_table.getID(i);
-		//NOTICE: we can denote the total size here in vector, but no need because the variables' num is small
-		//(won't double to require more space)
-		RecordType record(1, ele);
-		this->current_table.push_back(record);
-		//this->table_row_new.push_back(false);
+		this->current_table.appendColumn(&(*start_table.getList())[0], start_size);
 	}
 	this->add_id_pos_mapping(this->start_id);
 	//cout<<"the mapping is id "<<this->start_id<<"   and pos "<<this->id2pos[this->start_id]<<endl;
-	this->new_start = this->current_table.end();
+
+	if (planned)
+	{
+		cout << "cost based join order:" << endl;
+		cout << "  " << this->basic_query->getVarName(this->start_id) << ": estimated " << (unsigned long)this->join_estimates[0]
+			<< " rows, actual " << this->current_table.size() << " rows" << endl;
+		for (unsigned i = 1; i < this->join_order.size(); ++i)
+		{
+			bool flag = this->join_var(this->join_order[i]);
+			//a streamed last var stops at the limit, only the rows copied to the result are known
+			unsigned long actual = this->result_copied ? this->result_list->size() : this->current_table.size();
+			cout << "  " << this->basic_query->getVarName(this->join_order[i]) << ": estimated " << (unsigned long)this->join_estimates[i]
+				<< " rows, actual " << actual << " rows" << (this->result_copied ? "(streamed)" : "") << endl;
+			if (!flag)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
 
 	this->mystack.push(this->start_id);
 #ifdef DEBUG_JOIN
@@ -1331,83 +1582,10 @@ Join::multi_join()
 		cout << "the start size " << this->basic_query->getCandidateSize(id2) << endl;
 #endif
 
-		vector< vector<int> > edges; //the edge index for table column in id2
-						   // the outer is node-loop, inner is canlist-loop
-		vector< vector<int*> > id_lists;
-		vector< vector<int> > id_lists_len;
-		//int* tmp_id_list;
-		//int tmp_id_list_len;
-		IDList& can_list = this->basic_query->getCandidateList(id2);
-		unsigned can_list_size = can_list.size();
-
-		for (int i = 0; i < this->id_pos; ++i)
-		{
-			vector<int> edge_index = this->basic_query->getEdgeIndex(id2, this->pos2id[i]);
-			edges.push_back(edge_index);
-		}
-		//NOTICE: there are several ways to join two tables
-		//h is the cost to search kvstore, m is the returned list size
-		//n is the normal can_list_size, k is the vars num to
-		//consider now, r is the record num
-		//0. expand and intersect with another table: not ok!
-		//1. given two node to find if exist right pre:
-		//O(1) space, O(rhknlogn) time,
-		//2. bsearch in can_list: O(mk+n) space, O(rmkhlogn) time
-		//3. bsearch in id_list: O(nkm) space, O(rnklogm+knh)
-		//
-		//most queries will contain many constants(entity/literal)
-		//var's can_list with one constant neighbor will be small,
-		//otherwise will be big compared with id_list
-		//the can_list of var representing literals is not valid,
-		//must use kvstore->get...() to join
-
-		//NOTICE: not cancle the followings, to be used for later
-		//TODO: if queries contain predicate variables, it may be hard to prepare candidates for a node
-		//(so it is not ready, can also be represented by is_literal_var())
-		/*
-		bool is_literal = this->is_literal_var(id2);
-		if(is_literal)
-		{
-#ifdef DEBUG_PRECISE
-			cout << "this var may contain literals: " << id2 << endl;
-#endif
-			this->basic_query->setReady(id2);
-		}
-		else
-		{
-#ifdef DEBUG_PRECISE
-			cout << "this var not contain literals: " << id2 << endl;
-#endif
-		}
-		*/
-		bool flag = false;
-#ifdef DEBUG_PRECISE
-			cout << "this edge uses not-prepared-join way" << endl;
-#endif
-			flag = this->join_two(edges, can_list, can_list_size, id2, this->basic_query->isReady(id2));
-
-		//if current_table is empty, ends directly
-		if (!flag)
-		{
-#ifdef DEBUG_JOIN
-			cout << "the result is already empty!!" << endl;
-#endif
-			//break;
-			return false; //to avoid later invalid copy
-		}
-
-		for (int i = 0; i < this->id_pos; ++i)
+		if (!this->join_var(id2))
 		{
-			vector<int> edge_index = edges[i];
-			for(vector<int>::iterator it = edge_index.begin(); it != edge_index.end(); ++it)
-			{
-				int edge_id = this->basic_query->getEdgeID(id2, *it);
-				dealed_triple[edge_id] = true;
-			}
+			return false;
 		}
-
-		this->new_start = this->current_table.end();
-		this->add_id_pos_mapping(id2);
 		this->mystack.push(id2);
 	}
 #ifdef DEBUG_JOIN
@@ -1425,7 +1603,615 @@ Join::multi_join()
 	return true;
 }
 
+void
+Join::predicate_stat(TYPE_PREDICATE_ID _pre, double& _triples, double& _subjects, double& _objects)
+{
+	if (_pre < 0)
+	{
+		//predicate var, any edge
+		_triples = this->statistics->getTripleNum();
+		_subjects = this->statistics->getSubjectNum();
+		_objects = this->statistics->getObjectNum();
+		return;
+	}
+	const Statistics::PredicateStat* ps = this->statistics->getPredicate(_pre);
+	if (ps == NULL)
+	{
+		_triples = _subjects = _objects = 0;
+		return;
+	}
+	_triples = ps->triples;
+	_subjects = ps->subjects;
+	_objects = ps->objects;
+}
+
+//the distinct values of a var before join: its candidates if ready, otherwise
+//bounded by the subjects or objects of each predicate on its edges
+double
+Join::estimate_var(int _var)
+{
+	if (this->basic_query->isReady(_var))
+	{
+		return this->basic_query->getCandidateSize(_var);
+	}
+	double est = (double)this->statistics->getSubjectNum() + this->statistics->getObjectNum();
+	int degree = this->basic_query->getVarDegree(_var);
+	for (int i = 0; i < degree; ++i)
+	{
+		double triples, subjects, objects;
+		this->predicate_stat(this->basic_query->getEdgePreID(_var, i), triples, subjects, objects);
+		if (this->basic_query->getEdgeType(_var, i) == Util::EDGE_OUT)
+			est = min(est, subjects);
+		else
+			est = min(est, objects);
+	}
+	return est;
+}
+
+//The size of joining a set of vars is estimated as the product of the sizes of
+//the vars and the selectivity of the edges among them, where an edge ?s p ?o keeps
+//triples(p) / (max(|?s|, subjects(p)) * max(|?o|, objects(p))) of the pairs.
+//The stars of a subject are corrected by the characteristic sets, since the
+//predicates of an entity are far from independent, and each step is capped by the
+//max degree of the predicates linking the new var.
+bool
+Join::plan_join_order()
+{
+	this->join_order.clear();
+	this->join_estimates.clear();
+	//the greedy order of score_node() if the counts are missing or stale
+	if (this->statistics == NULL || !this->statistics->isValid() || this->statistics->isStale())
+	{
+		return false;
+	}
+
+	vector<int> vars;
+	vector<int> bit(this->var_num, -1);
+	for (int i = 0; i < this->var_num; ++i)
+	{
+		if (this->basic_query->if_need_retrieve(i))
+		{
+			bit[i] = vars.size();
+			vars.push_back(i);
+		}
+	}
+	unsigned n = vars.size();
+	if (n < 2 || n > Join::MAX_DP_VARS)
+	{
+		return false;
+	}
+
+	//edges among the core vars, each one once from its subject
+	vector<unsigned> sub, obj;
+	vector<TYPE_PREDICATE_ID> pre;
+	vector<double> sel, max_out, max_in;
+	vector<unsigned> adj(n, 0);
+	vector<double> base(n);
+	for (unsigned k = 0; k < n; ++k)
+	{
+		base[k] = this->estimate_var(vars[k]);
+	}
+	for (unsigned k = 0; k < n; ++k)
+	{
+		int degree = this->basic_query->getVarDegree(vars[k]);
+		for (int i = 0; i < degree; ++i)
+		{
+			int id2 = this->basic_query->getEdgeNeighborID(vars[k], i);
+			if (id2 < 0 || id2 >= this->var_num || bit[id2] < 0)
+				continue;
+			unsigned k2 = bit[id2];
+			adj[k] |= 1u << k2;
+			if (this->basic_query->getEdgeType(vars[k], i) != Util::EDGE_OUT)
+				continue;
+			TYPE_PREDICATE_ID p = this->basic_query->getEdgePreID(vars[k], i);
+			double triples, subjects, objects;
+			this->predicate_stat(p, triples, subjects, objects);
+			sub.push_back(k);
+			obj.push_back(k2);
+			pre.push_back(p);
+			sel.push_back(triples / (max(max(base[k], subjects), 1.0) * max(max(base[k2], objects), 1.0)));
+			const Statistics::PredicateStat* ps = p < 0 ? NULL : this->statistics->getPredicate(p);
+			//no cap for predicate vars
+			max_out.push_back(p < 0 ? triples : (ps == NULL ? 0 : ps->max_out));
+			max_in.push_back(p < 0 ? triples : (ps == NULL ? 0 : ps->max_in));
+		}
+	}
+	unsigned edge_num = sub.size();
+	double subject_num = max((double)this->statistics->getSubjectNum(), 1.0);
+
+	unsigned full = (1u << n) - 1;
+	vector<double> card(full + 1, -1);
+	//the estimated size of joining the vars in _mask in any order
+	auto estimate = [&](unsigned _mask) -> double
+	{
+		if (card[_mask] >= 0)
+			return card[_mask];
+		double c = 1;
+		for (unsigned k = 0; k < n; ++k)
+		{
+			if (_mask & (1u << k))
+				c *= base[k];
+		}
+		for (unsigned e = 0; e < edge_num; ++e)
+		{
+			if ((_mask & (1u << sub[e])) && (_mask & (1u << obj[e])))
+				c *= sel[e];
+		}
+		for (unsigned k = 0; k < n; ++k)
+		{
+			if (!(_mask & (1u << k)))
+				continue;
+			vector<TYPE_PREDICATE_ID> star;
+			double independent = subject_num;
+			for (unsigned e = 0; e < edge_num; ++e)
+			{
+				if (sub[e] == k && (_mask & (1u << obj[e])) && pre[e] >= 0)
+				{
+					double triples, subjects, objects;
+					this->predicate_stat(pre[e], triples, subjects, objects);
+					star.push_back(pre[e]);
+					independent *= triples / subject_num;
+				}
+			}
+			double subjects, rows;
+			if (star.size() < 2 || independent <= 0 || !this->statistics->estimateStar(star, subjects, rows))
+				continue;
+			c *= max(rows, 1.0) / independent;
+		}
+		card[_mask] = c;
+		return c;
+	};
+
+	const double INF = HUGE_VAL;
+	vector<double> cost(full + 1, INF);
+	vector<double> rows(full + 1, 0);
+	vector<int> last(full + 1, -1);
+	for (unsigned k = 0; k < n; ++k)
+	{
+		if (this->basic_query->isReady(vars[k]))
+		{
+			cost[1u << k] = rows[1u << k] = base[k];
+			last[1u << k] = k;
+		}
+	}
+	//masks only grow, so all ways to reach a mask are done before it is extended
+	for (unsigned mask = 1; mask < full; ++mask)
+	{
+		if (cost[mask] == INF)
+			continue;
+		unsigned next = 0;
+		for (unsigned k = 0; k < n; ++k)
+		{
+			if (mask & (1u << k))
+				next |= adj[k];
+		}
+		next &= ~mask;
+		for (unsigned k = 0; k < n; ++k)
+		{
+			if (!(next & (1u << k)))
+				continue;
+			unsigned new_mask = mask | (1u << k);
+			double fanout = INF;
+			for (unsigned e = 0; e < edge_num; ++e)
+			{
+				if (sub[e] == k && (mask & (1u << obj[e])))
+					fanout = min(fanout, max_in[e]);
+				else if (obj[e] == k && (mask & (1u << sub[e])))
+					fanout = min(fanout, max_out[e]);
+			}
+			double r = estimate(new_mask);
+			if (fanout != INF)
+				r = min(r, rows[mask] * fanout);
+			if (cost[mask] + r < cost[new_mask])
+			{
+				cost[new_mask] = cost[mask] + r;
+				rows[new_mask] = r;
+				last[new_mask] = k;
+			}
+		}
+	}
+	if (cost[full] == INF)
+	{
+		//not connected
+		return false;
+	}
+
+	for (unsigned mask = full; mask != 0; mask &= ~(1u << last[mask]))
+	{
+		this->join_order.push_back(vars[last[mask]]);
+		this->join_estimates.push_back(rows[mask]);
+	}
+	reverse(this->join_order.begin(), this->join_order.end());
+	reverse(this->join_estimates.begin(), this->join_estimates.end());
+	if (this->join_plan != NULL)
+	{
+		this->join_plan->vars.clear();
+		for (unsigned k = 0; k < n; ++k)
+		{
+			this->join_plan->vars.push_back(this->basic_query->getVarName(vars[k]));
+		}
+		this->join_plan->order = this->join_order;
+		this->join_plan->estimates = this->join_estimates;
+	}
+	return true;
+}
+
+bool
+Join::reuse_join_order()
+{
+	if (this->join_plan == NULL || this->join_plan->order.empty())
+	{
+		return false;
+	}
+	vector<string> vars;
+	vector<bool> core(this->var_num, false);
+	for (int i = 0; i < this->var_num; ++i)
+	{
+		if (this->basic_query->if_need_retrieve(i))
+		{
+			vars.push_back(this->basic_query->getVarName(i));
+			core[i] = true;
+		}
+	}
+	const vector<int>& order = this->join_plan->order;
+	if (vars != this->join_plan->vars || order.size() != vars.size() || this->join_plan->estimates.size() != vars.size())
+	{
+		return false;
+	}
+
+	//each core var once, the first one ready and the others linked to a var before them
+	vector<bool> joined(this->var_num, false);
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		int id = order[i];
+		if (id < 0 || id >= this->var_num || !core[id] || joined[id])
+		{
+			return false;
+		}
+		bool linked = i == 0 && this->basic_query->isReady(id);
+		int degree = this->basic_query->getVarDegree(id);
+		for (int j = 0; j < degree && !linked && i > 0; ++j)
+		{
+			int id2 = this->basic_query->getEdgeNeighborID(id, j);
+			linked = id2 >= 0 && id2 < this->var_num && joined[id2];
+		}
+		if (!linked)
+		{
+			return false;
+		}
+		joined[id] = true;
+	}
+	this->join_order = order;
+	this->join_estimates = this->join_plan->estimates;
+	cout << "join order reused from the plan cache" << endl;
+	return true;
+}
+
+
+
+//===================================================================================================
+//Below are functions to do leapfrog-join method
+//===================================================================================================
+
+//whether the vars to be joined form a connected graph with cycles
+//parallel edges between two vars are not viewed as a cycle
+bool
+Join::is_cyclic()
+{
+	vector<int> parent(this->var_num);
+	for (int i = 0; i < this->var_num; ++i)
+	{
+		parent[i] = i;
+	}
+	int core_num = 0, union_num = 0;
+	bool cyclic = false;
+	for (int i = 0; i < this->var_num; ++i)
+	{
+		if (!this->basic_query->if_need_retrieve(i))
+		{
+			continue;
+		}
+		++core_num;
+		int degree = this->basic_query->getVarDegree(i);
+		for (int j = 0; j < degree; ++j)
+		{
+			int id2 = this->basic_query->getEdgeNeighborID(i, j);
+			if (id2 == i)
+			{
+				//self loops are only supported by multi-join
+				return false;
+			}
+			//each pair only once
+			if (id2 < i || id2 >= this->var_num || !this->basic_query->if_need_retrieve(id2))
+			{
+				continue;
+			}
+			vector<int> edge_index = this->basic_query->getEdgeIndex(i, id2);
+			if (edge_index[0] != j)
+			{
+				continue;
+			}
+			int r1 = i, r2 = id2;
+			while (parent[r1] != r1)
+			{
+				r1 = parent[r1];
+			}
+			while (parent[r2] != r2)
+			{
+				r2 = parent[r2];
+			}
+			if (r1 == r2)
+			{
+				cyclic = true;
+			}
+			else
+			{
+				parent[r1] = r2;
+				++union_num;
+			}
+		}
+	}
+
+	//the join order below requires a connected graph
+	return cyclic && union_num == core_num - 1;
+}
+
+bool
+Join::leapfrog_join()
+{
+	this->select();
+
+	//the order to bind vars: start from start_id, then always choose the var
+	//with the most bound neighbors, so that more lists are intersected early
+	vector<bool> ordered(this->var_num, false);
+	this->add_id_pos_mapping(this->start_id);
+	ordered[this->start_id] = true;
+	this->leapfrog_edges.push_back(vector<LeapfrogEdge>());
+	while (true)
+	{
+		int best = -1, best_links = 0;
+		double best_score = -1;
+		for (int i = 0; i < this->var_num; ++i)
+		{
+			if (ordered[i] || !this->basic_query->if_need_retrieve(i))
+			{
+				continue;
+			}
+			int links = 0;
+			for (int j = 0; j < this->id_pos; ++j)
+			{
+				links += this->basic_query->getEdgeIndex(i, this->pos2id[j]).size();
+			}
+			if (links == 0)
+			{
+				continue;
+			}
+			double score = this->score_node(i);
+			if (links > best_links || (links == best_links && score > best_score))
+			{
+				best = i;
+				best_links = links;
+				best_score = score;
+			}
+		}
+		if (best == -1)
+		{
+			break;
+		}
+
+		//collect the lists to intersect, in the same way as join_two()
+		vector<LeapfrogEdge> edges;
+		for (int j = 0; j < this->id_pos; ++j)
+		{
+			vector<int> edge_index = this->basic_query->getEdgeIndex(best, this->pos2id[j]);
+			bool exist_constant_pre = false;
+			bool s2o_pre_var = false, o2s_pre_var = false;
+			for (vector<int>::iterator it = edge_index.begin(); it != edge_index.end(); ++it)
+			{
+				char edge_type = this->basic_query->getEdgeType(best, *it);
+				TYPE_PREDICATE_ID pre_id = this->basic_query->getEdgePreID(best, *it);
+				this->dealed_triple[this->basic_query->getEdgeID(best, *it)] = true;
+				if (pre_id == -2)
+				{
+					if (edge_type == Util::EDGE_IN)
+						s2o_pre_var = true;
+					else
+						o2s_pre_var = true;
+				}
+				else if (pre_id >= 0)
+				{
+					exist_constant_pre = true;
+					edges.push_back(LeapfrogEdge(j, pre_id, edge_type));
+				}
+				else
+				{
+					cout << "invalid pre found in leapfrog_join!!!" << endl;
+					return false;
+				}
+			}
+			//sp2o and op2s are more precise than s2o and o2s
+			if (!exist_constant_pre)
+			{
+				if (s2o_pre_var)
+					edges.push_back(LeapfrogEdge(j, -2, Util::EDGE_IN));
+				if (o2s_pre_var)
+					edges.push_back(LeapfrogEdge(j, -2, Util::EDGE_OUT));
+			}
+		}
+		this->leapfrog_edges.push_back(edges);
+		this->add_id_pos_mapping(best);
+		ordered[best] = true;
+	}
+
+	RecordType record(this->id_pos);
+	this->current_table.reset(this->id_pos);
+	//when streamed, each row found goes to the result at once and the search stops at row_limit
+	this->result_copied = this->stream_result && this->begin_copy();
+	this->leapfrog_search(0, record);
+	if (this->result_copied)
+	{
+		this->end_copy();
+	}
+	return !this->current_table.empty();
+}
+
+void
+Join::leapfrog_search(unsigned _depth, RecordType& _record)
+{
+	if (_depth == this->leapfrog_edges.size())
+	{
+		this->current_table.appendRow(&_record[0]);
+		if (this->result_copied)
+		{
+			this->copy_row(&_record[0]);
+		}
+		return;
+	}
+	if (this->result_copied && this->reached_limit())
+	{
+		return;
+	}
+
+	int id = this->pos2id[_depth];
+	vector<LeapfrogEdge>& edges = this->leapfrog_edges[_depth];
+	vector<const unsigned*> lists;
+	vector<unsigned> lens;
+	deque<IDListView> views;
+	vector<unsigned*> owned_lists;
+	bool empty = false;
+
+	if (this->basic_query->isReady(id))
+	{
+		IDList& can_list = this->basic_query->getCandidateList(id);
+		if (can_list.empty())
+		{
+			return;
+		}
+		lists.push_back(&(*can_list.getList())[0]);
+		lens.push_back(can_list.size());
+	}
+	for (vector<LeapfrogEdge>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		unsigned ele = _record[it->pos];
+		if (it->preid >= 0)
+		{
+			views.emplace_back();
+			IDListView& id_list = views.back();
+			if (it->edge_type == Util::EDGE_IN)
+				this->kvstore->getobjIDlistBysubIDpreID(ele, it->preid, id_list, txn);
+			else
+				this->kvstore->getsubIDlistByobjIDpreID(ele, it->preid, id_list, txn);
+			if (id_list.empty())
+			{
+				empty = true;
+				break;
+			}
+			lists.push_back(id_list.getList());
+			lens.push_back(id_list.getLen());
+		}
+		else
+		{
+			unsigned* id_list = NULL;
+			unsigned id_list_len = 0;
+			if (it->edge_type == Util::EDGE_IN)
+				this->kvstore->getobjIDlistBysubID(ele, id_list, id_list_len, true, txn);
+			else
+				this->kvstore->getsubIDlistByobjID(ele, id_list, id_list_len, true, txn);
+			owned_lists.push_back(id_list);
+			if (id_list_len == 0)
+			{
+				empty = true;
+				break;
+			}
+			lists.push_back(id_list);
+			lens.push_back(id_list_len);
+		}
+	}
+
+	vector<unsigned> result;
+	if (!empty && !lists.empty())
+	{
+		Join::leapfrog_intersect(lists, lens, result);
+	}
+	views.clear();
+	for (vector<unsigned*>::iterator it = owned_lists.begin(); it != owned_lists.end(); ++it)
+	{
+		delete[] *it;
+	}
+
+	for (vector<unsigned>::iterator it = result.begin(); it != result.end(); ++it)
+	{
+		_record[_depth] = *it;
+		this->leapfrog_search(_depth + 1, _record);
+		if (this->result_copied && this->reached_limit())
+		{
+			break;
+		}
+	}
+}
+
+//intersect k ordered lists: each list seeks to the largest head met so far by galloping,
+//until all heads are equal, so the cost is bounded by the smallest list instead of the largest
+void
+Join::leapfrog_intersect(vector<const unsigned*>& _lists, vector<unsigned>& _lens, vector<unsigned>& _result)
+{
+	unsigned k = _lists.size();
+	if (k == 1)
+	{
+		_result.assign(_lists[0], _lists[0] + _lens[0]);
+		return;
+	}
+	if (k == 2)
+	{
+		_result.resize(_lens[0] < _lens[1] ? _lens[0] : _lens[1]);
+		_result.resize(ListIntersect::intersect(_lists[0], _lens[0], _lists[1], _lens[1], &_result[0]));
+		return;
+	}
+
+	//visit the lists in the order of their heads
+	vector<unsigned> order(k), pos(k, 0);
+	for (unsigned i = 0; i < k; ++i)
+	{
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return _lists[a][0] < _lists[b][0]; });
 
+	unsigned p = 0;
+	unsigned max = _lists[order[k - 1]][0];
+	while (true)
+	{
+		unsigned l = order[p];
+		const unsigned* list = _lists[l];
+		unsigned len = _lens[l];
+		if (list[pos[l]] == max)
+		{
+			//all heads are equal
+			_result.push_back(max);
+			if (++pos[l] == len)
+			{
+				break;
+			}
+		}
+		else
+		{
+			//gallop to the first element >= max
+			unsigned lo = pos[l], step = 1;
+			while (lo + step < len && list[lo + step] < max)
+			{
+				lo += step;
+				step <<= 1;
+			}
+			unsigned hi = lo + step < len ? lo + step + 1 : len;
+			pos[l] = lower_bound(list + lo, list + hi, max) - list;
+			if (pos[l] == len)
+			{
+				break;
+			}
+		}
+		max = list[pos[l]];
+		p = (p + 1) % k;
+	}
+}
 
 //===================================================================================================
 //Below are functions before or after Join
@@ -1994,9 +2780,10 @@ Join::only_pre_filter_after_join()
 			continue;
 		}
 
-		for (TableIterator it = this->current_table.begin(); it != this->current_table.end();)
+		vector<bool> keep(this->current_table.size(), true);
+		for (unsigned long row = 0; row < this->current_table.size(); ++row)
 		{
-			TYPE_ENTITY_LITERAL_ID entity_id = (*it)[this->id2pos[var_id]];
+			TYPE_ENTITY_LITERAL_ID entity_id = this->current_table.get(row, this->id2pos[var_id]);
 			unsigned* pair_list = NULL;
 			unsigned pair_len = 0;
 			bool exist_preid = true;
@@ -2052,13 +2839,10 @@ Join::only_pre_filter_after_join()
 			//result sequence is illegal when there exists any missing filter predicate id.
 			if (!exist_preid)
 			{
-				it = this->current_table.erase(it);
-			}
-			else
-			{
-				it++;
+				keep[row] = false;
 			}
 		}
+		this->current_table.filter(keep);
 		if (this->current_table.empty())
 		{
 			return false;
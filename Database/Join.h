@@ -12,15 +12,17 @@
 #include "../Query/IDList.h"
 #include "../Query/BasicQuery.h"
 #include "../Query/SPARQLquery.h"
+#include "../Query/PlanCache.h"
 #include "../KVstore/KVstore.h"
 #include "../Util/Util.h"
 #include "../Util/Transaction.h"
+#include "../Util/ListIntersect.h"
+#include "../Util/IDTable.h"
+#include "../Util/WorkStealingPool.h"
+#include "Statistics.h"
 
 typedef vector<unsigned> RecordType;
 typedef vector<unsigned>::iterator RecordIterator;
-typedef list<RecordType> TableType;
-typedef list<RecordType>::iterator TableIterator;
-typedef list<RecordType>::reverse_iterator TableReverseIterator;
 //typedef list< vector<int> > TableType;
 //typedef list< vector<int> >::iterator TableIterator;
 //typedef list< vector<int> >::reverse_iterator TableReverseIterator;
@@ -30,9 +32,9 @@ typedef list<RecordType>::reverse_iterator TableReverseIterator;
 typedef struct Satellite
 {
 	int id;
-	unsigned* idlist;
+	const unsigned* idlist;
 	unsigned idlist_len;
-	Satellite(int _id, unsigned* _idlist, unsigned _idlist_len)
+	Satellite(int _id, const unsigned* _idlist, unsigned _idlist_len)
 	{
 		this->id = _id;
 		this->idlist = _idlist;
@@ -40,6 +42,20 @@ typedef struct Satellite
 	}
 }Satellite;
 
+//an edge from a var to a var placed before it in the leapfrog order
+typedef struct LeapfrogEdge
+{
+	int pos;	//the column of the bound neighbor in the record
+	TYPE_PREDICATE_ID preid;	//-2 means a predicate var, so all predicates are used
+	char edge_type;
+	LeapfrogEdge(int _pos, TYPE_PREDICATE_ID _preid, char _edge_type)
+	{
+		this->pos = _pos;
+		this->preid = _preid;
+		this->edge_type = _edge_type;
+	}
+}LeapfrogEdge;
+
 //Database new Join and pass something like kvstore
 class Join
 {
@@ -64,10 +80,10 @@ private:
 	//constexpr static const double JUDGE_LIMIT = 0.5;
 
 	static const unsigned LIMIT_CANDIDATE_LIST_SIZE = 1000;
-	//BETTER?:predefine size to avoid copy cost
-	TableType current_table;
-	TableIterator new_start;   //keep to end() as default
-	//list<bool> table_row_new;
+	//the table joined so far, one column per var in id2pos order
+	//each step builds next_table with one more column and swaps them
+	IDTable current_table;
+	IDTable next_table;
 	
 	//keep the mapping for disordered ids in vector<int> table
 	int* id2pos; 
@@ -78,6 +94,8 @@ private:
 
 	vector<unsigned*>* result_list;
 	vector<Satellite> satellites;
+	//the id lists referenced by satellites, deque keeps elements in place
+	deque<IDListView> satellite_lists;
 	unsigned* record;
 	unsigned record_len;
 
@@ -115,9 +133,6 @@ private:
 	void cartesian(int pos, int end);
 
 	//functions for help
-	//copy/add to the end of current_table and set true
-	void add_new_to_results(TableIterator it, unsigned id);
-
 	//void set_results_old(list<bool>::iterator it);
 	int choose_next_node(int id);
 
@@ -125,13 +140,67 @@ private:
 	//bool is_literal_ele(int _id);
 	
 	void copyToResult();
+	//copyToResult() in steps, so that rows can also be copied as they are joined
+	bool begin_copy();
+	void copy_row(const unsigned* _rec);
+	void end_copy();
 
 	//BETTER?:change these params to members in class
 	//void acquire_all_id_lists(IdLists& _id_lists, IdListsLen& _id_lists_len, IDList& _can_list, vector<int>& _edges, int _id, unsigned _can_list_size);
-	void update_answer_list(IDList*& valid_ans_list, IDList& _can_list, unsigned* id_list, unsigned id_list_len, bool _is_literal);
+	void update_answer_list(IDList*& valid_ans_list, IDList& _can_list, const unsigned* id_list, unsigned id_list_len, bool _is_literal);
 	bool join_two(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_list_size, int _id, bool _is_ready);
+	bool join_morsels(vector< vector<int> >& _edges, IDList& _can_list, int _id, bool _is_ready, unsigned long _first, unsigned long _last);
+	bool join_rows(vector< vector<int> >& _edges, IDList& _can_list, int _id, bool _is_ready, unsigned long _begin, unsigned long _end, IDTable& _out);
+
+	//morsel-driven parallel join: the rows of current_table are cut into morsels,
+	//which are extended by the threads of pool(query_parallelism in init.conf,
+	//1 by default and 0 for all cores) into their own tables and merged later
+	static const unsigned MORSEL_ROWS = IDTable::CHUNK_ROWS;
+	unsigned parallelism;
+	WorkStealingPool* pool;
+	vector<IDTable*> worker_tables;
 
 	bool multi_join();
+	//join the next var with all edges to the vars already in current_table
+	bool join_var(int _id2);
+
+	//cost based join order: with the statistics of the database, choose the order
+	//of the core vars by dynamic programming over their connected subsets, which
+	//minimizes the sum of the estimated sizes of the intermediate tables
+	//(the old greedy order by score_node is used if there are no statistics)
+	static const unsigned MAX_DP_VARS = 16;
+	Statistics* statistics;
+	vector<int> join_order;
+	vector<double> join_estimates;
+	bool plan_join_order();
+	double estimate_var(int _var);
+	//the order cached for this BasicQuery in the PlanCache(NULL if none), taken if it is for the same
+	//core vars and still a valid order, and set to the order planned otherwise
+	PlanCache::JoinPlan* join_plan;
+	bool reuse_join_order();
+	void predicate_stat(TYPE_PREDICATE_ID _pre, double& _triples, double& _subjects, double& _objects);
+
+	//worst-case optimal join(leapfrog triejoin) for cyclic query graphs:
+	//bind one var at a time by intersecting the lists of all its bound neighbors
+	bool use_leapfrog;
+	vector< vector<LeapfrogEdge> > leapfrog_edges;
+	bool is_cyclic();
+	bool leapfrog_join();
+	void leapfrog_search(unsigned _depth, RecordType& _record);
+	static void leapfrog_intersect(vector<const unsigned*>& _lists, vector<unsigned>& _lens, vector<unsigned>& _result);
+
+	//LIMIT pushdown: the result rows wanted(0 for all), set by Strategy when they are the rows
+	//of the query without ORDER BY/DISTINCT/aggregates. copyToResult() stops there, and if no
+	//pre var or pre filter after the join may drop rows, the last join step is pulled a wave of
+	//morsels at a time straight into result_list until there are enough
+	unsigned long long row_limit;
+	bool stream_result;
+	bool result_copied;
+	bool can_stream();
+	bool reached_limit() const
+	{ return this->row_limit > 0 && this->result_list->size() >= this->row_limit; }
+	bool stream_var(vector< vector<int> >& _edges, IDList& _can_list, unsigned _can_list_size, int _id);
+
 	//NOTICE:this is only used to join a BasicQuery
 	bool join();
 
@@ -139,10 +208,12 @@ private:
 public:
 	Join();
 	Join(KVstore* _kvstore, TYPE_TRIPLE_NUM* _pre2num, TYPE_PREDICATE_ID _limitID_predicate, TYPE_ENTITY_LITERAL_ID _limitID_literal,
-		TYPE_ENTITY_LITERAL_ID _limitID_entity, shared_ptr<Transaction> txn = nullptr);
+		TYPE_ENTITY_LITERAL_ID _limitID_entity, shared_ptr<Transaction> txn = nullptr, Statistics* _statistics = NULL);
 	//these functions can be called by Database
 	bool join_sparql(SPARQLquery& _sparql_query);
 	bool join_basic(BasicQuery* _basic_query, bool* d_triple);
+	void setRowLimit(unsigned long long _row_limit) { this->row_limit = _row_limit; }
+	void setJoinPlan(PlanCache::JoinPlan* _join_plan) { this->join_plan = _join_plan; }
 	~Join();
 };
 
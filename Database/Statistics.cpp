@@ -0,0 +1,349 @@
+#include "Statistics.h"
+
+using namespace std;
+
+//version 02 adds the update num after the object num
+static const char STATISTICS_MAGIC[8] = { 'G', 'S', 'T', 'A', 'T', 'S', '0', '2' };
+static const char STATISTICS_MAGIC_01[8] = { 'G', 'S', 'T', 'A', 'T', 'S', '0', '1' };
+
+Statistics::Statistics()
+{
+	this->valid = false;
+	this->triple_num = 0;
+	this->subject_num = 0;
+	this->object_num = 0;
+	this->update_num = 0;
+	this->saved_update_num = 0;
+}
+
+unsigned
+Statistics::bucket(TYPE_TRIPLE_NUM _degree)
+{
+	unsigned b = 0;
+	while (_degree > 1 && b + 1 < Statistics::HIST_BUCKETS)
+	{
+		_degree >>= 1;
+		++b;
+	}
+	return b;
+}
+
+Statistics::PredicateStat&
+Statistics::stat(TYPE_PREDICATE_ID _pid)
+{
+	if ((unsigned)_pid >= this->predicates.size())
+	{
+		PredicateStat empty;
+		memset(&empty, 0, sizeof(PredicateStat));
+		this->predicates.resize(_pid + 1, empty);
+	}
+	return this->predicates[_pid];
+}
+
+const Statistics::PredicateStat*
+Statistics::getPredicate(TYPE_PREDICATE_ID _pid) const
+{
+	if (_pid < 0 || (unsigned)_pid >= this->predicates.size() || this->predicates[_pid].triples == 0)
+		return NULL;
+	return &this->predicates[_pid];
+}
+
+void
+Statistics::collectSubjects(const ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num, TYPE_PREDICATE_ID _limitID_predicate)
+{
+	this->beginSubjects(_limitID_predicate);
+	for (TYPE_TRIPLE_NUM i = 0; i < _num; ++i)
+		this->addSubject(_tuples[i]);
+	this->endSubjects();
+}
+
+void
+Statistics::collectObjects(const ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num)
+{
+	this->beginObjects();
+	for (TYPE_TRIPLE_NUM i = 0; i < _num; ++i)
+		this->addObject(_tuples[i]);
+	this->endObjects();
+}
+
+void
+Statistics::beginSubjects(TYPE_PREDICATE_ID _limitID_predicate)
+{
+	if (_limitID_predicate > 0)
+		this->stat(_limitID_predicate - 1);
+	this->triple_num = 0;
+	this->subject_num = 0;
+	this->subjects = Collector();
+}
+
+//the degree of the current subject on the current predicate is known
+void
+Statistics::endSubjectPredicate()
+{
+	Collector& c = this->subjects;
+	PredicateStat& ps = this->stat(c.pre);
+	ps.triples += c.degree;
+	ps.subjects++;
+	ps.out_hist[Statistics::bucket(c.degree)]++;
+	if (c.degree > ps.max_out)
+		ps.max_out = c.degree;
+	c.preds.push_back(c.pre);
+	c.occ.push_back(c.degree);
+}
+
+//count the characteristic set of the current subject, pruning the rare ones if there are too many
+void
+Statistics::endSubject()
+{
+	Collector& c = this->subjects;
+	this->subject_num++;
+	pair<TYPE_TRIPLE_NUM, vector<TYPE_TRIPLE_NUM> >& cs = c.sets[c.preds];
+	if (cs.second.empty())
+		cs.second.resize(c.preds.size(), 0);
+	cs.first++;
+	for (unsigned k = 0; k < c.occ.size(); ++k)
+		cs.second[k] += c.occ[k];
+	c.preds.clear();
+	c.occ.clear();
+
+	if (c.sets.size() > 50 * (size_t)Statistics::MAX_CHARSET_NUM)
+	{
+		for (auto it = c.sets.begin(); it != c.sets.end();)
+		{
+			if (it->second.first <= c.prune_limit)
+				it = c.sets.erase(it);
+			else
+				++it;
+		}
+		c.prune_limit *= 2;
+	}
+}
+
+void
+Statistics::addSubject(const ID_TUPLE& _tuple)
+{
+	Collector& c = this->subjects;
+	this->triple_num++;
+	if (c.has_cur && _tuple.subid == c.id && (TYPE_PREDICATE_ID)_tuple.preid == c.pre)
+	{
+		c.degree++;
+		return;
+	}
+	if (c.has_cur)
+	{
+		this->endSubjectPredicate();
+		if (_tuple.subid != c.id)
+			this->endSubject();
+	}
+	c.has_cur = true;
+	c.id = _tuple.subid;
+	c.pre = _tuple.preid;
+	c.degree = 1;
+}
+
+void
+Statistics::endSubjects()
+{
+	Collector& c = this->subjects;
+	if (c.has_cur)
+	{
+		this->endSubjectPredicate();
+		this->endSubject();
+	}
+
+	//keep the most frequent ones
+	vector< pair<TYPE_TRIPLE_NUM, const vector<TYPE_PREDICATE_ID>*> > order;
+	for (auto it = c.sets.begin(); it != c.sets.end(); ++it)
+		order.push_back(make_pair(it->second.first, &it->first));
+	sort(order.begin(), order.end(), [](const pair<TYPE_TRIPLE_NUM, const vector<TYPE_PREDICATE_ID>*>& a,
+		const pair<TYPE_TRIPLE_NUM, const vector<TYPE_PREDICATE_ID>*>& b) { return a.first > b.first; });
+	if (order.size() > Statistics::MAX_CHARSET_NUM)
+		order.resize(Statistics::MAX_CHARSET_NUM);
+	this->charsets.clear();
+	for (unsigned k = 0; k < order.size(); ++k)
+	{
+		this->charsets.push_back(CharSet());
+		CharSet& cs = this->charsets.back();
+		cs.preds = *order[k].second;
+		cs.subjects = order[k].first;
+		cs.occurrences = c.sets[cs.preds].second;
+	}
+	this->subjects = Collector();
+	this->valid = true;
+}
+
+void
+Statistics::beginObjects()
+{
+	this->object_num = 0;
+	this->objects = Collector();
+}
+
+void
+Statistics::endObjectPredicate()
+{
+	Collector& c = this->objects;
+	PredicateStat& ps = this->stat(c.pre);
+	ps.objects++;
+	ps.in_hist[Statistics::bucket(c.degree)]++;
+	if (c.degree > ps.max_in)
+		ps.max_in = c.degree;
+}
+
+void
+Statistics::addObject(const ID_TUPLE& _tuple)
+{
+	Collector& c = this->objects;
+	if (c.has_cur && _tuple.objid == c.id && (TYPE_PREDICATE_ID)_tuple.preid == c.pre)
+	{
+		c.degree++;
+		return;
+	}
+	if (c.has_cur)
+	{
+		this->endObjectPredicate();
+		if (_tuple.objid != c.id)
+			this->object_num++;
+	}
+	c.has_cur = true;
+	c.id = _tuple.objid;
+	c.pre = _tuple.preid;
+	c.degree = 1;
+}
+
+void
+Statistics::endObjects()
+{
+	if (this->objects.has_cur)
+	{
+		this->endObjectPredicate();
+		this->object_num++;
+	}
+	this->objects = Collector();
+}
+
+bool
+Statistics::save(const string& _file) const
+{
+	FILE* fp = fopen(_file.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "error, can not create statistics file. @Statistics::save" << endl;
+		return false;
+	}
+	fwrite(STATISTICS_MAGIC, sizeof(STATISTICS_MAGIC), 1, fp);
+	fwrite(&this->triple_num, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+	fwrite(&this->subject_num, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+	fwrite(&this->object_num, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+	TYPE_TRIPLE_NUM update_num = this->update_num;
+	fwrite(&update_num, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+	this->saved_update_num = update_num;
+	unsigned n = this->predicates.size();
+	fwrite(&n, sizeof(unsigned), 1, fp);
+	if (n > 0)
+		fwrite(&this->predicates[0], sizeof(PredicateStat), n, fp);
+	n = this->charsets.size();
+	fwrite(&n, sizeof(unsigned), 1, fp);
+	for (unsigned i = 0; i < n; ++i)
+	{
+		const CharSet& cs = this->charsets[i];
+		unsigned len = cs.preds.size();
+		fwrite(&len, sizeof(unsigned), 1, fp);
+		fwrite(&cs.subjects, sizeof(TYPE_TRIPLE_NUM), 1, fp);
+		fwrite(&cs.preds[0], sizeof(TYPE_PREDICATE_ID), len, fp);
+		fwrite(&cs.occurrences[0], sizeof(TYPE_TRIPLE_NUM), len, fp);
+	}
+	Util::Csync(fp);
+	fclose(fp);
+	return true;
+}
+
+bool
+Statistics::load(const string& _file)
+{
+	this->valid = false;
+	this->predicates.clear();
+	this->charsets.clear();
+	FILE* fp = fopen(_file.c_str(), "rb");
+	if (fp == NULL)
+	{
+		//database built by older versions
+		return false;
+	}
+	char magic[sizeof(STATISTICS_MAGIC)];
+	bool ok = fread(magic, sizeof(magic), 1, fp) == 1;
+	bool old = ok && memcmp(magic, STATISTICS_MAGIC_01, sizeof(magic)) == 0;
+	ok = ok && (old || memcmp(magic, STATISTICS_MAGIC, sizeof(magic)) == 0);
+	ok = ok && fread(&this->triple_num, sizeof(TYPE_TRIPLE_NUM), 1, fp) == 1;
+	ok = ok && fread(&this->subject_num, sizeof(TYPE_TRIPLE_NUM), 1, fp) == 1;
+	ok = ok && fread(&this->object_num, sizeof(TYPE_TRIPLE_NUM), 1, fp) == 1;
+	TYPE_TRIPLE_NUM update_num = 0;
+	if (!old)
+		ok = ok && fread(&update_num, sizeof(TYPE_TRIPLE_NUM), 1, fp) == 1;
+	this->update_num = update_num;
+	this->saved_update_num = update_num;
+	unsigned n = 0;
+	ok = ok && fread(&n, sizeof(unsigned), 1, fp) == 1;
+	if (ok && n > 0)
+	{
+		this->predicates.resize(n);
+		ok = fread(&this->predicates[0], sizeof(PredicateStat), n, fp) == n;
+	}
+	ok = ok && fread(&n, sizeof(unsigned), 1, fp) == 1;
+	for (unsigned i = 0; ok && i < n; ++i)
+	{
+		this->charsets.push_back(CharSet());
+		CharSet& cs = this->charsets.back();
+		unsigned len = 0;
+		ok = fread(&len, sizeof(unsigned), 1, fp) == 1 && len > 0;
+		ok = ok && fread(&cs.subjects, sizeof(TYPE_TRIPLE_NUM), 1, fp) == 1;
+		if (!ok)
+			break;
+		cs.preds.resize(len);
+		cs.occurrences.resize(len);
+		ok = fread(&cs.preds[0], sizeof(TYPE_PREDICATE_ID), len, fp) == len;
+		ok = ok && fread(&cs.occurrences[0], sizeof(TYPE_TRIPLE_NUM), len, fp) == len;
+	}
+	fclose(fp);
+	if (!ok)
+	{
+		cout << "error, broken statistics file. @Statistics::load" << endl;
+		this->predicates.clear();
+		this->charsets.clear();
+		return false;
+	}
+	this->valid = true;
+	return true;
+}
+
+bool
+Statistics::estimateStar(const vector<TYPE_PREDICATE_ID>& _preds, double& _subjects, double& _rows) const
+{
+	_subjects = _rows = 0;
+	if (this->charsets.empty())
+		return false;
+	vector<TYPE_PREDICATE_ID> want(_preds);
+	sort(want.begin(), want.end());
+	for (unsigned i = 0; i < this->charsets.size(); ++i)
+	{
+		const CharSet& cs = this->charsets[i];
+		//both are in increasing order, a repeated pred in _preds matches the same one
+		double rows = cs.subjects;
+		unsigned k = 0;
+		bool all = true;
+		for (unsigned j = 0; j < want.size() && all; ++j)
+		{
+			while (k < cs.preds.size() && cs.preds[k] < want[j])
+				++k;
+			if (k == cs.preds.size() || cs.preds[k] != want[j])
+				all = false;
+			else
+				rows *= (double)cs.occurrences[k] / cs.subjects;
+		}
+		if (!all)
+			continue;
+		_subjects += cs.subjects;
+		_rows += rows;
+	}
+	return true;
+}
@@ -0,0 +1,112 @@
+#ifndef _DATABASE_STATISTICS_H
+#define _DATABASE_STATISTICS_H
+
+#include "../Util/Util.h"
+
+//Cardinality statistics collected when building a database and used by the
+//cost based join order of Join:
+//1. per predicate: triples, distinct subjects and objects, max degrees, and the
+//   histograms of the out degree of its subjects and in degree of its objects
+//   (bucket b counts the degrees in [2^b, 2^(b+1)))
+//2. characteristic sets: the distinct sets of predicates used by a subject, each
+//   with the number of such subjects and the triples of each predicate in them,
+//   used to estimate stars without assuming the predicates are independent
+//NOTICE: the counts are not updated by insert/delete, only the triples changed since
+//the build are, and the statistics are stale once they pass 1/STALE_RATIO of the triples
+class Statistics
+{
+public:
+	static const unsigned HIST_BUCKETS = 32;
+	//characteristic sets kept in the file, the most frequent ones
+	static const unsigned MAX_CHARSET_NUM = 10000;
+	static const unsigned STALE_RATIO = 10;
+
+	struct PredicateStat
+	{
+		TYPE_TRIPLE_NUM triples;
+		TYPE_TRIPLE_NUM subjects;
+		TYPE_TRIPLE_NUM objects;
+		unsigned max_out;
+		unsigned max_in;
+		TYPE_TRIPLE_NUM out_hist[HIST_BUCKETS];
+		TYPE_TRIPLE_NUM in_hist[HIST_BUCKETS];
+	};
+
+	struct CharSet
+	{
+		std::vector<TYPE_PREDICATE_ID> preds;	//in increasing order
+		TYPE_TRIPLE_NUM subjects;
+		std::vector<TYPE_TRIPLE_NUM> occurrences;	//triples of each pred
+	};
+
+	Statistics();
+
+	//collect from the id tuples of a build, sorted in spo order for the subject
+	//side(duplicates removed) and in ops order for the object side
+	void collectSubjects(const ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num, TYPE_PREDICATE_ID _limitID_predicate);
+	void collectObjects(const ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num);
+	//the same fed one tuple at a time, i.e. as they are merged from disk: beginSubjects(),
+	//addSubject() for each tuple and endSubjects(), then the same for the objects
+	void beginSubjects(TYPE_PREDICATE_ID _limitID_predicate);
+	void addSubject(const ID_TUPLE& _tuple);
+	void endSubjects();
+	void beginObjects();
+	void addObject(const ID_TUPLE& _tuple);
+	void endObjects();
+	bool save(const std::string& _file) const;
+	bool load(const std::string& _file);
+	//false if there are no statistics(old database or not built)
+	bool isValid() const { return this->valid; }
+	//count the triples inserted or removed since the build, from any thread
+	void addUpdates(TYPE_TRIPLE_NUM _num) { this->update_num += _num; }
+	TYPE_TRIPLE_NUM getUpdateNum() const { return this->update_num; }
+	//updated since the last save or load
+	bool isChanged() const { return this->update_num != this->saved_update_num; }
+	//too many updates for the counts to be trusted
+	bool isStale() const { return this->update_num * Statistics::STALE_RATIO > this->triple_num; }
+
+	TYPE_TRIPLE_NUM getTripleNum() const { return this->triple_num; }
+	TYPE_TRIPLE_NUM getSubjectNum() const { return this->subject_num; }
+	TYPE_TRIPLE_NUM getObjectNum() const { return this->object_num; }
+	//NULL for an invalid predicate
+	const PredicateStat* getPredicate(TYPE_PREDICATE_ID _pid) const;
+	unsigned getCharSetNum() const { return this->charsets.size(); }
+
+	//estimate the subjects having all of _preds and the rows of the star
+	//?s p1 ?o1. ?s p2 ?o2 ..., return false if no characteristic set is known
+	bool estimateStar(const std::vector<TYPE_PREDICATE_ID>& _preds, double& _subjects, double& _rows) const;
+
+private:
+	//the subject(or object) and predicate being counted while collecting
+	struct Collector
+	{
+		Collector() : has_cur(false), id(0), pre(0), degree(0), prune_limit(1) {}
+		bool has_cur;
+		TYPE_ENTITY_LITERAL_ID id;
+		TYPE_PREDICATE_ID pre;
+		TYPE_TRIPLE_NUM degree;
+		std::vector<TYPE_PREDICATE_ID> preds;	//of the current subject, with the triples of each
+		std::vector<TYPE_TRIPLE_NUM> occ;
+		std::map< std::vector<TYPE_PREDICATE_ID>, std::pair<TYPE_TRIPLE_NUM, std::vector<TYPE_TRIPLE_NUM> > > sets;
+		TYPE_TRIPLE_NUM prune_limit;
+	};
+
+	static unsigned bucket(TYPE_TRIPLE_NUM _degree);
+	PredicateStat& stat(TYPE_PREDICATE_ID _pid);
+	void endSubjectPredicate();
+	void endSubject();
+	void endObjectPredicate();
+
+	bool valid;
+	TYPE_TRIPLE_NUM triple_num;
+	TYPE_TRIPLE_NUM subject_num;
+	TYPE_TRIPLE_NUM object_num;
+	std::atomic<TYPE_TRIPLE_NUM> update_num;
+	mutable TYPE_TRIPLE_NUM saved_update_num;
+	std::vector<PredicateStat> predicates;
+	std::vector<CharSet> charsets;
+	Collector subjects;
+	Collector objects;
+};
+
+#endif //_DATABASE_STATISTICS_H
@@ -18,12 +18,16 @@ Strategy::Strategy()
 	this->fp = NULL;
 	this->export_flag = false;
 	this->txn = nullptr;
+	this->statistics = NULL;
+	this->row_limit = 0;
+	this->join_plans = NULL;
+	this->join_plan_num = 0;
 	//this->prepare_handler();
 }
 
 Strategy::Strategy(KVstore* _kvstore, VSTree* _vstree, TYPE_TRIPLE_NUM* _pre2num, TYPE_TRIPLE_NUM* _pre2sub,
  	TYPE_TRIPLE_NUM* _pre2obj, TYPE_PREDICATE_ID _limitID_predicate, TYPE_ENTITY_LITERAL_ID _limitID_literal,
-	TYPE_ENTITY_LITERAL_ID _limitID_entity,bool _is_distinct, shared_ptr<Transaction> _txn)
+	TYPE_ENTITY_LITERAL_ID _limitID_entity,bool _is_distinct, shared_ptr<Transaction> _txn, Statistics* _statistics)
 {
 	this->method = 0;
 	this->kvstore = _kvstore;
@@ -39,6 +43,10 @@ Strategy::Strategy(KVstore* _kvstore, VSTree* _vstree, TYPE_TRIPLE_NUM* _pre2num
 	this->fp = NULL;
 	this->export_flag = false;
 	this->txn = _txn;
+	this->statistics = _statistics;
+	this->row_limit = 0;
+	this->join_plans = NULL;
+	this->join_plan_num = 0;
 	//this->prepare_handler();
 }
 
@@ -614,7 +622,14 @@ Strategy::handler0(BasicQuery* _bq, vector<unsigned*>& _result_list)
 		cout << "after the prehandler, the canlist size is 0." << endl;
 	}
 
-	Join *join = new Join(kvstore, pre2num, this->limitID_predicate, this->limitID_literal,this->limitID_entity, txn);
+	Join *join = new Join(kvstore, pre2num, this->limitID_predicate, this->limitID_literal,this->limitID_entity, txn, this->statistics);
+	join->setRowLimit(this->row_limit);
+	if (this->join_plans != NULL)
+	{
+		if (this->join_plan_num == this->join_plans->size())
+			this->join_plans->push_back(PlanCache::JoinPlan());
+		join->setJoinPlan(&(*this->join_plans)[this->join_plan_num++]);
+	}
 	join->join_basic(_bq,d_triple);
 	delete join;
 
@@ -632,8 +647,7 @@ Strategy::handler1(BasicQuery* _bq, vector<unsigned*>& _result_list)
 	int triple_id = _bq->getEdgeID(0, 0);
 	Triple triple = _bq->getTriple(triple_id);
 	TYPE_PREDICATE_ID pre_id = _bq->getEdgePreID(0, 0);
-	unsigned* id_list = NULL;
-	unsigned id_list_len = 0;
+	IDListView id_list;
 	if (edge_type == Util::EDGE_OUT)
 	{
 		//cout<<"edge out!!!"<<endl;
@@ -643,28 +657,29 @@ Strategy::handler1(BasicQuery* _bq, vector<unsigned*>& _result_list)
 		{
 			nid = (this->kvstore)->getIDByLiteral(triple.object);
 		}
-		this->kvstore->getsubIDlistByobjIDpreID(nid, pre_id, id_list, id_list_len, true, txn);
+		this->kvstore->getsubIDlistByobjIDpreID(nid, pre_id, id_list, txn);
 	}
 	else
 	{
 		//cout<<"edge in!!!"<<endl;
-		this->kvstore->getobjIDlistBysubIDpreID(this->kvstore->getIDByEntity(triple.subject), pre_id, id_list, id_list_len, true, txn);
+		this->kvstore->getobjIDlistBysubIDpreID(this->kvstore->getIDByEntity(triple.subject), pre_id, id_list, txn);
 	}
+	unsigned id_list_len = id_list.getLen();
 
 	long after_filter = Util::get_cur_time();
 	cout << "after filter, used " << (after_filter - before_filter) << "ms" << endl;
 	_result_list.clear();
 	//cout<<"now to copy result to list"<<endl;
+	id_list_len = this->limitRows(id_list_len);
 	for (unsigned i = 0; i < id_list_len; ++i)
 	{
-		unsigned* record = new unsigned[1];    //only this var is selected
+		unsigned* record = _bq->newResultRow(1);    //only this var is selected
 		record[0] = id_list[i];
 		//cout<<this->kvstore->getEntityByID(record[0])<<endl;
 		_result_list.push_back(record);
 	}
 	long after_copy = Util::get_cur_time();
 	cout << "after copy to result list: used " << (after_copy - after_filter) << " ms" << endl;
-	delete[] id_list;
 	cout << "Final result size: " << _result_list.size() << endl;
 }
 
@@ -700,15 +715,15 @@ Strategy::handler2(BasicQuery* _bq, vector<unsigned*>& _result_list)
 	long after_filter = Util::get_cur_time();
 	cout << "after filter, used " << (after_filter - before_filter) << "ms" << endl;
 	_result_list.clear();
-	for (unsigned i = 0; i < id_list_len; ++i)
+	unsigned row_num = this->limitRows(id_list_len);
+	for (unsigned i = 0; i < row_num; ++i)
 	{
-		unsigned* record = new unsigned[1];    //only one var
+		unsigned* record = _bq->newResultRow(1);    //only one var
 		record[0] = id_list[i];
 		_result_list.push_back(record);
 	}
 	long after_copy = Util::get_cur_time();
 	cout << "after copy to result list: used " << (after_copy - after_filter) << " ms" << endl;
-	delete[] id_list;
 	cout << "Final result size: " << _result_list.size() << endl;
 }
 
@@ -737,9 +752,10 @@ Strategy::handler3(BasicQuery* _bq, vector<unsigned*>& _result_list)
 	long after_filter = Util::get_cur_time();
 	cout << "after filter, used " << (after_filter - before_filter) << "ms" << endl;
 
-	for (unsigned i = 0; i < id_list_len; i += 2)
+	unsigned pair_len = 2 * this->limitRows(id_list_len / 2);
+	for (unsigned i = 0; i < pair_len; i += 2)
 	{
-		unsigned* record = new unsigned[2];    //2 vars and selected
+		unsigned* record = _bq->newResultRow(2);    //2 vars and selected
 		record[var1_id] = id_list[i];
 		record[var2_id] = id_list[i + 1];
 		_result_list.push_back(record);
@@ -747,7 +763,6 @@ Strategy::handler3(BasicQuery* _bq, vector<unsigned*>& _result_list)
 
 	long after_copy = Util::get_cur_time();
 	cout << "after copy to result list: used " << (after_copy - after_filter) << " ms" << endl;
-	delete[] id_list;
 	cout << "Final result size: " << _result_list.size() << endl;
 }
 
@@ -783,7 +798,7 @@ Strategy::handler4(BasicQuery* _bq, vector<unsigned*>& _result_list)
 			for (TYPE_PREDICATE_ID i = 0; i < this->limitID_predicate; ++i)
 			{
 				TYPE_PREDICATE_ID pid = i;
-				unsigned* record = new unsigned;
+				unsigned* record = _bq->newResultRow(1);
 				*record = pid;
 				_result_list.push_back(record);
 			}
@@ -803,7 +818,7 @@ Strategy::handler4(BasicQuery* _bq, vector<unsigned*>& _result_list)
 			//always place s/o before p in result list
 			for (unsigned j = 0; j < id_list_len; j += 2)
 			{
-				unsigned* record = new unsigned[rsize];
+				unsigned* record = _bq->newResultRow(rsize);
 				//check the s/o var if selected, need to ensure the placement order
 				if(ovpos >= 0)
 				{
@@ -856,7 +871,7 @@ Strategy::handler4(BasicQuery* _bq, vector<unsigned*>& _result_list)
 		//always place s/o before p in result list
 		for (unsigned i = 0; i < id_list_len; i += 2)
 		{
-			unsigned* record = new unsigned[rsize];
+			unsigned* record = _bq->newResultRow(rsize);
 			if(vpos >= 0)
 			{
 				record[vpos] = id_list[i + 1]; //for the s/o var
@@ -883,7 +898,7 @@ Strategy::handler4(BasicQuery* _bq, vector<unsigned*>& _result_list)
 		//copy to result list
 		for (unsigned i = 0; i < id_list_len; ++i)
 		{
-			unsigned* record = new unsigned[1];
+			unsigned* record = _bq->newResultRow(1);
 			record[0] = id_list[i];
 			_result_list.push_back(record);
 		}
@@ -925,18 +940,16 @@ Strategy::handler5(BasicQuery* _bq, vector<unsigned*>& _result_list)
 		return;
 	}
 
-	unsigned* id_list = NULL;
-	unsigned id_list_len = 0;
-	(this->kvstore)->getobjIDlistBysubIDpreID(subid, preid, id_list, id_list_len, true, txn);
-	if (Util::bsearch_int_uporder(objid, id_list, id_list_len) != INVALID)
+	IDListView id_list;
+	(this->kvstore)->getobjIDlistBysubIDpreID(subid, preid, id_list, txn);
+	if (Util::bsearch_int_uporder(objid, id_list.getList(), id_list.getLen()) != INVALID)
 	{
-		unsigned* record = new unsigned[3];
+		unsigned* record = _bq->newResultRow(3);
 		record[0] = subid;
 		record[1] = preid;
 		record[2] = objid;
 		_result_list.push_back(record);
 	}
-	delete[] id_list;
 }
 
 void
@@ -963,7 +976,7 @@ Strategy::handler6(BasicQuery* _bq, vector<unsigned*>& _result_list)
   cout<<"predicate: "<<triple.predicate<<" "<<pvpos<<endl;
   //very special case, to find all triples, select ?s (?p) ?o where { ?s ?p ?o . }
   //filter and join is too costly, should enum all predicates and use p2so
-  unsigned* rsize = new unsigned[1];
+  unsigned* rsize = _bq->newResultRow(1);
   rsize[0] = 0;
   for (TYPE_PREDICATE_ID i = 0; i < this->limitID_predicate; ++i)
   {
@@ -28,12 +28,19 @@ public:
 	    	// if there exists a variable with limited matches in the query, then skip the filter of other
 	    	// variables as soon as possible
 	Strategy(KVstore*, VSTree*, TYPE_TRIPLE_NUM*, TYPE_TRIPLE_NUM*,TYPE_TRIPLE_NUM*, TYPE_PREDICATE_ID, 
-		TYPE_ENTITY_LITERAL_ID,TYPE_ENTITY_LITERAL_ID,bool, shared_ptr<Transaction> _txn = nullptr);
+		TYPE_ENTITY_LITERAL_ID,TYPE_ENTITY_LITERAL_ID,bool, shared_ptr<Transaction> _txn = nullptr,
+		Statistics* _statistics = NULL);
 	~Strategy();
 	//select efficient strategy to do the sparql query
 	bool handle(SPARQLquery&);
 	bool pre_handler(BasicQuery * basic_query, KVstore * kvstore, TYPE_TRIPLE_NUM* pre2num,
 		TYPE_TRIPLE_NUM* pre2sub, TYPE_TRIPLE_NUM* pre2obj, bool* dealed_triple);
+	//at most _row_limit rows are needed from each BasicQuery(0 for all), i.e. OFFSET + LIMIT
+	//when the BasicQuery results are the query result as they are
+	void setRowLimit(unsigned long long _row_limit) { this->row_limit = _row_limit; }
+	unsigned long long getRowLimit() const { return this->row_limit; }
+	//the join orders cached for the BasicQueries of handler0, taken and filled in turn(NULL for none)
+	void setJoinPlans(vector<PlanCache::JoinPlan>* _join_plans) { this->join_plans = _join_plans; this->join_plan_num = 0; }
 
 private:
 	int method;
@@ -46,6 +53,11 @@ private:
 	TYPE_PREDICATE_ID limitID_predicate;
 	TYPE_ENTITY_LITERAL_ID limitID_literal;
 	TYPE_ENTITY_LITERAL_ID limitID_entity; 
+	unsigned long long row_limit;
+	vector<PlanCache::JoinPlan>* join_plans;
+	unsigned join_plan_num;
+	unsigned long long limitRows(unsigned long long _num) const
+	{ return this->row_limit > 0 && this->row_limit < _num ? this->row_limit : _num; }
 	//NOTICE: even the ID type is int, it is no problem and no waste that we use unsigned in answer
 	//(because -1, -2 or other invalid IDs can not be in answer)
 	void handler0(BasicQuery*, vector<unsigned*>&);
@@ -58,6 +70,7 @@ private:
 	//QueryHandler *dispatch;
 	//void prepare_handler();
 	shared_ptr<Transaction> txn;
+	Statistics* statistics;
 };
 
 //function pointer array
@@ -5,10 +5,6 @@ Txn_manager::Txn_manager(Database *db, string db_name)
 {
 	this->db = db;
 	this->db_name = db_name;
-	this->log_path = "./" + db_name + ".db/" + "update.log";
-	this->all_log_path = "./" + db_name + ".db/" + "update_since_backup.log";
-	out.open(this->log_path.c_str(), ios::out | ios::app);
-	out_all.open(this->all_log_path.c_str(), ios::out | ios::app);
 	cnt.store(1);
 	txn_table.clear();
 	for(int i = 0; i < 3; i++)
@@ -24,16 +20,6 @@ Txn_manager::~Txn_manager()
 	Checkpoint();
 	cout << "Checkpoint done" << endl;
 	txn_table.clear();
-	out.close();
-	out_all.close();
-}
-
-void Txn_manager::writelog(string str)
-{
-	this->lock_log();
-	out << str << endl;
-	out_all << str << endl;
-	this->unlock_log();
 }
 
 bool Txn_manager::add_transaction(txn_id_t TID, shared_ptr<Transaction> txn)
@@ -57,65 +43,6 @@ shared_ptr<Transaction> Txn_manager::get_transaction(txn_id_t TID)
 	return p;
 }
 
-//TODO: undo failed
-bool Txn_manager::undo(string str, txn_id_t TID)
-{
-	Util::get_timestamp(str);
-	string undo_sparql;
-	if (str[0] == 'I') {
-		undo_sparql = "DELETE DATA{";
-	}
-	else if (str[0] == 'D') {
-		undo_sparql = "INSERT DATA{";
-	}
-	else {
-		cerr << "wrong undo sparql: " << str << endl;
-		return false;
-	}
-	undo_sparql += str.substr(2, str.length());
-	undo_sparql += '}';
-	ResultSet rs;
-	FILE* output = stdout;
-	shared_ptr<Transaction> txn = get_transaction(TID);
-	if(db != nullptr)
-		this->db->query(undo_sparql, rs, output);
-	else
-	{
-		cout << "error! database has been flushed or removed!" << endl;
-		return false;
-	}
-	return true;
-}
-
-bool Txn_manager::redo(string str, txn_id_t TID)
-{
-	Util::get_timestamp(str);
-	string redo_sparql;
-	if (str[0] == 'I') {
-		redo_sparql = "INSERT DATA{";
-	}
-	else if (str[0] == 'D') {
-		redo_sparql = "DELETE DATA{";
-	}
-	else {
-		cerr << "wrong redo sparql: " << str << endl;
-		return false;
-	}
-	redo_sparql += str.substr(2, str.length());
-	redo_sparql += '}';
-	ResultSet rs;
-	FILE* output = stdout;
-	shared_ptr<Transaction> txn = get_transaction(TID); 
-	if(db != nullptr)
-		this->db->query(redo_sparql, rs, output);
-	else
-	{
-		cout << "error! database has been flushed or removed" << endl;
-		return false;
-	}
-	return true;
-}
-
 
 /*
 inline txn_id_t Txn_manager::ArrangeTID()
@@ -154,15 +81,12 @@ txn_id_t Txn_manager::Begin(IsolationLevelType isolationlevel)
 	shared_ptr<Transaction> txn = make_shared<Transaction>(this->db_name, Util::get_cur_time(), TID, isolationlevel);
 	txn->SetCommitID(TID);
 	add_transaction(TID, txn);
-	string log_str = "Begin " + Util::int2string(TID);
-	//writelog(log_str);
 	txn->SetState(TransactionState::RUNNING);
 	return TID;
 }
 
 int Txn_manager::Commit(txn_id_t TID)
 {
-	string log_str = "Commit " + Util::int2string(TID);
 	shared_ptr<Transaction> txn = get_transaction(TID);
 	if (txn == nullptr) {
 		cerr << "wrong transaction id!" << endl;
@@ -176,15 +100,14 @@ int Txn_manager::Commit(txn_id_t TID)
 	}
 	txn_id_t CID = this->ArrangeCommitID();
 	txn->SetCommitID(CID);
-	if(db != nullptr)
-		db->TransactionCommit(txn);
-	else
+	if(db == nullptr)
 	{
 		cout << "error! database has been flushed or removed" << endl;
 		checkpoint_lock.unlock();
 		return -1;
 	}
-	//writelog(log_str);
+	if(!db->TransactionCommit(txn))
+		return -1;
 	txn->SetState(TransactionState::COMMITTED);
 	txn->SetEndTime(Util::get_cur_time());
 	add_dirty_keys(txn);
@@ -200,7 +123,6 @@ int Txn_manager::Commit(txn_id_t TID)
 
 int Txn_manager::Abort(txn_id_t TID)
 {
-	string log_str = "Abort " + Util::int2string(TID);
 	shared_ptr<Transaction> txn = get_transaction(TID);
 	if (txn == nullptr) {
 		cerr << "wrong transaction id!" << endl;
@@ -213,7 +135,6 @@ int Txn_manager::Abort(txn_id_t TID)
 		cout << "error! database has been flushed or removed" << endl;
 		return -1;
 	}
-	//writelog(log_str);
 	txn->SetState(TransactionState::ABORTED);
 	txn->SetEndTime(Util::get_cur_time());
 	checkpoint_lock.unlock();
@@ -299,43 +220,6 @@ void Txn_manager::Checkpoint()
 }
 
 
-//TODO:this function is not complete
-void Txn_manager::restore()
-{
-	string line;
-	ifstream in;
-	in.open(this->log_path.c_str(), ios::in);
-	txn_id_t  TID = -1; //NOT COMPLETE
-	while (getline(in, line)) 
-	{
-		if (line[0] == 'B')
-		{
-			vector<string> redo_set;
-			while (getline(in, line))
-			{
-				if (line[0] == 'B' || line[0] == 'C')
-				{
-					break;
-				}
-				else if (line[0] == 'A')
-				{
-					if (redo_set.size() != 0)
-						continue;
-					else
-						break; //no update txn
-				}
-				else {
-					redo_set.push_back(line);
-				}
-			}
-			for (int i = 0; i < redo_set.size(); i++)
-			{
-				redo(redo_set[i], TID);
-			}
-		}
-	}
-}
-
 txn_id_t Txn_manager::find_latest_txn()
 {
 	auto it = txn_table.begin();
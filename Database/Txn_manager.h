@@ -23,18 +23,13 @@ private:
 	string db_name;
 	map<txn_id_t, shared_ptr<Transaction> > txn_table;
 	
-	string log_path;
-	string all_log_path;
 	atomic<txn_id_t> cnt;
 	TYPE_TS base_ts;
-	ofstream out;
-	ofstream out_all;
 	
 	//naive lock table 
 	map<txn_id_t, vector<shared_ptr<Transaction> > > waiting_lists;
 	
 	//locks
-	mutex log_lock;
 	Latch checkpoint_lock;
 	Latch table_lock;
 	mutex DirtyKeys_lock;
@@ -48,14 +43,8 @@ private:
 	inline txn_id_t ArrangeCommitID();
 	
 	inline TYPE_TS ArrangeTS();
-	void writelog(string str);
-	bool undo(string str, txn_id_t TID);
-	bool redo(string str, txn_id_t TID);
 	int Abort(txn_id_t TID);
 	
-	inline void lock_log() { log_lock.lock(); }
-	inline void unlock_log() { log_lock.unlock(); }
-	
 	void add_dirty_keys(shared_ptr<Transaction> txn);
 public:
 	Txn_manager(Txn_manager const&) = delete;
@@ -64,6 +53,7 @@ public:
 	
 	//Basic 
 	txn_id_t Begin(IsolationLevelType isolationlevel = IsolationLevelType::SERIALIZABLE);
+	//-1 if the commit could not be logged, then the transaction is still running
 	int Commit(txn_id_t TID);
 	int Query(txn_id_t TID, string sparql, string & result);
 	int Rollback(txn_id_t TID);
@@ -81,7 +71,4 @@ public:
 	
 	//DEBUG
 	void print_txn_dataset(txn_id_t TID);
-	
-	//Recovery(not complete)
-	void restore();
 };
@@ -0,0 +1,478 @@
+#include "UpdateLog.h"
+#include "../Util/WorkStealingPool.h"
+#include <boost/crc.hpp>
+
+using namespace std;
+
+static void
+putInt(string& _buf, const void* _val, size_t _len)
+{
+	_buf.append((const char*)_val, _len);
+}
+
+static bool
+getInt(const char*& _p, const char* _end, void* _val, size_t _len)
+{
+	if ((size_t)(_end - _p) < _len)
+		return false;
+	memcpy(_val, _p, _len);
+	_p += _len;
+	return true;
+}
+
+static void
+putString(string& _buf, const string& _str)
+{
+	unsigned len = _str.length();
+	putInt(_buf, &len, sizeof(len));
+	_buf.append(_str);
+}
+
+static bool
+getString(const char*& _p, const char* _end, string& _str)
+{
+	unsigned len;
+	if (!getInt(_p, _end, &len, sizeof(len)) || (size_t)(_end - _p) < len)
+		return false;
+	_str.assign(_p, len);
+	_p += len;
+	return true;
+}
+
+static bool
+loadFile(const string& _path, string& _data)
+{
+	ifstream in(_path.c_str(), ios::in | ios::binary);
+	if (!in)
+		return false;
+	ostringstream ss;
+	ss << in.rdbuf();
+	_data = ss.str();
+	return true;
+}
+
+//the offsets of the records whose body is all in _data, which may end with a torn one
+static void
+scanRecords(const string& _data, vector<size_t>& _offsets)
+{
+	size_t pos = 0;
+	while (_data.length() - pos >= 8)
+	{
+		unsigned len;
+		memcpy(&len, _data.data() + pos, sizeof(len));
+		if (_data.length() - pos - 8 < len)
+			break;
+		_offsets.push_back(pos);
+		pos += 8 + len;
+	}
+}
+
+static bool
+writeAll(int _fd, const string& _data)
+{
+	size_t done = 0;
+	while (done < _data.length())
+	{
+		ssize_t n = ::write(_fd, _data.data() + done, _data.length() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+UpdateLog::UpdateLog()
+{
+	this->durability = UpdateLog::Sync;
+	this->flush_interval = UpdateLog::DEFAULT_FLUSH_INTERVAL;
+	this->fd = this->backup_fd = -1;
+	this->size = this->backup_size = 0;
+	this->appended_lsn = this->written_lsn = 0;
+	this->writing = false;
+	this->failed = false;
+	this->stop = false;
+}
+
+UpdateLog::~UpdateLog()
+{
+	this->close();
+}
+
+bool
+UpdateLog::open(const string& _path, const string& _backup_path)
+{
+	this->close();
+
+	string mode = Util::getConfigureValue("update_log_durability");
+	if (mode == "write")
+		this->durability = UpdateLog::Write;
+	else if (mode == "async")
+		this->durability = UpdateLog::Async;
+	else
+		this->durability = UpdateLog::Sync;
+	string interval = Util::getConfigureValue("update_log_flush_interval");
+	if (!interval.empty() && atoi(interval.c_str()) > 0)
+		this->flush_interval = atoi(interval.c_str());
+
+	//a record torn by a crash is cut off, or the records after it could not be read
+	string paths[2] = { _path, _backup_path };
+	int* fds[2] = { &this->fd, &this->backup_fd };
+	off_t* sizes[2] = { &this->size, &this->backup_size };
+	for (int i = 0; i < 2; ++i)
+	{
+		string data;
+		loadFile(paths[i], data);
+		vector<size_t> offsets;
+		scanRecords(data, offsets);
+		size_t valid = 0;
+		for (size_t j = 0; j < offsets.size(); ++j)
+		{
+			unsigned len, crc;
+			memcpy(&len, data.data() + offsets[j], sizeof(len));
+			memcpy(&crc, data.data() + offsets[j] + 4, sizeof(crc));
+			if (UpdateLog::checksum(data.data() + offsets[j] + UpdateLog::HEADER_SIZE, len) != crc)
+				break;
+			valid = offsets[j] + UpdateLog::HEADER_SIZE + len;
+		}
+		*fds[i] = ::open(paths[i].c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (*fds[i] < 0 || ftruncate(*fds[i], valid) != 0)
+		{
+			cout << "failed to open the update log " << paths[i] << " @UpdateLog::open" << endl;
+			this->close();
+			return false;
+		}
+		if (valid < data.length())
+			cout << "the update log " << paths[i] << " is cut at byte " << valid << ", the rest is torn or corrupt" << endl;
+		*sizes[i] = valid;
+	}
+
+	this->failed = false;
+	this->stop = false;
+	//the transactions running when the server stopped are never committed
+	if ((this->size > 0 || this->backup_size > 0) && !this->append(UpdateLog::Abort, 0))
+	{
+		this->close();
+		return false;
+	}
+	if (this->durability == UpdateLog::Async)
+		this->flusher = thread(&UpdateLog::flusherLoop, this);
+	return true;
+}
+
+void
+UpdateLog::close()
+{
+	if (this->flusher.joinable())
+	{
+		{
+			lock_guard<mutex> guard(this->lock);
+			this->stop = true;
+		}
+		this->flusher_cv.notify_all();
+		this->flusher.join();
+	}
+	if (this->fd >= 0)
+		this->flush();
+	if (this->fd >= 0)
+		::close(this->fd);
+	if (this->backup_fd >= 0)
+		::close(this->backup_fd);
+	this->fd = this->backup_fd = -1;
+	//what could not be written is dropped, the log refuses it anyway
+	this->buffer.clear();
+	this->written_lsn = this->appended_lsn;
+}
+
+unsigned
+UpdateLog::checksum(const char* _data, size_t _len)
+{
+	boost::crc_32_type crc;
+	crc.process_bytes(_data, _len);
+	return crc.checksum();
+}
+
+void
+UpdateLog::encode(string& _buf, RecordType _type, unsigned long long _txn_id, const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num)
+{
+	size_t start = _buf.length();
+	_buf.append(UpdateLog::HEADER_SIZE, '\0');
+	unsigned char type = _type;
+	long long time = Util::get_cur_time();
+	unsigned triple_num = _triple_num;
+	putInt(_buf, &type, sizeof(type));
+	putInt(_buf, &_txn_id, sizeof(_txn_id));
+	putInt(_buf, &time, sizeof(time));
+	putInt(_buf, &triple_num, sizeof(triple_num));
+	for (TYPE_TRIPLE_NUM i = 0; i < _triple_num; ++i)
+	{
+		unsigned char object_type = _triples[i].object_type;
+		putInt(_buf, &object_type, sizeof(object_type));
+		putString(_buf, _triples[i].subject);
+		putString(_buf, _triples[i].predicate);
+		putString(_buf, _triples[i].object);
+	}
+	unsigned len = _buf.length() - start - UpdateLog::HEADER_SIZE;
+	unsigned crc = UpdateLog::checksum(_buf.data() + start + UpdateLog::HEADER_SIZE, len);
+	memcpy(&_buf[start], &len, sizeof(len));
+	memcpy(&_buf[start + 4], &crc, sizeof(crc));
+}
+
+bool
+UpdateLog::decode(const char* _body, unsigned _len, Record& _record)
+{
+	const char* p = _body;
+	const char* end = _body + _len;
+	unsigned char type;
+	unsigned triple_num;
+	if (!getInt(p, end, &type, sizeof(type)) || !getInt(p, end, &_record.txn_id, sizeof(_record.txn_id))
+		|| !getInt(p, end, &_record.time, sizeof(_record.time)) || !getInt(p, end, &triple_num, sizeof(triple_num)))
+		return false;
+	if (type < UpdateLog::Insert || type > UpdateLog::Abort)
+		return false;
+	_record.type = (RecordType)type;
+	//each triple takes 13 bytes at least
+	if ((size_t)(end - p) < (size_t)triple_num * 13)
+		return false;
+	_record.triples.resize(triple_num);
+	for (unsigned i = 0; i < triple_num; ++i)
+	{
+		TripleWithObjType& triple = _record.triples[i];
+		unsigned char object_type;
+		if (!getInt(p, end, &object_type, sizeof(object_type)) || !getString(p, end, triple.subject)
+			|| !getString(p, end, triple.predicate) || !getString(p, end, triple.object))
+			return false;
+		triple.object_type = (TripleWithObjType::ObjectType)object_type;
+	}
+	return p == end;
+}
+
+bool
+UpdateLog::append(RecordType _type, unsigned long long _txn_id, const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num)
+{
+	string record;
+	UpdateLog::encode(record, _type, _txn_id, _triples, _triple_num);
+
+	unsigned long long lsn;
+	{
+		lock_guard<mutex> guard(this->lock);
+		if (this->fd < 0 || this->failed)
+		{
+			cout << "the update log is not open or failed to be written @UpdateLog::append" << endl;
+			return false;
+		}
+		this->buffer += record;
+		lsn = ++this->appended_lsn;
+	}
+	//the updates of a transaction are written by its commit, and an abort is redone as nothing
+	if (this->durability == UpdateLog::Async || _type == UpdateLog::Abort || (_txn_id != 0 && _type != UpdateLog::Commit))
+		return true;
+	return this->waitFor(lsn);
+}
+
+bool
+UpdateLog::waitFor(unsigned long long _lsn)
+{
+	unique_lock<mutex> guard(this->lock);
+	while (this->written_lsn < _lsn && !this->failed)
+	{
+		//the records appended meanwhile are written together by the next writer
+		if (this->writing)
+			this->written_cv.wait(guard);
+		else
+			this->writeBuffer(guard);
+	}
+	return this->written_lsn >= _lsn;
+}
+
+bool
+UpdateLog::writeBuffer(unique_lock<mutex>& _lock)
+{
+	this->writing = true;
+	string data;
+	data.swap(this->buffer);
+	unsigned long long lsn = this->appended_lsn;
+	bool sync = this->durability != UpdateLog::Write;
+	_lock.unlock();
+
+	bool ok = writeAll(this->fd, data) && writeAll(this->backup_fd, data);
+	if (ok && sync)
+		ok = fdatasync(this->fd) == 0 && fdatasync(this->backup_fd) == 0;
+
+	_lock.lock();
+	if (ok)
+	{
+		this->size += data.length();
+		this->backup_size += data.length();
+		this->written_lsn = lsn;
+	}
+	else
+	{
+		//the updates waiting are refused, and so are the later ones until the log is opened again
+		cout << "failed to write the update log: " << strerror(errno) << " @UpdateLog::writeBuffer" << endl;
+		if (ftruncate(this->fd, this->size) != 0 || ftruncate(this->backup_fd, this->backup_size) != 0)
+			cout << "failed to cut the update log back @UpdateLog::writeBuffer" << endl;
+		this->failed = true;
+	}
+	this->writing = false;
+	this->written_cv.notify_all();
+	return ok;
+}
+
+void
+UpdateLog::flusherLoop()
+{
+	unique_lock<mutex> guard(this->lock);
+	while (!this->stop)
+	{
+		this->flusher_cv.wait_for(guard, chrono::milliseconds(this->flush_interval));
+		if (!this->buffer.empty() && !this->writing && !this->failed)
+			this->writeBuffer(guard);
+	}
+}
+
+bool
+UpdateLog::flush()
+{
+	unsigned long long lsn;
+	{
+		lock_guard<mutex> guard(this->lock);
+		if (this->fd < 0)
+			return false;
+		lsn = this->appended_lsn;
+	}
+	if (!this->waitFor(lsn))
+		return false;
+	return this->durability != UpdateLog::Write || (fdatasync(this->fd) == 0 && fdatasync(this->backup_fd) == 0);
+}
+
+bool
+UpdateLog::truncate(bool _backup)
+{
+	unique_lock<mutex> guard(this->lock);
+	if (this->fd < 0)
+		return false;
+	while (this->writing)
+		this->written_cv.wait(guard);
+	int fd = _backup ? this->backup_fd : this->fd;
+	if (ftruncate(fd, 0) != 0)
+	{
+		cout << "failed to empty the update log @UpdateLog::truncate" << endl;
+		return false;
+	}
+	if (_backup)
+		this->backup_size = 0;
+	else
+		this->size = 0;
+	return true;
+}
+
+bool
+UpdateLog::read(const string& _path, vector<Record>& _records, unsigned _parallelism)
+{
+	string data;
+	if (!loadFile(_path, data))
+	{
+		cout << "failed to read the update log " << _path << " @UpdateLog::read" << endl;
+		return false;
+	}
+	vector<size_t> offsets;
+	scanRecords(data, offsets);
+
+	size_t first = _records.size();
+	_records.resize(first + offsets.size());
+	vector<char> valid(offsets.size(), 0);
+	WorkStealingPool pool(_parallelism);
+	pool.run(offsets.size(), [&](unsigned, unsigned long _i)
+	{
+		unsigned len, crc;
+		memcpy(&len, data.data() + offsets[_i], sizeof(len));
+		memcpy(&crc, data.data() + offsets[_i] + 4, sizeof(crc));
+		const char* body = data.data() + offsets[_i] + UpdateLog::HEADER_SIZE;
+		valid[_i] = UpdateLog::checksum(body, len) == crc && UpdateLog::decode(body, len, _records[first + _i]);
+	});
+
+	size_t num = 0;
+	while (num < offsets.size() && valid[num])
+		num++;
+	size_t end = 0;
+	if (num > 0)
+	{
+		unsigned len;
+		memcpy(&len, data.data() + offsets[num - 1], sizeof(len));
+		end = offsets[num - 1] + UpdateLog::HEADER_SIZE + len;
+	}
+	if (end < data.length())
+		cout << "the update log " << _path << " is read up to byte " << end << ", the rest is torn or corrupt" << endl;
+	_records.resize(first + num);
+	return true;
+}
+
+void
+UpdateLog::replay(const vector<Record>& _records, vector<TripleWithObjType>& _insertions,
+	vector<TripleWithObjType>& _removals, unsigned _parallelism)
+{
+	//scanned backwards, an update of a transaction is redone if its commit comes later; the IDs
+	//restart with the server, so the commits before a restart mark are not looked for after it
+	vector<char> redo(_records.size(), 0);
+	set<unsigned long long> committed;
+	for (size_t i = _records.size(); i-- > 0; )
+	{
+		const Record& record = _records[i];
+		if (record.type == UpdateLog::Commit)
+			committed.insert(record.txn_id);
+		else if (record.type == UpdateLog::Abort && record.txn_id == 0)
+			committed.clear();
+		else if (record.type == UpdateLog::Abort)
+			committed.erase(record.txn_id);
+		else
+			redo[i] = record.txn_id == 0 || committed.count(record.txn_id) > 0;
+	}
+
+	WorkStealingPool pool(_parallelism);
+	unsigned part_num = pool.getWorkerNum();
+
+	//the triples are split in hash partitions, each replayed in log order by one worker
+	vector<vector<unsigned> > parts(_records.size());
+	pool.run(_records.size(), [&](unsigned, unsigned long _i)
+	{
+		const Record& record = _records[_i];
+		if (!redo[_i])
+			return;
+		parts[_i].resize(record.triples.size());
+		for (size_t j = 0; j < record.triples.size(); ++j)
+		{
+			const TripleWithObjType& t = record.triples[j];
+			size_t h = hash<string>()(t.subject);
+			boost::hash_combine(h, t.predicate);
+			boost::hash_combine(h, t.object);
+			parts[_i][j] = h % part_num;
+		}
+	});
+
+	//the last operation on each triple, true for an insertion
+	vector<unordered_map<string, pair<bool, const TripleWithObjType*> > > last(part_num);
+	pool.run(part_num, [&](unsigned, unsigned long _p)
+	{
+		unordered_map<string, pair<bool, const TripleWithObjType*> >& ops = last[_p];
+		for (size_t i = 0; i < _records.size(); ++i)
+			for (size_t j = 0; j < parts[i].size(); ++j)
+			{
+				if (parts[i][j] != _p)
+					continue;
+				const TripleWithObjType& t = _records[i].triples[j];
+				string key = t.subject + '\t' + t.predicate + '\t' + t.object;
+				ops[key] = make_pair(_records[i].type == UpdateLog::Insert, &t);
+			}
+	});
+
+	for (unsigned p = 0; p < part_num; ++p)
+		for (unordered_map<string, pair<bool, const TripleWithObjType*> >::iterator it = last[p].begin(); it != last[p].end(); ++it)
+		{
+			if (it->second.first)
+				_insertions.push_back(*it->second.second);
+			else
+				_removals.push_back(*it->second.second);
+		}
+}
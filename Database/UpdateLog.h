@@ -0,0 +1,86 @@
+#ifndef _DATABASE_UPDATELOG_H
+#define _DATABASE_UPDATELOG_H
+
+#include "../Util/Util.h"
+#include "../Util/Triple.h"
+
+//The binary write-ahead log of the updates since the last save, copied to the log since the last
+//backup. A record is the length and the CRC-32 of its body, then the type, the transaction(0 for
+//none), the time in ms and the triples. The records appended by concurrent updates are written
+//together by one of them(group commit): one write and, in the sync mode, one fdatasync for all.
+//update_log_durability(in init.conf) decides when an update or a commit returns:
+//  sync: after its record is on disk(the default)
+//  write: after its record is written to the OS, lost only if the machine fails
+//  async: at once, the records are written and synced every update_log_flush_interval ms
+//The updates of a transaction are only waited for at its commit. An abort with no transaction marks
+//a restart, as the transaction IDs restart with the server.
+class UpdateLog
+{
+public:
+	enum RecordType { Insert = 1, Remove = 2, Commit = 3, Abort = 4 };
+	enum Durability { Sync, Write, Async };
+
+	struct Record
+	{
+		RecordType type;
+		unsigned long long txn_id;
+		long long time;
+		std::vector<TripleWithObjType> triples;
+	};
+
+	UpdateLog();
+	~UpdateLog();
+
+	//the mode is read from init.conf
+	bool open(const std::string& _path, const std::string& _backup_path);
+	void close();
+	//false if the record could not be logged, then the update must not be done
+	bool append(RecordType _type, unsigned long long _txn_id, const TripleWithObjType* _triples = NULL, TYPE_TRIPLE_NUM _triple_num = 0);
+	//write and sync all the records appended
+	bool flush();
+	//empty the log since the last save, or the one since the last backup
+	bool truncate(bool _backup = false);
+
+	//Read the records of a log up to the first torn or corrupt one, checked and decoded by
+	//_parallelism threads(0 for all cores)
+	static bool read(const std::string& _path, std::vector<Record>& _records, unsigned _parallelism);
+	//The updates to redo: the last operation on each triple, leaving out the transactions not committed
+	static void replay(const std::vector<Record>& _records, std::vector<TripleWithObjType>& _insertions,
+		std::vector<TripleWithObjType>& _removals, unsigned _parallelism);
+
+private:
+	static const unsigned HEADER_SIZE = 8;
+	static const unsigned DEFAULT_FLUSH_INTERVAL = 100;
+
+	UpdateLog(const UpdateLog&);
+	UpdateLog& operator=(const UpdateLog&);
+
+	static void encode(std::string& _buf, RecordType _type, unsigned long long _txn_id, const TripleWithObjType* _triples, TYPE_TRIPLE_NUM _triple_num);
+	static bool decode(const char* _body, unsigned _len, Record& _record);
+	static unsigned checksum(const char* _data, size_t _len);
+	//wait until the records up to _lsn are written, writing them if no one else is
+	bool waitFor(unsigned long long _lsn);
+	//write the buffer with the lock held on entry, which is released while writing
+	bool writeBuffer(std::unique_lock<std::mutex>& _lock);
+	void flusherLoop();
+
+	Durability durability;
+	unsigned flush_interval;	//in ms, for async
+	int fd;
+	int backup_fd;
+	off_t size, backup_size;	//what is written, a failed write is cut back to it
+
+	std::mutex lock;
+	std::condition_variable written_cv;
+	std::string buffer;	//records appended and not written
+	unsigned long long appended_lsn;
+	unsigned long long written_lsn;
+	bool writing;
+	bool failed;
+
+	std::thread flusher;
+	std::condition_variable flusher_cv;
+	bool stop;
+};
+
+#endif //_DATABASE_UPDATELOG_H
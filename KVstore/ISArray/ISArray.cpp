@@ -138,6 +138,110 @@ ISArray::PreLoad()
 	return true;
 }
 
+bool
+ISArray::Compact(string _dir_path, string _new_dir_path, string _filename, unsigned _block_size, ValueLayout &_before, ValueLayout &_after)
+{
+	string filename = _dir_path + "/" + _filename;
+	string new_name = _new_dir_path + "/" + _filename;
+	string ISfile_name = filename + "_ISfile";
+	memset(&_before, 0, sizeof(ValueLayout));
+	memset(&_after, 0, sizeof(ValueLayout));
+
+	// the block of each key, keys never saved are not in the file
+	FILE *fp = fopen(ISfile_name.c_str(), "rb");
+	if (fp == NULL)
+	{
+		cout << "Error in open " << ISfile_name << endl;
+		return false;
+	}
+	unsigned key_num = 0;
+	vector<unsigned> stores;
+	if (fread(&key_num, sizeof(unsigned), 1, fp) == 1)
+	{
+		stores.resize(key_num, 0);
+		if (key_num > 0)
+			fread(&stores[0], sizeof(unsigned), key_num, fp);
+	}
+	fclose(fp);
+
+	string mode = "open";
+	ISBlockManager *old_bm = new ISBlockManager(filename, mode);
+	old_bm->GetFreeInfo(_before);
+	if (_block_size == 0)
+		_block_size = old_bm->getBlockSize();
+
+	unsigned long long new_blocks = 0;
+	for (unsigned i = 0; i < key_num; i++)
+	{
+		if (stores[i] == 0)
+			continue;
+		unsigned len;
+		unsigned blocks, runs;
+		if (!old_bm->GetChain(stores[i], len, blocks, runs))
+		{
+			cout << filename << ": broken value of key " << i << ", compaction is cancelled" << endl;
+			delete old_bm;
+			return false;
+		}
+		_before.values++;
+		_before.value_bytes += len;
+		_before.blocks += blocks;
+		_before.runs += runs;
+		new_blocks += ISBlockManager::BlocksOf(len, _block_size);
+	}
+	if (new_blocks >= UINT_MAX)
+	{
+		cout << filename << ": block size " << _block_size << " is too small" << endl;
+		delete old_bm;
+		return false;
+	}
+
+	// the new dir may link to the old files, which must not be truncated through it
+	const char *suffix[] = { "_ValueFile", "_FreeBlockList", "_ISfile", "_BlockSize" };
+	for (unsigned i = 0; i < 4; i++)
+		unlink((new_name + suffix[i]).c_str());
+
+	// a single free run of all the blocks is taken from its front by each value
+	mode = "build";
+	ISBlockManager *new_bm = new ISBlockManager(new_name, mode, (unsigned)new_blocks, _block_size);
+	for (unsigned i = 0; i < key_num; i++)
+	{
+		if (stores[i] == 0)
+			continue;
+		char *str = NULL;
+		unsigned len = 0;
+		old_bm->ReadValue(stores[i], str, len);
+		stores[i] = new_bm->WriteValue(str, len);
+		delete [] str;
+
+		unsigned blocks, runs;
+		new_bm->GetChain(stores[i], len, blocks, runs);
+		_after.values++;
+		_after.value_bytes += len;
+		_after.blocks += blocks;
+		_after.runs += runs;
+	}
+	new_bm->SaveFreeBlockList();
+	new_bm->GetFreeInfo(_after);
+	new_bm->Sync();
+	delete new_bm;
+	delete old_bm;
+
+	string new_ISfile = new_name + "_ISfile";
+	fp = fopen(new_ISfile.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "Error in open " << new_ISfile << endl;
+		return false;
+	}
+	fwrite(&key_num, sizeof(unsigned), 1, fp);
+	if (key_num > 0)
+		fwrite(&stores[0], sizeof(unsigned), key_num, fp);
+	Util::Csync(fp);
+	fclose(fp);
+	return true;
+}
+
 bool
 ISArray::save()
 {
@@ -63,5 +63,9 @@ public:
 	bool remove(unsigned _key);
 	bool insert(unsigned _key, char *_str, unsigned _len);
 	bool save();
+	// rewrite the values of the closed array _dir_path/_filename in key order,
+	// each in adjacent blocks of _block_size bytes(0 keeps the current size),
+	// into the files of the same name in _new_dir_path, synced to disk
+	static bool Compact(string _dir_path, string _new_dir_path, string _filename, unsigned _block_size, ValueLayout &_before, ValueLayout &_after);
 	bool batch_id2str(vector<unsigned>& ids, vector<unsigned>& strs);
 };
@@ -17,10 +17,9 @@ using namespace std;
 class ISBlockManager
 {
 private:
-	// size of block, 4K, unit is byte
-	static const unsigned BLOCK_SIZE = 1 << 7;//1 << 12;
-	// size of data stored in block, unit is byte
-	static const unsigned BLOCK_DATA_SIZE = BLOCK_SIZE - 2 * sizeof(unsigned);
+	// default size of block, unit is byte, gcompact can rewrite a store with
+	// another size which is then kept in <filename>_BlockSize
+	static const unsigned DEFAULT_BLOCK_SIZE = 1 << 7;//1 << 12;
 	// minimum initial blocks
 	static const unsigned SET_BLOCK_NUM = 1 << 8;
 	// minimum blocks-num inc
@@ -38,6 +37,7 @@ private:
 	//string dir_path;
 	string FreeBlockList_path;
 	string ValueFile_path;
+	string BlockSize_path;
 	// File record which block is free
 	FILE* FreeBlockList;
 	// File record value lists
@@ -46,6 +46,9 @@ private:
 	BlockInfo* BlockToWrite;
 
 	unsigned cur_block_num;
+	// size of block and of data stored in block, unit is byte
+	unsigned block_size;
+	unsigned block_data_size;
 
 	bool AllocBlock(unsigned len);
 	
@@ -53,7 +56,8 @@ private:
 
 public:
 	ISBlockManager();
-	ISBlockManager(string& _filename, string &_mode, unsigned _keynum = 0);
+	// _block_size is used when building, 0 means DEFAULT_BLOCK_SIZE
+	ISBlockManager(string& _filename, string &_mode, unsigned _keynum = 0, unsigned _block_size = 0);
 	~ISBlockManager();
 
 	unsigned WriteValue(const char *_str, const unsigned _len);
@@ -61,6 +65,16 @@ public:
 	bool ReadValue(unsigned _blk_index, char *&_str, unsigned &_len);
 
 	void SaveFreeBlockList();
+	// flush the value file and the free block list to disk
+	void Sync();
 
 	bool FreeBlocks(const unsigned index);
+
+	unsigned getBlockSize() const { return block_size; }
+	// blocks of _block_size bytes needed by a value of _len bytes
+	static unsigned long long BlocksOf(unsigned _len, unsigned _block_size);
+	// walk the blocks of a value, _runs counts the runs of adjacent blocks
+	bool GetChain(unsigned _blk_index, unsigned &_len, unsigned &_blocks, unsigned &_runs);
+	// fill block_size, file_blocks, free_blocks and free_extents
+	void GetFreeInfo(ValueLayout &_layout);
 };
@@ -9,33 +9,43 @@
 
 #include "IVArray.h"
 
+const char IVArray::MMAP_MAGIC[8] = { 'G', 'I', 'V', 'M', 'M', 'A', 'P', '1' };
+
 IVArray::IVArray()
 {
-	array = NULL;
+	SegNum = 0;
+	FirstSegLen = 0;
 	IVfile = NULL;
 	dir_path = "";
 	IVfile_name = "";
 	BM = NULL;
 	CurEntryNum = 0;
-	CurCacheSize = 0;
 	CurEntryNumChange = false;
 	//index_time_map.clear();
 	//time_index_map.clear();
 	MAX_CACHE_SIZE = 0;
-	cache_head = new IVEntry;
-	cache_tail_id = -1;
+	CurCacheSize = 0;
+	MmapBase = NULL;
+	MmapLength = 0;
+	MmapOffset = NULL;
+	MmapLen = NULL;
+	shards = new CacheShard[CACHE_SHARD_NUM];
+	for (unsigned i = 0; i < CACHE_SHARD_NUM; i++)
+	{
+		shards[i].hand = 0;
+		shards[i].hits = shards[i].misses = shards[i].evictions = 0;
+	}
 }
 
 IVArray::~IVArray()
 {
-	if (array != NULL)
-	{
-		delete [] array;
-		array = NULL;
-	}
-	fclose(IVfile);
+	FreeEntries();
+	if (MmapBase != NULL)
+		munmap(MmapBase, MmapLength);
+	if (IVfile != NULL)
+		fclose(IVfile);
 	delete BM;
-	delete cache_head;
+	delete [] shards;
 	//index_time_map.clear();
 	//time_index_map.clear();
 }
@@ -46,389 +56,816 @@ IVArray::IVArray(string _dir_path, string _filename, string mode, unsigned long
 	dir_path = _dir_path;
 	filename = _dir_path + "/" + _filename;
 	IVfile_name = filename + "_IVfile";
+	Mmap_name = filename + "_IVmmap";
 	CurEntryNumChange = false;
+	MmapBase = NULL;
+	MmapLength = 0;
+	MmapOffset = NULL;
+	MmapLen = NULL;
+	SegNum = 0;
+	FirstSegLen = 0;
+	BM = NULL;
+	IVfile = NULL;
 	//index_time_map.clear();
 	//time_index_map.clear();
 	MAX_CACHE_SIZE = buffer_size;
 //	MAX_CACHE_SIZE = 10 * (1 << 30);
-	cache_head = new IVEntry;
-	cache_tail_id = -1;
+	CurCacheSize = 0;
+	shards = new CacheShard[CACHE_SHARD_NUM];
+	for (unsigned i = 0; i < CACHE_SHARD_NUM; i++)
+	{
+		shards[i].hand = 0;
+		shards[i].hits = shards[i].misses = shards[i].evictions = 0;
+	}
 
 	unsigned SETKEYNUM = 1 << 10;
 
 	if (mode == "build")
 	{
-		CurCacheSize = 0;
-
 		// temp is the smallest number >= _key_num and mod SET_KEY_INC = 0
 		unsigned temp = ((_key_num + (1 << 10) - 1) >> 10) << 10;
 		CurEntryNum = max(temp, SETKEYNUM);
 		CurEntryNumChange = true;
 
 		BM = new IVBlockManager(filename, mode, CurEntryNum);
-		array = new IVEntry [CurEntryNum];
+		AllocEntries(CurEntryNum);
 
 		IVfile = fopen(IVfile_name.c_str(), "w+b");
 	
-		if (BM == NULL || array == NULL || IVfile == NULL)
+		if (BM == NULL || SegNum == 0 || IVfile == NULL)
 		{
 			cout << "Initialize IVArray ERROR" << endl;
 		}
+		// the old layout for mmap is stale now
+		unlink(Mmap_name.c_str());
 	}
-	else // open mode
+	else if (mode == "mmap")
 	{
-		CurCacheSize = 0;
-		
-		IVfile = fopen(IVfile_name.c_str(), "r+b");
-		if (IVfile == NULL)
+		// read-only, values are read from the mapping with no cache
+		CurEntryNum = 0;
+		if (!MapValues())
 		{
-			cout << "Error in open " << IVfile_name << endl;
-			perror("fopen");
-			exit(0);
+			cout << _filename << ": laying out the values for mmap..." << endl;
+			OpenArray(_filename);
+			bool ok = WriteMmapFile();
+			FreeEntries();
+			delete BM;
+			BM = NULL;
+			fclose(IVfile);
+			IVfile = NULL;
+			CurEntryNum = 0;
+			if (!ok || !MapValues())
+			{
+				cout << _filename << ": Fail to map the values." << endl;
+				exit(0);
+			}
 		}
-		
-		int fd  = fileno(IVfile);
+	}
+	else // open mode
+	{
+		OpenArray(_filename);
+	}
+//	cout << _filename << " Done." << endl;
+}
 
-		pread(fd, &CurEntryNum, 1 * sizeof(unsigned), 0);
+// Open the index file and the value blocks
+void
+IVArray::OpenArray(string _filename)
+{
+	string mode = "open";
+	IVfile = fopen(IVfile_name.c_str(), "r+b");
+	if (IVfile == NULL)
+	{
+		cout << "Error in open " << IVfile_name << endl;
+		perror("fopen");
+		exit(0);
+	}
+	
+	int fd  = fileno(IVfile);
 
-		BM = new IVBlockManager(filename, mode, CurEntryNum);
-		if (BM == NULL)
-		{
-			cout << _filename << ": Fail to initialize IVBlockManager" << endl;
-			exit(0);
-		}
+	unsigned key_num = 0;
+	pread(fd, &key_num, 1 * sizeof(unsigned), 0);
+	CurEntryNum = key_num;
 
-		array = new IVEntry [CurEntryNum];
-		if (array == NULL)
-		{
-			cout << _filename << ": Fail to malloc enough space in main memory for array." << endl;
-			exit(0);
-		}
+	BM = new IVBlockManager(filename, mode, key_num);
+	if (BM == NULL)
+	{
+		cout << _filename << ": Fail to initialize IVBlockManager" << endl;
+		exit(0);
+	}
+
+	AllocEntries(key_num);
+	if (SegNum == 0)
+	{
+		cout << _filename << ": Fail to malloc enough space in main memory for array." << endl;
+		exit(0);
+	}
 //		cout << _filename << " CurEntryNum = " << CurEntryNum << endl;
-		for(unsigned i = 0; i < CurEntryNum; i++)
-		{
-			unsigned _store;
-			off_t offset = (i + 1) * sizeof(unsigned);
-			pread(fd, &_store, 1 * sizeof(unsigned), offset);
+	for(unsigned i = 0; i < key_num; i++)
+	{
+		unsigned _store;
+		off_t offset = (i + 1) * sizeof(unsigned);
+		pread(fd, &_store, 1 * sizeof(unsigned), offset);
 
 //			if (i % 1000000 == 0)
 //			cout << _filename << ": Key " << i << " stored in block " << _store << endl;
 
-			array[i].setStore(_store);
-			array[i].setDirtyFlag(false);
-		
-			if (_store > 0)
-			{
-				array[i].setUsedFlag(true);
-			}	
+		Entry(i).setStore(_store);
+		Entry(i).setDirtyFlag(false);
+	
+		if (_store > 0)
+		{
+			Entry(i).setUsedFlag(true);
+		}	
+	}
+	//TODO PreLoad
+//	PreLoad();
+}
+
+bool
+IVArray::Compact(string _dir_path, string _new_dir_path, string _filename, unsigned _block_size, ValueLayout &_before, ValueLayout &_after)
+{
+	string filename = _dir_path + "/" + _filename;
+	string new_name = _new_dir_path + "/" + _filename;
+	string IVfile_name = filename + "_IVfile";
+	memset(&_before, 0, sizeof(ValueLayout));
+	memset(&_after, 0, sizeof(ValueLayout));
+
+	// the block of each key, keys never saved are not in the file
+	FILE *fp = fopen(IVfile_name.c_str(), "rb");
+	if (fp == NULL)
+	{
+		cout << "Error in open " << IVfile_name << endl;
+		return false;
+	}
+	unsigned key_num = 0;
+	vector<unsigned> stores;
+	if (fread(&key_num, sizeof(unsigned), 1, fp) == 1)
+	{
+		stores.resize(key_num, 0);
+		if (key_num > 0)
+			fread(&stores[0], sizeof(unsigned), key_num, fp);
+	}
+	fclose(fp);
+
+	string mode = "open";
+	IVBlockManager *old_bm = new IVBlockManager(filename, mode);
+	old_bm->GetFreeInfo(_before);
+	if (_block_size == 0)
+		_block_size = old_bm->getBlockSize();
+
+	unsigned long long new_blocks = 0;
+	for (unsigned i = 0; i < key_num; i++)
+	{
+		if (stores[i] == 0)
+			continue;
+		unsigned long len;
+		unsigned blocks, runs;
+		if (!old_bm->GetChain(stores[i], len, blocks, runs))
+		{
+			cout << filename << ": broken value of key " << i << ", compaction is cancelled" << endl;
+			delete old_bm;
+			return false;
 		}
-		//TODO PreLoad
-//		PreLoad();
+		_before.values++;
+		_before.value_bytes += len;
+		_before.blocks += blocks;
+		_before.runs += runs;
+		new_blocks += IVBlockManager::BlocksOf(len, _block_size);
+	}
+	if (new_blocks >= UINT_MAX)
+	{
+		cout << filename << ": block size " << _block_size << " is too small" << endl;
+		delete old_bm;
+		return false;
+	}
 
+	// the new dir may link to the old files, which must not be truncated through it
+	const char *suffix[] = { "_ValueFile", "_FreeBlockList", "_IVfile", "_BlockSize" };
+	for (unsigned i = 0; i < 4; i++)
+		unlink((new_name + suffix[i]).c_str());
+
+	// a single free run of all the blocks is taken from its front by each value
+	mode = "build";
+	IVBlockManager *new_bm = new IVBlockManager(new_name, mode, (unsigned)new_blocks, _block_size);
+	for (unsigned i = 0; i < key_num; i++)
+	{
+		if (stores[i] == 0)
+			continue;
+		char *str = NULL;
+		unsigned long len = 0;
+		old_bm->ReadValue(stores[i], str, len);
+		stores[i] = new_bm->WriteValue(str, len);
+		delete [] str;
+
+		unsigned blocks, runs;
+		new_bm->GetChain(stores[i], len, blocks, runs);
+		_after.values++;
+		_after.value_bytes += len;
+		_after.blocks += blocks;
+		_after.runs += runs;
 	}
-//	cout << _filename << " Done." << endl;
+	new_bm->SaveFreeBlockList();
+	new_bm->GetFreeInfo(_after);
+	new_bm->Sync();
+	delete new_bm;
+	delete old_bm;
+
+	string new_IVfile = new_name + "_IVfile";
+	fp = fopen(new_IVfile.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "Error in open " << new_IVfile << endl;
+		return false;
+	}
+	fwrite(&key_num, sizeof(unsigned), 1, fp);
+	if (key_num > 0)
+		fwrite(&stores[0], sizeof(unsigned), key_num, fp);
+	Util::Csync(fp);
+	fclose(fp);
+	return true;
 }
 
 bool
 IVArray::save()
 {
+	if (MmapBase != NULL)
+		return true;
+
 	// save ValueFile and IVfile
 	int fd = fileno(IVfile);
 
+	bool changed = CurEntryNumChange;
 	if (CurEntryNumChange)
 		pwrite(fd, &CurEntryNum, 1 * sizeof(unsigned), 0);
 	CurEntryNumChange = false;
 
 	for(unsigned i = 0; i < CurEntryNum; i++)
 	{
-		if (array[i].isDirty())
+		if (Entry(i).isDirty())
 		{
 			char *str = NULL;
 			unsigned long len = 0;
 			unsigned int _store;
 			// probably value has been written but store has not	
-			if (array[i].isUsed() && array[i].getBstr(str, len, false))
+			if (Entry(i).isUsed() && Entry(i).getBstr(str, len, false))
 			{
 				//TODO Recycle free block
 				_store = BM->WriteValue(str, len);
-				array[i].setStore(_store);
+				Entry(i).setStore(_store);
 			}
 
-			_store = array[i].getStore();
+			_store = Entry(i).getStore();
 //			if (i == 839)
 //				cout << filename << " key " << i << " stored in block " << _store << endl;
 
 			off_t offset = (off_t)(i + 1) * sizeof(unsigned);
 			pwrite(fd, &_store, 1 * sizeof(unsigned), offset);
 
-			array[i].setDirtyFlag(false);
-
+			Entry(i).setDirtyFlag(false);
+			changed = true;
 		}
 
 	}
 
 	BM->SaveFreeBlockList();
 
+	// the layout for mmap is laid out again when mapped next time
+	if (changed)
+		unlink(Mmap_name.c_str());
+
 	return true;
 }
 
-// Swap the least used entry out of main memory
+// Write all values contiguously in key order to Mmap_name, the file is
+// MMAP_MAGIC, the key num, the offset and length of each value(offset 0 for
+// unused keys), then the values, each aligned to 8 bytes
 bool
-IVArray::SwapOut()
+IVArray::WriteMmapFile()
 {
-	int targetID;
-	if ((targetID = cache_head->getNext()) == -1) // cache is empty
+	string tmp_name = Mmap_name + ".tmp";
+	FILE* fp = fopen(tmp_name.c_str(), "wb");
+	if (fp == NULL)
 	{
+		cout << "IVArray: fail to create " << tmp_name << endl;
 		return false;
 	}
-
-	int nextID = array[targetID].getNext();
-	cache_head->setNext(nextID);
-	if (nextID != -1)
+	unsigned long long key_num = CurEntryNum;
+	vector<unsigned long long> offsets(key_num, 0), lens(key_num, 0);
+	unsigned long long pos = sizeof(MMAP_MAGIC) + sizeof(unsigned long long) * (1 + 2 * key_num);
+	fseeko(fp, pos, SEEK_SET);
+	static const char zeros[8] = { 0 };
+	bool ok = true;
+	for (unsigned i = 0; i < CurEntryNum && ok; i++)
 	{
-		array[nextID].setPrev(-1);
+		if (!Entry(i).isUsed())
+			continue;
+		char *str = NULL;
+		unsigned long len = 0;
+		bool own = !Entry(i).inCache();
+		if (!own)
+			Entry(i).getBstr(str, len, false);
+		else if (!BM->ReadValue(Entry(i).getStore(), str, len))
+			continue;
+		offsets[i] = pos;
+		lens[i] = len;
+		ok = fwrite(str, 1, len, fp) == len;
+		pos += len;
+		if (pos % 8 != 0)
+		{
+			fwrite(zeros, 1, 8 - pos % 8, fp);
+			pos += 8 - pos % 8;
+		}
+		if (own)
+			delete [] str;
 	}
-	else // p is tail
+	fseeko(fp, 0, SEEK_SET);
+	ok = ok && fwrite(MMAP_MAGIC, sizeof(MMAP_MAGIC), 1, fp) == 1;
+	ok = ok && fwrite(&key_num, sizeof(unsigned long long), 1, fp) == 1;
+	if (key_num > 0)
 	{
-		cache_tail_id = -1;
+		ok = ok && fwrite(&offsets[0], sizeof(unsigned long long), key_num, fp) == key_num;
+		ok = ok && fwrite(&lens[0], sizeof(unsigned long long), key_num, fp) == key_num;
 	}
-
-	char *str = NULL;
-	unsigned long len = 0;
-	array[targetID].getBstr(str, len, false);
-	CurCacheSize -= len;
-	if (array[targetID].isDirty())
+	Util::Csync(fp);
+	fclose(fp);
+	if (!ok || rename(tmp_name.c_str(), Mmap_name.c_str()) != 0)
 	{
-		//TODO recycle free blocks
-		unsigned store = BM->WriteValue(str, len);
-		if (store == 0)
-			return false;
-		array[targetID].setStore(store);
-	//	array[targetID].setDirtyFlag(false);
+		cout << "IVArray: fail to write " << Mmap_name << endl;
+		unlink(tmp_name.c_str());
+		return false;
 	}
-	array[targetID].release();
-	array[targetID].setCacheFlag(false);
-
 	return true;
 }
 
-// Add an entry into main memory
+// Map Mmap_name read-only, return false if it does not exist or is broken
 bool
-IVArray::AddInCache(unsigned _key, char *_str, unsigned long _len)
+IVArray::MapValues()
 {
-	if (_len > MAX_CACHE_SIZE)
+	int fd = open(Mmap_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MMAP_MAGIC) + sizeof(unsigned long long))
+	{
+		close(fd);
+		return false;
+	}
+	char *base = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		perror("mmap");
+		return false;
+	}
+	unsigned long long key_num = *(unsigned long long*)(base + sizeof(MMAP_MAGIC));
+	if (memcmp(base, MMAP_MAGIC, sizeof(MMAP_MAGIC)) != 0 ||
+		(unsigned long long)st.st_size < sizeof(MMAP_MAGIC) + sizeof(unsigned long long) * (1 + 2 * key_num))
 	{
+		munmap(base, st.st_size);
 		return false;
 	}
+	MmapBase = base;
+	MmapLength = st.st_size;
+	MmapOffset = (const unsigned long long*)(base + sizeof(MMAP_MAGIC) + sizeof(unsigned long long));
+	MmapLen = MmapOffset + key_num;
+	CurEntryNum = key_num;
+	return true;
+}
 
-//	this->CacheLock.lock();
-	// ensure there is enough room in main memory
-	while (CurCacheSize + _len > MAX_CACHE_SIZE)
+// Evict one value of the shard by CLOCK: the hand clears the reference bits it
+// passes and takes the first value neither referenced recently nor in use
+// NOTICE: called with the shard lock held
+bool
+IVArray::SwapOut(CacheShard& _shard)
+{
+	// two rounds, the first one may only clear the reference bits
+	unsigned long steps = 2 * (unsigned long)_shard.ring.size();
+	for (unsigned long i = 0; i < steps && !_shard.ring.empty(); i++)
 	{
-		if (!SwapOut())
+		if (_shard.hand >= _shard.ring.size())
+			_shard.hand = 0;
+		unsigned targetID = _shard.ring[_shard.hand];
+		IVEntry& target = Entry(targetID);
+		if (target.getRefBit())
+		{
+			target.setRefBit(false);
+			_shard.hand++;
+			continue;
+		}
+		if (target.getRefCount() > 0)
+		{
+			_shard.hand++;
+			continue;
+		}
+		// a reader takes its reference before checking the flag, so either it
+		// sees the flag cleared or we see its reference
+		target.setCacheFlag(false);
+		if (target.getRefCount() > 0)
+		{
+			target.setCacheFlag(true);
+			_shard.hand++;
+			continue;
+		}
+
+		// the last key of the ring is moved to the hand
+		RemoveFromClock(targetID);
+
+		char *str = NULL;
+		unsigned long len = 0;
+		target.getBstr(str, len, false);
+		CurCacheSize.fetch_sub(len);
+		if (target.isDirty())
 		{
-			cout << filename << ": swapout error" << endl;
-			exit(0);
+			//TODO recycle free blocks
+			unsigned store = BM->WriteValue(str, len);
+			if (store == 0)
+			{
+				cout << filename << ": swapout error" << endl;
+				exit(0);
+			}
+			target.setStore(store);
+		//	target.setDirtyFlag(false);
 		}
+		target.release();
+		_shard.evictions.fetch_add(1, memory_order_relaxed);
+		return true;
 	}
+	// cache is empty, or all values are in use
+	return false;
+}
 
+// Evict one value of a shard other than the one of _key, the shards busy now are
+// skipped, as two threads adding values may each hold the lock the other wants
+// NOTICE: called with the shard lock of _key held
+bool
+IVArray::SwapOutOthers(unsigned _key)
+{
+	unsigned own = _key % CACHE_SHARD_NUM;
+	for (unsigned i = 1; i < CACHE_SHARD_NUM; i++)
+	{
+		CacheShard& shard = shards[(own + i) % CACHE_SHARD_NUM];
+		if (!shard.lock.try_lock())
+			continue;
+		bool ret = SwapOut(shard);
+		shard.lock.unlock();
+		if (ret)
+			return true;
+	}
+	return false;
+}
 
-	if (cache_tail_id == -1)
-		cache_head->setNext(_key);
-	else
-		array[cache_tail_id].setNext(_key);
+// Add an entry into main memory, the cache takes _str if it returns true
+// The shards share MAX_CACHE_SIZE: the room is taken from the values of the own
+// shard first, then from the others. If all values are in use, _str is not cached
+// NOTICE: called with the shard lock held
+bool
+IVArray::AddInCache(unsigned _key, char *_str, unsigned long _len)
+{
+	if (_len > MAX_CACHE_SIZE)
+	{
+		return false;
+	}
 
-	array[_key].setPrev(cache_tail_id);
-	array[_key].setNext(-1);
-	cache_tail_id = _key;
+	CacheShard& shard = GetShard(_key);
+	// reserve the room in main memory
+	unsigned long long size = CurCacheSize.load();
+	while (size + _len > MAX_CACHE_SIZE || !CurCacheSize.compare_exchange_weak(size, size + _len))
+	{
+		if (size + _len > MAX_CACHE_SIZE && !SwapOut(shard) && !SwapOutOthers(_key))
+			return false;
+		size = CurCacheSize.load();
+	}
 
-	CurCacheSize += _len;
-	array[_key].setBstr(_str, _len);
-	array[_key].setCacheFlag(true);
+	Entry(_key).setClockPos(shard.ring.size());
+	shard.ring.push_back(_key);
+	Entry(_key).setBstr(_str, _len);
+	Entry(_key).setRefBit(false);
+	// published after the value
+	Entry(_key).setCacheFlag(true);
 
-//	this->CacheLock.unlock();
 	return true;
 }
 
-//Update last used time of array[_key]
+// Remove a key from the CLOCK ring of its shard, the last key takes its place
+// NOTICE: called with the shard lock held
+void
+IVArray::RemoveFromClock(unsigned _key)
+{
+	int pos = Entry(_key).getClockPos();
+	if (pos < 0)
+		return;
+	CacheShard& shard = GetShard(_key);
+	unsigned last = shard.ring.back();
+	shard.ring[pos] = last;
+	Entry(last).setClockPos(pos);
+	shard.ring.pop_back();
+	Entry(_key).setClockPos(-1);
+}
+
+// Read a cached value without lock, return false if it is not cached
+// with _copy false, the reference is kept and must be released by releaseRef
 bool
-IVArray::UpdateTime(unsigned _key, bool HasLock)
+IVArray::TryHit(unsigned _key, char *&_str, unsigned long & _len, bool _copy)
 {
-	if (array[_key].isPined()) // the cache pined should not be swaped out
-		return true;
+	IVEntry& entry = Entry(_key);
+	if (!entry.inCache())
+		return false;
+	entry.addRef();
+	if (!entry.inCache())
+	{
+		entry.subRef();
+		return false;
+	}
+	// avoid writing the shared cache line if already set
+	if (!entry.getRefBit())
+		entry.setRefBit(true);
+	entry.getBstr(_str, _len, _copy);
+	if (_copy)
+		entry.subRef();
+	GetShard(_key).hits.fetch_add(1, memory_order_relaxed);
+	return true;
+}
 
-	if (_key == (unsigned) cache_tail_id)// already most recent
+// Read the value of a used key through the cache, _str is a copy for the caller
+bool
+IVArray::GetValue(unsigned _key, char *&_str, unsigned long & _len)
+{
+	if (TryHit(_key, _str, _len, true))
 		return true;
 
-//	if (!HasLock)
-//		this->CacheLock.lock();
-//	cout << "UpdateTime: " << _key << endl;
-	int prevID = array[_key].getPrev();
-	int nextID = array[_key].getNext();
-
-	if (prevID == -1)
-		cache_head->setNext(nextID);
-	else
-		array[prevID].setNext(nextID);
-
-	array[nextID].setPrev(prevID); // since array[_key] is not tail, nextp will not be NULL
-
-	array[_key].setPrev(cache_tail_id);
-	array[_key].setNext(-1);
-	array[cache_tail_id].setNext(_key);
-	cache_tail_id = _key;
-
-//	if (!HasLock)
-//		this->CacheLock.unlock();
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
+	// loaded by another thread, or pinned
+	if (Entry(_key).inCache())
+	{
+		shard.hits.fetch_add(1, memory_order_relaxed);
+		Entry(_key).setRefBit(true);
+		bool ret = Entry(_key).getBstr(_str, _len);
+		shard.lock.unlock();
+		return ret;
+	}
+	shard.misses.fetch_add(1, memory_order_relaxed);
+	// read in disk
+	unsigned store = Entry(_key).getStore();
+	if (!BM->ReadValue(store, _str, _len))
+	{
+		shard.lock.unlock();
+		return false;
+	}
+	if (!VList::isLongList(_len) && AddInCache(_key, _str, _len))
+	{
+		char *copy = new char [_len];
+		memcpy(copy, _str, _len);
+		_str = copy;
+	}
+	shard.lock.unlock();
 	return true;
 }
 
 bool
 IVArray::search(unsigned _key, char *&_str, unsigned long & _len)
 {
+	if (MmapBase != NULL)
+	{
+		if (_key >= CurEntryNum || MmapOffset[_key] == 0)
+		{
+			_str = NULL;
+			_len = 0;
+			return false;
+		}
+		_len = MmapLen[_key];
+		_str = new char [_len];
+		memcpy(_str, MmapBase + MmapOffset[_key], _len);
+		return true;
+	}
 	//printf("%s search %d: ", filename.c_str(), _key);
-	if (_key >= CurEntryNum ||!array[_key].isUsed())
+	if (_key >= CurEntryNum ||!Entry(_key).isUsed())
 	{
 		_str = NULL;
 		_len = 0;
 		return false;
 	}
-	// try to read in main memory
-	this->CacheLock.lock();
-	if (array[_key].inCache())
+	bool ret = GetValue(_key, _str, _len);
+	return ret;
+}
+
+bool
+IVArray::searchRef(unsigned _key, char *&_str, unsigned long & _len, bool & _own)
+{
+	_own = false;
+	if (MmapBase != NULL)
 	{
-		UpdateTime(_key);
-		this->CacheLock.unlock();
-		bool ret = array[_key].getBstr(_str, _len);
-		return ret;
+		if (_key >= CurEntryNum || MmapOffset[_key] == 0)
+		{
+			_str = NULL;
+			_len = 0;
+			return false;
+		}
+		// points into the mapping, nothing to release
+		_str = MmapBase + MmapOffset[_key];
+		_len = MmapLen[_key];
+		return true;
 	}
-	// read in disk
-	unsigned store = array[_key].getStore();
-	if (!BM->ReadValue(store, _str, _len))
+	if (_key >= CurEntryNum ||!Entry(_key).isUsed())
 	{
-		this->CacheLock.unlock();
+		_str = NULL;
+		_len = 0;
 		return false;
 	}
-	if(!VList::isLongList(_len))
+	if (TryHit(_key, _str, _len, false))
 	{
-//		if (array[_key].Lock.try_lock())
-//		{
-//			if (array[_key].inCache())
-//				return true;
-			AddInCache(_key, _str, _len);
-			char *debug = new char [_len];
-			memcpy(debug, _str, _len);
-			_str = debug;
-	//		array[_key].Lock.unlock();
-	
-//		}
+		return true;
+	}
+
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
+	if (Entry(_key).inCache())
+	{
+		shard.hits.fetch_add(1, memory_order_relaxed);
+		Entry(_key).setRefBit(true);
+	}
+	else
+	{
+		shard.misses.fetch_add(1, memory_order_relaxed);
+		// read in disk
+		unsigned store = Entry(_key).getStore();
+		if (!BM->ReadValue(store, _str, _len))
+		{
+			shard.lock.unlock();
+			return false;
+		}
+		if (VList::isLongList(_len) || !AddInCache(_key, _str, _len))
+		{
+			shard.lock.unlock();
+			_own = true;
+			return true;
+		}
+	}
+	Entry(_key).getBstr(_str, _len, false);
+	Entry(_key).addRef();
+	shard.lock.unlock();
+	return true;
+}
+
+void
+IVArray::releaseRef(unsigned _key)
+{
+	if (MmapBase != NULL)
+		return;
+	if (_key < CurEntryNum)
+		Entry(_key).subRef();
+}
+
+//NOTICE: called with the shard lock held after the cache flag is cleared,
+//so no new reader can take a reference
+void
+IVArray::WaitForReaders(unsigned _key)
+{
+	while (Entry(_key).getRefCount() > 0)
+		this_thread::yield();
+}
+
+void
+IVArray::getCacheStats(unsigned long long & _hits, unsigned long long & _misses, unsigned long long & _evictions) const
+{
+	_hits = _misses = _evictions = 0;
+	for (unsigned i = 0; i < CACHE_SHARD_NUM; i++)
+	{
+		_hits += shards[i].hits.load(memory_order_relaxed);
+		_misses += shards[i].misses.load(memory_order_relaxed);
+		_evictions += shards[i].evictions.load(memory_order_relaxed);
+	}
+}
+
+// Allocate the first segment with _num entries(at least SET_KEY_NUM)
+void
+IVArray::AllocEntries(unsigned _num)
+{
+	FirstSegLen = max(_num, SET_KEY_NUM);
+	segments[0] = new (nothrow) IVEntry[FirstSegLen];
+	SegNum = segments[0] == NULL ? 0 : 1;
+	if (SegNum > 0 && CurEntryNum != FirstSegLen)
+	{
+		CurEntryNum = FirstSegLen;
+		CurEntryNumChange = true;
+	}
+}
+
+void
+IVArray::FreeEntries()
+{
+	for (unsigned i = 0; i < SegNum; i++)
+		delete [] segments[i];
+	SegNum = 0;
+}
+
+// Enlarge the array to hold _key by adding segments, each as large as all the
+// ones before. CurEntryNum is raised after a segment is ready, so a reader that
+// sees the key in range finds its entry, and the entries already there stay
+bool
+IVArray::Enlarge(unsigned _key)
+{
+	lock_guard<mutex> guard(EnlargeLock);
+	while (_key >= CurEntryNum)
+	{
+		unsigned long long base = CurEntryNum;
+		unsigned long long len = min(base, (unsigned long long)MAX_KEY_NUM - base);
+		IVEntry* seg = new (nothrow) IVEntry[len];
+		if (seg == NULL)
+		{
+			cout << "IVArray insert error: main memory full" << endl;
+			return false;
+		}
+		segments[SegNum++] = seg;
+		CurEntryNum.store(base + len, memory_order_release);
+		CurEntryNumChange = true;
 	}
-	this->CacheLock.unlock();
 	return true;
 }
 
 bool
 IVArray::insert(unsigned _key, char *_str, unsigned long _len)
 {
-	this->CacheLock.lock();
-	if (_key < CurEntryNum && array[_key].isUsed())
+	if (MmapBase != NULL)
 	{
-		this->CacheLock.unlock();
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
 		return false;
 	}
-	
 	if (_key >= IVArray::MAX_KEY_NUM)
 	{
 		cout << _key << ' ' << MAX_KEY_NUM << endl;
 		cout << "IVArray insert error: Key is bigger than MAX_KEY_NUM" << endl;
-		this->CacheLock.unlock();
 		return false;
 	}
 
 	//if (CurKeyNum >= CurEntryNum) // need to realloc
-	if (_key >= CurEntryNum)
+	if (_key >= CurEntryNum && !Enlarge(_key))
 	{
-		CurEntryNumChange = true;
-		// temp is the smallest number >= _key and mod SET_KEY_INC = 0
-		unsigned temp = ((_key + (1 << 10) - 1) >> 10) << 10;
-		unsigned OldEntryNum = CurEntryNum;
-//		CurEntryNum = max(CurEntryNum + IVArray::SET_KEY_INC, temp);
-		CurEntryNum = IVMIN(OldEntryNum << 1, IVMAXKEYNUM);
-
-		IVEntry* newp = new IVEntry[CurEntryNum];
-		if (newp == NULL)
-		{
-			cout << "IVArray insert error: main memory full" << endl;
-			CurEntryNum = OldEntryNum;
-			delete[] newp;
-			this->CacheLock.unlock();
-			return false;
-		}
-
-		for(int i = 0; i < OldEntryNum; i++)
-			newp[i].Copy(array[i]);
-
-		delete [] array;
-		array = newp;
+		return false;
+	}
 
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
+	if (Entry(_key).isUsed())
+	{
+		shard.lock.unlock();
+		return false;
 	}
 
 	// TODO maybe sometimes not to write in disk, but stored in main memory
-	if (VList::isLongList(_len))
+	if (VList::isLongList(_len) || !AddInCache(_key, _str, _len))
 	{
 		unsigned store = BM->WriteValue(_str, _len);
 		if (store == 0)
 		{
+			shard.lock.unlock();
 			return false;
 		}
-		array[_key].setStore(store);
-	}
-	else
-	{
-		AddInCache(_key, _str, _len);
+		Entry(_key).setStore(store);
+		// the value is only kept on disk
+		delete [] _str;
 	}
 	//AddInCache(_key, _str, _len);
 	
-	array[_key].setUsedFlag(true);
-	array[_key].setDirtyFlag(true);
-	this->CacheLock.unlock();
+	Entry(_key).setUsedFlag(true);
+	Entry(_key).setDirtyFlag(true);
+	shard.lock.unlock();
 	return true;
 }
 
 bool
 IVArray::remove(unsigned _key)
 {
-	if (!array[_key].isUsed())
+	if (MmapBase != NULL)
+	{
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
+		return false;
+	}
+	if (_key >= CurEntryNum || !Entry(_key).isUsed())
 	{
 		return false;
 	}
 
-	this->CacheLock.lock();
-	unsigned store = array[_key].getStore();
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
+	bool cached = Entry(_key).inCache();
+	Entry(_key).setCacheFlag(false);
+	WaitForReaders(_key);
+	unsigned store = Entry(_key).getStore();
 	BM->FreeBlocks(store);
 
-	array[_key].setUsedFlag(false);
-	array[_key].setDirtyFlag(true);
-	array[_key].setStore(0);
+	Entry(_key).setUsedFlag(false);
+	Entry(_key).setDirtyFlag(true);
+	Entry(_key).setStore(0);
 
-	if (array[_key].inCache())
+	if (cached)
 	{
-		RemoveFromLRUQueue(_key);
-		if(array[_key].isPined())
-			array[_key].setCachePinFlag(false);
-
-		char *str = NULL;
-		unsigned long len = 0;
-		array[_key].getBstr(str, len, false);
-		CurCacheSize += len;
-		array[_key].setCacheFlag(false);
+		RemoveFromCache(_key);
 	}
 
-	if (array[_key].isPined())
-		array[_key].setCachePinFlag(false);
-
-	array[_key].release();
-	this->CacheLock.unlock();
+	Entry(_key).release();
+	shard.lock.unlock();
 	return true;
 
 }
@@ -436,38 +873,40 @@ IVArray::remove(unsigned _key)
 bool
 IVArray::modify(unsigned _key, char *_str, unsigned long _len)
 {
+	if (MmapBase != NULL)
+	{
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
+		return false;
+	}
 	//cout << "this IVArray::modify " << endl;
-	if (!array[_key].isUsed())
+	if (_key >= CurEntryNum || !Entry(_key).isUsed())
 	{
-		
 		return false;
 	}
-	array[_key].setDirtyFlag(true);
-	this->CacheLock.lock();
-	if (array[_key].inCache())
+	Entry(_key).setDirtyFlag(true);
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
+	if (Entry(_key).inCache())
 	{
-		RemoveFromLRUQueue(_key);
-		
-		if(array[_key].isPined())
-			array[_key].setCachePinFlag(false);
-
-		char* str = NULL;
-		unsigned long len = 0;
-		array[_key].getBstr(str, len, false);
-
-		array[_key].release();
-		CurCacheSize -= len;
-		AddInCache(_key, _str, _len);
+		Entry(_key).setCacheFlag(false);
+		WaitForReaders(_key);
+		RemoveFromCache(_key);
+		Entry(_key).release();
 	}
 	else
 	{
 		//cout << "free disk and set" << endl;
-		unsigned store = array[_key].getStore();
+		unsigned store = Entry(_key).getStore();
 		BM->FreeBlocks(store);
-		AddInCache(_key, _str, _len);
-		
+		Entry(_key).setStore(0);
 	}
-	this->CacheLock.unlock();
+	// too large for the cache
+	if (!AddInCache(_key, _str, _len))
+	{
+		Entry(_key).setStore(BM->WriteValue(_str, _len));
+		delete [] _str;
+	}
+	shard.lock.unlock();
 	return true;
 	
 }
@@ -477,68 +916,66 @@ void
 IVArray::PinCache(unsigned _key)
 {
 	//printf("%s search %d: ", filename.c_str(), _key);
-	if (_key >= CurEntryNum ||!array[_key].isUsed())
+	if (MmapBase != NULL)
+	{
+		return;
+	}
+	if (_key >= CurEntryNum ||!Entry(_key).isUsed())
 	{
 		return;
 	}
+	CacheShard& shard = GetShard(_key);
+	shard.lock.lock();
 	// try to read in main memory
-	if (array[_key].inCache())
+	if (Entry(_key).inCache())
 	{
-		RemoveFromLRUQueue(_key);
-
-		array[_key].setCachePinFlag(true);
-	
+		if (!Entry(_key).isPined())
+		{
+			char *str = NULL;
+			unsigned long len = 0;
+			Entry(_key).getBstr(str, len, false);
+			RemoveFromClock(_key);
+			CurCacheSize.fetch_sub(len);
+			Entry(_key).setCachePinFlag(true);
+		}
+		shard.lock.unlock();
 		return;
 	}
 	// read in disk
-	unsigned store = array[_key].getStore();
+	unsigned store = Entry(_key).getStore();
 	char *_str = NULL;
 	unsigned long _len = 0;
 	if (!BM->ReadValue(store, _str, _len))
 	{
+		shard.lock.unlock();
 		return;
 	}
 
-	array[_key].setBstr(_str, _len);
-	array[_key].setCacheFlag(true);
-	array[_key].setCachePinFlag(true);
+	Entry(_key).setBstr(_str, _len);
+	Entry(_key).setCachePinFlag(true);
+	Entry(_key).setCacheFlag(true);
+	shard.lock.unlock();
 
 	return;
 }
 
+// Drop the accounting of a cached value, the caller clears the cache flag and
+// releases the value
+// NOTICE: called with the shard lock held
 void
-IVArray::RemoveFromLRUQueue(unsigned _key)
+IVArray::RemoveFromCache(unsigned _key)
 {
-	if (!array[_key].inCache() || array[_key].isPined())
+	if (Entry(_key).isPined())
+	{
+		Entry(_key).setCachePinFlag(false);
 		return;
+	}
 
-	//this->CacheLock.lock();
-	int prevID = array[_key].getPrev();
-	int nextID = array[_key].getNext();
-
-	if (prevID == -1)
-		cache_head->setNext(nextID);
-	else
-		array[prevID].setNext(nextID);
-
-	//cout << "next ID: " << nextID << endl;
-	if (nextID != -1)
-		array[nextID].setPrev(prevID); // since array[_key] is not tail, nextp will not be NULL
-	else
-		cache_tail_id = prevID;
-
-	array[_key].setCacheFlag(false);
-	array[_key].setPrev(-1);
-	array[_key].setNext(-1);
-	/*UpdateTime(_key, true);
-	unsigned PrevID = array[_key].getPrev();
-	cache_tail_id = PrevID;
-	if (PrevID == -1)
-		cache_head->setNext(-1);
-	else
-		array[PrevID].setNext(-1);*/
-
-	//this->CacheLock.unlock();
+	char *str = NULL;
+	unsigned long len = 0;
+	Entry(_key).getBstr(str, len, false);
+	CurCacheSize.fetch_sub(len);
+	RemoveFromClock(_key);
 	return;
 }
 
@@ -548,18 +985,29 @@ IVArray::RemoveFromLRUQueue(unsigned _key)
 bool 
 IVArray::search(unsigned _key, char *& _str, unsigned long & _len, VDataSet& AddSet, VDataSet& DelSet, shared_ptr<Transaction> txn, bool &latched, bool is_firstread )
 {
-	ArraySharedLock();
+	// no versions in a read-only array
+	if (MmapBase != NULL)
+	{
+		latched = false;
+		if (_key >= CurEntryNum)
+		{
+			_str = NULL;
+			_len = 0;
+			return false;
+		}
+		search(_key, _str, _len);
+		return true;
+	}
 	//printf("%s search %d: ", filename.c_str(), _key);
 	if (_key >= CurEntryNum)
 	{
 		_str = NULL;
 		_len = 0;
-		//cout << "_key >= CurEntryNum ||!array[_key].isUsed()......................................................" << endl;
-		ArrayUnlock();
+		//cout << "_key >= CurEntryNum ||!Entry(_key).isUsed()......................................................" << endl;
 		return false;
 	}
 	// try to read in main memory
-	bool ret = array[_key].ReadVersion(AddSet, DelSet, txn, latched, is_firstread);
+	bool ret = Entry(_key).ReadVersion(AddSet, DelSet, txn, latched, is_firstread);
 	bool is_empty = AddSet.size() == 0 && DelSet.size() == 0;
 	
 	if(ret == false) {
@@ -568,80 +1016,46 @@ IVArray::search(unsigned _key, char *& _str, unsigned long & _len, VDataSet& Add
 		_len = 0;
 		txn->SetState(TransactionState::ABORTED);
 		assert(latched == false);
-		ArrayUnlock();
 		return false;
 	}
-	this->CacheLock.lock();
-	if(!array[_key].isUsed())
+	if(!Entry(_key).isUsed())
 	{
 		//cerr << "empty entry!" << endl;
 		_str = NULL;
 		_len = 0;
-		ArrayUnlock();
-		this->CacheLock.unlock();
 		return true;
 	}
 	
-	
-	if (array[_key].inCache())
-	{
-		UpdateTime(_key);
-		this->CacheLock.unlock();
-		bool ret = array[_key].getBstr(_str, _len);
-		//cout << ret << endl;
-		//_str maybe nullptr
-		//cout << "get base str success......................................................" << endl;
-		ArrayUnlock();
-		if(ret == false && latched == true) assert(false);
-		return ret;
-	}
-	
-	// read in disk
-	unsigned store = array[_key].getStore();
-	if (!BM->ReadValue(store, _str, _len))
+	//_str maybe nullptr if the base value is empty
+	if (!GetValue(_key, _str, _len))
 	{
-		this->CacheLock.unlock();
-		ArrayUnlock();
 		//cout << "base str is null......................................................" << endl;
-		return true;
-	}
-	if(!VList::isLongList(_len) )
-	{
-//		if (array[_key].Lock.try_lock())
-//		{
-//			if (array[_key].inCache())
-//				return true;
-			AddInCache(_key, _str, _len);
-			char *debug = new char [_len];
-			memcpy(debug, _str, _len);
-			_str = debug;
-	//		array[_key].Lock.unlock();
-	
-//		}
+		_str = NULL;
+		_len = 0;
 	}
-	this->CacheLock.unlock();
-	ArrayUnlock();
 	return true;
 }
 
 bool 
 IVArray::remove(unsigned _key, VDataSet& delta, shared_ptr<Transaction> txn)
 {
-	ArraySharedLock();
+	if (MmapBase != NULL)
+	{
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
+		return false;
+	}
 	if (_key < CurEntryNum)
 	{
 		//check if first remove
 		VDataSet addset;
 		addset.clear();
 		
-		bool ret = array[_key].WriteVersion(addset, delta, txn);
+		bool ret = Entry(_key).WriteVersion(addset, delta, txn);
 		if(ret == false) txn->SetState(TransactionState::ABORTED);
-		ArrayUnlock();
 		return ret;
 	}
 	else
 	{
-		ArrayUnlock();
 		return false;
 	}
 }
@@ -649,24 +1063,25 @@ IVArray::remove(unsigned _key, VDataSet& delta, shared_ptr<Transaction> txn)
 bool 
 IVArray::insert(unsigned _key, VDataSet& delta, shared_ptr<Transaction> txn)
 {
-	ArraySharedLock();
+	if (MmapBase != NULL)
+	{
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
+		return false;
+	}
 	if(_key >= CurEntryNum) {
-		ArrayUnlock();
 		return false; //not happen
 	}
 	VDataSet delset;
 	delset.clear();
 	//check if first insert 
-	//array[_key].setDirtyFlag(true);
-	int ret = array[_key].WriteVersion(delta, delset, txn);
+	//Entry(_key).setDirtyFlag(true);
+	int ret = Entry(_key).WriteVersion(delta, delset, txn);
 	if(ret != 1) {
 		cerr << "write version failed!" << endl;
 		txn->SetState(TransactionState::ABORTED);
-		ArrayUnlock();
 		return false;
 	}
-	//cout << "array[_key].inCache()" << array[_key].inCache() << endl;
-	ArrayUnlock();
+	//cout << "Entry(_key).inCache()" << Entry(_key).inCache() << endl;
 	return true;
 }
 
@@ -674,7 +1089,11 @@ IVArray::insert(unsigned _key, VDataSet& delta, shared_ptr<Transaction> txn)
 int 
 IVArray::TryExclusiveLatch(unsigned _key, shared_ptr<Transaction> txn, bool has_read )
 {
-	ArraySharedLock();
+	if (MmapBase != NULL)
+	{
+		cout << filename << ": values are mapped read-only, updates are not allowed" << endl;
+		return 0;
+	}
 	if(_key >= CurEntryNum) //expand
 	{
 		//cerr << "expanding..............." << endl;
@@ -682,73 +1101,45 @@ IVArray::TryExclusiveLatch(unsigned _key, shared_ptr<Transaction> txn, bool has_
 		{
 			cerr << _key << ' ' << MAX_KEY_NUM << endl;
 			cerr << "IVArray insert error: Key is bigger than MAX_KEY_NUM" << endl;
-			ArrayUnlock();
 			return 0;
 		}
-		ArrayUnlock();
- 		ArrayExclusiveLock(); 
-		if(_key >= CurEntryNum) //recheck
+		if (!Enlarge(_key))
 		{
-			CurEntryNumChange = true;
-			//assuming one expand is enough
-			unsigned OldEntryNum = CurEntryNum;
-			CurEntryNum = IVMIN(OldEntryNum << 1, IVMAXKEYNUM);
-
-			IVEntry* newp = new IVEntry[CurEntryNum];
-			if (newp == NULL)
-			{
-				cerr << "IVArray insert error: main memory full" << endl;
-				CurEntryNum = OldEntryNum;
-				delete[] newp;
-				ArrayUnlock();
-				return 0;
-			}
-
-			for(int i = 0; i < OldEntryNum; i++)
-				newp[i].Copy(array[i]);
-
-			delete [] array;
-			array = newp;
+			return 0;
 		}
-		ArrayUnlock();
-		//cerr << "Array lock downgrade !" << endl;
-		ArraySharedLock();
 	}
 	//assert(_key < CurEntryNum);
 	
-	int ret = array[_key].GetExclusiveLatch(txn, has_read);
-	ArrayUnlock();
+	int ret = Entry(_key).GetExclusiveLatch(txn, has_read);
 	return ret;
 }
 
 bool 
 IVArray::ReleaseLatch(unsigned _key, shared_ptr<Transaction> txn, IVEntry::LatchType type)
 {
-	ArraySharedLock();
+	if (MmapBase != NULL)
+		return false;
 	if (_key >= CurEntryNum)
 	{
-		ArrayUnlock();
 		return false;
 	}
-	bool ret = array[_key].UnLatch(txn, type);
-	ArrayUnlock();
+	bool ret = Entry(_key).UnLatch(txn, type);
 	return ret;
 }
 
 bool
 IVArray::Rollback(unsigned _key, shared_ptr<Transaction> txn, bool has_read)
 {
-	ArraySharedLock();
+	if (MmapBase != NULL)
+		return false;
 	if (_key >= CurEntryNum)
 	{
-		ArrayUnlock();
 		return false;
 	}
-	//bool delete_ret = array[_key].deleteUnCommittedVersion(txn);
-	bool delete_ret = array[_key].InvalidExlusiveLatch(txn, has_read);
+	//bool delete_ret = Entry(_key).deleteUnCommittedVersion(txn);
+	bool delete_ret = Entry(_key).InvalidExlusiveLatch(txn, has_read);
 	//cerr << "delete_retdelete_ret TID:" << txn->GetTID() << " " << _key << "    " << delete_ret << endl;
-	//bool unlock_ret = array[_key].releaseExlusiveLock(txn);
-	ArrayUnlock();
+	//bool unlock_ret = Entry(_key).releaseExlusiveLock(txn);
 	return delete_ret;
 }
 
@@ -757,14 +1148,13 @@ IVArray::Rollback(unsigned _key, shared_ptr<Transaction> txn, bool has_read)
 bool
 IVArray::CleanDirtyKey(unsigned _key)
 {
-	ArraySharedLock();
-	if (_key >= CurEntryNum || !array[_key].isVersioned())
+	if (MmapBase != NULL)
+		return false;
+	if (_key >= CurEntryNum || !Entry(_key).isVersioned())
 	{
-		ArrayUnlock();
 		return false;
 	}
-	array[_key].CleanAllVersion();
-	ArrayUnlock();
+	Entry(_key).CleanAllVersion();
 	return true;
 
 }
\ No newline at end of file
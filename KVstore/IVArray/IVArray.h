@@ -25,52 +25,103 @@ private:
 	static const unsigned int SET_KEY_NUM = 1 << 10; // minimum initial keys num
 	static const unsigned int SET_KEY_INC = SET_KEY_NUM; // minimum keys num inc
 	static const unsigned int SEG_LEN = 1 << 8; 
+	// the entries are kept in segments that are never moved: segment 0 holds the
+	// first FirstSegLen keys and segment k the keys [FirstSegLen << (k - 1), FirstSegLen << k)
+	static const unsigned MAX_SEG_NUM = 32;
 	unsigned long long MAX_CACHE_SIZE;
+	// the cache is split into shards by key, each one has its own lock and
+	// CLOCK ring, all of them share MAX_CACHE_SIZE
+	static const unsigned CACHE_SHARD_NUM = 64;
+	static const char MMAP_MAGIC[8];
+
+	struct CacheShard
+	{
+		spinlock lock;
+		vector<unsigned> ring; // keys cached and not pinned
+		unsigned hand;
+		atomic<unsigned long long> hits;
+		atomic<unsigned long long> misses;
+		atomic<unsigned long long> evictions;
+	};
 
 private:
-	IVEntry* array;
-	IVEntry *cache_head;
-	int cache_tail_id;
+	IVEntry* segments[MAX_SEG_NUM];
+	unsigned SegNum;
+	unsigned FirstSegLen;
+	CacheShard* shards;
+	atomic<unsigned long long> CurCacheSize;
 	FILE* IVfile; // file that records index-store
 	string IVfile_name;
+	// "mmap" mode: the values laid out contiguously by WriteMmapFile() are mapped
+	// read-only, search returns pointers into the mapping with no cache, and
+	// updates are refused
+	string Mmap_name;
+	char *MmapBase;
+	size_t MmapLength;
+	const unsigned long long *MmapOffset;
+	const unsigned long long *MmapLen;
 	string filename;
 	string dir_path;
 	IVBlockManager *BM;
-	unsigned CurEntryNum; // how many entries are available
+	atomic<unsigned> CurEntryNum; // how many entries are available
 	bool CurEntryNumChange;
+	mutex EnlargeLock; // only taken to add segments
 
 	//Cache 
-	unsigned CurCacheSize;
+	//A hit takes no cache lock: it sets the reference bit of the entry and holds a
+	//reference(refCount) while reading the value. The shard lock is only taken to
+	//load, add or evict values, and eviction clears the cache flag before checking
+	//the references, so a value is never freed under a reader. An entry is never
+	//moved once allocated, so no lock is taken to find it while the array grows.
 	//map <unsigned, long> index_time_map;
 	//multimap <long, unsigned> time_index_map;
+	inline CacheShard& GetShard(unsigned _key) { return shards[_key % CACHE_SHARD_NUM]; }
+
+	inline IVEntry& Entry(unsigned _key) const
+	{
+		if (_key < FirstSegLen)
+			return segments[0][_key];
+		unsigned k = 32 - __builtin_clz(_key / FirstSegLen);
+		return segments[k][_key - (FirstSegLen << (k - 1))];
+	}
+	void AllocEntries(unsigned _num);
+	void FreeEntries();
+	bool Enlarge(unsigned _key);
+	void OpenArray(string _filename);
+	bool WriteMmapFile();
+	bool MapValues();
 
+	bool TryHit(unsigned _key, char *& _str, unsigned long & _len, bool _copy);
+	bool GetValue(unsigned _key, char *& _str, unsigned long & _len);
 	bool AddInCache(unsigned _key, char *_str, unsigned long _len);
-	bool SwapOut();
-	bool UpdateTime(unsigned _key, bool HasLock = false);
+	bool SwapOut(CacheShard& _shard);
+	bool SwapOutOthers(unsigned _key);
+	void RemoveFromClock(unsigned _key);
 
-	void RemoveFromLRUQueue(unsigned _key);
-	
-	//mutex CacheLock;
-	spinlock CacheLock;
-	Latch ArrayLock;
-	//spinrwlock ArrayLock;
-	inline void ArraySharedLock(){ ArrayLock.lockShared();}
-	inline void ArrayExclusiveLock(){ArrayLock.lockExclusive();};
-	inline void ArrayUnlock(){ArrayLock.unlock();}
-	//inline void ArrayUnlock(){ArrayLock.unlock(false);}
-	//inline void ArraySharedUnLock(){ArrayLock.unlock(false);}
-	//inline void ArrayExclusiveUnLock(){ArrayLock.unlock(true);}
+	void RemoveFromCache(unsigned _key);
+	void WaitForReaders(unsigned _key);
 public:
 	IVArray();
 	IVArray(string _dir_path, string _filename, string mode, unsigned long long buffer_size, unsigned _key_num = 0);
 	~IVArray();
 
 	bool search(unsigned _key, char *& _str, unsigned long & _len);
+	//zero-copy read: _str points to the cached value, which will not be swapped out
+	//or freed until releaseRef(_key) is called
+	//if _own is true after return, the value is not cached and _str must be freed by caller
+	bool searchRef(unsigned _key, char *& _str, unsigned long & _len, bool & _own);
+	void releaseRef(unsigned _key);
 	bool modify(unsigned _key, char *_str, unsigned long _len);
 	bool remove(unsigned _key);
 	bool insert(unsigned _key, char *_str, unsigned long _len);
 	bool save();
+	// rewrite the values of the closed array _dir_path/_filename in key order,
+	// each in adjacent blocks of _block_size bytes(0 keeps the current size),
+	// into the files of the same name in _new_dir_path, synced to disk
+	static bool Compact(string _dir_path, string _new_dir_path, string _filename, unsigned _block_size, ValueLayout &_before, ValueLayout &_after);
 	void PinCache(unsigned _key);
+	// counters of all shards since the array is opened
+	void getCacheStats(unsigned long long & _hits, unsigned long long & _misses, unsigned long long & _evictions) const;
 	
 	//MVCC
 	//read 
@@ -14,6 +14,8 @@ using namespace std;
 IVBlockManager::IVBlockManager()
 {
 	cur_block_num = 0;
+	block_size = DEFAULT_BLOCK_SIZE;
+	block_data_size = block_size - sizeof(unsigned int) - sizeof(unsigned long);
 
 	index_len_map.clear();
 	len_index_map.clear();
@@ -24,11 +26,43 @@ IVBlockManager::IVBlockManager()
 	BlockToWrite = NULL;
 }
 
-IVBlockManager::IVBlockManager(string& _filename, string& _mode, unsigned _keynum )
+IVBlockManager::IVBlockManager(string& _filename, string& _mode, unsigned _keynum, unsigned _block_size)
 {
 	//dir_path = _dir_path;
 	FreeBlockList_path = _filename + "_FreeBlockList";
 	ValueFile_path = _filename + "_ValueFile";
+	BlockSize_path = _filename + "_BlockSize";
+
+	block_size = DEFAULT_BLOCK_SIZE;
+	if (_mode == "build")
+	{
+		if (_block_size > 0)
+			block_size = _block_size;
+		// only a non-default size is recorded
+		if (block_size == DEFAULT_BLOCK_SIZE)
+			unlink(BlockSize_path.c_str());
+		else
+		{
+			FILE* fp = fopen(BlockSize_path.c_str(), "wb");
+			if (fp != NULL)
+			{
+				fwrite(&block_size, sizeof(unsigned), 1, fp);
+				Util::Csync(fp);
+				fclose(fp);
+			}
+		}
+	}
+	else
+	{
+		FILE* fp = fopen(BlockSize_path.c_str(), "rb");
+		if (fp != NULL)
+		{
+			if (fread(&block_size, sizeof(unsigned), 1, fp) != 1)
+				block_size = DEFAULT_BLOCK_SIZE;
+			fclose(fp);
+		}
+	}
+	block_data_size = block_size - sizeof(unsigned int) - sizeof(unsigned long);
 
 	if (_mode == "build")
 	{
@@ -120,6 +154,13 @@ IVBlockManager::SaveFreeBlockList()
 	//fwrite(&tmp, sizeof(unsigned), 1, FreeBlockList);
 }
 
+void
+IVBlockManager::Sync()
+{
+	fsync(fileno(ValueFile));
+	fsync(fileno(FreeBlockList));
+}
+
 bool
 IVBlockManager::ReadValue(unsigned _blk_index, char *&_str, unsigned long&_len)
 {
@@ -135,8 +176,8 @@ IVBlockManager::ReadValue(unsigned _blk_index, char *&_str, unsigned long&_len)
 	unsigned long Len_left; // how many bits left to read
 	int fd = fileno(ValueFile);
 
-	//fseek(ValueFile, (off_t)BLOCK_SIZE * (_blk_index - 1) + sizeof(unsigned), SEEK_SET);
-	off_t offset = (off_t)BLOCK_SIZE * (_blk_index - 1) + sizeof(unsigned);
+	//fseek(ValueFile, (off_t)block_size * (_blk_index - 1) + sizeof(unsigned), SEEK_SET);
+	off_t offset = (off_t)block_size * (_blk_index - 1) + sizeof(unsigned);
 	pread(fd, &Len_left, 1 * sizeof(unsigned long), offset);
 //	fread(&Len_left, sizeof(unsigned), 1, ValueFile);
 
@@ -153,11 +194,11 @@ IVBlockManager::ReadValue(unsigned _blk_index, char *&_str, unsigned long&_len)
 
 	do
 	{
-		unsigned long Bits2read = BLOCK_DATA_SIZE < Len_left ? BLOCK_DATA_SIZE : Len_left;
+		unsigned long Bits2read = block_data_size < Len_left ? block_data_size : Len_left;
 
-		offset = (off_t)BLOCK_SIZE * (next_blk - 1);
+		offset = (off_t)block_size * (next_blk - 1);
 		pread(fd, &next_blk, 1 * sizeof(unsigned), offset);
-//		fseek(ValueFile, (off_t)BLOCK_SIZE * (next_blk - 1), SEEK_SET);
+//		fseek(ValueFile, (off_t)block_size * (next_blk - 1), SEEK_SET);
 //		fread(&next_blk, sizeof(unsigned), 1, ValueFile);
 		offset += sizeof(unsigned) + sizeof(unsigned long);
 		pread(fd, _str + (_len - Len_left), Bits2read * sizeof(char), offset);
@@ -201,7 +242,7 @@ IVBlockManager::getWhereToWrite(unsigned long _len)
 {
 	// try to find suitable free blocks in current free block lists
 	// AllocNum is number of blocks which can fit in _len bits
-	unsigned int AllocNum = (unsigned int) ((_len + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE);
+	unsigned int AllocNum = (unsigned int) ((_len + block_data_size - 1) / block_data_size);
 
 	// map <unsigned, unsigned>::iterator it = len_index_map.upper_bound(AllocNum - 1);
 	indexlock.lock();
@@ -259,6 +300,7 @@ IVBlockManager::getWhereToWrite(unsigned long _len)
 unsigned
 IVBlockManager::WriteValue(const char *_str, const unsigned long _len)
 {
+	lock_guard<mutex> guard(writelock);
 	if (!getWhereToWrite(_len))
 	{
 		return false;
@@ -273,8 +315,8 @@ IVBlockManager::WriteValue(const char *_str, const unsigned long _len)
 	while (p != NULL)
 	{
 		BlockInfo *nextp = p->next;
-		unsigned long Bits2Write = BLOCK_DATA_SIZE < len_left ? BLOCK_DATA_SIZE:len_left;
-		off_t offset = (off_t)(BLOCK_SIZE) * (p->num - 1);
+		unsigned long Bits2Write = block_data_size < len_left ? block_data_size:len_left;
+		off_t offset = (off_t)(block_size) * (p->num - 1);
 		unsigned NextIndex = 0;
 		if (nextp != NULL)
 		{
@@ -314,17 +356,18 @@ IVBlockManager::FreeBlocks(const unsigned index)
 	unsigned _index = index;
 	unsigned next_index;
 	int fd = fileno(ValueFile);
+	// the run of adjacent blocks being freed
 	unsigned curlen = 1;
 	unsigned cur_index = index;
 	
 	indexlock.lock();
 	while (_index > 0)
 	{
-		off_t offset = (off_t)(_index - 1) * BLOCK_SIZE;
+		off_t offset = (off_t)(_index - 1) * block_size;
 
 		pread(fd, &next_index, 1 * sizeof(unsigned), offset);
 
-		if (next_index - index == 1) // continuous
+		if (next_index == _index + 1) // continuous
 		{
 			curlen++;
 		}
@@ -341,8 +384,8 @@ IVBlockManager::FreeBlocks(const unsigned index)
 				{
 					cur_index = it->first;
 					curlen += it->second;
-					index_len_map.erase(it);
 					len_index_map.erase(make_pair(it->second,it->first));
+					index_len_map.erase(it);
 				}
 			}
 
@@ -352,17 +395,15 @@ IVBlockManager::FreeBlocks(const unsigned index)
 				if (curlen + cur_index == it->first) // block after is free
 				{
 					curlen += it->second;
-					auto tmp_key = it->second, tmp_val = it->first;
+					len_index_map.erase(make_pair(it->second,it->first));
 					index_len_map.erase(it);
-					//len_index_map.erase(make_pair(it->second,it->first));
-					len_index_map.erase(make_pair(tmp_key,tmp_val));
 				}
 			}
 
 			index_len_map.insert(make_pair(cur_index, curlen));
 			len_index_map.insert(make_pair(curlen, cur_index));
 			
-			curlen = 0;
+			curlen = 1;
 			cur_index = next_index;
 		}
 		_index = next_index;
@@ -390,4 +431,46 @@ IVBlockManager::~IVBlockManager()
 	fclose(ValueFile);
 }
 
+unsigned long long
+IVBlockManager::BlocksOf(unsigned long _len, unsigned _block_size)
+{
+	unsigned long long data_size = _block_size - sizeof(unsigned int) - sizeof(unsigned long);
+	unsigned long long n = (_len + data_size - 1) / data_size;
+	return n > 0 ? n : 1;
+}
 
+bool
+IVBlockManager::GetChain(unsigned _blk_index, unsigned long &_len, unsigned &_blocks, unsigned &_runs)
+{
+	_len = 0;
+	_blocks = _runs = 0;
+	if (_blk_index == 0)
+		return false;
+	int fd = fileno(ValueFile);
+	pread(fd, &_len, 1 * sizeof(unsigned long), (off_t)block_size * (_blk_index - 1) + sizeof(unsigned));
+	unsigned cur = _blk_index;
+	while (cur > 0)
+	{
+		unsigned next = 0;
+		pread(fd, &next, 1 * sizeof(unsigned), (off_t)block_size * (cur - 1));
+		_blocks++;
+		if (next != cur + 1)
+			_runs++;
+		// a broken chain
+		if (_blocks > cur_block_num)
+			return false;
+		cur = next;
+	}
+	return true;
+}
+
+void
+IVBlockManager::GetFreeInfo(ValueLayout &_layout)
+{
+	_layout.block_size = block_size;
+	_layout.file_blocks = cur_block_num;
+	_layout.free_blocks = 0;
+	_layout.free_extents = index_len_map.size();
+	for (map<unsigned, unsigned>::iterator it = index_len_map.begin(); it != index_len_map.end(); ++it)
+		_layout.free_blocks += it->second;
+}
@@ -25,10 +25,9 @@ using namespace std;
 class IVBlockManager
 {
 private:
-	// size of block, 4K, unit is byte
-	static const unsigned BLOCK_SIZE = 1 << 8;//1 << 12;
-	// size of data stored in block, unit is byte
-	static const unsigned BLOCK_DATA_SIZE = BLOCK_SIZE -  sizeof(unsigned int)- sizeof(unsigned long);
+	// default size of block, unit is byte, gcompact can rewrite a store with
+	// another size which is then kept in <filename>_BlockSize
+	static const unsigned DEFAULT_BLOCK_SIZE = 1 << 8;//1 << 12;
 	// minimum initial blocks
 	static const unsigned SET_BLOCK_NUM = 1 << 8;
 	// minimum blocks-num inc
@@ -46,6 +45,7 @@ private:
 	//string dir_path;
 	string FreeBlockList_path;
 	string ValueFile_path;
+	string BlockSize_path;
 	// File record which block is free
 	FILE* FreeBlockList;
 	// File record value lists
@@ -54,15 +54,21 @@ private:
 	BlockInfo* BlockToWrite;
 
 	unsigned cur_block_num;
+	// size of block and of data stored in block, unit is byte
+	unsigned block_size;
+	unsigned block_data_size;
 
 	bool AllocBlock(unsigned len);
 	
 	bool getWhereToWrite(unsigned long _len);
 	
 	mutex indexlock;
+	// BlockToWrite is shared, so one value is written at a time
+	mutex writelock;
 public:
 	IVBlockManager();
-	IVBlockManager(string& _filename, string &_mode, unsigned _keynum = 0);
+	// _block_size is used when building, 0 means DEFAULT_BLOCK_SIZE
+	IVBlockManager(string& _filename, string &_mode, unsigned _keynum = 0, unsigned _block_size = 0);
 	~IVBlockManager();
 
 	unsigned WriteValue(const char *_str, const unsigned long _len);
@@ -70,6 +76,16 @@ public:
 	bool ReadValue(unsigned _blk_index, char *&_str, unsigned long &_len);
 
 	void SaveFreeBlockList();
+	// flush the value file and the free block list to disk
+	void Sync();
 
 	bool FreeBlocks(const unsigned index);
+
+	unsigned getBlockSize() const { return block_size; }
+	// blocks of _block_size bytes needed by a value of _len bytes
+	static unsigned long long BlocksOf(unsigned long _len, unsigned _block_size);
+	// walk the blocks of a value, _runs counts the runs of adjacent blocks
+	bool GetChain(unsigned _blk_index, unsigned long &_len, unsigned &_blocks, unsigned &_runs);
+	// fill block_size, file_blocks, free_blocks and free_extents
+	void GetFreeInfo(ValueLayout &_layout);
 };
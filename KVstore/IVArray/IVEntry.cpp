@@ -19,7 +19,9 @@ IVEntry::IVEntry()
 	dirtyFlag = true;
 	cacheFlag = false;
 	CachePinFlag = false;
-	prevID = nextID = -1;
+	clockPos = -1;
+	refBit.store(false);
+	refCount.store(0);
 	shared_ptr<Version> p = make_shared<Version>(0, INVALID_ID);
 	vList.push_back(p); //dummy version [0, INF)
 	clearVersionFlag();
@@ -137,54 +139,72 @@ IVEntry::release()
 		delete value;
 	}
 	value = NULL;
-	nextID = prevID = -1;
+	clockPos = -1;
 	//if(is_versioned.load())
 	//{
 		//cout << "error: versions has not been merged!" << endl;
 	//}
 }
 
+//NOTICE: the cached value is moved rather than copied, so that the pointers
+//handed out by IVArray::searchRef stay valid when the array is enlarged
 void
-IVEntry::Copy(const IVEntry& _entry)
+IVEntry::Copy(IVEntry& _entry)
 {
 	this->store = _entry.store;
-	this->cacheFlag = _entry.cacheFlag;
+	this->cacheFlag.store(_entry.cacheFlag.load());
 	this->dirtyFlag = _entry.dirtyFlag;
 	this->usedFlag = _entry.usedFlag;
-	if (_entry.value != NULL)
-	{
-		this->value = new Bstr();
-		value->copy(_entry.value);
-	}
-	this->prevID = _entry.prevID;
-	this->nextID = _entry.nextID;
+	this->value = _entry.value;
+	_entry.value = NULL;
+	this->refCount.store(_entry.refCount.load());
+	this->clockPos = _entry.clockPos;
+	this->refBit.store(_entry.refBit.load());
 	this->vList = move(_entry.vList);
 	this->glatch = _entry.glatch;
 	this->is_versioned.store(_entry.is_versioned.load());
 }
 
 void
-IVEntry::setPrev(int ID)
+IVEntry::setClockPos(int _pos)
 {
-	prevID = ID;
+	clockPos = _pos;
 }
 
 int
-IVEntry::getPrev() const
+IVEntry::getClockPos() const
 {
-	return prevID;
+	return clockPos;
 }
 
 void
-IVEntry::setNext(int ID)
+IVEntry::setRefBit(bool _flag)
 {
-	nextID = ID;
+	refBit.store(_flag, memory_order_relaxed);
 }
 
-int
-IVEntry::getNext() const
+bool
+IVEntry::getRefBit() const
+{
+	return refBit.load(memory_order_relaxed);
+}
+
+void
+IVEntry::addRef()
+{
+	refCount.fetch_add(1);
+}
+
+void
+IVEntry::subRef()
+{
+	refCount.fetch_sub(1);
+}
+
+unsigned
+IVEntry::getRefCount() const
 {
-	return nextID;
+	return refCount.load();
 }
 
 IVEntry::~IVEntry()
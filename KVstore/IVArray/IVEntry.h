@@ -19,14 +19,18 @@ class IVEntry
 private:
 	bool usedFlag;   // mark if the entry is used
 	bool dirtyFlag;
-	bool cacheFlag;
+	// read without lock by cache hits(see IVArray::TryHit)
+	atomic<bool> cacheFlag;
 	bool CachePinFlag;
 	unsigned store;  //index of block where value is stored
-	// pointer to id for LRU list
-	int prevID;
-	int nextID;
+	// position in the CLOCK ring of its cache shard, -1 if not in the ring
+	int clockPos;
+	// CLOCK reference bit, set by hits and cleared by the clock hand
+	atomic<bool> refBit;
 	
 	Bstr* value;
+	// number of readers holding a reference to value(see IVArray::searchRef)
+	atomic<unsigned> refCount;
 	
 	GLatch glatch;
 	//MVCC
@@ -60,12 +64,16 @@ public:
 
 	void release();
 
-	void Copy(const IVEntry& _entry);
+	void Copy(IVEntry& _entry);
 
-	void setPrev(int ID);
-	int getPrev() const;
-	void setNext(int ID);
-	int getNext() const;
+	void addRef();
+	void subRef();
+	unsigned getRefCount() const;
+
+	void setClockPos(int _pos);
+	int getClockPos() const;
+	void setRefBit(bool _flag);
+	bool getRefBit() const;
 	
 	
 	
@@ -10,6 +10,34 @@
 
 using namespace std;
 
+IDListView::IDListView()
+{
+	this->array = NULL;
+	this->key = 0;
+	this->owned = NULL;
+	this->list = NULL;
+	this->len = 0;
+}
+
+IDListView::~IDListView()
+{
+	this->release();
+}
+
+void
+IDListView::release()
+{
+	if (this->array != NULL)
+	{
+		this->array->releaseRef(this->key);
+		this->array = NULL;
+	}
+	delete[] this->owned;
+	this->owned = NULL;
+	this->list = NULL;
+	this->len = 0;
+}
+
 //sets store_path as the root dir of this KVstore
 //initial all Tree pointers as NULL
 KVstore::KVstore(string _store_path) 
@@ -32,6 +60,8 @@ KVstore::KVstore(string _store_path)
 	this->preID2values = NULL;
 	this->objID2values = NULL;
 	this->objID2values_literal = NULL;
+
+	this->value_format = KVstore::VALUE_FORMAT_RAW;
 }
 
 //Release all the memory used in this KVstore before destruction
@@ -164,6 +194,18 @@ KVstore::set_if_single_thread(bool _single)
   this->literal2id->SetSingleThread(_single);
 }
 
+void
+KVstore::set_value_format(int _format)
+{
+	this->value_format = _format;
+}
+
+int
+KVstore::get_value_format() const
+{
+	return this->value_format;
+}
+
 string 
 KVstore::getStringByID(TYPE_ENTITY_LITERAL_ID _id)
 {
@@ -2732,6 +2774,11 @@ KVstore::open_subID2values(int _mode, TYPE_ENTITY_LITERAL_ID _entity_num)
 	{
 		buffer_size = Util::MAX_BUFFER_SIZE * buffer_sID2values_query;
 	}
+	else if (_mode == KVstore::READ_ONLY_MODE) 
+	{
+		//no cache, values are read from the mapping
+		buffer_size = 0;
+	}
 	else 
 	{
 		cerr << "Invalid open mode in open_subID2values, mode = " << _mode << endl;
@@ -2761,7 +2808,14 @@ KVstore::close_subID2values()
 //p1-list(in offset1) p2-list(in offset2) ... pn-list(in offsetn)
 //(the final whole list is a unsorted olist)
 bool 
-KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num) 
+KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num)
+{
+	IDTupleArrayReader reader(_p_id_tuples, _triples_num);
+	return this->build_subID2values(reader, total_entity_num);
+}
+
+bool 
+KVstore::build_subID2values(IDTupleReader& _reader, TYPE_ENTITY_LITERAL_ID total_entity_num) 
 {
 	cout << "Begin building subID2values..." << endl;
 	//qsort(_p_id_tuples, _triples_num, sizeof(int*), Util::_spo_cmp);
@@ -2782,10 +2836,12 @@ KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 
 	//NOTICE: i*3 + j maybe break the unsigned limit
 	//for (unsigned long i = 0; i < _triples_num; i++) 
-	for (TYPE_TRIPLE_NUM i = 0; i < _triples_num; i++) 
+	ID_TUPLE cur, nxt;
+	bool has_cur = _reader.next(cur);
+	while (has_cur) 
 	{
-		if (i + 1 == _triples_num || _p_id_tuples[i].subid != _p_id_tuples[i+1].subid
-			|| _p_id_tuples[i].preid != _p_id_tuples[i+1].preid || _p_id_tuples[i].objid != _p_id_tuples[i+1].objid) 
+		bool has_next = _reader.next(nxt);
+		if (!has_next || !Util::equal(cur, nxt))
 		{
 			if (_sub_change) 
 			{
@@ -2794,9 +2850,9 @@ KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 				_entity_num = 0;
 			}
 
-			TYPE_ENTITY_LITERAL_ID _sub_id = _p_id_tuples[i].subid;
-			TYPE_PREDICATE_ID _pre_id = _p_id_tuples[i].preid;
-			TYPE_ENTITY_LITERAL_ID _obj_id = _p_id_tuples[i].objid;
+			TYPE_ENTITY_LITERAL_ID _sub_id = cur.subid;
+			TYPE_PREDICATE_ID _pre_id = cur.preid;
+			TYPE_ENTITY_LITERAL_ID _obj_id = cur.objid;
 
 			if (_sub_pre_change) 
 			{
@@ -2810,8 +2866,8 @@ KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 				_entity_num++;
 			}
 
-			_sub_change = (i + 1 == _triples_num) || (_p_id_tuples[i].subid != _p_id_tuples[i+1].subid);
-			_pre_change = (i + 1 == _triples_num) || (_p_id_tuples[i].preid != _p_id_tuples[i+1].preid);
+			_sub_change = !has_next || (cur.subid != nxt.subid);
+			_pre_change = !has_next || (cur.preid != nxt.preid);
 			_sub_pre_change = _sub_change || _pre_change;
 
 			if (_sub_change) 
@@ -2839,10 +2895,14 @@ KVstore::build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 					_entrylist_s[j] = _oidlist_s[k];
 				}
 
-				this->addValueByKey(this->subID2values, _sub_id, (char*)_entrylist_s, sizeof(unsigned) * j);
+				unsigned long _vlen = sizeof(unsigned) * j;
+				_entrylist_s = this->compressValue(this->subID2values, _entrylist_s, _vlen);
+				this->addValueByKey(this->subID2values, _sub_id, (char*)_entrylist_s, _vlen);
 				//delete[] _entrylist_s;
 			}
 		}
+		cur = nxt;
+		has_cur = has_next;
 	}
 
 	this->close_subID2values();
@@ -3083,40 +3143,15 @@ KVstore::getobjIDlistBysubIDpreID(TYPE_ENTITY_LITERAL_ID _subid, TYPE_PREDICATE_
 	unsigned long _len = 0;
 	if(txn == nullptr)
 	{
-		bool _get = this->getValueByKey(this->subID2values, _subid, (char*&)_tmp, _len);
-		if (!_get) {
+		IDListView _view;
+		if (!this->getobjIDlistBysubIDpreID(_subid, _preid, _view)) {
 			_objidlist = NULL;
 			_list_len = 0;
 			return false;
 		}
-		//cout<<"check "<<_subid<<" "<<_preid<<endl;
-		unsigned _result = KVstore::binarySearch(_preid, _tmp + 3, _tmp[1], 2);
-		//if (_result == -1) 
-		if (_result == INVALID) 
-		{
-			_objidlist = NULL;
-			_list_len = 0;
-			return false;
-		}
-		unsigned _offset = _tmp[4 + 2 * _result];
-		unsigned _offset_next;
-		if (_result == _tmp[1] - 1) {
-			_offset_next = 3 + 2 * _tmp[1] + _tmp[0];
-		}
-		else {
-			_offset_next = _tmp[6 + 2 * _result];
-		}
-		_list_len = _offset_next - _offset;
+		_list_len = _view.getLen();
 		_objidlist = new unsigned[_list_len];
-		memcpy(_objidlist, _tmp + _offset, sizeof(unsigned) * _list_len);
-
-		//if this is a long list, then we should remove itself after copying
-		//otherwise, we should not free the list memory
-	//	if(VList::listNeedDelete(_len))
-	//	{
-			delete[] _tmp;
-			//_tmp = NULL;
-	//	}
+		memcpy(_objidlist, _view.getList(), sizeof(unsigned) * _list_len);
 
 		return true;
 	}
@@ -3206,6 +3241,34 @@ KVstore::getobjIDlistBysubIDpreID(TYPE_ENTITY_LITERAL_ID _subid, TYPE_PREDICATE_
 	}
 }
 
+bool
+KVstore::getobjIDlistBysubIDpreID(TYPE_ENTITY_LITERAL_ID _subid, TYPE_PREDICATE_ID _preid, IDListView& _view, shared_ptr<Transaction> txn) const
+{
+	_view.release();
+	if (!Util::is_entity_ele(_subid)) {
+		return false;
+	}
+	//MVCC reads merge the versions into a new value, so there is nothing to reference
+	if (txn != nullptr)
+	{
+		unsigned* _list = NULL;
+		unsigned _list_len = 0;
+		if (!this->getobjIDlistBysubIDpreID(_subid, _preid, _list, _list_len, false, txn))
+			return false;
+		_view.owned = _list;
+		_view.list = _list;
+		_view.len = _list_len;
+		return true;
+	}
+
+	unsigned* _tmp = NULL;
+	unsigned long _len = 0;
+	if (!this->getValueRefByKey(this->subID2values, _subid, (char*&)_tmp, _len, _view)) {
+		return false;
+	}
+	return KVstore::setViewByPreID(_tmp, 3, _preid, _view);
+}
+
 bool 
 KVstore::getpreIDobjIDlistBysubID(TYPE_ENTITY_LITERAL_ID _subid, unsigned*& _preid_objidlist, unsigned& _list_len, bool _no_duplicate, shared_ptr<Transaction> txn) const 
 {
@@ -3349,6 +3412,11 @@ KVstore::open_objID2values(int _mode, TYPE_ENTITY_LITERAL_ID _entity_num, TYPE_E
 	{
 		buffer_size = Util::MAX_BUFFER_SIZE * buffer_oID2values_query;
 	}
+	else if (_mode == KVstore::READ_ONLY_MODE) 
+	{
+		//no cache, values are read from the mapping
+		buffer_size = 0;
+	}
 	else 
 	{
 		cerr << "Invalid open mode in open_objID2values, mode = " << _mode << endl;
@@ -3388,7 +3456,14 @@ KVstore::close_objID2values()
 //p1-list(in offset1) p2-list(in offset2) ... pn-list(in offsetn)
 //(the final whole list is a unsorted slist)
 bool 
-KVstore::build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num, TYPE_ENTITY_LITERAL_ID total_literal_num) 
+KVstore::build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num, TYPE_ENTITY_LITERAL_ID total_literal_num)
+{
+	IDTupleArrayReader reader(_p_id_tuples, _triples_num);
+	return this->build_objID2values(reader, total_entity_num, total_literal_num);
+}
+
+bool 
+KVstore::build_objID2values(IDTupleReader& _reader, TYPE_ENTITY_LITERAL_ID total_entity_num, TYPE_ENTITY_LITERAL_ID total_literal_num) 
 {
 	cout << "Begin building objID2values..." << endl;
 	//qsort(_p_id_tuples, _triples_num, sizeof(int*), Util::_ops_cmp);
@@ -3405,18 +3480,20 @@ KVstore::build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 	this->open_objID2values(KVstore::CREATE_MODE, total_entity_num, total_literal_num);
 
 	//for (unsigned long i = 0; i < _triples_num; i++) 
-	for (TYPE_TRIPLE_NUM i = 0; i < _triples_num; i++) 
+	ID_TUPLE cur, nxt;
+	bool has_cur = _reader.next(cur);
+	while (has_cur) 
 	{
-		if (i + 1 == _triples_num || _p_id_tuples[i].subid != _p_id_tuples[i+1].subid
-			|| _p_id_tuples[i].preid != _p_id_tuples[i+1].preid || _p_id_tuples[i].objid != _p_id_tuples[i+1].objid) {
+		bool has_next = _reader.next(nxt);
+		if (!has_next || !Util::equal(cur, nxt)) {
 			if (_obj_change) {
 				_pidoffsetlist_o.clear();
 				_sidlist_o.clear();
 			}
 
-			TYPE_ENTITY_LITERAL_ID _sub_id = _p_id_tuples[i].subid;
-			TYPE_PREDICATE_ID _pre_id = _p_id_tuples[i].preid;
-			TYPE_ENTITY_LITERAL_ID _obj_id = _p_id_tuples[i].objid;
+			TYPE_ENTITY_LITERAL_ID _sub_id = cur.subid;
+			TYPE_PREDICATE_ID _pre_id = cur.preid;
+			TYPE_ENTITY_LITERAL_ID _obj_id = cur.objid;
 
 			if (_obj_pre_change) {
 				_pidoffsetlist_o.push_back(_pre_id);
@@ -3425,8 +3502,8 @@ KVstore::build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 
 			_sidlist_o.push_back(_sub_id);
 
-			_obj_change = (i + 1 == _triples_num) || (_p_id_tuples[i].objid != _p_id_tuples[i+1].objid);
-			_pre_change = (i + 1 == _triples_num) || (_p_id_tuples[i].preid != _p_id_tuples[i+1].preid);
+			_obj_change = !has_next || (cur.objid != nxt.objid);
+			_pre_change = !has_next || (cur.preid != nxt.preid);
 			_obj_pre_change = _obj_change || _pre_change;
 
 			if (_obj_change) {
@@ -3448,11 +3525,15 @@ KVstore::build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 					_entrylist_o[j] = _sidlist_o[k];
 				}
 				
-				this->addValueByKey(this->objID2values, _obj_id, (char*)_entrylist_o, sizeof(unsigned) * j);
+				unsigned long _vlen = sizeof(unsigned) * j;
+				_entrylist_o = this->compressValue(this->objID2values, _entrylist_o, _vlen);
+				this->addValueByKey(this->objID2values, _obj_id, (char*)_entrylist_o, _vlen);
 				
 				//delete[] _entrylist_o;
 			}
 		}
+		cur = nxt;
+		has_cur = has_next;
 	}
 	this->close_objID2values();
 	cout << "Finished building objID2values" << endl;
@@ -3686,38 +3767,16 @@ KVstore::getsubIDlistByobjIDpreID(TYPE_ENTITY_LITERAL_ID _objid, TYPE_PREDICATE_
 	unsigned long _len = 0;
 	if(txn == nullptr)
 	{
-		bool _get = this->getValueByKey(this->objID2values, _objid, (char*&)_tmp, _len);
-		if (!_get) {
+		IDListView _view;
+		if (!this->getsubIDlistByobjIDpreID(_objid, _preid, _view)) {
 			_subidlist = NULL;
 			_list_len = 0;
 			return false;
 		}
-		unsigned _result = KVstore::binarySearch(_preid, _tmp + 2, _tmp[1], 2);
-		//if (_result == -1) 
-		if (_result == INVALID) 
-		{
-			_subidlist = NULL;
-			_list_len = 0;
-			delete[] _tmp;
-			return false;
-		}
-		unsigned _offset = _tmp[3 + 2 * _result];
-		unsigned _offset_next;
-
-		if (_result == _tmp[1] - 1) {
-			_offset_next = 2 + 2 * _tmp[1] + _tmp[0];
-		}
-		else {
-			_offset_next = _tmp[5 + 2 * _result];
-		}
-		_list_len = _offset_next - _offset;
+		_list_len = _view.getLen();
 		_subidlist = new unsigned[_list_len];
-		memcpy(_subidlist, _tmp + _offset, sizeof(unsigned) * _list_len);
+		memcpy(_subidlist, _view.getList(), sizeof(unsigned) * _list_len);
 
-		//if this is a long list, then we should remove itself after copying
-		//otherwise, we should not free the list memory
-		delete[] _tmp;
-			//_tmp = NULL;
 		return true;
 	}
 	else
@@ -3819,6 +3878,34 @@ KVstore::getsubIDlistByobjIDpreID(TYPE_ENTITY_LITERAL_ID _objid, TYPE_PREDICATE_
 	}
 }
 
+bool
+KVstore::getsubIDlistByobjIDpreID(TYPE_ENTITY_LITERAL_ID _objid, TYPE_PREDICATE_ID _preid, IDListView& _view, shared_ptr<Transaction> txn) const
+{
+	_view.release();
+	if(_objid == INVALID_ENTITY_LITERAL_ID) {
+		return false;
+	}
+	//MVCC reads merge the versions into a new value, so there is nothing to reference
+	if (txn != nullptr)
+	{
+		unsigned* _list = NULL;
+		unsigned _list_len = 0;
+		if (!this->getsubIDlistByobjIDpreID(_objid, _preid, _list, _list_len, false, txn))
+			return false;
+		_view.owned = _list;
+		_view.list = _list;
+		_view.len = _list_len;
+		return true;
+	}
+
+	unsigned* _tmp = NULL;
+	unsigned long _len = 0;
+	if (!this->getValueRefByKey(this->objID2values, _objid, (char*&)_tmp, _len, _view)) {
+		return false;
+	}
+	return KVstore::setViewByPreID(_tmp, 2, _preid, _view);
+}
+
 bool 
 KVstore::getpreIDsubIDlistByobjID(TYPE_ENTITY_LITERAL_ID _objid, unsigned*& _preid_subidlist, unsigned& _list_len, bool _no_duplicate, shared_ptr<Transaction> txn) const 
 {
@@ -3953,6 +4040,10 @@ KVstore::open_preID2values(int _mode, TYPE_PREDICATE_ID _pre_num)
 	else if (_mode == KVstore::READ_WRITE_MODE) {
 		buffer_size = Util::MAX_BUFFER_SIZE * buffer_pID2values_query;
 	}
+	else if (_mode == KVstore::READ_ONLY_MODE) {
+		//no cache, values are read from the mapping
+		buffer_size = 0;
+	}
 	else {
 		cerr << "Invalid open mode in open_preID2values, mode = " << _mode << endl;
 		return false;
@@ -3975,7 +4066,14 @@ KVstore::close_preID2values()
 }
 
 bool 
-KVstore::build_preID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_PREDICATE_ID total_pre_num) 
+KVstore::build_preID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_PREDICATE_ID total_pre_num)
+{
+	IDTupleArrayReader reader(_p_id_tuples, _triples_num);
+	return this->build_preID2values(reader, total_pre_num);
+}
+
+bool 
+KVstore::build_preID2values(IDTupleReader& _reader, TYPE_PREDICATE_ID total_pre_num) 
 //NOTICE: if we sort sidlist, then oidlist is not sorted; otherwise if we sort oidlist, then sidlist is not sorted
 //STRUCT of p2xx: triple_number sidlist oidlist(not sorted, linked with sidlist one by one)
 {
@@ -3990,23 +4088,25 @@ KVstore::build_preID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 	this->open_preID2values(KVstore::CREATE_MODE, total_pre_num);
 
 	//for (unsigned long i = 0; i < _triples_num; i++) 
-	for (TYPE_TRIPLE_NUM i = 0; i < _triples_num; i++) 
+	ID_TUPLE cur, nxt;
+	bool has_cur = _reader.next(cur);
+	while (has_cur) 
 	{
-		if (i + 1 == _triples_num || _p_id_tuples[i].subid != _p_id_tuples[i+1].subid
-			|| _p_id_tuples[i].preid != _p_id_tuples[i+1].preid || _p_id_tuples[i].objid != _p_id_tuples[i+1].objid) {
+		bool has_next = _reader.next(nxt);
+		if (!has_next || !Util::equal(cur, nxt)) {
 			if (_pre_change) {
 				_sidlist_p.clear();
 				_oidlist_p.clear();
 			}
 
-			TYPE_ENTITY_LITERAL_ID _sub_id = _p_id_tuples[i].subid;
-			TYPE_PREDICATE_ID _pre_id = _p_id_tuples[i].preid;
-			TYPE_ENTITY_LITERAL_ID _obj_id = _p_id_tuples[i].objid;
+			TYPE_ENTITY_LITERAL_ID _sub_id = cur.subid;
+			TYPE_PREDICATE_ID _pre_id = cur.preid;
+			TYPE_ENTITY_LITERAL_ID _obj_id = cur.objid;
 
 			_sidlist_p.push_back(_sub_id);
 			_oidlist_p.push_back(_obj_id);
 
-			_pre_change = (i + 1 == _triples_num) || (_p_id_tuples[i].preid != _p_id_tuples[i+1].preid);
+			_pre_change = !has_next || (cur.preid != nxt.preid);
 
 			if (_pre_change) {
 				unsigned* _entrylist_p = new unsigned[1 + _sidlist_p.size() * 2];
@@ -4021,10 +4121,14 @@ KVstore::build_preID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num
 				for (k = 0; k < _oidlist_p.size(); j++, k++) {
 					_entrylist_p[j] = _oidlist_p[k];
 				}
-				this->addValueByKey(this->preID2values, _pre_id, (char*)_entrylist_p, sizeof(unsigned) * j);
+				unsigned long _vlen = sizeof(unsigned) * j;
+				_entrylist_p = this->compressValue(this->preID2values, _entrylist_p, _vlen);
+				this->addValueByKey(this->preID2values, _pre_id, (char*)_entrylist_p, _vlen);
 				//delete[] _entrylist_p;
 			}
 		}
+		cur = nxt;
+		has_cur = has_next;
 	}
 
 	this->close_preID2values();
@@ -4683,6 +4787,10 @@ KVstore::open(IVArray*& _array, string _name, int _mode, unsigned long long _buf
 	{
 		smode = "open";
 	}
+	else if (_mode == KVstore::READ_ONLY_MODE)
+	{
+		smode = "mmap";
+	}
 	else
 	{
 		cerr << "Invalid open mode of: " << _name << " mode = " << _mode << endl;
@@ -4853,12 +4961,208 @@ KVstore::getValueByKey(IVTree* _p_btree, unsigned _key, char*& _val, unsigned& _
 bool
 KVstore::getValueByKey(IVArray* _array, unsigned _key, char*& _val, unsigned long & _vlen) const
 {
+	bool ret;
 	if (Util::is_literal_ele(_key) && _array == objID2values)
 	{
 		unsigned key = _key - Util::LITERAL_FIRST_ID;
-		return objID2values_literal->search(key, _val, _vlen);
+		ret = objID2values_literal->search(key, _val, _vlen);
 	}
-	return _array->search(_key, _val, _vlen);
+	else
+		ret = _array->search(_key, _val, _vlen);
+
+	//callers work on the raw STRUCT, restore it if compressed
+	if (ret && KVstore::isCompressedValue((unsigned*)_val, _vlen))
+	{
+		unsigned* raw = this->decompressValue(_array, (unsigned*)_val, _vlen);
+		delete[] _val;
+		_val = (char*)raw;
+	}
+	return ret;
+}
+
+bool
+KVstore::getValueRefByKey(IVArray* _array, unsigned _key, char*& _val, unsigned long & _vlen, IDListView& _view) const
+{
+	if (Util::is_literal_ele(_key) && _array == objID2values)
+	{
+		_array = objID2values_literal;
+		_key = _key - Util::LITERAL_FIRST_ID;
+	}
+	bool own = false;
+	if (!_array->searchRef(_key, _val, _vlen, own))
+		return false;
+	if (own)
+	{
+		_view.owned = (unsigned*)_val;
+	}
+	else
+	{
+		_view.array = _array;
+		_view.key = _key;
+	}
+	return true;
+}
+
+//STRUCT of s2xx/o2xx: _head_len words(triple num, pre num ...), then (pre, offset) pairs and the lists
+bool
+KVstore::setViewByPreID(const unsigned* _val, unsigned _head_len, TYPE_PREDICATE_ID _preid, IDListView& _view)
+{
+	unsigned _pre_num = _val[1];
+	unsigned _result = KVstore::binarySearch(_preid, _val + _head_len, _pre_num, 2);
+	if (_result == INVALID) 
+	{
+		_view.release();
+		return false;
+	}
+	unsigned _offset = _val[_head_len + 1 + 2 * _result];
+	if (_val[0] & KVstore::COMPRESSED_FLAG)
+	{
+		//decode the run only, and drop the reference to the compressed value
+		const unsigned* _run = _val + _offset;
+		unsigned _list_len = IDListCodec::decodedLen(_run);
+		unsigned* _list = new unsigned[_list_len];
+		IDListCodec::decode(_run, _list);
+		_view.release();
+		_view.owned = _list;
+		_view.list = _list;
+		_view.len = _list_len;
+		return true;
+	}
+
+	unsigned _offset_next;
+	if (_result == _pre_num - 1) {
+		_offset_next = _head_len + 2 * _pre_num + _val[0];
+	}
+	else {
+		_offset_next = _val[_head_len + 3 + 2 * _result];
+	}
+	_view.list = _val + _offset;
+	_view.len = _offset_next - _offset;
+	return true;
+}
+
+bool
+KVstore::isCompressedValue(const unsigned* _val, unsigned long _vlen)
+{
+	return _val != NULL && _vlen >= sizeof(unsigned) && (_val[0] & KVstore::COMPRESSED_FLAG);
+}
+
+//0 means the p2xx STRUCT
+unsigned
+KVstore::headLen(IVArray* _array) const
+{
+	if (_array == this->subID2values)
+		return 3;
+	if (_array == this->objID2values || _array == this->objID2values_literal)
+		return 2;
+	return 0;
+}
+
+//return the value to store, _val is freed if it is replaced by a compressed one
+unsigned*
+KVstore::compressValue(IVArray* _array, unsigned* _val, unsigned long& _vlen) const
+{
+	if (this->value_format != KVstore::VALUE_FORMAT_COMPRESSED)
+		return _val;
+	unsigned long _words = _vlen / sizeof(unsigned);
+	unsigned _triple_num = _val[0];
+	if (_triple_num & KVstore::COMPRESSED_FLAG)
+		return _val;
+
+	unsigned _head_len = this->headLen(_array);
+	//encode() may use up to maxEncodedLen() words before falling back to raw
+	unsigned long _cap;
+	if (_head_len == 0)
+		_cap = 1 + 2 * (unsigned long)IDListCodec::maxEncodedLen(_triple_num);
+	else
+		_cap = _words + _words / IDListCodec::BLOCK_LEN + 3 * (unsigned long)_val[1];
+	unsigned* _ret = new unsigned[_cap];
+	unsigned long _pos;
+	if (_head_len == 0)
+	{
+		_ret[0] = _triple_num;
+		_pos = 1;
+		unsigned _run_len = IDListCodec::encode(_val + 1, _triple_num, true, _ret + _pos);
+		if (_run_len == 0)
+		{
+			delete[] _ret;
+			return _val;
+		}
+		_pos += _run_len;
+		_run_len = IDListCodec::encode(_val + 1 + _triple_num, _triple_num, false, _ret + _pos);
+		if (_run_len == 0)
+		{
+			delete[] _ret;
+			return _val;
+		}
+		_pos += _run_len;
+	}
+	else
+	{
+		unsigned _pre_num = _val[1];
+		memcpy(_ret, _val, sizeof(unsigned) * (_head_len + 2 * _pre_num));
+		_pos = _head_len + 2 * _pre_num;
+		for (unsigned i = 0; i < _pre_num; ++i)
+		{
+			unsigned _offset = _val[_head_len + 1 + 2 * i];
+			unsigned _offset_next = (i + 1 == _pre_num) ? (unsigned)_words : _val[_head_len + 3 + 2 * i];
+			_ret[_head_len + 1 + 2 * i] = _pos;
+			unsigned _run_len = IDListCodec::encode(_val + _offset, _offset_next - _offset, true, _ret + _pos);
+			if (_run_len == 0)
+			{
+				delete[] _ret;
+				return _val;
+			}
+			_pos += _run_len;
+		}
+	}
+
+	//keep the raw one if nothing is saved
+	if (_pos >= _words)
+	{
+		delete[] _ret;
+		return _val;
+	}
+	_ret[0] |= KVstore::COMPRESSED_FLAG;
+	delete[] _val;
+	_vlen = sizeof(unsigned) * _pos;
+	return _ret;
+}
+
+unsigned*
+KVstore::decompressValue(IVArray* _array, const unsigned* _val, unsigned long& _vlen) const
+{
+	unsigned _head_len = this->headLen(_array);
+	unsigned _triple_num = _val[0] & ~KVstore::COMPRESSED_FLAG;
+	unsigned* _ret;
+	unsigned long _words;
+	if (_head_len == 0)
+	{
+		_words = 1 + 2 * (unsigned long)_triple_num;
+		_ret = new unsigned[_words];
+		_ret[0] = _triple_num;
+		const unsigned* _run = _val + 1;
+		_run += IDListCodec::decode(_run, _ret + 1);
+		IDListCodec::decode(_run, _ret + 1 + _triple_num);
+	}
+	else
+	{
+		unsigned _pre_num = _val[1];
+		_words = _head_len + 2 * _pre_num + _triple_num;
+		_ret = new unsigned[_words];
+		memcpy(_ret, _val, sizeof(unsigned) * (_head_len + 2 * _pre_num));
+		_ret[0] = _triple_num;
+		unsigned _pos = _head_len + 2 * _pre_num;
+		for (unsigned i = 0; i < _pre_num; ++i)
+		{
+			const unsigned* _run = _val + _val[_head_len + 1 + 2 * i];
+			_ret[_head_len + 1 + 2 * i] = _pos;
+			IDListCodec::decode(_run, _ret + _pos);
+			_pos += IDListCodec::decodedLen(_run);
+		}
+	}
+	_vlen = sizeof(unsigned) * _words;
+	return _ret;
 }
 
 TYPE_ENTITY_LITERAL_ID
@@ -5065,12 +5369,22 @@ KVstore::getValueByKey(IVArray* _array, unsigned _key, char*& _val, unsigned lon
 {
 	//cout << "getValueByKey                  " << _key << FirstRead << endl;
 	//cout << "this is transaction getValueByKey ..................." << endl;
+	bool ret;
 	if (Util::is_literal_ele(_key) && _array == objID2values)
 	{
 		unsigned key = _key - Util::LITERAL_FIRST_ID;
-		return objID2values_literal->search(key, _val, _vlen, AddSet, DelSet, txn, latched, FirstRead);
+		ret = objID2values_literal->search(key, _val, _vlen, AddSet, DelSet, txn, latched, FirstRead);
+	}
+	else
+		ret = _array->search(_key, _val, _vlen, AddSet, DelSet, txn, latched,  FirstRead);
+
+	if (ret && _val != NULL && KVstore::isCompressedValue((unsigned*)_val, _vlen))
+	{
+		unsigned* raw = this->decompressValue(_array, (unsigned*)_val, _vlen);
+		delete[] _val;
+		_val = (char*)raw;
 	}
-	return _array->search(_key, _val, _vlen, AddSet, DelSet, txn, latched,  FirstRead);
+	return ret;
 }
 
 bool 
@@ -5877,3 +6191,128 @@ KVstore::clean_dirty_key(IVArray* _array, unsigned _key)
 {
 	return _array->CleanDirtyKey(_key);
 }
+
+static void
+printLayout(const char* _title, const ValueLayout& _layout)
+{
+	double values = _layout.values > 0 ? _layout.values : 1;
+	double bytes = _layout.value_bytes > 0 ? _layout.value_bytes : 1;
+	double file_blocks = _layout.file_blocks > 0 ? _layout.file_blocks : 1;
+	cout << "\t" << _title << ": " << (double)_layout.file_blocks * _layout.block_size / (1 << 20) << " MB in blocks of "
+		<< _layout.block_size << " B, " << 100.0 * _layout.free_blocks / file_blocks << "% free in "
+		<< _layout.free_extents << " extents" << endl;
+	cout << "\t\t" << _layout.values << " values, " << _layout.blocks / values << " blocks and "
+		<< _layout.runs / values << " seeks per value, read amplification "
+		<< (double)_layout.blocks * _layout.block_size / bytes << "x" << endl;
+}
+
+//remove a dir of files, such as the stores
+static void
+removeStoreDir(const string& _dir)
+{
+	DIR* dp = opendir(_dir.c_str());
+	if (dp == NULL)
+		return;
+	struct dirent* entry;
+	while ((entry = readdir(dp)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+			unlink((_dir + "/" + entry->d_name).c_str());
+	}
+	closedir(dp);
+	rmdir(_dir.c_str());
+}
+
+//hard link each file of _dir into the new dir _new_dir
+static bool
+linkStoreDir(const string& _dir, const string& _new_dir)
+{
+	DIR* dp = opendir(_dir.c_str());
+	if (dp == NULL || mkdir(_new_dir.c_str(), 0755) != 0)
+	{
+		cout << "Error in create " << _new_dir << endl;
+		if (dp != NULL)
+			closedir(dp);
+		return false;
+	}
+	bool ok = true;
+	struct dirent* entry;
+	while (ok && (entry = readdir(dp)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+		string name = string("/") + entry->d_name;
+		if (link((_dir + name).c_str(), (_new_dir + name).c_str()) != 0)
+		{
+			cout << "Error in link " << _dir + name << endl;
+			ok = false;
+		}
+	}
+	closedir(dp);
+	return ok;
+}
+
+//flush the entries of a dir to disk
+static void
+syncDir(const string& _dir)
+{
+	int fd = open(_dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return;
+	fsync(fd);
+	close(fd);
+}
+
+//The stores are compacted into a new dir linking to the files of the others, which
+//is swapped with the old one in a single rename, so a crash leaves either all the
+//old files or all the new ones
+bool
+KVstore::compact(unsigned _value_block_size, unsigned _string_block_size)
+{
+	string new_path = this->store_path + "_compact";
+	//left by a crash
+	removeStoreDir(new_path);
+	if (!linkStoreDir(this->store_path, new_path))
+	{
+		removeStoreDir(new_path);
+		return false;
+	}
+
+	string is_names[] = { KVstore::s_id2entity, KVstore::s_id2literal, KVstore::s_id2predicate };
+	string iv_names[] = { KVstore::s_sID2values, KVstore::s_oID2values, KVstore::s_oID2values + "_literal", KVstore::s_pID2values };
+	for (unsigned i = 0; i < 7; ++i)
+	{
+		ValueLayout before, after;
+		string name = i < 3 ? is_names[i] : iv_names[i - 3];
+		if (!Util::file_exist(this->store_path + "/" + name + "_ValueFile"))
+			continue;
+		long tv_begin = Util::get_cur_time();
+		bool done;
+		if (i < 3)
+			done = ISArray::Compact(this->store_path, new_path, name, _string_block_size, before, after);
+		else
+			done = IVArray::Compact(this->store_path, new_path, name, _value_block_size, before, after);
+		if (!done)
+		{
+			cout << name << ": compaction of " << this->store_path << " is cancelled" << endl;
+			removeStoreDir(new_path);
+			return false;
+		}
+		cout << name << ": compacted in " << Util::get_cur_time() - tv_begin << " ms" << endl;
+		printLayout("before", before);
+		printLayout("after", after);
+	}
+
+	syncDir(new_path);
+	if (renameat2(AT_FDCWD, new_path.c_str(), AT_FDCWD, this->store_path.c_str(), RENAME_EXCHANGE) != 0)
+	{
+		cout << "Error in replace " << this->store_path << ", compaction is cancelled" << endl;
+		removeStoreDir(new_path);
+		return false;
+	}
+	size_t pos = this->store_path.rfind('/');
+	syncDir(pos == string::npos ? "." : this->store_path.substr(0, pos + 1));
+	//the old files now
+	removeStoreDir(new_path);
+	return true;
+}
@@ -13,6 +13,8 @@
 #include "../Util/VList.h"
 #include "Tree.h"
 #include "../Trie/Trie.h"
+#include "../Util/IDListCodec.h"
+#include "../Util/IDTupleSorter.h"
 #include "IVArray/IVArray.h"
 #include "ISArray/ISArray.h"
 
@@ -36,12 +38,54 @@
 //Triple Num   Pre Num   p1 offset1  p2 offset2 ... pn offsetn (slist-p1) (slist-p2) ... (slist-pn)
 //3. p2xx
 //Triple Num   (sid list)  (oid list) (not sorted, matched with sid one by one)
+//
+//COMPRESSED values(VALUE_FORMAT_COMPRESSED, marked by COMPRESSED_FLAG in Triple Num):
+//the header of s2xx/o2xx is kept as it is, so the pre can still be searched, while
+//each offset points to an IDListCodec run instead of a plain list
+//p2xx becomes: Triple Num   (sid run)   (oid run)
+
+//A read-only window on an ID list stored in s2values/o2values.
+//In the common case list points into the cached value of IVArray, which is
+//referenced (cannot be swapped out or freed) until release() or destruction,
+//so no copy is made; otherwise the view owns a private buffer.
+class IDListView
+{
+public:
+	IDListView();
+	~IDListView();
+	void release();
+
+	const unsigned* getList() const { return this->list; }
+	unsigned getLen() const { return this->len; }
+	bool empty() const { return this->len == 0; }
+	const unsigned* begin() const { return this->list; }
+	const unsigned* end() const { return this->list + this->len; }
+	unsigned operator[](unsigned _i) const { return this->list[_i]; }
+
+private:
+	friend class KVstore;
+	IDListView(const IDListView&);
+	IDListView& operator=(const IDListView&);
+
+	//the array holding the reference, NULL if nothing is referenced
+	IVArray* array;
+	unsigned key;
+	//the buffer to delete[] on release, NULL if the list is not owned
+	unsigned* owned;
+	const unsigned* list;
+	unsigned len;
+};
 
 class KVstore
 {
 public:
 	static const int READ_WRITE_MODE = 1;	//Open a B tree, which must exist
 	static const int CREATE_MODE = 2;		//Build a new B tree and delete existing ones (if any)
+	static const int READ_ONLY_MODE = 3;	//Map the values of an id2values array in memory, no updates
+
+	//format used by build_*ID2values
+	static const int VALUE_FORMAT_RAW = 0;
+	static const int VALUE_FORMAT_COMPRESSED = 1;
 
 	KVstore(std::string _store_path = ".");
 	~KVstore();
@@ -139,6 +183,13 @@ public:
 	//No Transaction should be running!
 	void IVArrayVacuum(vector<unsigned>& sub_ids , vector<unsigned>& obj_ids, vector<unsigned>& obj_literal_ids, vector<unsigned>& pre_ids) ;
 
+	//rewrite the values of all IVArray/ISArray stores in key order, each in
+	//adjacent blocks, and print the layout before and after(used by gcompact)
+	//_value_block_size for the id lists, _string_block_size for the strings,
+	//0 keeps the current size, either all the stores are compacted or none
+	//NOTICE: the stores must not be open
+	bool compact(unsigned _value_block_size, unsigned _string_block_size);
+
 	//===============================================================================
 
 	//for entity2id 
@@ -189,24 +240,32 @@ public:
 	bool open_subID2values(int _mode, TYPE_ENTITY_LITERAL_ID _entity_num = 0);
 	bool close_subID2values();
 	bool build_subID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num);
+	//the same from tuples read in spo order, i.e. merged by an IDTupleSorter
+	bool build_subID2values(IDTupleReader& _reader, TYPE_ENTITY_LITERAL_ID total_entity_num);
 	bool getpreIDlistBysubID(TYPE_ENTITY_LITERAL_ID _subid, unsigned*& _preidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getobjIDlistBysubID(TYPE_ENTITY_LITERAL_ID _subid, unsigned*& _objidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getobjIDlistBysubIDpreID(TYPE_ENTITY_LITERAL_ID _subid, TYPE_PREDICATE_ID _preid, unsigned*& _objidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getpreIDobjIDlistBysubID(TYPE_ENTITY_LITERAL_ID _subid, unsigned*& _preid_objidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
+	//zero-copy version of getobjIDlistBysubIDpreID
+	bool getobjIDlistBysubIDpreID(TYPE_ENTITY_LITERAL_ID _subid, TYPE_PREDICATE_ID _preid, IDListView& _view, shared_ptr<Transaction> txn = nullptr) const;
 
 	//for objID2values
 	bool open_objID2values(int _mode, TYPE_ENTITY_LITERAL_ID _entitynum = 0, TYPE_ENTITY_LITERAL_ID _literal_num = 0);
 	bool close_objID2values();
 	bool build_objID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_ENTITY_LITERAL_ID total_entity_num, TYPE_ENTITY_LITERAL_ID total_literal_num);
+	bool build_objID2values(IDTupleReader& _reader, TYPE_ENTITY_LITERAL_ID total_entity_num, TYPE_ENTITY_LITERAL_ID total_literal_num);	//in ops order
 	bool getpreIDlistByobjID(TYPE_ENTITY_LITERAL_ID _objid, unsigned*& _preidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getsubIDlistByobjID(TYPE_ENTITY_LITERAL_ID _objid, unsigned*& _subidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getsubIDlistByobjIDpreID(TYPE_ENTITY_LITERAL_ID _objid, TYPE_PREDICATE_ID _preid, unsigned*& _subidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getpreIDsubIDlistByobjID(TYPE_ENTITY_LITERAL_ID _objid, unsigned*& _preid_subidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
+	//zero-copy version of getsubIDlistByobjIDpreID
+	bool getsubIDlistByobjIDpreID(TYPE_ENTITY_LITERAL_ID _objid, TYPE_PREDICATE_ID _preid, IDListView& _view, shared_ptr<Transaction> txn = nullptr) const;
 
 	//for preID2values
 	bool open_preID2values(int _mode, TYPE_PREDICATE_ID _pre_num = 0);
 	bool close_preID2values();
 	bool build_preID2values(ID_TUPLE* _p_id_tuples, TYPE_TRIPLE_NUM _triples_num, TYPE_PREDICATE_ID total_pre_num);
+	bool build_preID2values(IDTupleReader& _reader, TYPE_PREDICATE_ID total_pre_num);	//in pso order
 	bool getsubIDlistBypreID(TYPE_PREDICATE_ID _preid, unsigned*& _subidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getobjIDlistBypreID(TYPE_PREDICATE_ID _preid, unsigned*& _objidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
 	bool getsubIDobjIDlistBypreID(TYPE_PREDICATE_ID _preid, unsigned*& _subid_objidlist, unsigned& _list_len, bool _no_duplicate = false, shared_ptr<Transaction> txn = nullptr) const;
@@ -219,9 +278,14 @@ public:
 	Trie *getTrie();
 
 	void set_if_single_thread(bool _single);
+	void set_value_format(int _format);
+	int get_value_format() const;
 private:
 	std::string store_path;
 
+	int value_format;
+	static const unsigned COMPRESSED_FLAG = 1u << 31;
+
 	std::string dictionary_store_path;
 
 	Trie *trie;
@@ -306,6 +370,8 @@ private:
 	bool getValueByKey(ISArray* _array, unsigned _key, char*& _val, unsigned& _vlen) const;
 //	bool getValueByKey(IVTree* _p_btree, unsigned _key, char*& _val, unsigned& _vlen) const;
 	bool getValueByKey(IVArray* _array, unsigned _key, char*& _val, unsigned long & _vlen) const;
+	//reference the value in cache instead of copying it, the view records what to release
+	bool getValueRefByKey(IVArray* _array, unsigned _key, char*& _val, unsigned long & _vlen, IDListView& _view) const;
 
 
 	TYPE_ENTITY_LITERAL_ID getIDByStr(SITree* _p_btree, const char* _key, unsigned _klen) const;
@@ -316,6 +382,14 @@ private:
 //	bool removeKey(IVTree* _p_btree, unsigned _key);
 	bool removeKey(IVArray* _array, unsigned _key);
 
+	//compress s2xx/o2xx/p2xx values, and restore them to the raw STRUCT
+	unsigned headLen(IVArray* _array) const;
+	unsigned* compressValue(IVArray* _array, unsigned* _val, unsigned long& _vlen) const;
+	unsigned* decompressValue(IVArray* _array, const unsigned* _val, unsigned long& _vlen) const;
+	static bool isCompressedValue(const unsigned* _val, unsigned long _vlen);
+	//set _view to the list of _preid in a s2xx/o2xx value
+	static bool setViewByPreID(const unsigned* _val, unsigned _head_len, TYPE_PREDICATE_ID _preid, IDListView& _view);
+
 	static std::vector<unsigned> intersect(const unsigned* _list1, const unsigned* _list2, unsigned _len1, unsigned _len2);
 	static unsigned binarySearch(unsigned key, const unsigned* _list, unsigned _list_len, int step = 1);
 	static bool isEntity(TYPE_ENTITY_LITERAL_ID id);
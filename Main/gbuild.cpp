@@ -48,6 +48,7 @@ main(int argc, char * argv[])
 			cout << "\t-h,--help\t\tDisplay this message." << endl;
 			cout << "\t-db,--database,\t\t the database name. " << endl;
 			cout << "\t-f,--file,\t\tthe file path for building." << endl;
+			cout << "\t-c,--compress,\t\tstore the id lists compressed, 1 for yes and 0 for no(default 0)." << endl;
 			cout << endl;
 			return 0;
 		}
@@ -110,6 +111,8 @@ main(int argc, char * argv[])
 			cout<<"Begin to build database...."<<endl;
 			long tv_begin = Util::get_cur_time();
 			Database _db(_db_path);
+			if (Util::getArgValue(argc, argv, "c", "compress", "0") == "1")
+				_db.setValueFormat(KVstore::VALUE_FORMAT_COMPRESSED);
 			bool flag = _db.build(_rdf);
 			if (flag)
 			{
@@ -0,0 +1,88 @@
+/*=============================================================================
+# Filename: gcompact.cpp
+# Description: used to defragment the value files of a database offline, every
+# value is rewritten into adjacent blocks in key order
+=============================================================================*/
+
+#include "../Util/Util.h"
+#include "../KVstore/KVstore.h"
+
+using namespace std;
+
+static bool
+getBlockSize(int argc, char * argv[], string _arg, string _arg2, unsigned& _size)
+{
+	string value = Util::getArgValue(argc, argv, _arg, _arg2, "0");
+	_size = (unsigned)atoi(value.c_str());
+	if (_size != 0 && (_size < 64 || _size > (1 << 20)))
+	{
+		cout << "The block size must be between 64 and 1048576 bytes." << endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char * argv[])
+{
+	Util util;
+	string db_name;
+	if (argc < 2)
+	{
+		cout<<"Invalid arguments! Input \"bin/gcompact -h\" for help."<<endl;
+		return 0;
+	}
+	string command = argv[1];
+	if (command == "-h" || command == "--help")
+	{
+		cout << endl;
+		cout << "gStore Compact Database Tools(gcompact)" << endl;
+		cout << endl;
+		cout << "Usage:\tbin/gcompact -db [dbname] -bs [block size] -sbs [block size]" << endl;
+		cout << endl;
+		cout << "Options:" << endl;
+		cout << "\t-h,--help\t\tDisplay this message." << endl;
+		cout << "\t-db,--database,\t\tthe database name. Notice that the name not end with .db" << endl;
+		cout << "\t-bs,--blocksize,\t\t(optional) block size in bytes of the id lists, the current one by default" << endl;
+		cout << "\t-sbs,--strblocksize,\t\t(optional) block size in bytes of the strings, the current one by default" << endl;
+		cout << endl;
+		cout << "Notice: the database must not be loaded by ghttp or other tools while compacting," << endl;
+		cout << "and backing it up with gbackup first is recommended." << endl;
+		cout << endl;
+		return 0;
+	}
+
+	db_name = Util::getArgValue(argc, argv, "db", "database");
+	if (db_name.empty())
+	{
+		cout<<"The database name can not been empty! Input \"bin/gcompact -h\" for help."<<endl;
+		return -1;
+	}
+	int len = db_name.length();
+	if (db_name.length() > 3 && db_name.substr(len - 3, 3) == ".db")
+	{
+		cout<<"The database name can not end with .db"<<endl;
+		return -1;
+	}
+	if (!Util::dir_exist(db_name + ".db"))
+	{
+		cout<<"The database that you want to compact does not exist."<<endl;
+		return -1;
+	}
+	unsigned value_block_size, string_block_size;
+	if (!getBlockSize(argc, argv, "bs", "blocksize", value_block_size) ||
+		!getBlockSize(argc, argv, "sbs", "strblocksize", string_block_size))
+		return -1;
+
+	cout<<"Begin to compact database...."<<endl;
+	long tv_begin = Util::get_cur_time();
+	KVstore kvstore(db_name + ".db/kv_store");
+	bool ok = kvstore.compact(value_block_size, string_block_size);
+	long tv_end = Util::get_cur_time();
+	if (!ok)
+	{
+		cout << db_name << ".db is not compacted, its stores are unchanged." << endl;
+		return -1;
+	}
+	cout << db_name << ".db is compacted successfully! Used " << (tv_end - tv_begin) << " ms" << endl;
+	return 0;
+}
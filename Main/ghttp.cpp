@@ -144,7 +144,11 @@ void backup_thread_new(const shared_ptr<HttpServer::Response>& response,string d
 void restore_thread_new(const shared_ptr<HttpServer::Response>& response,string db_name,string backup_path,string username);
 
 void query_thread_new(const shared_ptr<HttpServer::Response>& response,string db_name,string sparql,string format,
-string update_flag,string remote_ip,string log_prefix);
+string update_flag,string remote_ip,string log_prefix,string statement_id="",map<string, string> parameters=map<string, string>());
+
+void prepare_thread_new(const shared_ptr<HttpServer::Response>& response,string db_name,string sparql);
+
+bool parseParameters(const Value& value, map<string, string>& parameters);
 
 void export_thread_new(const shared_ptr<HttpServer::Response>& response,string db_name,string db_path,string username);
 
@@ -544,6 +548,9 @@ public:
 	string remote_ip;
 	string querytype;
 	string log_prefix;
+	//set for the execution of a prepared statement
+	string statement_id;
+	map<string, string> parameters;
 	const shared_ptr<HttpServer::Response> response;
 	const shared_ptr<HttpServer::Request> request;
 	Task(bool flag, string name, string ft, string query, const shared_ptr<HttpServer::Response>& res, const shared_ptr<HttpServer::Request>& req);
@@ -581,7 +588,7 @@ Task::~Task()
 void Task::run()
 {
 	//query_thread(update, db_name, format, db_query, response, request);
-	query_thread_new(response,db_name,db_query,format,querytype,remote_ip,log_prefix);
+	query_thread_new(response,db_name,db_query,format,querytype,remote_ip,log_prefix,statement_id,parameters);
 }
 
 class Thread
@@ -1397,6 +1404,77 @@ void build_thread_new(const shared_ptr<HttpServer::Response>& response,string db
  * @param {string} msg:StatusMsg value
  * @param {const} shared_ptr
  */
+/**
+ * @description: a streambuf that sends what is written to it as the chunks of a response with
+ * "Transfer-Encoding: chunked", so that big results are not built in memory first.
+ * The headers must be written into the response before anything is written here.
+ */
+class ChunkedStreamBuf : public std::streambuf
+{
+public:
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	ChunkedStreamBuf(const shared_ptr<HttpServer::Response>& _response) : response(_response), failed(false)
+	{
+		this->buffer.resize(CHUNK_SIZE);
+		this->setp(&this->buffer[0], &this->buffer[0] + CHUNK_SIZE);
+	}
+
+	//send the rest and the last chunk, false if the client has gone
+	bool finish()
+	{
+		if (!this->sendChunk())
+			return false;
+		*this->response << "0\r\n\r\n";
+		return true;
+	}
+
+protected:
+	int overflow(int c)
+	{
+		if (!this->sendChunk())
+			return traits_type::eof();
+		if (c != traits_type::eof())
+		{
+			*this->pptr() = (char)c;
+			this->pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync()
+	{
+		return this->sendChunk() ? 0 : -1;
+	}
+
+private:
+	bool sendChunk()
+	{
+		if (this->failed)
+			return false;
+		size_t len = this->pptr() - this->pbase();
+		if (len > 0)
+		{
+			char size[32];
+			sprintf(size, "%zx\r\n", len);
+			*this->response << size;
+			this->response->write(this->pbase(), len);
+			*this->response << "\r\n";
+			this->setp(&this->buffer[0], &this->buffer[0] + CHUNK_SIZE);
+		}
+		if (!this->response->flush_now())
+		{
+			cout << "the client has gone, stop sending the result" << endl;
+			this->failed = true;
+		}
+		return !this->failed;
+	}
+
+	shared_ptr<HttpServer::Response> response;
+	vector<char> buffer;
+	bool failed;
+};
+
 void sendResponseMsg(int code, string msg, const shared_ptr<HttpServer::Response>& response)
 {
 	string resJson = CreateJson(code, msg, 0);
@@ -1697,6 +1775,33 @@ void monitor_thread_new(const shared_ptr<HttpServer::Response>& response, string
 	resDoc.AddMember("predicate num", _database->getPreNum(), allocator);
 	int conn_num = connection_num / 2;
 	resDoc.AddMember("connection num", conn_num, allocator);
+	StringCache::Stats cache_stats;
+	if (_database->getStringIndex()->getCacheStats(cache_stats))
+	{
+		unsigned long long lookups = cache_stats.hits + cache_stats.misses;
+		resDoc.AddMember("string cache hits", (uint64_t)cache_stats.hits, allocator);
+		resDoc.AddMember("string cache misses", (uint64_t)cache_stats.misses, allocator);
+		resDoc.AddMember("string cache hit ratio", lookups == 0 ? 0.0 : (double)cache_stats.hits / lookups, allocator);
+		resDoc.AddMember("string cache entries", (uint64_t)cache_stats.entries, allocator);
+		resDoc.AddMember("string cache bytes", (uint64_t)cache_stats.bytes, allocator);
+	}
+	QueryCache::Stats query_cache_stats;
+	_database->getQueryCache()->getStats(query_cache_stats);
+	unsigned long long pattern_lookups = query_cache_stats.pattern_hits + query_cache_stats.pattern_misses;
+	unsigned long long result_lookups = query_cache_stats.result_hits + query_cache_stats.result_misses;
+	resDoc.AddMember("query cache result hits", (uint64_t)query_cache_stats.result_hits, allocator);
+	resDoc.AddMember("query cache result misses", (uint64_t)query_cache_stats.result_misses, allocator);
+	resDoc.AddMember("query cache result hit ratio", result_lookups == 0 ? 0.0 : (double)query_cache_stats.result_hits / result_lookups, allocator);
+	resDoc.AddMember("query cache pattern hits", (uint64_t)query_cache_stats.pattern_hits, allocator);
+	resDoc.AddMember("query cache pattern misses", (uint64_t)query_cache_stats.pattern_misses, allocator);
+	resDoc.AddMember("query cache pattern hit ratio", pattern_lookups == 0 ? 0.0 : (double)query_cache_stats.pattern_hits / pattern_lookups, allocator);
+	resDoc.AddMember("query cache evictions", (uint64_t)query_cache_stats.evictions, allocator);
+	resDoc.AddMember("query cache invalidations", (uint64_t)query_cache_stats.invalidations, allocator);
+	resDoc.AddMember("query cache entries", (uint64_t)query_cache_stats.entries, allocator);
+	resDoc.AddMember("query cache bytes", (uint64_t)query_cache_stats.bytes, allocator);
+	resDoc.AddMember("query cache capacity", (uint64_t)query_cache_stats.capacity, allocator);
+	resDoc.AddMember("plan cache hits", (uint64_t)_database->getPlanCache()->getHitNum(), allocator);
+	resDoc.AddMember("plan cache misses", (uint64_t)_database->getPlanCache()->getMissNum(), allocator);
 
 	StringBuffer resBuffer;
 	PrettyWriter<StringBuffer> resWriter(resBuffer);
@@ -2502,7 +2607,7 @@ void restore_thread_new(const shared_ptr<HttpServer::Response>& response,string
  */
 void query_thread_new(const shared_ptr<HttpServer::Response>& response,
 string db_name,string sparql,string format,
-string update_flag,string remote_ip,string log_prefix)
+string update_flag,string remote_ip,string log_prefix,string statement_id,map<string, string> parameters)
 {
     string error="";
 	error=checkparamValue("db_name",db_name);
@@ -2511,7 +2616,8 @@ string update_flag,string remote_ip,string log_prefix)
 		sendResponseMsg(1003, error, response);
 		return;
 	}
-	error=checkparamValue("sparql",sparql);
+	//a prepared statement is executed if statement_id is given
+	error=checkparamValue(statement_id.empty() ? "sparql" : "stmt_id", statement_id.empty() ? sparql : statement_id);
 	if (error.empty() == false)
 	{
 		sendResponseMsg(1003, error, response);
@@ -2610,7 +2716,14 @@ string update_flag,string remote_ip,string log_prefix)
 	//catch exception when this is an update query and has no update privilege
 	try{
 		cout << "begin query..." << endl;
-		ret_val = current_database->query(sparql, rs, output, update_flag_bool,false,nullptr);
+		if (statement_id.empty())
+			ret_val = current_database->query(sparql, rs, output, update_flag_bool,false,nullptr);
+		else
+		{
+			//the statement is logged as the query
+			current_database->getPlanCache()->getStatement(statement_id, sparql);
+			ret_val = current_database->execute(statement_id, parameters, rs, output, update_flag_bool,false,nullptr);
+		}
 	}catch(string exception_msg){
 	
 		string content=exception_msg;
@@ -2712,63 +2825,50 @@ string update_flag,string remote_ip,string log_prefix)
 		ofstream outfile;
 		string ans = "";
 		string success = "";
-		//TODO: if result is stored in Stream instead of memory?  (if out of memory to use to_str)
-		//BETTER: divide and transfer, in multiple times, getNext()
+		//the result is written to the socket row by row in chunks, and the
+		//database is not needed any more once the strings are in rs
 		if (format == "json")
 		{
-			success = rs.to_JSON();
-			int rs_ansNum=rs.ansNum;
-			int rs_outputlimit=rs.output_limit;
-			//delete &rs;
-			Document resDoc;
-			Document::AllocatorType &allocator = resDoc.GetAllocator();
-			
-				/* code */
-			resDoc.Parse(success.c_str());
-			
-			if(resDoc.HasParseError())
-			{
-				cout<<"result parse error:"<<success<<endl;
-				error="parse error";
-				string filename2 ="error_"+thread_id+"_"+Util::getTimeString2()+"_"+Util::int2string(Util::getRandNum())+".txt";
-	
-                string localname2 = "query_result/" + filename2;
-				outfile.open(localname2);
-			    outfile << success;
-		  	    outfile.close();
-				sendResponseMsg(1005,error,response); 
-				return;
-			}
-			
-			
-			resDoc.AddMember("StatusCode", 0, allocator);
-			resDoc.AddMember("StatusMsg", "success", allocator);
-			resDoc.AddMember("AnsNum", rs_ansNum, allocator);
-			resDoc.AddMember("OutputLimit", rs_outputlimit, allocator);
-			resDoc.AddMember("ThreadId",StringRef(thread_id.c_str()),allocator);
-	        resDoc.AddMember("QueryTime", StringRef(Util::int2string(query_time).c_str()), allocator);
-			StringBuffer resBuffer;
-			PrettyWriter<StringBuffer> resWriter(resBuffer);
-			resDoc.Accept(resWriter);
-			string resJson = resBuffer.GetString();
-			//   localname = localname + "." + format;
-			//   filename = filename + "." + format;
-			//   filename = "";
-			//   filename = "sparql." + format;
-			//   cout << log_prefix << "filename: " << filename << endl;
-
-			*response << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " << resJson.length();
+			pthread_rwlock_unlock(&(it_already_build->second->db_lock));
+			stringstream status;
+			status << "\"StatusCode\": 0, \"StatusMsg\": \"success\", \"AnsNum\": " << (int)rs.ansNum
+				<< ", \"OutputLimit\": " << rs.output_limit << ", \"ThreadId\": \"" << thread_id
+				<< "\", \"QueryTime\": \"" << query_time << "\", ";
+			*response << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked";
 			*response << "\r\nCache-Control: no-cache"
 					  << "\r\nPragma: no-cache"
 					  << "\r\nExpires: 0";
-			*response << "\r\n\r\n"
-					  << resJson;
-			cout << "query complete! unlock the database " << endl;
+			*response << "\r\n\r\n";
+			ChunkedStreamBuf chunks(response);
+			ostream out(&chunks);
+			rs.writeJSON(out, status.str());
+			chunks.finish();
+			cout << "query complete! the result has been sent" << endl;
+			return;
+		}
+		else if (format == "sparql-results+json" || format == "csv" || format == "tsv")
+		{
 			pthread_rwlock_unlock(&(it_already_build->second->db_lock));
-			cout << "query complete! unlock the database successfully! " << endl;
+			string content_type = "application/sparql-results+json";
+			if (format == "csv")
+				content_type = "text/csv; charset=utf-8";
+			else if (format == "tsv")
+				content_type = "text/tab-separated-values; charset=utf-8";
+			*response << "HTTP/1.1 200 OK\r\nContent-Type: " << content_type << "\r\nTransfer-Encoding: chunked";
+			*response << "\r\nCache-Control: no-cache"
+					  << "\r\nPragma: no-cache"
+					  << "\r\nExpires: 0";
+			*response << "\r\n\r\n";
+			ChunkedStreamBuf chunks(response);
+			ostream out(&chunks);
+			if (format == "csv")
+				rs.writeCSV(out);
+			else if (format == "tsv")
+				rs.writeTSV(out);
+			else
+				rs.writeSparqlJSON(out);
+			chunks.finish();
 			return;
-			//return true;
-			//
 		}
 		else if (format == "file")
 		{
@@ -2869,23 +2969,6 @@ string update_flag,string remote_ip,string log_prefix)
 			cout << "query complete! unlock the database successfully! " << endl;
 			return;
 		}
-		else if (format == "sparql-results+json")
-		{
-
-			success = rs.to_JSON(); // convert the result to json
-			int rs_ansNum=rs.ansNum;
-			int rs_outputlimit=rs.output_limit;
-			//delete &rs;
-			*response << "HTTP/1.1 200 OK\r\nContent-Type: application/sparql-results+json\r\nContent-Length: " << success.length();
-			*response << "\r\nCache-Control: no-cache"
-					  << "\r\nPragma: no-cache"
-					  << "\r\nExpires: 0";
-			*response << "\r\n\r\n"
-					  << success; // success contains the json-encoded result
-
-			pthread_rwlock_unlock(&(it_already_build->second->db_lock));
-			return;
-		}
 		else
 		{
 			localname = localname + ".txt";
@@ -2934,6 +3017,116 @@ string update_flag,string remote_ip,string log_prefix)
 	}
 }
 
+/**
+ * @description: prepare a query with $name placeholders to be executed later(operation execute)
+ * @param {string} db_name
+ * @param {string} sparql
+ * @return {*} the statement id and the placeholders
+ */
+void prepare_thread_new(const shared_ptr<HttpServer::Response>& response,string db_name,string sparql)
+{
+	string error=checkparamValue("db_name",db_name);
+	if (error.empty() == false)
+	{
+		sendResponseMsg(1003, error, response);
+		return;
+	}
+	error=checkparamValue("sparql",sparql);
+	if (error.empty() == false)
+	{
+		sendResponseMsg(1003, error, response);
+		return;
+	}
+	if(checkdbload(db_name)==false)
+	{
+		error="Database not load yet.";
+		sendResponseMsg(1004,error,response);
+		return;
+	}
+	pthread_rwlock_rdlock(&databases_map_lock);
+	std::map<std::string, Database *>::iterator iter = databases.find(db_name);
+	if(iter == databases.end())
+	{
+		error = "Database not load yet.";
+		sendResponseMsg(1004,error,response);
+		pthread_rwlock_unlock(&databases_map_lock);
+		return;
+	}
+	Database *current_database = iter->second;
+	pthread_rwlock_unlock(&databases_map_lock);
+
+	pthread_rwlock_rdlock(&already_build_map_lock);
+	std::map<std::string, struct DBInfo *>::iterator it_already_build = already_build.find(db_name);
+	pthread_rwlock_unlock(&already_build_map_lock);
+	if (it_already_build == already_build.end())
+	{
+		error = "Database not build yet.";
+		sendResponseMsg(1004,error,response);
+		return;
+	}
+	pthread_rwlock_rdlock(&(it_already_build->second->db_lock));
+
+	string statement_id;
+	vector<string> parameters;
+	bool ret = false;
+	try
+	{
+		ret = current_database->prepare(sparql, statement_id, parameters);
+	}
+	catch(const std::runtime_error& e)
+	{
+		error = e.what();
+	}
+	catch (...)
+	{
+		error = "unknow error";
+	}
+	pthread_rwlock_unlock(&(it_already_build->second->db_lock));
+	if (!ret)
+	{
+		if (error.empty())
+			error = "prepare failed.";
+		cout << "prepare failed:" << error << endl;
+		sendResponseMsg(1005,error,response);
+		return;
+	}
+
+	StringBuffer s;
+	PrettyWriter<StringBuffer> writer(s);
+	writer.StartObject();
+	writer.Key("StatusCode");
+	writer.Uint(0);
+	writer.Key("StatusMsg");
+	writer.String(StringRef("success"));
+	writer.Key("StmtId");
+	writer.String(StringRef(statement_id.c_str()));
+	writer.Key("Params");
+	writer.StartArray();
+	for (unsigned i = 0; i < parameters.size(); ++i)
+		writer.String(StringRef(parameters[i].c_str()));
+	writer.EndArray();
+	writer.EndObject();
+	string resJson = s.GetString();
+	*response << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " << resJson.length() << "\r\n\r\n" << resJson;
+}
+
+//the RDF term of each placeholder from a JSON object
+bool parseParameters(const Value& value, map<string, string>& parameters)
+{
+	if (!value.IsObject())
+		return false;
+	for (Value::ConstMemberIterator it = value.MemberBegin(); it != value.MemberEnd(); ++it)
+	{
+		if (!it->value.IsString())
+			return false;
+		string name = it->name.GetString();
+		if (name.empty() || name[0] != '$')
+			name = "$" + name;
+		parameters[name] = it->value.GetString();
+	}
+	return true;
+}
+
 /**
  * @description: export the database
  * @Author:liwenjie
@@ -3924,7 +4117,9 @@ const shared_ptr<HttpServer::Request>& request, string RequestType)
 		sendResponseMsg(1001, checkidentityresult, response);
 		return;
 	}
-	if (checkPrivilege(username, operation, db_name) == 0)
+	//prepared statements are queries
+	string privilege = (operation == "prepare" || operation == "execute") ? "query" : operation;
+	if (checkPrivilege(username, privilege, db_name) == 0)
 	{
 		string msg = "You have no " + operation + " privilege, operation failed";
 		sendResponseMsg(1002, msg, response);
@@ -4179,6 +4374,77 @@ const shared_ptr<HttpServer::Request>& request, string RequestType)
 
 		//query_thread_new(response,db_name,sparql,format,querytype,remote_ip,thread_id,log_prefix);
 	}
+	else if(operation=="prepare")
+	{
+		string sparql="";
+		if(RequestType=="GET")
+		{
+			sparql=WebUrl::CutParam(url,"sparql");
+			sparql=UrlDecode(sparql);
+		}
+		else
+		{
+			if (document.HasMember("sparql")&&document["sparql"].IsString())
+			{
+				sparql = document["sparql"].GetString();
+			}
+		}
+		prepare_thread_new(response,db_name,sparql);
+	}
+	else if(operation=="execute")
+	{
+		string format="";
+		string statement_id="";
+		map<string, string> parameters;
+		string querytype = checkPrivilege(username, "update", db_name) == 0 ? "0" : "1";
+		//params: a JSON object of the RDF term of each placeholder, i.e. {"$name": "<iri>"}
+		bool params_ok = true;
+		if(RequestType=="GET")
+		{
+			format=WebUrl::CutParam(url,"format");
+			statement_id=WebUrl::CutParam(url,"stmt_id");
+			statement_id=UrlDecode(statement_id);
+			string params=WebUrl::CutParam(url,"params");
+			params=UrlDecode(params);
+			if (!params.empty())
+			{
+				Document params_doc;
+				params_doc.Parse(params.c_str());
+				params_ok = !params_doc.HasParseError() && parseParameters(params_doc, parameters);
+			}
+		}
+		else
+		{
+			if (document.HasMember("format")&&document["format"].IsString())
+			{
+				format = document["format"].GetString();
+			}
+			if (document.HasMember("stmt_id")&&document["stmt_id"].IsString())
+			{
+				statement_id = document["stmt_id"].GetString();
+			}
+			if (document.HasMember("params"))
+			{
+				params_ok = parseParameters(document["params"], parameters);
+			}
+		}
+		if (!params_ok)
+		{
+			string error = "params should be a JSON object of the RDF term(string) of each placeholder.";
+			sendResponseMsg(1003, error, response);
+			return;
+		}
+		if(format.empty())
+		{
+			format="json";
+		}
+
+		query_num++;
+		Task* task = new Task(db_name, format,remote_ip,log_prefix,querytype,"", response, request);
+		task->statement_id = statement_id;
+		task->parameters = parameters;
+		pool.AddTask(task);
+	}
 	else if(operation=="export")
 	{
         string db_path="";
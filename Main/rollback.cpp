@@ -28,30 +28,21 @@ int get_all_folders(string path, vector<string> &folders)
     return 0;
 }
 
-long int get_timestamp(string& line)
-{
-    int n = line.length()-2;
-    long int timestamp = 0;
-    int i = 0;
-    while(isdigit(line[n]))
-    {
-        timestamp = pow(10, i) * (line[n] - '0') + timestamp;
-        i++;
-        n--;
-    }
-    line = line.substr(0, line.length() - i - 2);
-    return timestamp;
-}
-
-string undo_sparql(string line)
+string undo_sparql(const UpdateLog::Record& record)
 {
     string undo_sparql;
-    if(line[0] == 'I'){
-        undo_sparql = "Delete DATA{";
+    if(record.type == UpdateLog::Insert){
+        undo_sparql = "DELETE DATA{";
     }else{
         undo_sparql = "INSERT DATA{";
     }
-    undo_sparql += line.substr(2, line.length());
+    for(size_t i = 0; i < record.triples.size(); ++i)
+    {
+        const TripleWithObjType& triple = record.triples[i];
+        undo_sparql += Util::node2string(triple.subject.c_str()) + ' ';
+        undo_sparql += Util::node2string(triple.predicate.c_str()) + ' ';
+        undo_sparql += Util::node2string(triple.object.c_str()) + " . ";
+    }
     undo_sparql += '}';
     return undo_sparql;
 }
@@ -162,22 +153,21 @@ main(int argc, char * argv[])
     //load
 
     gc.load(db_name);
-    string log_path = db_name + ".db/" + "update_since_backup.log";
+    string log_path = db_name + ".db/" + "update_since_backup.wal";
     cout << log_path << endl;
-    ofp.open(log_path, ios::in);
+    vector<UpdateLog::Record> records;
+    UpdateLog::read(log_path, records, 0);
     int flag = 0; int undo_point;
-    string rec;
-    while(getline(ofp, rec))
+    for(size_t i = 0; i < records.size(); ++i)
     {
-        //TODO: remove divide 1000
-        int _timestamp = Util::get_timestamp(rec)/1000;
+        int _timestamp = records[i].time / 1000;
         if(_timestamp < timestamp) continue;
         if(!flag){
             undo_point = _timestamp;
             flag = 1;
         }
-        if (rec[0] != 'I' && rec[0] != 'R') continue;
-        rec = undo_sparql(rec);
+        if (records[i].type != UpdateLog::Insert && records[i].type != UpdateLog::Remove) continue;
+        string rec = undo_sparql(records[i]);
         cout << rec << endl;
         ResultSet rs;
         gc.query(db_name, "json", rec);
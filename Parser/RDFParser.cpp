@@ -15,11 +15,11 @@ RDF-3X's TurtleParser
 RDFParser::RDFParser():_TurtleParser(_sin)
 {}
 
-/** Constructor for parseFile. Takes in an ifstream of an RDF file 
+/** Constructor for parseFile. Takes in an input stream of an RDF file 
  * and passes to TurtleParser.
- * @param _fin the ifstream of the input RDF file.
+ * @param _fin the stream of the input RDF file.
  */
-RDFParser::RDFParser(ifstream& _fin):_TurtleParser(_fin)
+RDFParser::RDFParser(istream& _fin):_TurtleParser(_fin)
 {}
 
 /** Parses an RDF file. More rigorous numeric checks on top of TurtleParser.
@@ -45,33 +45,47 @@ RDFParser::RDFParser(ifstream& _fin):_TurtleParser(_fin)
  */
 int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, string _error_log, int init_line)
 {
-	string rawSubject, rawPredicate, rawObject;
-	string _subject, _predicate, _object, _objectSubType;
-	string errorMsg;
-	Type::Type_ID _objectType;
-	streambuf *coutbuf = cout.rdbuf();
+	ostream null_out(NULL);	// Writes nothing
 	ofstream ofile;
+	ostream* out = &cout;
 
 	if (!_error_log.empty())
 	{
 		if (_error_log == "NULL")
-			cout.setstate(ios_base::badbit);	// Silent output
+			out = &null_out;	// Silent output
 		else
 		{
 			ofile.open(_error_log,ios::app);
 			if (ofile)
 			{
 				cout << "Error log file: " << _error_log << endl;
-				cout.rdbuf(ofile.rdbuf());
+				out = &ofile;
 			}
 			else
 				cout << "Error log file cannot be opened." << endl;
 		}
 	}
 
+	int numLines = this->parseStream(_triple_array, _triple_num, RDFParser::TRIPLE_NUM_PER_GROUP, *out, init_line);
+	cout << "RDFParser parseFile done!" << endl;
+
+	return numLines;
+}
+
+/** Parses up to _max_num triples like parseFile, writing the errors to _err.
+ * It does not touch cout, so parsers of different streams can run at the same time.
+ * @return the line number reached.
+ */
+int RDFParser::parseStream(TripleWithObjType* _triple_array, int& _triple_num, int _max_num, ostream& _err, int init_line)
+{
+	string rawSubject, rawPredicate, rawObject;
+	string _subject, _predicate, _object, _objectSubType;
+	string errorMsg;
+	Type::Type_ID _objectType;
+
 	int numLines = init_line;
 	int prev_line = -1;	// For recognizing errors thrown by TurtleParser in the same line of the input file
-	while (_triple_num < RDFParser::TRIPLE_NUM_PER_GROUP)
+	while (_triple_num < _max_num)
 	{
 		numLines++;
 		try
@@ -95,7 +109,7 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 			errorMsg = errorMsg.substr(0, num_l - 9) + errorMsg.substr(num_r);
 
 			// TODO: get the actual corresponding line
-			cout << "Line " << numLines << " (<" << rawSubject << "...> ...): " << errorMsg << endl;
+			_err << "Line " << numLines << " (<" << rawSubject << "...> ...): " << errorMsg << endl;
 			this->_TurtleParser.discardLine();
 			continue;
 		}
@@ -127,14 +141,14 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 				catch (invalid_argument& e)
 				{
 					errorMsg = "Object integer value invalid";
-					cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+					_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 						<< "> <" << rawObject << ">): " << errorMsg << endl;
 					continue;
 				}
 				catch (out_of_range& e)
 				{
 					errorMsg = "Object integer out of range";
-					cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+					_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 						<< "> <" << rawObject << ">): " << errorMsg << endl;
 					continue;
 				}
@@ -152,7 +166,7 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 				catch (invalid_argument& e)
 				{
 					errorMsg = "Object double value invalid";
-					cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+					_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 						<< "> <" << rawObject << ">): " << errorMsg << endl;
 					continue;
 				}
@@ -160,7 +174,7 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					&& toupper(rawObject[2]) == 'N')
 				{
 					errorMsg = "Object double value is NaN";
-					cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+					_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 						<< "> <" << rawObject << ">): " << errorMsg << endl;
 					continue;
 				}
@@ -180,14 +194,14 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					catch (invalid_argument& e)
 					{
 						errorMsg = "Object long value invalid";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					catch (out_of_range& e)
 					{
 						errorMsg = "Object long value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -202,21 +216,21 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					catch (invalid_argument& e)
 					{
 						errorMsg = "Object int value invalid";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					catch (out_of_range& e)
 					{
 						errorMsg = "Object int value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					if (ll < (long long)INT_MIN || ll >(long long)INT_MAX)
 					{
 						errorMsg = "Object int value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -231,21 +245,21 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					catch (invalid_argument& e)
 					{
 						errorMsg = "Object short value invalid";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					catch (out_of_range& e)
 					{
 						errorMsg = "Object short value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					if (ll < (long long)SHRT_MIN || ll >(long long)SHRT_MAX)
 					{
 						errorMsg = "Object short value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -260,21 +274,21 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					catch (invalid_argument& e)
 					{
 						errorMsg = "Object byte value invalid";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					catch (out_of_range& e)
 					{
 						errorMsg = "Object byte value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
 					if (ll < (long long)SCHAR_MIN || ll >(long long)SCHAR_MAX)
 					{
 						errorMsg = "Object byte value out of range";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -289,7 +303,7 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 					catch (invalid_argument& e)
 					{
 						errorMsg = "Object float value invalid";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -297,7 +311,7 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 						&& toupper(rawObject[2]) == 'N')
 					{
 						errorMsg = "Object float value is NaN";
-						cout << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
+						_err << "Line " << numLines << " (<" << rawSubject << "> <" << rawPredicate \
 							<< "> <" << rawObject << ">): " << errorMsg << endl;
 						continue;
 					}
@@ -310,18 +324,6 @@ int RDFParser::parseFile(TripleWithObjType* _triple_array, int& _triple_num, str
 		_triple_array[_triple_num++] = TripleWithObjType(_subject, _predicate, _object, _object_type);
 
 	}
-	if (!_error_log.empty())
-	{
-		if (_error_log == "NULL")
-			cout.clear();
-		else
-		{
-			ofile.close();
-			cout.rdbuf(coutbuf);
-		}
-	}
-	cout << "RDFParser parseFile done!" << endl;
-
 	return numLines;
 }
 
@@ -28,8 +28,9 @@ public:
     static const int TRIPLE_NUM_PER_GROUP = 10 * 1000 * 1000;
 
     RDFParser();
-    RDFParser(ifstream& _fin);
+    RDFParser(istream& _fin);
     int parseFile(TripleWithObjType* _triple_array, int& _triple_num, string _error_log="", int init_line=0);
+    int parseStream(TripleWithObjType* _triple_array, int& _triple_num, int _max_num, ostream& _err, int init_line=0);
     void parseString(string _str, TripleWithObjType* _triple_array, int& _triple_num);
 };
 #endif
@@ -61,11 +61,9 @@ BasicQuery::clear()
 	this->ready = NULL;
 	delete[] this->need_retrieve;
 	this->need_retrieve = NULL;
-    for (unsigned i=0;i<this->result_list.size();++i)
-    {
-        delete[] this->result_list[i];
-        this->result_list[i] = NULL;
-    }    
+    //the rows are released with the arena, maybe later if a TempResult shares it
+    this->result_list.clear();
+    this->result_arena.reset();    
 }
 
 int
@@ -197,6 +195,20 @@ BasicQuery::getResultListPointer()
     return &result_list;
 }
 
+unsigned*
+BasicQuery::newResultRow(unsigned _len)
+{
+    if (this->result_arena == NULL)
+        this->result_arena = make_shared<Arena>();
+    return this->result_arena->allocIDs(_len);
+}
+
+shared_ptr<Arena>
+BasicQuery::getResultArena()
+{
+    return this->result_arena;
+}
+
 const EntityBitSet& 
 BasicQuery::getVarBitSet(int _i)const
 {
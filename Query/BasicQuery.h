@@ -11,6 +11,7 @@
 
 #include "../Util/Util.h"
 #include "../Util/Triple.h"
+#include "../Util/Arena.h"
 #include "../Signature/Signature.h"
 #include "../KVstore/KVstore.h"
 #include "IDList.h"
@@ -121,6 +122,8 @@ private:
 	string* var_name;
 	IDList* candidate_list;
 	vector<unsigned*> result_list;
+	//rows of result_list are allocated here, shared with the TempResult taking them over
+	shared_ptr<Arena> result_arena;
 	int* var_degree;
 
 	//whether has added the variable's literal candidate
@@ -242,6 +245,9 @@ public:
 	// get the result list of _var in the query graph
 	vector<unsigned*>& getResultList();
 	vector<unsigned*>* getResultListPointer();
+	//a row of _len ids for result_list, released with the arena
+	unsigned* newResultRow(unsigned _len);
+	shared_ptr<Arena> getResultArena();
 
 	// get the entity signature of _var in the query graph
 	const EntityBitSet& getEntitySignature(int _var);
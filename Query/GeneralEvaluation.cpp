@@ -14,10 +14,10 @@ using namespace std;
 GeneralEvaluation::GeneralEvaluation(VSTree *_vstree, KVstore *_kvstore, StringIndex *_stringindex, QueryCache *_query_cache, \
 	TYPE_TRIPLE_NUM *_pre2num,TYPE_TRIPLE_NUM *_pre2sub, TYPE_TRIPLE_NUM *_pre2obj, \
 	TYPE_PREDICATE_ID _limitID_predicate, TYPE_ENTITY_LITERAL_ID _limitID_literal, \
-	TYPE_ENTITY_LITERAL_ID _limitID_entity, CSR *_csr, shared_ptr<Transaction> _txn):
-	vstree(_vstree), kvstore(_kvstore), stringindex(_stringindex), query_cache(_query_cache), pre2num(_pre2num), \
+	TYPE_ENTITY_LITERAL_ID _limitID_entity, CSR *_csr, shared_ptr<Transaction> _txn, Statistics *_statistics):
+	vstree(_vstree), kvstore(_kvstore), stringindex(_stringindex), query_cache(_query_cache), cache_generation(0), pre2num(_pre2num), \
 	pre2sub(_pre2sub), pre2obj(_pre2obj), limitID_predicate(_limitID_predicate), limitID_literal(_limitID_literal), \
-	limitID_entity(_limitID_entity), csr(_csr), txn(_txn), fp(NULL), export_flag(false), temp_result(nullptr)
+	limitID_entity(_limitID_entity), csr(_csr), txn(_txn), statistics(_statistics), join_plans(NULL), fp(NULL), export_flag(false), temp_result(nullptr)
 {
 	if (csr)
 		pqHandler = new PathQueryHandler(csr);
@@ -37,96 +37,11 @@ GeneralEvaluation::loadCSR()
 {
 	cout << "GeneralEvaluation::loadCSR" << endl;
 
-	if (csr)
-		delete csr;
 	csr = new CSR[2];
-
 	unsigned pre_num = stringindex->getNum(StringIndexFile::Predicate);
-	csr[0].init(pre_num);
-	csr[1].init(pre_num);	
 	cout << "pre_num: " << pre_num << endl;
 	long begin_time = Util::get_cur_time();
-
-	// Process out-edges (csr[0])
-	// i: predicate; j: subject; k: object
-	for(unsigned i = 0; i < pre_num; i++)
-	{
-		string pre = kvstore->getPredicateByID(i);
-		cout<<"pid: "<<i<<"    pre: "<<pre<<endl;
-		unsigned* sublist = NULL;
-		unsigned sublist_len = 0;
-		bool ret = kvstore->getsubIDlistBypreID(i, sublist, sublist_len, true);
-		//cout<<"    sub_num: "<<sublist_len<<endl;
-		unsigned offset = 0;
-		unsigned index = 0;
-		for(unsigned j=0;j<sublist_len;j++)
-		{
-			string sub = kvstore->getEntityByID(sublist[j]);
-			//cout<<"    sid: "<<sublist[j]<<"    sub: "<<sub<<endl;
-			unsigned* objlist = NULL;
-			unsigned objlist_len = 0;
-			bool ret = kvstore->getobjIDlistBysubIDpreID(sublist[j], i, objlist, objlist_len); 
-			unsigned len = objlist_len;	// the real object list length
-			for(unsigned k=0;k<objlist_len;k++)
-			{
-				if(objlist[k]>=Util::LITERAL_FIRST_ID)
-				{
-					--len;
-					continue;
-				}
-				csr[0].adjacency_list[i].push_back(objlist[k]);
-			}
-			if(len > 0)
-			{
-				csr[0].id2vid[i].push_back(sublist[j]);
-				csr[0].vid2id[i].insert(pair<unsigned, unsigned>(sublist[j], index));
-				csr[0].offset_list[i].push_back(offset);
-				index++;
-				offset += len;
-			}
-		}
-		cout<<csr[0].offset_list[i].size()<<endl;	// # of this predicate's subjects
-		cout<<csr[0].adjacency_list[i].size()<<endl;	// # of this predicate's objects
-	}
-
-	// Process out-edges (csr[1])
-	// i: predicate; j: object; k: subject
-	for(unsigned i = 0;i<pre_num;i++)
-	{
-		string pre = kvstore->getPredicateByID(i);
-		cout<<"pid: "<<i<<"    pre: "<<pre<<endl;
-		unsigned* objlist = NULL;
-		unsigned objlist_len = 0;
-		bool ret = kvstore->getobjIDlistBypreID(i, objlist, objlist_len, true);
-		//cout<<"    obj_num: "<<objlist_len<<endl;
-		unsigned offset = 0;
-		unsigned index = 0;
-		for(unsigned j=0;j<objlist_len;j++)
-		{
-			if(objlist[j]>=Util::LITERAL_FIRST_ID)
-				continue;
-			string obj = kvstore->getEntityByID(objlist[j]);
-			unsigned* sublist = NULL;
-			unsigned sublist_len = 0;
-			bool ret = kvstore->getsubIDlistByobjIDpreID(objlist[j], i, sublist, sublist_len); 
-			unsigned len = sublist_len;
-			for(unsigned k=0;k<sublist_len;k++)
-			{
-				string sub = kvstore->getEntityByID(sublist[k]);
-				csr[1].adjacency_list[i].push_back(sublist[k]);
-			}
-			if(len > 0)
-			{
-				csr[1].id2vid[i].push_back(objlist[j]);
-				csr[1].vid2id[i].insert(pair<unsigned, unsigned>(objlist[j], index));
-				csr[1].offset_list[i].push_back(offset);
-				index++;
-				offset += len;
-			}
-		}
-		cout<<csr[1].offset_list[i].size()<<endl;
-		cout<<csr[1].adjacency_list[i].size()<<endl;
-	}
+	CSR::build(csr, kvstore, pre_num);
 	long end_time = Util::get_cur_time();
 	cout << "Loading CSR in GeneralEvaluation takes " << (end_time - begin_time) << "ms" << endl;
 }
@@ -174,14 +89,26 @@ bool GeneralEvaluation::parseQuery(const string &_query)
 	return true;
 }
 
+void GeneralEvaluation::setQueryTree(const QueryTree &_query_tree)
+{
+	this->query_tree = _query_tree;
+}
+
 QueryTree& GeneralEvaluation::getQueryTree()
 {
 	return this->query_tree;
 }
 
+void GeneralEvaluation::setJoinPlans(vector<PlanCache::JoinPlan> *_join_plans)
+{
+	this->join_plans = _join_plans;
+}
+
 bool GeneralEvaluation::doQuery()
 {
 	query_tree.print();
+	if (this->query_cache != NULL)
+		this->cache_generation = this->query_cache->getGeneration();
 
 	if (!this->query_tree.checkProjectionAsterisk() && this->query_tree.getProjection().empty())
 		return false;
@@ -210,7 +137,9 @@ bool GeneralEvaluation::doQuery()
 
 	this->strategy = Strategy(this->kvstore, this->vstree, this->pre2num,this->pre2sub, this->pre2obj, 
 		this->limitID_predicate, this->limitID_literal, this->limitID_entity,
-		this->query_tree.Modifier_Distinct== QueryTree::Modifier_Distinct, txn);
+		this->query_tree.Modifier_Distinct== QueryTree::Modifier_Distinct, txn, this->statistics);
+	this->strategy.setRowLimit(this->getPushdownRowLimit());
+	this->strategy.setJoinPlans(this->join_plans);
 
 	this->rewriting_evaluation_stack.clear();
 	this->rewriting_evaluation_stack.push_back(EvaluationStackStruct());
@@ -379,28 +308,18 @@ TempResultSet* GeneralEvaluation::queryEvaluation(int dep)
 					temp->results.push_back(TempResult());
 
 					temp->results[0].id_varset = Varset(encode_varset[j]);
-					int varnum = (int)encode_varset[j].size();
 
 					vector<unsigned*> &basicquery_result = sparql_query.getBasicQuery(j).getResultList();
-					// todo: change this type to unsigned may fit large results query?
-					int basicquery_result_num = (int)basicquery_result.size();
+					temp->results[0].adoptRows(basicquery_result, sparql_query.getBasicQuery(j).getResultArena());
 
-					temp->results[0].result.reserve(basicquery_result_num);
-					for (int k = 0; k < basicquery_result_num; k++)
-					{
-						unsigned *v = new unsigned[varnum];
-						memcpy(v, basicquery_result[k], sizeof(int) * varnum);
-						temp->results[0].result.push_back(TempResult::ResultPair());
-						temp->results[0].result.back().id = v;
-					}
-
-					if (this->query_cache != NULL)
+					//a result cut at the row limit is not the whole BGP result
+					if (this->query_cache != NULL && this->strategy.getRowLimit() == 0)
 					{
 						//if unconnected, time is incorrect
 						int time = tv_handle - tv_begin;
 
 						long tv_bftry = Util::get_cur_time();
-						bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time);
+						bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time, this->cache_generation);
 						if (success)	printf("QueryCache cached\n");
 						else			printf("QueryCache didn't cache\n");
 						long tv_aftry = Util::get_cur_time();
@@ -563,27 +482,17 @@ TempResultSet* GeneralEvaluation::queryEvaluation(int dep)
 						temp->results.push_back(TempResult());
 
 						temp->results[0].id_varset = Varset(encode_varset[j]);
-						int varnum = (int)encode_varset[j].size();
 
 						vector<unsigned*> &basicquery_result = sparql_query.getBasicQuery(j).getResultList();
-						int basicquery_result_num = (int)basicquery_result.size();
+						temp->results[0].adoptRows(basicquery_result, sparql_query.getBasicQuery(j).getResultArena());
 
-						temp->results[0].result.reserve(basicquery_result_num);
-						for (int k = 0; k < basicquery_result_num; k++)
-						{
-							unsigned *v = new unsigned[varnum];
-							memcpy(v, basicquery_result[k], sizeof(int) * varnum);
-							temp->results[0].result.push_back(TempResult::ResultPair());
-							temp->results[0].result.back().id = v;
-						}
-
-						if (this->query_cache != NULL && dep == 0)
+						if (this->query_cache != NULL && dep == 0 && this->strategy.getRowLimit() == 0)
 						{
 							//if unconnected, time is incorrect
 							int time = tv_handle - tv_begin;
 
 							long tv_bftry = Util::get_cur_time();
-							bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time);
+							bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time, this->cache_generation);
 							if (success)	printf("QueryCache cached\n");
 							else			printf("QueryCache didn't cache\n");
 							long tv_aftry = Util::get_cur_time();
@@ -1015,27 +924,17 @@ TempResultSet* GeneralEvaluation::rewritingBasedQueryEvaluation(int dep)
 			temp->results.push_back(TempResult());
 
 			temp->results[0].id_varset = Varset(encode_varset[j]);
-			int varnum = (int)encode_varset[j].size();
 
 			vector<unsigned*> &basicquery_result = sparql_query.getBasicQuery(j).getResultList();
-			int basicquery_result_num = (int)basicquery_result.size();
+			temp->results[0].adoptRows(basicquery_result, sparql_query.getBasicQuery(j).getResultArena());
 
-			temp->results[0].result.reserve(basicquery_result_num);
-			for (int k = 0; k < basicquery_result_num; k++)
-			{
-				unsigned *v = new unsigned[varnum];
-				memcpy(v, basicquery_result[k], sizeof(int) * varnum);
-				temp->results[0].result.push_back(TempResult::ResultPair());
-				temp->results[0].result.back().id = v;
-			}
-
-			if (this->query_cache != NULL && dep == 0)
+			if (this->query_cache != NULL && dep == 0 && this->strategy.getRowLimit() == 0)
 			{
 				//if unconnected, time is incorrect
 				int time = tv_handle - tv_begin;
 
 				long tv_bftry = Util::get_cur_time();
-				bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time);
+				bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time, this->cache_generation);
 				if (success)	printf("QueryCache cached\n");
 				else			printf("QueryCache didn't cache\n");
 				long tv_aftry = Util::get_cur_time();
@@ -1310,7 +1209,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 				// TODO: handle CONTAINS and custom functions
 
 				new_result0.result.push_back(TempResult::ResultPair());
-				new_result0.result.back().id = new unsigned[new_result0_id_cols];
+				new_result0.result.back().id = new_result0.newRow(new_result0_id_cols);
 				new_result0.result.back().str.resize(new_result0_str_cols);
 
 				for (int i = 0; i < new_result0_id_cols; i++)
@@ -1558,7 +1457,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 					end = result0.findRightBounder(group2temp, result0.result[begin], result0_id_cols, group2temp);
 
 				new_result0.result.push_back(TempResult::ResultPair());
-				new_result0.result.back().id = new unsigned[new_result0_id_cols];
+				new_result0.result.back().id = new_result0.newRow(new_result0_id_cols);
 				new_result0.result.back().str.resize(new_result0_str_cols);
 
 				for (int i = 0; i < new_result0_id_cols; i++)
@@ -2053,7 +1952,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 							if (j < end)
 							{
 								new_result0.result.push_back(TempResult::ResultPair());
-								new_result0.result.back().id = new unsigned[new_result0_id_cols];
+								new_result0.result.back().id = new_result0.newRow(new_result0_id_cols);
 								new_result0.result.back().str.resize(new_result0_str_cols);
 							}
 						}
@@ -2147,7 +2046,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 								if (j < end)
 								{
 									new_result0.result.push_back(TempResult::ResultPair());
-									new_result0.result.back().id = new unsigned[new_result0_id_cols];
+									new_result0.result.back().id = new_result0.newRow(new_result0_id_cols);
 									new_result0.result.back().str.resize(new_result0_str_cols);
 								}
 							}
@@ -2283,6 +2182,25 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 								pred_id_set.push_back(j);
 						}
 
+						// The lengths of all the pairs come from one multi-source BFS,
+						// and paths are only searched for the pairs connected
+						vector<int> pairDist;
+						bool batched = uid_ls.size() * vid_ls.size() > 1 && \
+							(proj[i].aggregate_type == QueryTree::ProjectionVar::shortestPath_type || \
+							proj[i].aggregate_type == QueryTree::ProjectionVar::shortestPathLen_type || \
+							proj[i].aggregate_type == QueryTree::ProjectionVar::kHopReachable_type || \
+							proj[i].aggregate_type == QueryTree::ProjectionVar::kHopReachablePath_type);
+						if (batched)
+						{
+							int hopConstraint = INT_MAX;
+							if (proj[i].aggregate_type == QueryTree::ProjectionVar::kHopReachable_type || \
+								proj[i].aggregate_type == QueryTree::ProjectionVar::kHopReachablePath_type)
+								hopConstraint = proj[i].path_args.k < 0 ? 999 : proj[i].path_args.k;
+							pqHandler->batchDistance(uid_ls, vid_ls, proj[i].path_args.directed, hopConstraint, \
+								pred_id_set, pairDist);
+						}
+						int pairIdx = -1;
+
 						// For each u-v pair, query
 						bool exist = 0, earlyBreak = 0;	// Boolean queries can break early with true
 						stringstream ss;
@@ -2292,6 +2210,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 						{
 							for (int vid : vid_ls)
 							{
+								pairIdx++;
 								if (proj[i].aggregate_type == QueryTree::ProjectionVar::cyclePath_type)
 								{
 									if (uid == vid)
@@ -2329,7 +2248,9 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 										pathVec2JSON(uid, vid, path, ss);
 										continue;
 									}
-									vector<int> path = pqHandler->shortestPath(uid, vid, proj[0].path_args.directed, pred_id_set);
+									vector<int> path;
+									if (!batched || pairDist[pairIdx] != -1)
+										path = pqHandler->shortestPath(uid, vid, proj[i].path_args.directed, pred_id_set);
 									if (path.size() != 0)
 									{
 										if (notFirstOutput)
@@ -2352,8 +2273,16 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 											<< "\",\"length\":0}";
 										continue;
 									}
-									vector<int> path = pqHandler->shortestPath(uid, vid, proj[0].path_args.directed, pred_id_set);
-									if (path.size() != 0)
+									int len = -1;
+									if (batched)
+										len = pairDist[pairIdx];
+									else
+									{
+										vector<int> path = pqHandler->shortestPath(uid, vid, proj[i].path_args.directed, pred_id_set);
+										if (path.size() != 0)
+											len = (path.size() - 1) / 2;
+									}
+									if (len != -1)
 									{
 										if (notFirstOutput)
 											ss << ",";
@@ -2361,7 +2290,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 											notFirstOutput = 1;
 										ss << "{\"src\":\"" << kvstore->getStringByID(uid) \
 											<< "\",\"dst\":\"" << kvstore->getStringByID(vid) << "\",\"length\":";
-										ss << (path.size() - 1) / 2;
+										ss << len;
 										ss << "}";
 									}
 								}
@@ -2378,10 +2307,14 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 											<< "\",\"value\":\"true\"}";
 										continue;
 									}
-									int hopConstraint = proj[0].path_args.k;
+									int hopConstraint = proj[i].path_args.k;
 									if (hopConstraint < 0)
 										hopConstraint = 999;
-									bool reachRes = pqHandler->kHopReachable(uid, vid, proj[0].path_args.directed, hopConstraint, pred_id_set);
+									bool reachRes;
+									if (batched)
+										reachRes = pairDist[pairIdx] != -1;
+									else
+										reachRes = pqHandler->kHopReachable(uid, vid, proj[i].path_args.directed, hopConstraint, pred_id_set);
 									ss << "{\"src\":\"" << kvstore->getStringByID(uid) << "\",\"dst\":\"" \
 										<< kvstore->getStringByID(vid) << "\",\"value\":";
 									cout << "src = " << kvstore->getStringByID(uid) << ", dst = " << kvstore->getStringByID(vid) << endl;
@@ -2390,7 +2323,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 									else
 										ss << "\"false\"}";
 								}
-								else if (proj[0].aggregate_type == QueryTree::ProjectionVar::kHopReachablePath_type)
+								else if (proj[i].aggregate_type == QueryTree::ProjectionVar::kHopReachablePath_type)
 								{
 									cout << "begin run  kHopReachablePath " << endl;
 									if (uid == vid)
@@ -2403,10 +2336,12 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 										pathVec2JSON(uid, vid, path, ss);
 										continue;
 									}
-									int hopConstraint = proj[0].path_args.k;
+									int hopConstraint = proj[i].path_args.k;
 									if (hopConstraint < 0)
 										hopConstraint = 999;
-									vector<int> path = pqHandler->kHopReachablePath(uid, vid, proj[0].path_args.directed, hopConstraint, pred_id_set);
+									vector<int> path;
+									if (!batched || pairDist[pairIdx] != -1)
+										path = pqHandler->kHopReachablePath(uid, vid, proj[i].path_args.directed, hopConstraint, pred_id_set);
 									if (path.size() != 0)
 									{
 										if (notFirstOutput)
@@ -2501,15 +2436,47 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 		ret_result.ansNum = (int)result0.result.size();
 		ret_result.setOutputOffsetLimit(this->query_tree.getOffset(), this->query_tree.getLimit());
 
+		vector<int> proj2temp = ret_result_varset.mapTo(result0.getAllVarset());
+		int id_cols = result0.id_varset.getVarsetSize();
+
+		vector<bool> isel;
+		for (int i = 0; i < result0.id_varset.getVarsetSize(); i++)
+			isel.push_back(this->query_tree.getGroupPattern().group_pattern_subject_object_maximal_varset.findVar(result0.id_varset.vars[i]));
+
+		vector <unsigned> keys;
+		vector <bool> desc;
+		for (int i = 0; i < (int)this->query_tree.getOrderVarVector().size(); i++)
+		{
+			// int var_id = Varset(this->query_tree.getOrderVarVector()[i].var).mapTo(ret_result_varset)[0];
+			int var_id = this->query_tree.getOrderVarVector()[i].comp_tree_root.getVarset().mapTo(ret_result_varset)[0];
+			if (var_id != -1)
+			{
+				keys.push_back(var_id);
+				desc.push_back(this->query_tree.getOrderVarVector()[i].descending);
+			}
+		}
+		//with ORDER BY LIMIT only the first OFFSET + LIMIT rows are kept
+		unsigned long long keep_num = ret_result.ansNum;
+		if (!keys.empty() && this->query_tree.getLimit() != -1)
+			keep_num = min(keep_num, (unsigned long long)this->query_tree.getOffset() + this->query_tree.getLimit());
+
 #ifdef STREAM_ON
-		long long ret_result_size = (long long)ret_result.ansNum * (long long)ret_result.select_var_num * 100 / Util::GB;
-		if (Util::memoryLeft() < ret_result_size || !this->query_tree.getOrderVarVector().empty())
+		long long ret_result_size = (long long)keep_num * (long long)ret_result.select_var_num * 100 / Util::GB;
+		if (Util::memoryLeft() < ret_result_size)
 		{
 			ret_result.setUseStream();
 			printf("set use Stream\n");
 		}
 #endif
 
+		//the rows of result0 in ORDER BY order, sorted in memory unless the result goes to Stream
+		vector<unsigned> order_rows;
+		if (!keys.empty() && !ret_result.checkUseStream())
+		{
+			this->orderResult(result0, proj2temp, id_cols, isel, keys, desc, keep_num, order_rows);
+			ret_result.ansNum = order_rows.size();
+		}
+
 		if (!ret_result.checkUseStream())
 		{
 			ret_result.answer = new string*[ret_result.ansNum];
@@ -2518,28 +2485,9 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 		}
 		else
 		{
-			vector <unsigned> keys;
-			vector <bool> desc;
-			for (int i = 0; i < (int)this->query_tree.getOrderVarVector().size(); i++)
-			{
-				// int var_id = Varset(this->query_tree.getOrderVarVector()[i].var).mapTo(ret_result_varset)[0];
-				int var_id = this->query_tree.getOrderVarVector()[i].comp_tree_root.getVarset().mapTo(ret_result_varset)[0];
-				if (var_id != -1)
-				{
-					keys.push_back(var_id);
-					desc.push_back(this->query_tree.getOrderVarVector()[i].descending);
-				}
-			}
 			ret_result.openStream(keys, desc);
 		}
 
-		vector<int> proj2temp = ret_result_varset.mapTo(result0.getAllVarset());
-		int id_cols = result0.id_varset.getVarsetSize();
-
-		vector<bool> isel;
-		for (int i = 0; i < result0.id_varset.getVarsetSize(); i++)
-			isel.push_back(this->query_tree.getGroupPattern().group_pattern_subject_object_maximal_varset.findVar(result0.id_varset.vars[i]));
-
 		if (!ret_result.checkUseStream())
 		{
 
@@ -2618,7 +2566,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 						{
 							for (unsigned i = 0; i < retAnsNum; i++)
 							{
-								unsigned ans_id = result0.result[i].id[k];
+								unsigned ans_id = result0.result[order_rows.empty() ? i : order_rows[i]].id[k];
 								if (ans_id != INVALID)
 								{
 									if (ans_id < Util::LITERAL_FIRST_ID)
@@ -2634,7 +2582,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 						{
 							for (unsigned i = 0; i < retAnsNum; i++)
 							{
-								unsigned ans_id = result0.result[i].id[k];
+								unsigned ans_id = result0.result[order_rows.empty() ? i : order_rows[i]].id[k];
 								if (ans_id != INVALID){
 									//a[2]->addRequest(ans_id, i*selectVar + j);
 									requestVectors[2].push_back(StringIndexFile::AccessRequest(ans_id, i*selectVar + j));
@@ -2646,7 +2594,7 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 					{
 						for (unsigned i = 0; i < retAnsNum; i++)
 						{
-							ret_result.answer[i][j] = result0.result[i].str[k - id_cols];
+							ret_result.answer[i][j] = result0.result[order_rows.empty() ? i : order_rows[i]].str[k - id_cols];
 							// Up to this point the backslashes are hidden
 						}
 					}
@@ -2709,6 +2657,77 @@ void GeneralEvaluation::getFinalResult(ResultSet &ret_result)
 	this->releaseResult();
 }
 
+/**
+	Order the rows of _result by the ORDER BY keys, the columns _keys of the result set with
+	_proj2temp mapping them to _result. Only the key columns are decoded, each distinct ID once.
+
+	@param _keep_num the number of rows wanted, the first ones in order are kept by a bounded
+	heap when it is less than the rows, otherwise all rows are sorted in parallel.
+	@param _rows the rows of _result in order.
+*/
+void GeneralEvaluation::orderResult(TempResult &_result, vector<int> &_proj2temp, int _id_cols, vector<bool> &_isel,
+	vector<unsigned> &_keys, vector<bool> &_desc, unsigned long long _keep_num, vector<unsigned> &_rows)
+{
+	long tv_begin = Util::get_cur_time();
+	unsigned row_num = _result.result.size();
+	ResultOrder result_order(_desc, row_num);
+	for (unsigned i = 0; i < _keys.size(); i++)
+	{
+		int k = _proj2temp[_keys[i]];
+		if (k == -1)
+			continue;
+		if (k >= _id_cols)
+		{
+			for (unsigned j = 0; j < row_num; j++)
+				result_order.setKey(j, i, result_order.addValue(_result.result[j].str[k - _id_cols]));
+			continue;
+		}
+
+		//read the strings of the distinct IDs of this column in one pass over the string index
+		unordered_map<unsigned, unsigned> id2pos;
+		vector<unsigned> ids;
+		for (unsigned j = 0; j < row_num; j++)
+		{
+			unsigned ans_id = _result.result[j].id[k];
+			if (ans_id != INVALID && id2pos.insert(make_pair(ans_id, (unsigned)ids.size())).second)
+				ids.push_back(ans_id);
+		}
+		std::vector<StringIndexFile::AccessRequest> requestVectors[3];
+		for (unsigned p = 0; p < ids.size(); p++)
+		{
+			if (!_isel[k])
+				requestVectors[2].push_back(StringIndexFile::AccessRequest(ids[p], p));
+			else if (ids[p] < Util::LITERAL_FIRST_ID)
+				requestVectors[0].push_back(StringIndexFile::AccessRequest(ids[p], p));
+			else
+				requestVectors[1].push_back(StringIndexFile::AccessRequest(ids[p] - Util::LITERAL_FIRST_ID, p));
+		}
+		vector<string> strs(ids.size());
+		if (!ids.empty())
+			this->stringindex->trySequenceAccess(requestVectors, &strs[0], true, -1);
+
+		vector<unsigned> pos2value(ids.size());
+		for (unsigned p = 0; p < ids.size(); p++)
+			pos2value[p] = result_order.addValue(strs[p]);
+		for (unsigned j = 0; j < row_num; j++)
+		{
+			unsigned ans_id = _result.result[j].id[k];
+			if (ans_id != INVALID)
+				result_order.setKey(j, i, pos2value[id2pos[ans_id]]);
+		}
+	}
+	long tv_decode = Util::get_cur_time();
+
+	unsigned parallelism = 1;
+	string parallelism_str = Util::getConfigureValue("query_parallelism");
+	if (!parallelism_str.empty() && atoi(parallelism_str.c_str()) >= 0)
+		parallelism = atoi(parallelism_str.c_str());
+	result_order.order(_keep_num, parallelism, _rows);
+	long tv_order = Util::get_cur_time();
+	printf("order by: %u rows, %u distinct keys decoded in %ld ms, %s in %ld ms.\n", row_num, result_order.getValueNum() - 1,
+		tv_decode - tv_begin, _keep_num < row_num ? "top-k" : "sorted", tv_order - tv_decode);
+}
+
 void GeneralEvaluation::releaseResult()
 {
 	if (this->temp_result == NULL)
@@ -2842,6 +2861,29 @@ GeneralEvaluation::pathVec2JSON(int src, int dst, const vector<int> &v, stringst
 	ss << "]}";
 }
 
+/**
+	The rows needed from each BGP when LIMIT can be pushed into the join, 0 if not.
+	That is OFFSET + LIMIT for a SELECT of triple patterns only, without DISTINCT, ORDER BY,
+	GROUP BY or aggregates, whose BGP results are the query result as they are.
+*/
+unsigned long long GeneralEvaluation::getPushdownRowLimit()
+{
+	if (this->query_tree.getQueryForm() != QueryTree::Select_Query || this->query_tree.getLimit() < 0)
+		return 0;
+	if (this->query_tree.getProjectionModifier() != QueryTree::Modifier_None)
+		return 0;
+	if (!this->query_tree.getOrderVarVector().empty() || !this->query_tree.getGroupByVarset().empty()
+		|| this->query_tree.checkAtLeastOneAggregateFunction())
+		return 0;
+
+	QueryTree::GroupPattern &group_pattern = this->query_tree.getGroupPattern();
+	for (int i = 0; i < (int)group_pattern.sub_group_pattern.size(); i++)
+		if (group_pattern.sub_group_pattern[i].type != QueryTree::GroupPattern::SubGroupPattern::Pattern_type)
+			return 0;
+
+	return (unsigned long long)this->query_tree.getOffset() + this->query_tree.getLimit();
+}
+
 int GeneralEvaluation::constructTriplePattern(QueryTree::GroupPattern& triple_pattern, int dep)
 {
 	int group_pattern_triple_num = 0;
@@ -3060,27 +3102,17 @@ void GeneralEvaluation::joinBasicQueryResult(SPARQLquery& sparql_query, TempResu
 		temp->results.push_back(TempResult());
 
 		temp->results[0].id_varset = Varset(encode_varset[j]);
-		int varnum = (int)encode_varset[j].size();
 
 		vector<unsigned*> &basicquery_result = sparql_query.getBasicQuery(j).getResultList();
-		int basicquery_result_num = (int)basicquery_result.size();
-
-		temp->results[0].result.reserve(basicquery_result_num);
-		for (int k = 0; k < basicquery_result_num; k++)
-		{
-			unsigned *v = new unsigned[varnum];
-			memcpy(v, basicquery_result[k], sizeof(int) * varnum);
-			temp->results[0].result.push_back(TempResult::ResultPair());
-			temp->results[0].result.back().id = v;
-		}
+		temp->results[0].adoptRows(basicquery_result, sparql_query.getBasicQuery(j).getResultArena());
 
-		if (this->query_cache != NULL && dep == 0)
+		if (this->query_cache != NULL && dep == 0 && this->strategy.getRowLimit() == 0)
 		{
 			//if unconnected, time is incorrect
 			int time = tv_handle - tv_begin;
 
 			long tv_bftry = Util::get_cur_time();
-			bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time);
+			bool success = this->query_cache->tryCaching(basic_query_handle[j], temp->results[0], time, this->cache_generation);
 			if (success)	printf("QueryCache cached\n");
 			else			printf("QueryCache didn't cache\n");
 			long tv_aftry = Util::get_cur_time();
@@ -18,6 +18,7 @@
 #include "../Util/Triple.h"
 #include "../Util/Util.h"
 #include "../Util/EvalMultitypeValue.h"
+#include "../Util/ResultOrder.h"
 #include "SPARQLquery.h"
 #include "QueryTree.h"
 #include "Varset.h"
@@ -37,6 +38,7 @@ class GeneralEvaluation
 		StringIndex *stringindex;
 		Strategy strategy;
 		QueryCache *query_cache;
+		unsigned long long cache_generation;	//of query_cache when the query began
 		PathQueryHandler *pqHandler;
 		int well_designed;
 
@@ -48,6 +50,8 @@ class GeneralEvaluation
 		TYPE_ENTITY_LITERAL_ID limitID_entity;
 		CSR *csr;
 		shared_ptr<Transaction> txn;
+		Statistics *statistics;
+		std::vector<PlanCache::JoinPlan> *join_plans;
     public:
     	FILE* fp;
     	bool export_flag;
@@ -56,12 +60,17 @@ class GeneralEvaluation
 		GeneralEvaluation(VSTree *_vstree, KVstore *_kvstore, StringIndex *_stringindex, QueryCache *_query_cache, \
 			TYPE_TRIPLE_NUM *_pre2num,TYPE_TRIPLE_NUM *_pre2sub, TYPE_TRIPLE_NUM *_pre2obj, \
 			TYPE_PREDICATE_ID _limitID_predicate, TYPE_ENTITY_LITERAL_ID _limitID_literal, \
-			TYPE_ENTITY_LITERAL_ID _limitID_entity, CSR *_csr, shared_ptr<Transaction> txn = nullptr);
+			TYPE_ENTITY_LITERAL_ID _limitID_entity, CSR *_csr, shared_ptr<Transaction> txn = nullptr, \
+			Statistics *_statistics = NULL);
 
 		~GeneralEvaluation();
 
 		bool parseQuery(const std::string &_query);
+		//take a query parsed before(i.e. from the PlanCache) instead of parsing it
+		void setQueryTree(const QueryTree &_query_tree);
 		QueryTree& getQueryTree();
+		//the join orders cached for the query, used and filled by Join(NULL for none)
+		void setJoinPlans(std::vector<PlanCache::JoinPlan> *_join_plans);
 
 		bool doQuery();
 
@@ -92,6 +101,9 @@ class GeneralEvaluation
 		void prepPathQuery();
 		void pathVec2JSON(int src, int dst, const std::vector<int> &v, std::stringstream &ss);
 
+		unsigned long long getPushdownRowLimit();
+		void orderResult(TempResult &_result, std::vector<int> &_proj2temp, int _id_cols, std::vector<bool> &_isel,
+			std::vector<unsigned> &_keys, std::vector<bool> &_desc, unsigned long long _keep_num, std::vector<unsigned> &_rows);
 		int constructTriplePattern(QueryTree::GroupPattern& triple_pattern, int dep);
 		void getUsefulVarset(Varset& useful, int dep);
 		bool checkBasicQueryCache(vector<QueryTree::GroupPattern::Pattern>& basic_query, TempResultSet *&sub_result, Varset& useful);
@@ -7,6 +7,7 @@
 =============================================================================*/
 
 #include "IDList.h"
+#include "../Util/ListIntersect.h"
 
 using namespace std;
 
@@ -136,118 +137,24 @@ IDList::intersectList(const unsigned* _id_list, unsigned _list_len)
 		return remove_number;
 	}
 
-	//when size is almost the same, intersect O(n)
-	//when one size is small ratio, search in the larger one O(mlogn)
-	//
-	//n>0 m=nk(0<k<1) 
-	//compare n(k+1) and nklogn: k0 = log(n/2)2 requiring that n>2
-	//k<=k0 binary search; k>k0 intersect
-	int method = -1; //0: intersect 1: search in vector 2: search in int*
+	//ListIntersect chooses among SIMD merge and galloping by the size ratio
 	unsigned n = this->id_list.size();
-	double k = 0;
-	if (n < _list_len)
-	{
-		k = (double)n / (double)_list_len;
-		n = _list_len;
-		method = 2;
-	}
-	else
-	{
-		k = (double)_list_len / (double)n;
-		method = 1;
-	}
-	if (n <= 2)
-		method = 0;
-	else
-	{
-		double limit = Util::logarithm(n / 2, 2);
-		if (k > limit)
-			method = 0;
-	}
-
-	int remove_number = 0;
-	switch (method)
-	{
-	case 0:
-	{   //this bracket is needed if vars are defined in case
-		unsigned id_i = 0;
-		unsigned index_move_forward = 0;
-		vector<unsigned>::iterator it = this->id_list.begin();
-		while (it != (this->id_list).end())
-		{
-			unsigned can_id = *it;
-			while ((id_i < _list_len) && (_id_list[id_i] < can_id))
-			{
-				id_i++;
-			}
-
-			if (id_i == _list_len)
-			{
-				break;
-			}
-
-			if (can_id == _id_list[id_i])
-			{
-				(this->id_list)[index_move_forward] = can_id;
-				index_move_forward++;
-				id_i++;
-			}
-
-			it++;
-		}
-		remove_number = this->id_list.size() - index_move_forward;
-		vector<unsigned>::iterator new_end = this->id_list.begin() + index_move_forward;
-		(this->id_list).erase(new_end, this->id_list.end());
-		break;
-	}
-	case 1:
-	{
-		vector<unsigned> new_id_list;
-		for (unsigned i = 0; i < _list_len; ++i)
-		{
-			if (Util::bsearch_vec_uporder(_id_list[i], this->getList()) != INVALID)
-				new_id_list.push_back(_id_list[i]);
-		}
-		this->id_list = new_id_list;
-		remove_number = n - this->id_list.size();
-		break;
-	}
-	case 2:
-	{
-		vector<unsigned> new_id_list;
-		unsigned m = this->id_list.size(), i;
-		for (i = 0; i < m; ++i)
-		{
-			if (Util::bsearch_int_uporder(this->id_list[i], _id_list, _list_len) != INVALID)
-				new_id_list.push_back(this->id_list[i]);
-		}
-		this->id_list = new_id_list;
-		remove_number = m - this->id_list.size();
-		break;
-	}
-	default:
-		cout << "no such method in IDList::intersectList()" << endl;
-		break;
-	}
+	if (n == 0)
+		return 0;
+	vector<unsigned> new_id_list(n < _list_len ? n : _list_len);
+	unsigned num = ListIntersect::intersect(&this->id_list[0], n, _id_list, _list_len, &new_id_list[0]);
+	new_id_list.resize(num);
+	this->id_list.swap(new_id_list);
 
-	return remove_number;
+	return n - num;
 }
 
 unsigned
 IDList::intersectList(const IDList& _id_list)
 {
-	// copy _id_list to the temp array first.
-	unsigned temp_list_len = _id_list.size();
-	unsigned* temp_list = new unsigned[temp_list_len];
-	//BETTER:not to copy, just achieve here
-	for (unsigned i = 0; i < temp_list_len; i++)
-	{
-		temp_list[i] = _id_list.getID(i);
-	}
-
-	unsigned remove_number = this->intersectList(temp_list, temp_list_len);
-	delete[] temp_list;
-	return remove_number;
+	if (_id_list.empty())
+		return this->intersectList(NULL, 0);
+	return this->intersectList(&(*_id_list.getList())[0], _id_list.size());
 }
 
 unsigned
@@ -376,95 +283,13 @@ IDList*
 IDList::intersect(const IDList& _id_list, const unsigned* _list, unsigned _len)
 {
 	IDList* p = new IDList;
-	//if (_list == NULL || _len == 0)  //just copy _id_list
-	//{
-		//int size = _id_list.size();
-		//for (int i = 0; i < size; ++i)
-			//p->addID(_id_list.getID(i));
-		//return p;
-	//}
-
-	//when size is almost the same, intersect O(n)
-	//when one size is small ratio, search in the larger one O(mlogn)
-	//
-	//n>0 m=nk(0<k<1) 
-	//compare n(k+1) and nklogn: k0 = log(n/2)2 requiring that n>2
-	//k<=k0 binary search; k>k0 intersect
-	int method = -1; //0: intersect 1: search in vector 2: search in int*
 	unsigned n = _id_list.size();
-	double k = 0;
-	if (n < _len)
-	{
-		k = (double)n / (double)_len;
-		n = _len;
-		method = 2;
-	}
-	else
-	{
-		k = (double)_len / (double)n;
-		method = 1;
-	}
-	if (n <= 2)
-		method = 0;
-	else
-	{
-		double limit = Util::logarithm(n / 2, 2);
-		if (k > limit)
-			method = 0;
-	}
-
-	//int remove_number = 0;
-	switch (method)
-	{
-	case 0:
-	{   //this bracket is needed if vars are defined in case
-		unsigned id_i = 0;
-		unsigned num = _id_list.size();
-		for (unsigned i = 0; i < num; ++i)
-		{
-			unsigned can_id = _id_list.getID(i);
-			while ((id_i < _len) && (_list[id_i] < can_id))
-			{
-				id_i++;
-			}
+	if (_list == NULL || _len == 0 || n == 0)
+		return p;
 
-			if (id_i == _len)
-			{
-				break;
-			}
-
-			if (can_id == _list[id_i])
-			{
-				p->addID(can_id);
-				id_i++;
-			}
-		}
-		break;
-	}
-	case 1:
-	{
-		for (unsigned i = 0; i < _len; ++i)
-		{
-			if (Util::bsearch_vec_uporder(_list[i], _id_list.getList()) != INVALID)
-				p->addID(_list[i]);
-		}
-		break;
-	}
-	case 2:
-	{
-		unsigned m = _id_list.size(), i;
-		for (i = 0; i < m; ++i)
-		{
-			unsigned t = _id_list.getID(i);
-			if (Util::bsearch_int_uporder(t, _list, _len) != INVALID)
-				p->addID(t);
-		}
-		break;
-	}
-	default:
-		cout << "no such method in IDList::intersectList()" << endl;
-		break;
-	}
+	p->id_list.resize(n < _len ? n : _len);
+	unsigned num = ListIntersect::intersect(&(*_id_list.getList())[0], n, _list, _len, &p->id_list[0]);
+	p->id_list.resize(num);
 
 	return p;
 }
@@ -31,6 +31,7 @@ public:
 	void copy(const IDList* _new_idlist);
 
 	// intersect/union _id_list to this IDList, note that the two list must be ordered before using these two functions.
+	// intersectList() also requires that neither list contains duplicates.
 	unsigned intersectList(const unsigned* _id_list, unsigned _list_len);
 	unsigned intersectList(const IDList&);
 	unsigned unionList(const unsigned* _id_list, unsigned _list_len, bool only_literal=false);
@@ -8,23 +8,45 @@ PathQueryHandler::PathQueryHandler(CSR *_csr)
 		csr = _csr;
 	else
 		csr = new CSR[2];
-	cacheMaxSize = 10000;
+	lastDistinctVid[0] = lastDistinctVid[1] = -1;
 	n = -1;
 	m = -1;
 	srand(time(NULL));
+	vertBound = -1;
+	pool = NULL;
+	workerNext.resize(1);
+	workerRng.push_back(mt19937_64(random_device()()));
+	parallelism = 1;
+	string parallelismStr = Util::getConfigureValue("query_parallelism");
+	if (!parallelismStr.empty() && atoi(parallelismStr.c_str()) >= 0)
+		parallelism = atoi(parallelismStr.c_str());
+}
+
+PathQueryHandler::~PathQueryHandler()
+{
+	delete pool;
 }
 
 int PathQueryHandler::getVertNum()
 {
 	if (n != -1)
 		return n;	// Only consider static graphs for now
-	set<int> vertices;
+	vector<bool> vertices(getVertBound());
+	n = 0;
 	for (int j = 0; j < 2; j++)
 	{
 		for (int i = 0; i < csr[j].pre_num; i++)
-			vertices.insert(csr[j].adjacency_list[i].begin(), csr[j].adjacency_list[i].end());
+		{
+			for (unsigned v : csr[j].adjacency_list[i])
+			{
+				if (!vertices[v])
+				{
+					vertices[v] = true;
+					n++;
+				}
+			}
+		}
 	}
-	n = vertices.size();
 	return n;
 }
 
@@ -47,12 +69,25 @@ int PathQueryHandler::getSetEdgeNum(const vector<int> &pred_set)
 	return ret;
 }
 
+// The last list is kept, so walking a vertex's neighbors by position does not look up the cache each time
+NeighborCache::List PathQueryHandler::getDistinctNeighbors(int dir, int vid)
+{
+	if (vid != lastDistinctVid[dir] || !lastDistinctList[dir])
+	{
+		if (vid < 0)
+			lastDistinctList[dir].reset(new vector<unsigned>);
+		else
+			lastDistinctList[dir] = csr[dir].getDistinctNeighbors(vid);
+		lastDistinctVid[dir] = vid;
+	}
+	return lastDistinctList[dir];
+}
+
 int PathQueryHandler::getInIndexByID(int vid, int pred)
 {
-	if (csr[1].vid2id[pred].find(vid) != csr[1].vid2id[pred].end())
-		return csr[1].vid2id[pred][vid];
-	else
+	if (vid < 0)
 		return -1;
+	return csr[1].getIndex(vid, pred);
 }
 
 int PathQueryHandler::getInSize(int vid, int pred)
@@ -60,10 +95,8 @@ int PathQueryHandler::getInSize(int vid, int pred)
 	int vIndex = getInIndexByID(vid, pred);
 	if (vIndex == -1)	// This vertex does not participate in this pred's relations
 		return 0;
-	else if (vIndex == csr[1].offset_list[pred].size() - 1)
-		return csr[1].adjacency_list[pred].size() - csr[1].offset_list[pred][vIndex];
 	else
-		return csr[1].offset_list[pred][vIndex + 1] - csr[1].offset_list[pred][vIndex];
+		return csr[1].getDegree(vIndex, pred);
 }
 
 int PathQueryHandler::getInVertID(int vid, int pred, int pos)
@@ -76,11 +109,9 @@ int PathQueryHandler::getInVertID(int vid, int pred, int pos)
 
 int PathQueryHandler::getInVertID(int vid, int pos)
 {
-	if (distinctInEdges.find(vid) == distinctInEdges.end())
-		getTotalInSize(vid, true);	// Load into cache
-
-	if (pos < distinctInEdges[vid].size())
-		return *next(distinctInEdges[vid].begin(), pos);
+	NeighborCache::List nbrs = getDistinctInNeighbors(vid);
+	if (pos >= 0 && pos < (int)nbrs->size())
+		return (*nbrs)[pos];
 	else
 		return -1;
 }
@@ -102,42 +133,15 @@ int PathQueryHandler::getTotalInSize(int vid, bool distinct)
 			ret += getInSize(vid, i);
 	}
 	else
-	{
-		if (distinctInEdges.find(vid) == distinctInEdges.end())
-		{
-			if (distinctInEdges.size() == cacheMaxSize)
-			{
-				int replacement = rand() % cacheMaxSize;
-				distinctInEdges.erase(next(distinctInEdges.begin(), replacement));
-				// cout << "distinctInEdges replaced entry " << replacement << endl;
-			}
-
-			distinctInEdges[vid] = set<int>();
-			for (int pred = 0; pred < csr[1].pre_num; pred++)
-			{
-				int vIndex = getInIndexByID(vid, pred);
-				if (vIndex == -1)	// This vertex does not participate in this pred's relations
-					continue;
-				else if (vIndex == csr[1].offset_list[pred].size() - 1 \
-					&& csr[1].adjacency_list[pred].size() > csr[1].offset_list[pred][vIndex])
-					distinctInEdges[vid].insert(next(csr[1].adjacency_list[pred].begin(), csr[1].offset_list[pred][vIndex]), \
-						csr[1].adjacency_list[pred].end());
-				else if (csr[1].offset_list[pred][vIndex + 1] > csr[1].offset_list[pred][vIndex])
-					distinctInEdges[vid].insert(next(csr[1].adjacency_list[pred].begin(), csr[1].offset_list[pred][vIndex]), \
-						next(csr[1].adjacency_list[pred].begin(), csr[1].offset_list[pred][vIndex + 1]));
-			}
-		}
-		ret = distinctInEdges[vid].size();
-	}
+		ret = getDistinctInNeighbors(vid)->size();
 	return ret;
 }
 
 int PathQueryHandler::getOutIndexByID(int vid, int pred)
 {
-	if (csr[0].vid2id[pred].find(vid) != csr[0].vid2id[pred].end())
-		return csr[0].vid2id[pred][vid];
-	else
+	if (vid < 0)
 		return -1;
+	return csr[0].getIndex(vid, pred);
 }
 
 int PathQueryHandler::getOutSize(int vid, int pred)
@@ -145,10 +149,8 @@ int PathQueryHandler::getOutSize(int vid, int pred)
 	int vIndex = getOutIndexByID(vid, pred);
 	if (vIndex == -1)	// This vertex does not participate in this pred's relations
 		return 0;
-	else if (vIndex == csr[0].offset_list[pred].size() - 1)
-		return csr[0].adjacency_list[pred].size() - csr[0].offset_list[pred][vIndex];
 	else
-		return csr[0].offset_list[pred][vIndex + 1] - csr[0].offset_list[pred][vIndex];
+		return csr[0].getDegree(vIndex, pred);
 }
 
 int PathQueryHandler::getOutVertID(int vid, int pred, int pos)
@@ -161,11 +163,9 @@ int PathQueryHandler::getOutVertID(int vid, int pred, int pos)
 
 int PathQueryHandler::getOutVertID(int vid, int pos)
 {
-	if (distinctOutEdges.find(vid) == distinctOutEdges.end())
-		getTotalOutSize(vid, true);	// Load into cache
-
-	if (pos < distinctOutEdges[vid].size())
-		return *next(distinctOutEdges[vid].begin(), pos);
+	NeighborCache::List nbrs = getDistinctOutNeighbors(vid);
+	if (pos >= 0 && pos < (int)nbrs->size())
+		return (*nbrs)[pos];
 	else
 		return -1;
 }
@@ -187,33 +187,7 @@ int PathQueryHandler::getTotalOutSize(int vid, bool distinct)
 			ret += getOutSize(vid, i);
 	}
 	else
-	{
-		if (distinctOutEdges.find(vid) == distinctOutEdges.end())
-		{
-			if (distinctOutEdges.size() == cacheMaxSize)
-			{
-				int replacement = rand() % cacheMaxSize;
-				distinctOutEdges.erase(next(distinctOutEdges.begin(), replacement));
-				// cout << "distinctInEdges replaced entry " << replacement << endl;
-			}
-
-			distinctOutEdges[vid] = set<int>();
-			for (int pred = 0; pred < csr[1].pre_num; pred++)
-			{
-				int vIndex = getOutIndexByID(vid, pred);
-				if (vIndex == -1)	// This vertex does not participate in this pred's relations
-					continue;
-				else if (vIndex == csr[0].offset_list[pred].size() - 1 \
-					&& csr[0].adjacency_list[pred].size() > csr[0].offset_list[pred][vIndex])
-					distinctOutEdges[vid].insert(next(csr[0].adjacency_list[pred].begin(), csr[0].offset_list[pred][vIndex]), \
-						csr[0].adjacency_list[pred].end());
-				else if (csr[0].offset_list[pred][vIndex + 1] > csr[0].offset_list[pred][vIndex])
-					distinctOutEdges[vid].insert(next(csr[0].adjacency_list[pred].begin(), csr[0].offset_list[pred][vIndex]), \
-						next(csr[0].adjacency_list[pred].begin(), csr[0].offset_list[pred][vIndex + 1]));
-			}
-		}
-		ret = distinctOutEdges[vid].size();
-	}
+		ret = getDistinctOutNeighbors(vid)->size();
 	return ret;
 }
 
@@ -226,6 +200,7 @@ void PathQueryHandler::inputGraph(string filename)
 	infile >> n >> numLabel;
 	csr[0].init(numLabel);
 	csr[1].init(numLabel);
+	lastDistinctVid[0] = lastDistinctVid[1] = -1;
 
 	int **indegree = new int*[numLabel];
 	int **outdegree = new int*[numLabel];
@@ -277,32 +252,26 @@ void PathQueryHandler::inputGraph(string filename)
 	}
 	infile.close();
 
-	int *pointer_outAdj = new int[numLabel];
-	int *pointer_inAdj = new int[numLabel];
-	memset(pointer_outAdj, 0, numLabel * sizeof(int));
-	memset(pointer_inAdj, 0, numLabel * sizeof(int));
 	for (int i = 0; i < numLabel; i++)
 	{
+		vector<unsigned> ids(n), out_offsets(n + 1), in_offsets(n + 1), out_adj, in_adj;
 		for (int j = 0; j < n; j++)
 		{
-			csr[0].id2vid[i].push_back(j);
-			csr[0].vid2id[i][j] = j;
-			csr[0].offset_list[i].push_back(pointer_outAdj[i]);
-			for (int k = 0; k < outdegree[i][j]; k++)
-			{
-				csr[0].adjacency_list[i].push_back(outAdjList[i][j][k]);
-				pointer_outAdj[i]++;
-			}
-
-			csr[1].id2vid[i].push_back(j);
-			csr[1].vid2id[i][j] = j;
-			csr[1].offset_list[i].push_back(pointer_inAdj[i]);
-			for (int k = 0; k < indegree[i][j]; k++)
-			{
-				csr[1].adjacency_list[i].push_back(inAdjList[i][j][k]);
-				pointer_inAdj[i]++;
-			}
+			ids[j] = j;
+			out_offsets[j] = out_adj.size();
+			out_adj.insert(out_adj.end(), outAdjList[i][j], outAdjList[i][j] + outdegree[i][j]);
+			in_offsets[j] = in_adj.size();
+			in_adj.insert(in_adj.end(), inAdjList[i][j], inAdjList[i][j] + indegree[i][j]);
 		}
+		out_offsets[n] = out_adj.size();
+		in_offsets[n] = in_adj.size();
+		vector<unsigned> in_ids(ids);
+		csr[0].id2vid[i].assign(ids);
+		csr[0].offset_list[i].assign(out_offsets);
+		csr[0].adjacency_list[i].assign(out_adj);
+		csr[1].id2vid[i].assign(in_ids);
+		csr[1].offset_list[i].assign(in_offsets);
+		csr[1].adjacency_list[i].assign(in_adj);
 	}
 
 	for (int i = 0; i < numLabel; i++)
@@ -331,8 +300,6 @@ void PathQueryHandler::inputGraph(string filename)
 	}
 	delete[] pointer_in;
 	delete[] pointer_out;
-	delete[] pointer_outAdj;
-	delete[] pointer_inAdj;
 }
 
 void PathQueryHandler::printCSR()
@@ -573,6 +540,195 @@ std::vector<int> PathQueryHandler::cycle(int uid, int vid, bool directed,
 	}
 }
 
+/**
+	Multi-source BFS from up to 64 sources at once: each vertex keeps a bit for
+	every source that has reached it, so one scan of a vertex's edges advances
+	all the sources at it. Levels are expanded in parallel, top-down or, when
+	many vertices are active, bottom-up(each vertex ors the bits of its
+	neighbors), and the search stops when every source has reached every
+	target, or after k levels.
+
+	@param tgts the targets, in increasing order.
+	@param dist set dist[i * tgts.size() + j] to the distance from srcs[i] to
+	tgts[j], left as is if it is above k.
+*/
+void PathQueryHandler::msBFS(const int *srcs, int srcNum, const vector<int> &tgts, bool directed, int k, \
+	const vector<int> &pred_set, int *dist)
+{
+	if (msSeen.size() != (size_t)vertBound)
+	{
+		msSeen.assign(vertBound, 0);
+		msVisit.assign(vertBound, 0);
+		msVisitNext.assign(vertBound, 0);
+	}
+	int dirs[2], dirNum = 0;
+	dirs[dirNum++] = 0;
+	if (!directed)
+		dirs[dirNum++] = 1;
+	long long candidateNum = 0;
+	for (int pred : pred_set)
+		candidateNum += csr[0].id2vid[pred].size() + csr[1].id2vid[pred].size();
+	candidateNum = min(candidateNum, (long long)vertBound);
+	unsigned long long allBits = srcNum == 64 ? ~0ULL : (1ULL << srcNum) - 1;
+	vector<BottomUpTask> tasks;
+
+	vector<int> active, touched;
+	long long remaining = (long long)srcNum * tgts.size();
+	for (int i = 0; i < srcNum; i++)
+	{
+		msSeen[srcs[i]] = msVisit[srcs[i]] = 1ULL << i;
+		active.push_back(srcs[i]);
+		vector<int>::const_iterator it = lower_bound(tgts.begin(), tgts.end(), srcs[i]);
+		if (it != tgts.end() && *it == srcs[i])
+		{
+			dist[i * tgts.size() + (it - tgts.begin())] = 0;
+			remaining--;
+		}
+	}
+	touched = active;
+
+	for (int level = 1; level <= k && !active.empty() && remaining > 0; level++)
+	{
+		for (size_t i = 0; i < workerNext.size(); i++)
+			workerNext[i].clear();
+		// msSeen and msVisit are only read here, msVisitNext is or-ed atomically
+		if ((long long)active.size() * BFS_ALPHA > candidateNum)
+		{
+			if (tasks.empty())
+				getBottomUpTasks(dirs, dirNum, pred_set, tasks);
+			runTasks(tasks.size(), [&](unsigned worker, unsigned long taskId)
+			{
+				const BottomUpTask &task = tasks[taskId];
+				const CSR &c = csr[task.dir];
+				vector<int> &next = workerNext[worker];
+				size_t end = min(c.id2vid[task.pred].size(), (size_t)task.begin + BFS_BOTTOM_UP_MORSEL);
+				const unsigned *adj = c.adjacency_list[task.pred].begin();
+				for (size_t i = task.begin; i < end; i++)
+				{
+					int v = c.id2vid[task.pred][i];
+					if (msSeen[v] == allBits)
+						continue;
+					unsigned long long bits = 0;
+					for (unsigned e = c.offset_list[task.pred][i]; e < c.offset_list[task.pred][i + 1]; e++)
+						bits |= msVisit[adj[e]];
+					bits &= ~msSeen[v];
+					if (bits != 0 && __atomic_fetch_or(&msVisitNext[v], bits, __ATOMIC_RELAXED) == 0)
+						next.push_back(v);
+				}
+			});
+		}
+		else
+		{
+			unsigned long taskNum = (active.size() + BFS_TOP_DOWN_MORSEL - 1) / BFS_TOP_DOWN_MORSEL;
+			runTasks(taskNum, [&](unsigned worker, unsigned long task)
+			{
+				vector<int> &next = workerNext[worker];
+				size_t end = min(active.size(), (size_t)(task + 1) * BFS_TOP_DOWN_MORSEL);
+				for (size_t i = task * BFS_TOP_DOWN_MORSEL; i < end; i++)
+				{
+					int u = active[i];
+					unsigned long long mask = msVisit[u];
+					for (int j = 0; j < dirNum; j++)
+					{
+						const CSR &c = csr[dirs[j]];
+						for (int pred : pred_set)
+						{
+							int index = c.getIndex(u, pred);
+							if (index == -1)
+								continue;
+							const unsigned *adj = c.adjacency_list[pred].begin();
+							for (unsigned e = c.offset_list[pred][index]; e < c.offset_list[pred][index + 1]; e++)
+							{
+								int v = adj[e];
+								unsigned long long bits = mask & ~msSeen[v];
+								if (bits == 0)
+									continue;
+								if (__atomic_fetch_or(&msVisitNext[v], bits, __ATOMIC_RELAXED) == 0)
+									next.push_back(v);
+							}
+						}
+					}
+				}
+			});
+		}
+
+		for (int u : active)
+			msVisit[u] = 0;
+		active.clear();
+		for (size_t i = 0; i < workerNext.size(); i++)
+			active.insert(active.end(), workerNext[i].begin(), workerNext[i].end());
+		for (int v : active)
+		{
+			unsigned long long bits = msVisitNext[v];
+			msVisitNext[v] = 0;
+			msSeen[v] |= bits;
+			msVisit[v] = bits;
+			touched.push_back(v);
+			vector<int>::const_iterator it = lower_bound(tgts.begin(), tgts.end(), v);
+			if (it == tgts.end() || *it != v)
+				continue;
+			for (; bits != 0; bits &= bits - 1)
+			{
+				dist[__builtin_ctzll(bits) * tgts.size() + (it - tgts.begin())] = level;
+				remaining--;
+			}
+		}
+	}
+
+	for (int v : touched)
+		msSeen[v] = 0;
+	for (int v : active)
+		msVisit[v] = 0;
+}
+
+void PathQueryHandler::batchDistance(const vector<int> &uids, const vector<int> &vids, bool directed, int k, \
+	const vector<int> &pred_set, vector<int> &dist)
+{
+	dist.assign(uids.size() * vids.size(), -1);
+	int bound = getVertBound();
+	vector<int> preds;
+	getValidPreds(pred_set, preds);
+
+	// Search from each distinct source once, 64 of them at a time
+	vector<int> srcs, tgts;
+	for (int uid : uids)
+	{
+		if (uid >= 0 && uid < bound)
+			srcs.push_back(uid);
+	}
+	for (int vid : vids)
+	{
+		if (vid >= 0 && vid < bound)
+			tgts.push_back(vid);
+	}
+	sort(srcs.begin(), srcs.end());
+	srcs.erase(unique(srcs.begin(), srcs.end()), srcs.end());
+	sort(tgts.begin(), tgts.end());
+	tgts.erase(unique(tgts.begin(), tgts.end()), tgts.end());
+	vector<int> srcDist(srcs.size() * tgts.size(), -1);
+	if (!tgts.empty())
+	{
+		for (size_t i = 0; i < srcs.size(); i += 64)
+			msBFS(&srcs[i], min((size_t)64, srcs.size() - i), tgts, directed, k, preds, &srcDist[i * tgts.size()]);
+	}
+
+	for (size_t i = 0; i < uids.size(); i++)
+	{
+		for (size_t j = 0; j < vids.size(); j++)
+		{
+			if (uids[i] == vids[j])
+			{
+				dist[i * vids.size() + j] = 0;
+				continue;
+			}
+			vector<int>::iterator s = lower_bound(srcs.begin(), srcs.end(), uids[i]);
+			vector<int>::iterator t = lower_bound(tgts.begin(), tgts.end(), vids[j]);
+			if (s != srcs.end() && *s == uids[i] && t != tgts.end() && *t == vids[j])
+				dist[i * vids.size() + j] = srcDist[(s - srcs.begin()) * tgts.size() + (t - tgts.begin())];
+		}
+	}
+}
+
 /**
 	Compute and return the shortest path between vertices u and v, with the
 	constraint that all edges in the path are labeled by labels in pred_set.
@@ -736,255 +892,357 @@ vector<int> PathQueryHandler::shortestPath0(int uid, int vid, bool directed, con
 	return ans;
 }
 
-/**
-	Compute and return the shortest path between vertices u and v, with the
-	constraint that all edges in the path are labeled by labels in pred_set.
-
-	@param uid the vertex u's ID.
-	@param vid the vertex v's ID.
-	@param directed if false, treat all edges in the graph as bidirectional.
-	@param pred_set the set of edge labels allowed.
-	@return a vector of vertex IDs representing the shortest path, shaped like
-	[v0, pred0, v1, pred1, ..., vk, predk, vk+1], where v0 = u, vk+1 = v, 
-	and predi labels the edge from vi to vi+1.
-
-	cost more time.
-	use dis_u, dis_v to record the distance from u,v to any node.
-	use bbfs to get the meet node.
-	get the route through searching the distance and meet node.
-*/
-vector<int> PathQueryHandler::shortestPath(int uid, int vid, bool directed, const vector<int> &pred_set) //cost less space and less time.
+int PathQueryHandler::getVertBound()
 {
-	//cout << "BFS2" << endl;
-	map<int, int> dis_u, dis_v;//store the distance to u and v
-	queue<int> q_u, q_v;
-	int num_of_pred = pred_set.size();
-	q_u.push(uid);
-	q_v.push(vid);
-	dis_u[uid] = 0;
-	dis_v[vid] = 0;
-	bool flag = 0;
-	map<int, int>::iterator it;
-	int meet_node = 0;
-	while(flag == 0 && (!q_u.empty() || !q_v.empty()))
+	if (vertBound != -1)
+		return vertBound;	// Only consider static graphs for now
+	// csr[0] has all subjects and csr[1] all objects, each id2vid in increasing order
+	vertBound = 0;
+	for (int j = 0; j < 2; j++)
 	{
-		queue<int> new_q_u;
-		
-		while(!q_u.empty() && flag == 0)
+		for (unsigned i = 0; i < csr[j].pre_num; i++)
 		{
-			int temp_u = q_u.front();
-			
-			q_u.pop();
-			for(int i = 0; i < num_of_pred; ++i)
-			{
-				int x = pred_set[i];
-				int num = getOutSize(temp_u, x);
-				for(int j = 0; j < num; ++j)
-				{
-					int t = getOutVertID(temp_u, x, j); //get the node
-					
-					if(dis_v.find(t) != dis_v.end())
-					{
-						flag = 1;
-						meet_node = t;
-						dis_u[t] = dis_u[temp_u] + 1;
-						break;
-					}									//get the meet node
-
-					if(dis_u.find(t) != dis_u.end()) continue;		//has visited before
-					
-					new_q_u.push(t);
-					dis_u[t] = dis_u[temp_u] + 1;
-				}
-				if(flag) break;
-				if(directed) continue;
+			size_t num = csr[j].id2vid[i].size();
+			if (num > 0 && (int)csr[j].id2vid[i][num - 1] >= vertBound)
+				vertBound = csr[j].id2vid[i][num - 1] + 1;
+		}
+	}
+	return vertBound;
+}
 
-				num = getInSize(temp_u, x);
-				for(int j = 0; j < num; ++j)
-				{
-					int t = getInVertID(temp_u, x, j); //get the node
-					
-					if(dis_v.find(t) != dis_v.end())
-					{
-						flag = 1;
-						meet_node = t;
-						dis_u[t] = dis_u[temp_u] + 1;
-						break;
-					}									//get the meet node
+void PathQueryHandler::getValidPreds(const vector<int> &pred_set, vector<int> &preds)
+{
+	preds.clear();
+	for (int pred : pred_set)
+	{
+		if (pred >= 0 && pred < (int)csr[0].pre_num)	// Otherwise not in the data
+			preds.push_back(pred);
+	}
+}
 
-					if(dis_u.find(t) != dis_u.end()) continue;		//has visited before
-					
-					new_q_u.push(t);
-					dis_u[t] = dis_u[temp_u] + 1;
-				}
-				if(flag) break;
-			}
-		}
-		q_u = new_q_u;
-		
-		queue<int> new_q_v;
-		while(!q_v.empty() && flag == 0)
+// Split the vertices of csr[1 - dir] into tasks, to find the neighbors a frontier reaches by csr[dir]
+void PathQueryHandler::getBottomUpTasks(const int *dirs, int dirNum, const vector<int> &pred_set, vector<BottomUpTask> &tasks)
+{
+	tasks.clear();
+	for (int j = 0; j < dirNum; j++)
+	{
+		for (int pred : pred_set)
 		{
-			int temp_v = q_v.front();
-			
-			q_v.pop();
-			for(int i = 0; i < num_of_pred; ++i)
-			{
-				int x = pred_set[i];
-				int num = getInSize(temp_v, x);
-				
-				for(int j = 0; j < num; ++j)
-				{
-					int t = getInVertID(temp_v, x, j); 
-					
-					if(dis_u.find(t) != dis_u.end())
-					{
-						flag = 1;
-						meet_node = t;
-						dis_v[t] = dis_v[temp_v] + 1;
-						break;
-					}									
+			BottomUpTask task;
+			task.dir = 1 - dirs[j];
+			task.pred = pred;
+			for (task.begin = 0; task.begin < csr[task.dir].id2vid[pred].size(); task.begin += BFS_BOTTOM_UP_MORSEL)
+				tasks.push_back(task);
+		}
+	}
+}
 
-					if(dis_v.find(t) != dis_v.end()) continue;	// Already in	
-					
-					new_q_v.push(t);
-					dis_v[t] = dis_v[temp_v] + 1;
-					
-				}
-				if(flag) break;
+void PathQueryHandler::runTasks(unsigned long taskNum, const WorkStealingPool::Task &func)
+{
+	if (parallelism != 1 && taskNum > 1)
+	{
+		if (pool == NULL)
+		{
+			pool = new WorkStealingPool(parallelism);
+			workerNext.resize(pool->getWorkerNum());
+			random_device seed;
+			while (workerRng.size() < workerNext.size())
+				workerRng.push_back(mt19937_64(seed()));
+		}
+		pool->run(taskNum, func);
+	}
+	else
+	{
+		for (unsigned long i = 0; i < taskNum; i++)
+			func(0, i);
+	}
+}
 
-				if(directed) continue;
+// Set v in bitmap, return false if it was already set
+static inline bool claimVert(vector<unsigned long long> &bitmap, int v)
+{
+	unsigned long long bit = 1ULL << (v & 63);
+	if (__atomic_load_n(&bitmap[v >> 6], __ATOMIC_RELAXED) & bit)
+		return false;
+	return !(__atomic_fetch_or(&bitmap[v >> 6], bit, __ATOMIC_RELAXED) & bit);
+}
 
-				num = getOutSize(temp_v, x);
-				for(int j = 0; j < num; ++j)
-				{
-					int t = getOutVertID(temp_v, x, j); 
-					
-					if(dis_u.find(t) != dis_u.end())
-					{
-						flag = 1;
-						meet_node = t;
-						dis_v[t] = dis_v[temp_v] + 1;
-						break;
-					}									
+static inline bool testVert(const vector<unsigned long long> &bitmap, int v)
+{
+	return __atomic_load_n(&bitmap[v >> 6], __ATOMIC_RELAXED) & (1ULL << (v & 63));
+}
 
-					if(dis_v.find(t) != dis_v.end()) continue;	// Already in	
-					
-					new_q_v.push(t);
-					dis_v[t] = dis_v[temp_v] + 1;
+void PathQueryHandler::bfsInit(BFSSide &side, int src, bool forward)
+{
+	// The arrays are kept for the next queries, only the visited bits are reset
+	size_t words = (getVertBound() + 63) / 64;
+	if (side.visited.size() != words)
+	{
+		side.visited.assign(words, 0);
+		side.in_frontier.assign(words, 0);
+		side.parent.resize(vertBound);
+	}
+	side.forward = forward;
+	side.bottom_up = false;
+	side.prev_frontier_size = 0;
+	side.frontier.assign(1, src);
+	side.touched.assign(1, src);
+	side.visited[src >> 6] |= 1ULL << (src & 63);
+	side.parent[src] = -1;
+}
 
-				}
-				if(flag) break;
-			}
-		}
-		
-		q_v = new_q_v;		
+void PathQueryHandler::bfsReset(BFSSide &side)
+{
+	if (side.touched.size() > side.visited.size())
+		fill(side.visited.begin(), side.visited.end(), 0);
+	else
+	{
+		for (int v : side.touched)
+			side.visited[v >> 6] = 0;
 	}
+	side.touched.clear();
+	side.frontier.clear();
+}
 
-	//get the route through the distance.
-	vector<int> empty_ans;
-	if(flag == 0) return empty_ans; // no route from u to v
-	stack<int> s;
-	s.push(meet_node);
-	//cout << "*************you are wrong!!!**********" << endl;
-	while(1)
+/**
+	Expand side's frontier by one level, in parallel. A level is expanded top-down
+	(each frontier vertex claims its unvisited neighbors) while the frontier is
+	small, and bottom-up (each unvisited vertex looks for a neighbor in the
+	frontier bitmap) while it is a large part of the unvisited vertices.
+
+	@param other the other side of a bidirectional search.
+	@param candidateNum the number of vertices the search may reach.
+	@param meet set to a vertex visited by both sides, if any.
+	@return true if the two sides meet.
+*/
+bool PathQueryHandler::bfsStep(BFSSide &side, const BFSSide &other, bool directed, const vector<int> &pred_set, \
+	long long candidateNum, int &meet)
+{
+	// Top-down follows csr[dir] from the frontier, bottom-up scans the vertices of csr[1 - dir]
+	int dirs[2], dirNum = 0;
+	if (!directed || side.forward)
+		dirs[dirNum++] = 0;
+	if (!directed || !side.forward)
+		dirs[dirNum++] = 1;
+
+	long long frontierNum = side.frontier.size();
+	if (!side.bottom_up && frontierNum * BFS_ALPHA > candidateNum - (long long)side.touched.size())
+		side.bottom_up = true;
+	else if (side.bottom_up && frontierNum * BFS_BETA < candidateNum && (size_t)frontierNum < side.prev_frontier_size)
+		side.bottom_up = false;
+
+	atomic<int> found(-1);
+	for (size_t i = 0; i < workerNext.size(); i++)
+		workerNext[i].clear();
+	if (!side.bottom_up)
 	{
-		int temp = s.top();
-		if(temp == vid) break;
-		int flag0 = 0;
-		for(int i = 0; i < num_of_pred; ++i)
+		unsigned long taskNum = (side.frontier.size() + BFS_TOP_DOWN_MORSEL - 1) / BFS_TOP_DOWN_MORSEL;
+		runTasks(taskNum, [&](unsigned worker, unsigned long task)
 		{
-			int x = pred_set[i];
-			int num = getOutSize(temp, x);
-			for(int j = 0; j < num; ++j)
+			if (found.load(memory_order_relaxed) != -1)
+				return;
+			vector<int> &next = workerNext[worker];
+			size_t end = min(side.frontier.size(), (size_t)(task + 1) * BFS_TOP_DOWN_MORSEL);
+			for (size_t i = task * BFS_TOP_DOWN_MORSEL; i < end; i++)
 			{
-				int t = getOutVertID(temp, x, j); 
-				if(dis_v.find(t) != dis_v.end() && dis_v[t] == dis_v[temp] - 1)
+				int u = side.frontier[i];
+				for (int j = 0; j < dirNum; j++)
 				{
-					s.push(x);
-					s.push(t);
-					flag0 = 1;
-					break;
+					const CSR &c = csr[dirs[j]];
+					for (int pred : pred_set)
+					{
+						int index = c.getIndex(u, pred);
+						if (index == -1)
+							continue;
+						const unsigned *adj = c.adjacency_list[pred].begin();
+						for (unsigned e = c.offset_list[pred][index]; e < c.offset_list[pred][index + 1]; e++)
+						{
+							int v = adj[e];
+							if (!claimVert(side.visited, v))
+								continue;
+							side.parent[v] = u;
+							next.push_back(v);
+							if (testVert(other.visited, v))
+							{
+								int none = -1;
+								found.compare_exchange_strong(none, v);
+								return;
+							}
+						}
+					}
 				}
 			}
-			if(flag0) break;
-
-			if(directed) continue;
-			num = getInSize(temp, x);
-			for(int j = 0; j < num; ++j)
+		});
+	}
+	else
+	{
+		vector<BottomUpTask> tasks;
+		getBottomUpTasks(dirs, dirNum, pred_set, tasks);
+		for (int v : side.frontier)
+			side.in_frontier[v >> 6] |= 1ULL << (v & 63);
+		runTasks(tasks.size(), [&](unsigned worker, unsigned long taskId)
+		{
+			if (found.load(memory_order_relaxed) != -1)
+				return;
+			const BottomUpTask &task = tasks[taskId];
+			const CSR &c = csr[task.dir];
+			vector<int> &next = workerNext[worker];
+			size_t end = min(c.id2vid[task.pred].size(), (size_t)task.begin + BFS_BOTTOM_UP_MORSEL);
+			const unsigned *adj = c.adjacency_list[task.pred].begin();
+			for (size_t i = task.begin; i < end; i++)
 			{
-				int t = getInVertID(temp, x, j); 
-				if(dis_v.find(t) != dis_v.end() && dis_v[t] == dis_v[temp] - 1)
+				int v = c.id2vid[task.pred][i];
+				if (testVert(side.visited, v))
+					continue;
+				for (unsigned e = c.offset_list[task.pred][i]; e < c.offset_list[task.pred][i + 1]; e++)
 				{
-					s.push(x);
-					s.push(t);
-					flag0 = 1;
+					int u = adj[e];
+					if (!testVert(side.in_frontier, u))
+						continue;
+					if (claimVert(side.visited, v))
+					{
+						side.parent[v] = u;
+						next.push_back(v);
+						if (testVert(other.visited, v))
+						{
+							int none = -1;
+							found.compare_exchange_strong(none, v);
+							return;
+						}
+					}
 					break;
 				}
 			}
-			if(flag0) break;
+		});
+		for (int v : side.frontier)
+			side.in_frontier[v >> 6] = 0;
+	}
+
+	side.prev_frontier_size = side.frontier.size();
+	side.frontier.clear();
+	for (size_t i = 0; i < workerNext.size(); i++)
+		side.frontier.insert(side.frontier.end(), workerNext[i].begin(), workerNext[i].end());
+	side.touched.insert(side.touched.end(), side.frontier.begin(), side.frontier.end());
+	meet = found.load();
+	return meet != -1;
+}
+
+// Get a pred in pred_set labeling the edge from -> to (or to -> from if undirected), -1 if none
+int PathQueryHandler::getEdgePred(int from, int to, bool directed, const vector<int> &pred_set)
+{
+	for (int j = 0; j < (directed ? 1 : 2); j++)
+	{
+		int u = j == 0 ? from : to, v = j == 0 ? to : from;
+		for (int pred : pred_set)
+		{
+			int index = csr[0].getIndex(u, pred);
+			if (index == -1)
+				continue;
+			const unsigned *adj = csr[0].adjacency_list[pred].begin();
+			if (find(adj + csr[0].offset_list[pred][index], adj + csr[0].offset_list[pred][index + 1], (unsigned)v) \
+				!= adj + csr[0].offset_list[pred][index + 1])
+				return pred;
 		}
-	}//get the route from meet_node to v.
-	
-	stack<int> s_new;
-	while(!s.empty())
+	}
+	return -1;
+}
+
+/**
+	Bidirectional BFS between u and v within k hops, along edges labeled by
+	pred_set; one side goes forward from u and the other backward from v, and
+	the side with the smaller frontier is expanded each time.
+
+	@param path if not NULL, set to the path in the shape of shortestPath's
+	result, or cleared if there is none.
+	@return the length of the shortest path, or -1 if it is longer than k.
+*/
+int PathQueryHandler::bfs(int uid, int vid, bool directed, int k, const vector<int> &pred_set, vector<int> *path)
+{
+	if (path)
+		path->clear();
+	if (uid == vid)
 	{
-		int temp = s.top();
-		s.pop();
-		s_new.push(temp);
+		if (path)
+			path->push_back(uid);
+		return 0;
 	}
-	if(s_new.empty())
+	int bound = getVertBound();
+	if (uid < 0 || vid < 0 || uid >= bound || vid >= bound || k <= 0)
+		return -1;
+	vector<int> preds;
+	getValidPreds(pred_set, preds);
+	long long candidateNum = 0;
+	for (int pred : preds)
+		candidateNum += csr[0].id2vid[pred].size() + csr[1].id2vid[pred].size();
+	candidateNum = min(candidateNum, (long long)bound);
+
+	BFSSide &fwd = bfsSide[0], &bwd = bfsSide[1];
+	bfsInit(fwd, uid, true);
+	bfsInit(bwd, vid, false);
+	int fwdLevel = 0, bwdLevel = 0, meet = -1;
+	while (fwdLevel + bwdLevel < k && !fwd.frontier.empty() && !bwd.frontier.empty())
 	{
-		s_new.push(meet_node);
-		//cout << "s_new empty" << endl;
+		if (fwd.frontier.size() <= bwd.frontier.size())
+		{
+			fwdLevel++;
+			if (bfsStep(fwd, bwd, directed, preds, candidateNum, meet))
+				break;
+		}
+		else
+		{
+			bwdLevel++;
+			if (bfsStep(bwd, fwd, directed, preds, candidateNum, meet))
+				break;
+		}
 	}
-	while(1)
+
+	int dist = -1;
+	if (meet != -1)
 	{
-		int temp = s_new.top();
-		if(temp == uid) break;
-		int flag0 = 0;
-		for(int i = 0; i < num_of_pred; ++i)
+		// Every meeting vertex of the first level they meet at lies on a shortest path
+		dist = fwdLevel + bwdLevel;
+		if (path)
 		{
-			int x = pred_set[i];
-			int num = getInSize(temp, x);
-			for(int j = 0; j < num; ++j)
+			vector<int> half;
+			for (int v = meet; v != -1; v = fwd.parent[v])
+				half.push_back(v);
+			for (size_t i = half.size() - 1; i > 0; i--)
 			{
-				int t = getInVertID(temp, x, j); 
-				if(dis_u.find(t) != dis_u.end() && dis_u[t] == dis_u[temp] - 1)
-				{
-					s_new.push(x);
-					s_new.push(t);
-					flag0 = 1;
-					break;
-				}
+				path->push_back(half[i]);
+				path->push_back(getEdgePred(half[i], half[i - 1], directed, preds));
 			}
-			if(flag0) break;
-
-			if(directed) continue;
-
-			num = getOutSize(temp, x);
-			for(int j = 0; j < num; ++j)
+			path->push_back(meet);
+			for (int v = meet; bwd.parent[v] != -1; v = bwd.parent[v])
 			{
-				int t = getOutVertID(temp, x, j); 
-				if(dis_u.find(t) != dis_u.end() && dis_u[t] == dis_u[temp] - 1)
-				{
-					s_new.push(x);
-					s_new.push(t);
-					flag0 = 1;
-					break;
-				}
+				path->push_back(getEdgePred(v, bwd.parent[v], directed, preds));
+				path->push_back(bwd.parent[v]);
 			}
-			if(flag0) break;
 		}
-	}//get the route from u to meet_node.
-
-	int lens = s_new.size();
-	vector<int> ans(lens);
-	for(int i = 0; i < lens; ++i)
-	{
-		ans[i] = s_new.top();
-		s_new.pop();
 	}
+	bfsReset(fwd);
+	bfsReset(bwd);
+	return dist;
+}
+
+/**
+	Compute and return the shortest path between vertices u and v, with the
+	constraint that all edges in the path are labeled by labels in pred_set.
+
+	@param uid the vertex u's ID.
+	@param vid the vertex v's ID.
+	@param directed if false, treat all edges in the graph as bidirectional.
+	@param pred_set the set of edge labels allowed.
+	@return a vector of vertex IDs representing the shortest path, shaped like
+	[v0, pred0, v1, pred1, ..., vk, predk, vk+1], where v0 = u, vk+1 = v, 
+	and predi labels the edge from vi to vi+1.
+
+	use the parallel bidirectional BFS, and rebuild the route from the parent
+	arrays of both sides.
+*/
+vector<int> PathQueryHandler::shortestPath(int uid, int vid, bool directed, const vector<int> &pred_set)
+{
+	vector<int> ans;
+	bfs(uid, vid, directed, INT_MAX, pred_set, &ans);
 	return ans;
 }
 
@@ -1001,365 +1259,7 @@ vector<int> PathQueryHandler::shortestPath(int uid, int vid, bool directed, cons
 */
 bool PathQueryHandler::kHopReachable(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set)
 {
-	if (uid == vid)
-		return true;
-	int uOutTotal = 0, vInTotal = 0;
-	for (int pred : pred_set)
-	{
-		uOutTotal += getOutSize(uid, pred);
-		vInTotal += getInSize(vid, pred);
-		if(!directed)
-		{
-			uOutTotal += getInSize(uid, pred);
-			vInTotal += getOutSize(vid, pred);
-		}
-	}
-	if (uOutTotal == 0 || vInTotal == 0)
-		return false;
-
-	//partial push
-    double  rmax_fwd = 0.001, rmax_bwd = 0.001;
-    queue< pair<int,int> > candidatePush1;
-    queue< pair<int,int> > candidatePush1_next;
-    queue< pair<int,int> > candidatePush2;
-    queue< pair<int,int> > candidatePush2_next;
-    candidatePush1.push( pair<int,int>(uid,0) );
-    candidatePush2.push( pair<int,int>(vid,0) );
-    map<int, int> residue1, residue2, l1, l2, f1, f2;
-    residue1[uid] = 1;
-    residue2[vid] = 1;
-    l1[uid] = 0;
-    l2[vid] = 0;
-
-    //full push
-    queue< int > fwdQ;
-    queue< int > fwdQ_next;
-    queue< int > bwdQ;
-    queue< int > bwdQ_next;
-    int fullL1 = 0;
-    int fullL2 = 0;
-    fwdQ.push(uid);
-    bwdQ.push(vid);
-    f1[uid] = 0;
-    f2[vid] = 0;
-    
-    double theta = 1, c_fora = 0.1, alpha = 0.2;
-    double init_rmax = 100.0 / pow(getEdgeNum(), 3.0 / 4.0) / c_fora;
-    int batchSize = 10;
-    int push_bs = theta * batchSize, bfs_bs = batchSize;
-    int op_cnt;
-    fullL1 = 1;
-    fullL2 = 1;
-    while (fullL1 <= k && fullL2 <= k && \
-        (!fwdQ.empty() || !fwdQ_next.empty()) && (!bwdQ.empty() || !bwdQ_next.empty()))
-    {
-        op_cnt = 0;
-        while ((!candidatePush1.empty() || !candidatePush1_next.empty()) && op_cnt < push_bs \
-            && rmax_fwd > init_rmax)
-        {
-            if (candidatePush1.empty())
-            {
-                swap(candidatePush1, candidatePush1_next);
-                rmax_fwd /= 2;
-                continue;
-            }
-            int curNode = candidatePush1.front().first;
-            int level = candidatePush1.front().second;
-            candidatePush1.pop();
-            op_cnt++;
-            if (level <= k)
-            {
-                if (!directed)
-                {
-                	if( residue1[curNode] / getSetOutSize(curNode, pred_set) >= rmax_fwd )
-	                {
-	                    for (int pred : pred_set)
-	                    {
-	                    	int num_out = getOutSize(curNode, pred);
-	                    	for (int i = 0; i < num_out; i++)
-	                    	{
-	                    		int adj = getOutVertID(curNode, pred, i);
-		                        if (l1.find(adj) == l1.end())
-		                        {
-		                            l1[adj] = level+1;
-		                            if (l2.find(adj) != l2.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f2.find(adj) != f2.end() && l1[adj] + f2[adj] <= k)
-		                                return true;
-		                            residue1[adj] = (1-alpha)*residue1[curNode]/getSetOutSize(curNode, pred_set);	// Should be equivalent to +=
-		                            if(residue1[adj]/getSetOutSize(adj, pred_set) >= rmax_fwd )
-		                                candidatePush1.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush1_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-	                    }
-	                    residue1[curNode] = 0;
-                	}
-	                else
-	                    candidatePush1_next.push( pair<int,int>(curNode,level) );
-                }
-
-                else
-                {
-	                if( residue1[curNode] / (getSetOutSize(curNode, pred_set) + getSetInSize(curNode, pred_set)) \
-	                	>= rmax_fwd )
-	                {
-	                    for (int pred : pred_set)
-	                    {
-	                    	int num_out = getOutSize(curNode, pred);
-	                    	for (int i = 0; i < num_out; i++)
-	                    	{
-	                    		int adj = getOutVertID(curNode, pred, i);
-		                        if (l1.find(adj) == l1.end())
-		                        {
-		                            l1[adj] = level+1;
-		                            if (l2.find(adj) != l2.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f2.find(adj) != f2.end() && l1[adj] + f2[adj] <= k)
-		                                return true;
-		                            residue1[adj] = (1-alpha)*residue1[curNode] / \
-		                            	(getSetOutSize(curNode, pred_set) + getSetInSize(curNode, pred_set));	// Should be equivalent to +=
-		                            if(residue1[adj] / (getSetOutSize(adj, pred_set) + getSetInSize(adj, pred_set)) >= rmax_fwd)
-		                                candidatePush1.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush1_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-
-	                    	int num_in = getInSize(curNode, pred);
-	                    	for (int i = 0; i < num_in; i++)
-	                    	{
-	                    		int adj = getInVertID(curNode, pred, i);
-		                        if (l1.find(adj) == l1.end())
-		                        {
-		                            l1[adj] = level+1;
-		                            if (l2.find(adj) != l2.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f2.find(adj) != f2.end() && l1[adj] + f2[adj] <= k)
-		                                return true;
-		                            residue1[adj] = (1-alpha)*residue1[curNode] / \
-		                            	(getSetOutSize(curNode, pred_set) + getSetInSize(curNode, pred_set));	// Should be equivalent to +=
-		                            if(residue1[adj]/(getSetOutSize(adj, pred_set) + getSetInSize(adj, pred_set)) >= rmax_fwd )
-		                                candidatePush1.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush1_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-	                    }
-	                    residue1[curNode] = 0;
-	                }
-	                else
-	                    candidatePush1_next.push( pair<int,int>(curNode,level) );
-                }
-            }
-        }
-
-        op_cnt = 0;
-        // clock_gettime(CLOCK_MONOTONIC, &start_at);
-        while ((!fwdQ.empty() || !fwdQ_next.empty()) && op_cnt < bfs_bs && fullL1 <= k)
-        {
-            if (fwdQ.empty())
-            {
-                swap(fwdQ, fwdQ_next);
-                fullL1++;
-                continue;
-            }
-            int curNode = fwdQ.front();
-            fwdQ.pop();
-            op_cnt++;
-            for (int pred : pred_set)
-            {
-            	int num_out = getOutSize(curNode, pred);
-            	for (int i = 0; i < num_out; i++)
-            	{
-            		int adj = getOutVertID(curNode, pred, i);
-            		if(f1.find(adj) == f1.end())
-	                {
-	                    f1[adj] = fullL1;
-	                    if (l2.find(adj) != l2.end() && f1[adj] + l2[adj] <= k)
-	                        return true;
-	                    if (f2.find(adj) != f2.end() && f1[adj] + f2[adj] <= k)
-	                        return true;
-	                    fwdQ_next.push(adj);
-	                }
-            	}
-
-            	if(directed) continue;
-
-            	int num_in = getInSize(curNode, pred);
-            	for (int i = 0; i < num_in; i++)
-            	{
-            		int adj = getOutVertID(curNode, pred, i);
-            		if(f1.find(adj) == f1.end())
-	                {
-	                    f1[adj] = fullL1;
-	                    if (l2.find(adj) != l2.end() && f1[adj] + l2[adj] <= k)
-	                        return true;
-	                    if (f2.find(adj) != f2.end() && f1[adj] + f2[adj] <= k)
-	                        return true;
-	                    fwdQ_next.push(adj);
-	                }
-            	}
-            }
-        }
-        // clock_gettime(CLOCK_MONOTONIC, &end_at);
-        // elapsed = timeDiff(start_at, end_at);
-        // printf("fullL1 = %d, time = %lf ms\n", fullL1, elapsed);
-
-        op_cnt = 0;
-        while ((!candidatePush2.empty() || !candidatePush2_next.empty()) && op_cnt < push_bs \
-            && rmax_bwd > init_rmax)
-        {
-            if (candidatePush2.empty())
-            {
-                swap(candidatePush2, candidatePush2_next);
-                rmax_bwd /= 2;
-                continue;
-            }
-            int curNode = candidatePush2.front().first;
-            int level = candidatePush2.front().second;
-            candidatePush2.pop();
-            op_cnt++;
-            if (level <= k)
-            {
-                if (!directed)
-                {
-                	if( residue2[curNode] / getSetInSize(curNode, pred_set) >= rmax_bwd )
-	                {
-	                    for (int pred : pred_set)
-	                    {
-	                    	int num_in = getInSize(curNode, pred);
-	                    	for (int i = 0; i < num_in; i++)
-	                    	{
-	                    		int adj = getInVertID(curNode, pred, i);
-		                        if (l2.find(adj) == l2.end())
-		                        {
-		                            l2[adj] = level+1;
-		                            if (l1.find(adj) != l1.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f1.find(adj) != f1.end() && f1[adj] + l2[adj] <= k)
-		                                return true;
-		                            residue2[adj] = (1-alpha)*residue1[curNode]/getSetInSize(curNode, pred_set);	// Should be equivalent to +=
-		                            if(residue2[adj]/getSetInSize(adj, pred_set) >= rmax_fwd )
-		                                candidatePush2.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush2_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-	                    }
-	                    residue2[curNode] = 0;
-	                }
-	                else
-	                    candidatePush2_next.push( pair<int,int>(curNode,level) );
-                }
-                else
-                {
-	                if( residue2[curNode] / (getSetInSize(curNode, pred_set) + getSetOutSize(curNode, pred_set)) \
-	                	>= rmax_bwd )
-	                {
-	                    for (int pred : pred_set)
-	                    {
-	                    	int num_in = getInSize(curNode, pred);
-	                    	for (int i = 0; i < num_in; i++)
-	                    	{
-	                    		int adj = getInVertID(curNode, pred, i);
-		                        if (l2.find(adj) == l2.end())
-		                        {
-		                            l2[adj] = level+1;
-		                            if (l1.find(adj) != l1.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f1.find(adj) != f1.end() && f1[adj] + l2[adj] <= k)
-		                                return true;
-		                            residue2[adj] = (1-alpha)*residue1[curNode] / \
-		                            	(getSetInSize(curNode, pred_set) + getSetOutSize(curNode, pred_set));	// Should be equivalent to +=
-		                            if(residue2[adj] / (getSetInSize(adj, pred_set) + getSetOutSize(adj, pred_set)) >= rmax_fwd )
-		                                candidatePush2.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush2_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-	                    	
-	                    	int num_out = getOutSize(curNode, pred);
-	                    	for (int i = 0; i < num_out; i++)
-	                    	{
-	                    		int adj = getOutVertID(curNode, pred, i);
-		                        if (l2.find(adj) == l2.end())
-		                        {
-		                            l2[adj] = level+1;
-		                            if (l1.find(adj) != l1.end() && l1[adj] + l2[adj] <= k)
-		                                return true;
-		                            if (f1.find(adj) != f1.end() && f1[adj] + l2[adj] <= k)
-		                                return true;
-		                            residue2[adj] = (1-alpha)*residue1[curNode] / \
-		                            	(getSetInSize(curNode, pred_set) + getSetOutSize(curNode, pred_set));	// Should be equivalent to +=
-		                            if(residue2[adj] / (getSetInSize(adj, pred_set) + getSetOutSize(adj, pred_set)) >= rmax_fwd )
-		                                candidatePush2.push( pair<int,int>(adj,level+1) );
-		                            else
-		                                candidatePush2_next.push( pair<int,int>(adj,level+1) );
-		                        }
-	                    	}
-	                    }
-	                    residue2[curNode] = 0;
-	                }
-	                else
-	                    candidatePush2_next.push( pair<int,int>(curNode,level) );
-                }
-            }
-        }
-
-        op_cnt = 0;
-        // clock_gettime(CLOCK_MONOTONIC, &start_at);
-        while ((!bwdQ.empty() || !bwdQ_next.empty()) && op_cnt < bfs_bs && fullL2 <= k)
-        {
-            if (bwdQ.empty())
-            {
-                swap(bwdQ, bwdQ_next);
-                fullL2++;
-                continue;
-            }
-            int curNode = bwdQ.front();
-            bwdQ.pop();
-            op_cnt++;
-            for (int pred : pred_set)
-            {
-            	int num_in = getInSize(curNode, pred);
-            	for (int i = 0; i < num_in; i++)
-            	{
-            		int adj = getOutVertID(curNode, pred, i);
-            		if(f2.find(adj) == f2.end())
-	                {
-	                    f2[adj] = fullL2;
-	                    if (l1.find(adj) != l1.end() && l1[adj] + f2[adj] <= k)
-	                        return true;
-	                    if (f1.find(adj) != f1.end() && f1[adj] + f2[adj] <= k)
-	                        return true;
-	                    fwdQ_next.push(adj);
-	                }
-            	}
-
-            	if(directed) continue;
-
-            	int num_out = getOutSize(curNode, pred);
-            	for (int i = 0; i < num_out; i++)
-            	{
-            		int adj = getOutVertID(curNode, pred, i);
-            		if(f2.find(adj) == f2.end())
-	                {
-	                    f2[adj] = fullL2;
-	                    if (l1.find(adj) != l1.end() && l1[adj] + f2[adj] <= k)
-	                        return true;
-	                    if (f1.find(adj) != f1.end() && f1[adj] + f2[adj] <= k)
-	                        return true;
-	                    fwdQ_next.push(adj);
-	                }
-            	}
-            }
-        }
-    }
-
-    return false;
-
+	return bfs(uid, vid, directed, k, pred_set, NULL) != -1;
 }
 
 bool PathQueryHandler::kHopReachableTest(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set)
@@ -1473,15 +1373,350 @@ bool PathQueryHandler::kHopReachableTest(int uid, int vid, bool directed, int k,
 
 vector<int> PathQueryHandler::kHopReachablePath(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set)
 {
-	vector<int> ret = shortestPath(uid, vid, directed, pred_set);
-	cout<<"ret.size:"<<ret.size()<<",k:"<<k<<endl;
-	if ((ret.size() - 1) / 2 > k)
-		ret.clear();
+	vector<int> ret;
+	bfs(uid, vid, directed, k, pred_set, &ret);
 	return ret;
 }
 
+static const double PPR_ALPHA = 0.2;	// Probability to stop at each step of a walk
+static const double PPR_EPSILON = 0.5;	// Relative error
+
+// Add inc to target shared by the workers, return its old value
+static inline double atomicAdd(double &target, double inc)
+{
+	double old, sum;
+	__atomic_load(&target, &old, __ATOMIC_RELAXED);
+	do
+	{
+		sum = old + inc;
+	} while (!__atomic_compare_exchange(&target, &old, &sum, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return old;
+}
+
+void PathQueryHandler::pprInit(const vector<int> &preds)
+{
+	size_t bound = getVertBound();
+	if (pprLevel.size() != bound)
+	{
+		pprReserve.assign(bound, 0);
+		pprResidue.assign(bound, 0);
+		pprEstimate.assign(bound, 0);
+		pprLevel.assign(bound, -1);
+		pprInQueue.assign(bound, 0);
+		pprDegree.clear();
+	}
+	// Degrees by the same predicates are kept for the next query
+	if (pprDegree.size() != bound || preds != pprDegreePreds)
+	{
+		pprDegree.assign(bound, -1);
+		pprDegreePreds = preds;
+	}
+}
+
+// Called by many workers at a time, they may compute the same degree
+int PathQueryHandler::pprOutDegree(int vid, const vector<int> &preds)
+{
+	int deg = __atomic_load_n(&pprDegree[vid], __ATOMIC_RELAXED);
+	if (deg == -1)
+	{
+		deg = 0;
+		for (int pred : preds)
+		{
+			int index = csr[0].getIndex(vid, pred);
+			if (index != -1)
+				deg += csr[0].getDegree(index, pred);
+		}
+		__atomic_store_n(&pprDegree[vid], deg, __ATOMIC_RELAXED);
+	}
+	return deg;
+}
+
+// Walk from start until it stops with probability PPR_ALPHA at each step, restarting from
+// start at vertices without out-edges, and return where it stops
+int PathQueryHandler::pprRandomWalk(int start, const vector<int> &preds, mt19937_64 &rng)
+{
+	if (pprOutDegree(start, preds) == 0)
+		return start;
+	int cur = start;
+	while ((rng() >> 11) * (1.0 / (1ULL << 53)) > PPR_ALPHA)
+	{
+		int deg = pprOutDegree(cur, preds);
+		if (deg == 0)
+		{
+			cur = start;
+			continue;
+		}
+		unsigned pos = rng() % deg;
+		for (int pred : preds)
+		{
+			int index = csr[0].getIndex(cur, pred);
+			if (index == -1)
+				continue;
+			unsigned predDeg = csr[0].getDegree(index, pred);
+			if (pos < predDeg)
+			{
+				cur = csr[0].adjacency_list[pred][csr[0].offset_list[pred][index] + pos];
+				break;
+			}
+			pos -= predDeg;
+		}
+	}
+	return cur;
+}
+
+// Forward push from s until no vertex within k hops(any if -1) has residue / out-degree >= rmax,
+// going on from the residues of the last push with a larger rmax
+void PathQueryHandler::pprPush(int s, double rmax, int k, const vector<int> &preds, double &rsum)
+{
+	if (pprLevel[s] == -1)
+	{
+		pprLevel[s] = 0;
+		pprResidue[s] = 1;
+		pprTouched.push_back(s);
+	}
+	pprQueue.clear();
+	for (int v : pprTouched)
+	{
+		int deg = pprOutDegree(v, preds);
+		if ((k == -1 || pprLevel[v] <= k) && pprResidue[v] > 0 && (deg == 0 || pprResidue[v] / deg >= rmax))
+		{
+			pprQueue.push_back(v);
+			pprInQueue[v] = 1;
+		}
+	}
+
+	for (size_t i = 0; i < pprQueue.size(); i++)
+	{
+		int v = pprQueue[i];
+		pprInQueue[v] = 0;
+		double residue = pprResidue[v];
+		pprResidue[v] = 0;
+		pprReserve[v] += residue * PPR_ALPHA;
+		rsum -= residue * PPR_ALPHA;
+		int deg = pprOutDegree(v, preds);
+		if (deg == 0)
+		{
+			// What would walk on goes back to the source
+			pprResidue[s] += residue * (1 - PPR_ALPHA);
+			if (!pprInQueue[s] && pprResidue[s] / pprOutDegree(s, preds) >= rmax)
+			{
+				pprQueue.push_back(s);
+				pprInQueue[s] = 1;
+			}
+			continue;
+		}
+		double push = residue * (1 - PPR_ALPHA) / deg;
+		for (int pred : preds)
+		{
+			int index = csr[0].getIndex(v, pred);
+			if (index == -1)
+				continue;
+			unsigned end = csr[0].offset_list[pred][index + 1];
+			for (unsigned j = csr[0].offset_list[pred][index]; j < end; j++)
+			{
+				int next = csr[0].adjacency_list[pred][j];
+				if (pprLevel[next] == -1)
+				{
+					pprLevel[next] = pprLevel[v] + 1;
+					pprTouched.push_back(next);
+				}
+				pprResidue[next] += push;
+				if (pprInQueue[next] || (k != -1 && pprLevel[next] > k))
+					continue;
+				int nextDeg = pprOutDegree(next, preds);
+				if (nextDeg == 0 || pprResidue[next] / nextDeg >= rmax)
+				{
+					pprQueue.push_back(next);
+					pprInQueue[next] = 1;
+				}
+			}
+		}
+	}
+}
+
+// Estimate PPR by the reserves and omega * rsum random walks from the residues, split among the
+// vertices by their residues; the first walks of a vertex are taken from the index if given
+void PathQueryHandler::pprWalk(double rsum, double omega, const vector<int> &preds, const PPRWalkIndex *index)
+{
+	for (int v : pprHit)
+		pprEstimate[v] = 0;
+	pprHit.clear();
+	vector<int> srcs;
+	vector<unsigned long long> walkEnd;	// Walks [walkEnd[i - 1], walkEnd[i]) are from srcs[i]
+	vector<double> walkInc;
+	for (int v : pprTouched)
+	{
+		if (pprReserve[v] > 0)
+		{
+			pprEstimate[v] = pprReserve[v];
+			pprHit.push_back(v);
+		}
+		if (rsum > 0 && pprResidue[v] > 0)
+		{
+			unsigned long long walkNum = ceil(pprResidue[v] * omega);
+			srcs.push_back(v);
+			walkEnd.push_back((walkEnd.empty() ? 0 : walkEnd.back()) + walkNum);
+			walkInc.push_back(pprResidue[v] / walkNum);
+		}
+	}
+	if (srcs.empty())
+		return;
+
+	unsigned long long totalWalk = walkEnd.back();
+	runTasks((totalWalk + PPR_WALK_MORSEL - 1) / PPR_WALK_MORSEL, [&](unsigned worker, unsigned long task)
+	{
+		unsigned long long begin = task * PPR_WALK_MORSEL, end = min(begin + PPR_WALK_MORSEL, totalWalk);
+		size_t i = upper_bound(walkEnd.begin(), walkEnd.end(), begin) - walkEnd.begin();
+		for (unsigned long long w = begin; w < end; w++)
+		{
+			while (w >= walkEnd[i])
+				i++;
+			int src = srcs[i];
+			unsigned long long j = w - (i == 0 ? 0 : walkEnd[i - 1]);	// The j-th walk from src
+			int dest;
+			if (index != NULL && j < index->offset[src + 1] - index->offset[src])
+				dest = index->dest[index->offset[src] + j];
+			else
+				dest = pprRandomWalk(src, preds, workerRng[worker]);
+			if (atomicAdd(pprEstimate[dest], walkInc[i]) == 0)
+				workerNext[worker].push_back(dest);
+		}
+	});
+	for (vector<int> &hit : workerNext)
+	{
+		pprHit.insert(pprHit.end(), hit.begin(), hit.end());
+		hit.clear();
+	}
+}
+
+// Each vertex gets enough walks for the residue it may keep after the push with the least rmax,
+// so that SSPPR needs no more walks from it at any delta if the push reached k hops
+shared_ptr<const PPRWalkIndex> PathQueryHandler::pprBuildIndex(const vector<int> &preds)
+{
+	int bound = getVertBound();
+	int vertNum = max(getVertNum(), 2);
+	double pfail = 1.0 / vertNum / vertNum / log(vertNum);
+	double min_delta = 1.0 / vertNum;
+	double rmax = PPR_EPSILON * sqrt(min_delta / 3 / getSetEdgeNum(preds) / log(2 / pfail));
+	double omega = (2 + PPR_EPSILON) * log(2 / pfail) / min_delta / PPR_EPSILON / PPR_EPSILON;
+
+	PPRWalkIndex *index = new PPRWalkIndex;
+	index->offset.assign(bound + 1, 0);
+	unsigned long taskNum = (bound + PPR_INDEX_MORSEL - 1) / PPR_INDEX_MORSEL;
+	runTasks(taskNum, [&](unsigned worker, unsigned long task)
+	{
+		int end = min((task + 1) * PPR_INDEX_MORSEL, (unsigned long)bound);
+		for (int v = task * PPR_INDEX_MORSEL; v < end; v++)
+		{
+			int deg = pprOutDegree(v, preds);
+			index->offset[v + 1] = deg == 0 ? 0 : (unsigned long long)ceil(rmax * deg * omega);
+		}
+	});
+	for (int v = 0; v < bound; v++)
+		index->offset[v + 1] += index->offset[v];
+	index->dest.resize(index->offset[bound]);
+	runTasks(taskNum, [&](unsigned worker, unsigned long task)
+	{
+		int end = min((task + 1) * PPR_INDEX_MORSEL, (unsigned long)bound);
+		for (int v = task * PPR_INDEX_MORSEL; v < end; v++)
+		{
+			for (unsigned long long j = index->offset[v]; j < index->offset[v + 1]; j++)
+				index->dest[j] = pprRandomWalk(v, preds, workerRng[worker]);
+		}
+	});
+	return shared_ptr<const PPRWalkIndex>(index);
+}
+
+bool PathQueryHandler::buildPPRWalkIndex(const vector<int> &pred_set)
+{
+	vector<int> preds;
+	getValidPreds(pred_set, preds);
+	sort(preds.begin(), preds.end());
+	preds.erase(unique(preds.begin(), preds.end()), preds.end());
+	if (preds.empty())
+	{
+		cout << "no valid predicate @PathQueryHandler::buildPPRWalkIndex" << endl;
+		return false;
+	}
+	pprInit(preds);
+	long begin_time = Util::get_cur_time();
+	shared_ptr<const PPRWalkIndex> index = pprBuildIndex(preds);
+	csr[0].putPPRWalkIndex(preds, index);
+	cout << "PPR walk index of " << preds.size() << " predicates: " << index->dest.size() << " walks, used "
+		<< Util::get_cur_time() - begin_time << "ms" << endl;
+	return true;
+}
+
 // retNum is the number of top nodes to return; k is the hop constraint -- don't mix them up!
+// FORA top-k like SSPPR0: halve delta from 1/4 until the retNum-th estimate is at least 2 * delta,
+// pushing on from the last residues and estimating by new random walks each time
 void PathQueryHandler::SSPPR(int uid, int retNum, int k, const vector<int> &pred_set, vector< pair<int ,double> > &topkV2ppr)
+{
+	topkV2ppr.clear();
+	vector<int> preds;
+	getValidPreds(pred_set, preds);
+	sort(preds.begin(), preds.end());
+	preds.erase(unique(preds.begin(), preds.end()), preds.end());
+	if (uid < 0 || uid >= getVertBound() || retNum <= 0)
+		return;
+	pprInit(preds);
+	if (pprOutDegree(uid, preds) == 0)
+		return;
+
+	shared_ptr<const PPRWalkIndex> index = csr[0].getPPRWalkIndex(preds);
+	if (!index && Util::getConfigureValue("ppr_walk_index") == "true")
+	{
+		buildPPRWalkIndex(preds);
+		index = csr[0].getPPRWalkIndex(preds);
+	}
+
+	int numPredEdges = getSetEdgeNum(preds);
+	int vertNum = max(getVertNum(), 2);
+	double pfail = 1.0 / vertNum / vertNum / log(vertNum);
+	double min_delta = 1.0 / vertNum;
+	double delta = 1.0 / 4;
+	double rsum = 1.0;
+	vector<double> top;
+	while (true)
+	{
+		double rmax = PPR_EPSILON * sqrt(delta / 3 / numPredEdges / log(2 / pfail));
+		double omega = (2 + PPR_EPSILON) * log(2 / pfail) / delta / PPR_EPSILON / PPR_EPSILON;
+		pprPush(uid, rmax, k, preds, rsum);
+		pprWalk(rsum, omega, preds, index.get());
+		if (delta <= min_delta)
+			break;
+		if ((int)pprHit.size() >= retNum)
+		{
+			top.clear();
+			for (int v : pprHit)
+				top.push_back(pprEstimate[v]);
+			nth_element(top.begin(), top.begin() + retNum - 1, top.end(), greater<double>());
+			if (top[retNum - 1] >= 2 * delta)
+				break;
+		}
+		delta = max(min_delta, delta / 2);
+	}
+
+	for (int v : pprHit)
+		topkV2ppr.push_back(make_pair(v, pprEstimate[v]));
+	size_t retSize = min((size_t)retNum, topkV2ppr.size());
+	partial_sort(topkV2ppr.begin(), topkV2ppr.begin() + retSize, topkV2ppr.end(),
+		[](const pair<int, double> &l, const pair<int, double> &r){return l.second > r.second;});
+	topkV2ppr.resize(retSize);
+
+	for (int v : pprTouched)
+	{
+		pprReserve[v] = pprResidue[v] = 0;
+		pprLevel[v] = -1;
+	}
+	pprTouched.clear();
+	for (int v : pprHit)
+		pprEstimate[v] = 0;
+	pprHit.clear();
+}
+
+// retNum is the number of top nodes to return; k is the hop constraint -- don't mix them up!
+void PathQueryHandler::SSPPR0(int uid, int retNum, int k, const vector<int> &pred_set, vector< pair<int ,double> > &topkV2ppr)
 {
 	topkV2ppr.clear();
 	srand(time(NULL));
@@ -1495,17 +1730,17 @@ void PathQueryHandler::SSPPR(int uid, int retNum, int k, const vector<int> &pred
 
 	// Data structures initialization
 	fwd_idx.first.nil = -9;
-    fwd_idx.first.initialize(getVertNum());
+    fwd_idx.first.initialize(getVertBound());
     fwd_idx.second.nil = -9;
-    fwd_idx.second.initialize(getVertNum());
+    fwd_idx.second.initialize(getVertBound());
     upper_bounds.nil = -9;
-    upper_bounds.init_keys(getVertNum());
+    upper_bounds.init_keys(getVertBound());
     lower_bounds.nil = -9;
-    lower_bounds.init_keys(getVertNum());
+    lower_bounds.init_keys(getVertBound());
     ppr.nil = -9;
-    ppr.initialize(getVertNum());
+    ppr.initialize(getVertBound());
     topk_filter.nil = -9;
-    topk_filter.initialize(getVertNum());
+    topk_filter.initialize(getVertBound());
 
     // Params initialization
     int numPredEdges = getSetEdgeNum(pred_set);
@@ -1524,7 +1759,7 @@ void PathQueryHandler::SSPPR(int uid, int retNum, int k, const vector<int> &pred
 
     vector<pair<int, int>> forward_from;
     forward_from.clear();
-    forward_from.reserve(getVertNum());
+    forward_from.reserve(getVertBound());
     forward_from.push_back(make_pair(uid, 0));
 
     fwd_idx.first.clean();  //reserve
@@ -1590,14 +1825,14 @@ void PathQueryHandler::forward_local_update_linear_topk(int s, double& rsum, dou
 {
     double myeps = rmax;
 
-    vector<bool> in_forward(getVertNum());
-    vector<bool> in_next_forward(getVertNum());
+    vector<bool> in_forward(getVertBound());
+    vector<bool> in_next_forward(getVertBound());
 
     std::fill(in_forward.begin(), in_forward.end(), false);
     std::fill(in_next_forward.begin(), in_next_forward.end(), false);
 
     vector<pair<int, int>> next_forward_from;
-    next_forward_from.reserve(getVertNum());
+    next_forward_from.reserve(getVertBound());
     for(auto &v: forward_from)
         in_forward[v.first] = true;
 
@@ -1866,9 +2101,11 @@ double PathQueryHandler::kth_ppr(unordered_map<int, double> &v2ppr, int retNum)
     int i = 0;
     for (auto it = v2ppr.begin(); it != v2ppr.end(); ++it)
     {
-    	temp_ppr[i] = v2ppr[it->second];
+    	temp_ppr[i] = it->second;
     	i++;
     }
+    if ((int)temp_ppr.size() < retNum)
+    	return 0;
     nth_element(temp_ppr.begin(), temp_ppr.begin() + retNum - 1, temp_ppr.end(), \
     	[](double x, double y){return x > y;});
     return temp_ppr[retNum - 1];
@@ -2,6 +2,7 @@
 
 #include "../Util/Util.h"
 #include "../Database/CSR.h"
+#include "../Util/WorkStealingPool.h"
 
 #ifndef _QUERY_PATH_H
 #define _QUERY_PATH_H
@@ -10,12 +11,74 @@ class PathQueryHandler
 {
 private:
 	CSR *csr;
-	std::unordered_map<int, std::set<int> > distinctInEdges;
-	std::unordered_map<int, std::set<int> > distinctOutEdges;
-	int cacheMaxSize;
 	int n, m;	// #vertices, #edges
+	int lastDistinctVid[2];	// The vertex and distinct neighbors last got by csr[0] and csr[1]
+	NeighborCache::List lastDistinctList[2];
+
+	// One side of the frontier-based BFS, the arrays are indexed by vertex ID
+	struct BFSSide
+	{
+		std::vector<unsigned long long> visited;	// Bitmap
+		std::vector<unsigned long long> in_frontier;	// Bitmap of frontier, for bottom-up steps
+		std::vector<int> parent;	// Valid for visited vertices, -1 for the source
+		std::vector<int> frontier;
+		std::vector<int> touched;	// Visited vertices, to reset visited
+		bool forward;	// Follows out-edges from the source, or in-edges to the target
+		bool bottom_up;
+		size_t prev_frontier_size;
+	};
+	BFSSide bfsSide[2];
+	int vertBound;	// All vertex IDs in the CSR are below it
+	unsigned parallelism;	// query_parallelism in init.conf
+	WorkStealingPool *pool;
+	std::vector<std::vector<int> > workerNext;	// Vertices found by each worker in a BFS step or random walks
+	std::vector<std::mt19937_64> workerRng;	// Random numbers of each worker
+	static const unsigned BFS_TOP_DOWN_MORSEL = 64;	// Frontier vertices per task
+	static const unsigned BFS_BOTTOM_UP_MORSEL = 4096;	// Candidate vertices per task
+	static const int BFS_ALPHA = 14, BFS_BETA = 24;	// Thresholds to switch the direction
+	struct BottomUpTask	// Candidate vertices [begin, begin + BFS_BOTTOM_UP_MORSEL) of csr[dir]'s pred
+	{
+		int dir, pred;
+		unsigned begin;
+	};
+
+	// Multi-source BFS state, one bit for each of the 64 sources of a batch, indexed by vertex ID
+	std::vector<unsigned long long> msSeen, msVisit, msVisitNext;
+
+	// SSPPR state, indexed by vertex ID
+	std::vector<double> pprReserve, pprResidue, pprEstimate;
+	std::vector<int> pprLevel;	// Hops from the source when first reached by the push, -1 if not
+	std::vector<int> pprDegree;	// Out-degree by the predicates in pprDegreePreds, -1 if not known yet
+	std::vector<int> pprDegreePreds;
+	std::vector<char> pprInQueue;
+	std::vector<int> pprTouched;	// Reached by the push
+	std::vector<int> pprQueue;
+	std::vector<int> pprHit;	// Estimate > 0
+	static const unsigned PPR_WALK_MORSEL = 1024;	// Random walks per task
+	static const unsigned PPR_INDEX_MORSEL = 256;	// Vertices per task when building a walk index
+
+	NeighborCache::List getDistinctNeighbors(int dir, int vid);
+	int getVertBound();
+	void getValidPreds(const std::vector<int> &pred_set, std::vector<int> &preds);
+	void getBottomUpTasks(const int *dirs, int dirNum, const std::vector<int> &pred_set, std::vector<BottomUpTask> &tasks);
+	void runTasks(unsigned long taskNum, const WorkStealingPool::Task &func);
+	void bfsInit(BFSSide &side, int src, bool forward);
+	void bfsReset(BFSSide &side);
+	bool bfsStep(BFSSide &side, const BFSSide &other, bool directed, const std::vector<int> &pred_set, \
+		long long candidateNum, int &meet);
+	int bfs(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set, std::vector<int> *path);
+	int getEdgePred(int from, int to, bool directed, const std::vector<int> &pred_set);
+	void msBFS(const int *srcs, int srcNum, const std::vector<int> &tgts, bool directed, int k, \
+		const std::vector<int> &pred_set, int *dist);
+	void pprInit(const std::vector<int> &preds);
+	int pprOutDegree(int vid, const std::vector<int> &preds);
+	int pprRandomWalk(int start, const std::vector<int> &preds, std::mt19937_64 &rng);
+	void pprPush(int s, double rmax, int k, const std::vector<int> &preds, double &rsum);
+	void pprWalk(double rsum, double omega, const std::vector<int> &preds, const PPRWalkIndex *index);
+	std::shared_ptr<const PPRWalkIndex> pprBuildIndex(const std::vector<int> &preds);
 public:
 	PathQueryHandler(CSR *_csr);
+	~PathQueryHandler();
 
 	void inputGraph(std::string filename);	// Read in a graph FOR TESTING. Graph file format:
 						// First line: #vertices #labels
@@ -38,6 +101,8 @@ public:
 	int getSetInSize(int vid, const std::vector<int> &pred_set);	// Get number of in-neighbors by pred_set
 	int getTotalInSize(int vid, bool distinct);	// Get the total number of in-neighbors of vert
 						// distinct will eliminate repetitive occurrences of same in-neighbor with different label edges
+	NeighborCache::List getDistinctInNeighbors(int vid) { return getDistinctNeighbors(1, vid); }
+						// Distinct in-neighbors in increasing order, shared with other queries
 
 	int getOutIndexByID(int vid, int pred);
 	int getOutSize(int vid, int pred);
@@ -45,6 +110,7 @@ public:
 	int getOutVertID(int vid, int pos);
 	int getSetOutSize(int vid, const std::vector<int> &pred_set);
 	int getTotalOutSize(int vid, bool distinct);
+	NeighborCache::List getDistinctOutNeighbors(int vid) { return getDistinctNeighbors(0, vid); }
 	void dfs(std::map<int, std::vector<int> > &route, std::map<int, bool> &vis, int q, int v, const std::vector<int> pred_set, std::vector<int> &ans, bool &finished);
 
 	// Path query evaluation functions
@@ -56,8 +122,16 @@ public:
 	bool kHopReachable(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set);
 	bool kHopReachableTest(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set);
 	std::vector<int> kHopReachablePath(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set);
+	void batchDistance(const std::vector<int> &uids, const std::vector<int> &vids, bool directed, int k, \
+		const std::vector<int> &pred_set, std::vector<int> &dist);	// Lengths of the shortest paths of all
+						// uids x vids pairs, -1 if longer than k; dist[i * vids.size() + j] for (uids[i], vids[j])
 
 	void SSPPR(int uid, int retNum, int k, const std::vector<int> &pred_set, std::vector< std::pair<int ,double> > &topkV2ppr);
+						// Parallel random walks on dense arrays, by the walk index of pred_set if any
+	void SSPPR0(int uid, int retNum, int k, const std::vector<int> &pred_set, std::vector< std::pair<int ,double> > &topkV2ppr);
+						// The sequential SSPPR, kept as the baseline
+	bool buildPPRWalkIndex(const std::vector<int> &pred_set);	// Build the walk index of pred_set, shared by
+						// the later SSPPR on the CSR(built by the first one if ppr_walk_index in init.conf)
 
     std::vector<std::pair<std::pair<int, int>, int>> kHopSubgraph(int uid, int vid, bool directed, int k, const std::vector<int> &pred_set);
     
@@ -0,0 +1,167 @@
+#include "PlanCache.h"
+
+using namespace std;
+
+PlanCache::PlanCache()
+{
+	this->capacity = PlanCache::DEFAULT_CAPACITY;
+	string capacity = Util::getConfigureValue("plan_cache_size");
+	if (!capacity.empty() && atoi(capacity.c_str()) >= 0)
+		this->capacity = atoi(capacity.c_str());
+	this->version = 0;
+	this->hit_num = 0;
+	this->miss_num = 0;
+	this->next_statement = 1;
+}
+
+string
+PlanCache::normalize(const string& _query)
+{
+	string key;
+	key.reserve(_query.length());
+	bool space = false;
+	size_t i = 0, n = _query.length();
+	while (i < n)
+	{
+		char c = _query[i];
+		if (isspace((unsigned char)c))
+		{
+			space = true;
+			++i;
+			continue;
+		}
+		if (c == '#')
+		{
+			while (i < n && _query[i] != '\n')
+				++i;
+			space = true;
+			continue;
+		}
+		if (space && !key.empty())
+			key += ' ';
+		space = false;
+
+		//copy IRIs and literals as they are; a '<' of less-than is copied up to the next '>' or
+		//the end, which only leaves the spaces there uncollapsed
+		size_t end = i + 1;
+		if (c == '<')
+		{
+			while (end < n && _query[end] != '>' && _query[end] != '\n')
+				++end;
+			end = end < n ? end + 1 : n;
+		}
+		else if ((c == '"' || c == '\'') && _query.compare(i, 3, string(3, c)) == 0)
+		{
+			size_t close = _query.find(string(3, c), i + 3);
+			while (close != string::npos && _query[close - 1] == '\\')
+				close = _query.find(string(3, c), close + 1);
+			end = close == string::npos ? n : close + 3;
+		}
+		else if (c == '"' || c == '\'')
+		{
+			while (end < n && _query[end] != c)
+				end += _query[end] == '\\' ? 2 : 1;
+			end = end < n ? end + 1 : n;
+		}
+		key.append(_query, i, end - i);
+		i = end;
+	}
+	return key;
+}
+
+bool
+PlanCache::get(const string& _key, Plan& _plan)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	unordered_map<string, Entry>::iterator it = this->plans.find(_key);
+	if (it == this->plans.end())
+	{
+		this->miss_num++;
+		return false;
+	}
+	this->hit_num++;
+	this->lru.splice(this->lru.begin(), this->lru, it->second.pos);
+	_plan = it->second.plan;
+	_plan.version = this->version;
+	return true;
+}
+
+void
+PlanCache::put(const string& _key, Plan& _plan)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	_plan.version = this->version;
+	if (this->capacity == 0)
+		return;
+	unordered_map<string, Entry>::iterator it = this->plans.find(_key);
+	if (it != this->plans.end())
+	{
+		this->lru.splice(this->lru.begin(), this->lru, it->second.pos);
+		it->second.plan = _plan;
+		return;
+	}
+	while (this->plans.size() >= this->capacity)
+	{
+		this->plans.erase(this->lru.back());
+		this->lru.pop_back();
+	}
+	this->lru.push_front(_key);
+	Entry& entry = this->plans[_key];
+	entry.plan = _plan;
+	entry.pos = this->lru.begin();
+}
+
+void
+PlanCache::putJoinPlans(const string& _key, const Plan& _plan)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	unordered_map<string, Entry>::iterator it = this->plans.find(_key);
+	if (it == this->plans.end() || _plan.version != this->version)
+		return;
+	it->second.plan.join_plans = _plan.join_plans;
+}
+
+void
+PlanCache::invalidateJoinPlans()
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	this->version++;
+	for (unordered_map<string, Entry>::iterator it = this->plans.begin(); it != this->plans.end(); ++it)
+		it->second.plan.join_plans.clear();
+}
+
+void
+PlanCache::clear()
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	this->version++;
+	this->plans.clear();
+	this->lru.clear();
+}
+
+string
+PlanCache::addStatement(const string& _query)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	string id = Util::int2string(this->next_statement++);
+	this->statements[id] = _query;
+	return id;
+}
+
+bool
+PlanCache::getStatement(const string& _id, string& _query)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	map<string, string>::iterator it = this->statements.find(_id);
+	if (it == this->statements.end())
+		return false;
+	_query = it->second;
+	return true;
+}
+
+bool
+PlanCache::removeStatement(const string& _id)
+{
+	lock_guard<mutex> guard(this->cache_lock);
+	return this->statements.erase(_id) > 0;
+}
@@ -0,0 +1,76 @@
+#ifndef _QUERY_PLANCACHE_H
+#define _QUERY_PLANCACHE_H
+
+#include "../Util/Util.h"
+#include "QueryTree.h"
+
+//Parsed queries, keyed by the normalized query text, so that a query asked again(most of all the
+//executions of a prepared statement) skips the SPARQL parser. Each plan also keeps the join order
+//chosen by Join for each BasicQuery, which is dropped when updates change the sizes it was costed
+//by. The plans are kept in LRU order up to plan_cache_size(in init.conf) queries.
+//Prepared statements are kept apart by id until they are closed, and their plans parsed again if evicted.
+class PlanCache
+{
+public:
+	//the join order of the core vars of a BasicQuery, valid while they are the same vars
+	struct JoinPlan
+	{
+		std::vector<std::string> vars;
+		std::vector<int> order;
+		std::vector<double> estimates;
+	};
+	struct Plan
+	{
+		QueryTree query_tree;	//as parsed, before any evaluation
+		std::vector<std::string> parameters;
+		std::vector<JoinPlan> join_plans;	//of the BasicQueries joined in Strategy 0, in turn
+		unsigned long long version;	//of the join plans when they were read
+		Plan() : version(0) {}
+	};
+
+	static const unsigned DEFAULT_CAPACITY = 1000;
+
+	PlanCache();
+
+	//the key of a query: whitespace outside IRIs and literals collapsed, and comments dropped
+	static std::string normalize(const std::string& _query);
+
+	//a copy of the plan, false if not cached
+	bool get(const std::string& _key, Plan& _plan);
+	//the version of the copy is set as in get()
+	void put(const std::string& _key, Plan& _plan);
+	//keep the join plans of a copy got before, unless they were invalidated since
+	void putJoinPlans(const std::string& _key, const Plan& _plan);
+	void invalidateJoinPlans();
+	void clear();
+
+	//each statement gets its own id, so closing it does not affect the others, and the
+	//statements of the same query share its plan
+	std::string addStatement(const std::string& _query);
+	bool getStatement(const std::string& _id, std::string& _query);
+	bool removeStatement(const std::string& _id);
+
+	unsigned long long getHitNum() const { return this->hit_num; }
+	unsigned long long getMissNum() const { return this->miss_num; }
+
+private:
+	typedef std::list<std::string> LRUList;
+	struct Entry
+	{
+		Plan plan;
+		LRUList::iterator pos;
+	};
+
+	std::mutex cache_lock;
+	unsigned capacity;
+	LRUList lru;	//most recently used first
+	std::unordered_map<std::string, Entry> plans;
+	unsigned long long version;
+	unsigned long long hit_num;
+	unsigned long long miss_num;
+
+	std::map<std::string, std::string> statements;
+	unsigned long long next_statement;
+};
+
+#endif //_QUERY_PLANCACHE_H
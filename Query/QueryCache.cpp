@@ -10,6 +10,42 @@
 
 using namespace std;
 
+QueryCache::QueryCache()
+{
+	//in MB
+	unsigned long long size = 256, item_size = 4;
+	string value = Util::getConfigureValue("query_cache_size");
+	if (!value.empty() && atoi(value.c_str()) >= 0)
+		size = atoi(value.c_str());
+	value = Util::getConfigureValue("query_cache_item_size");
+	if (!value.empty() && atoi(value.c_str()) >= 0)
+		item_size = atoi(value.c_str());
+	this->capacity = size * Util::MB;
+	//an entry must fit in its shard
+	this->item_capacity = min(item_size * Util::MB, this->capacity / QueryCache::SHARD_NUM);
+	this->generation = 0;
+
+	this->shards = new Shard[QueryCache::SHARD_NUM];
+	for (unsigned i = 0; i < QueryCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		s.bytes = 0;
+		s.pattern_hits = s.pattern_misses = s.result_hits = s.result_misses = 0;
+		s.evictions = s.invalidations = 0;
+	}
+}
+
+QueryCache::~QueryCache()
+{
+	delete[] this->shards;
+}
+
+QueryCache::Shard&
+QueryCache::shard(const string &_key)
+{
+	return this->shards[hash<string>()(_key) % QueryCache::SHARD_NUM];
+}
+
 bool QueryCache::getMinimalRepresentation(const Patterns &triple_pattern, Patterns &minimal_repre, map<string, string> &minimal_mapping)
 {
 	if ((int)triple_pattern.size() > TRIPLE_NUM_LIMIT)	return false;
@@ -93,43 +129,99 @@ bool QueryCache::getMinimalRepresentation(const Patterns &triple_pattern, Patter
 	return true;
 }
 
-bool QueryCache::tryCaching(const Patterns &triple_pattern, const TempResult &temp_result, int eva_time)
+//'P', the triples and then the vars, all separated by '\0' which no term has
+string
+QueryCache::patternKey(const Patterns &_minimal_repre, const vector<string> &_vars)
 {
-	lock_guard<mutex> lck(this->query_cache_lock);  //when quit this scope the lock will be released
-	//query_cache_lock.lock();
-	Patterns minimal_repre;
-	map<string, string> minimal_mapping;
+	string key = "P";
+	for (int i = 0; i < (int)_minimal_repre.size(); i++)
+	{
+		key += _minimal_repre[i].subject.value;
+		key += '\0';
+		key += _minimal_repre[i].predicate.value;
+		key += '\0';
+		key += _minimal_repre[i].object.value;
+		key += '\0';
+	}
+	for (int i = 0; i < (int)_vars.size(); i++)
+	{
+		key += '\0';
+		key += _vars[i];
+	}
+	return key;
+}
 
-	if (!this->getMinimalRepresentation(triple_pattern, minimal_repre, minimal_mapping))
+bool
+QueryCache::insert(Entry &_entry, unsigned long long _generation)
+{
+	if (_entry.bytes > this->capacity / QueryCache::SHARD_NUM)
+		return false;
+	Shard& s = this->shard(_entry.key);
+	lock_guard<mutex> lck(s.lock);
+	if (_generation != this->generation)
 		return false;
 
-	if (eva_time < MINIMAL_EVA_TIME_LIMIT) return false;
-
-	long long temp_result_memory_used = (long long)temp_result.id_varset.getVarsetSize() * (long long)temp_result.result.size();
-	if (temp_result_memory_used > ITEM_MEMORY_LIMIT)	return false;
-
-	while (temp_result_memory_used + total_memory_used > TOTAL_MEMORY_LIMIT)
+	unordered_map<string, list<Entry>::iterator>::iterator it = s.index.find(_entry.key);
+	if (it != s.index.end())
+		this->erase(s, it->second);
+	while (!s.lru.empty() && s.bytes + _entry.bytes > this->capacity / QueryCache::SHARD_NUM)
 	{
-		LRUStruct x = lru.top();
-		lru.pop();
+		this->erase(s, prev(s.lru.end()));
+		s.evictions++;
+	}
 
-		pair<vector<unsigned>, int> &cached_element = cache[x.second.first][x.second.second];
-		if (x.first != cached_element.second)
-		{
-			x.first = cached_element.second;
-			lru.push(x);
-		}
-		else
-		{
-			total_memory_used -= (long long)cached_element.first.size();
+	s.lru.push_front(Entry());
+	Entry& entry = s.lru.front();
+	entry.key.swap(_entry.key);
+	entry.ids.swap(_entry.ids);
+	entry.result = _entry.result;
+	entry.predicates.swap(_entry.predicates);
+	entry.all_predicates = _entry.all_predicates;
+	entry.bytes = _entry.bytes;
+
+	s.index[entry.key] = s.lru.begin();
+	if (entry.all_predicates)
+		s.all_predicate_keys.insert(entry.key);
+	for (int i = 0; i < (int)entry.predicates.size(); i++)
+		s.predicate_keys[entry.predicates[i]].insert(entry.key);
+	s.bytes += entry.bytes;
+	return true;
+}
 
-			cache[x.second.first].erase(x.second.second);
-			if (cache[x.second.first].empty())
-				cache.erase(x.second.first);
-		}
+void
+QueryCache::erase(Shard &_shard, list<Entry>::iterator _it)
+{
+	if (_it->all_predicates)
+		_shard.all_predicate_keys.erase(_it->key);
+	for (int i = 0; i < (int)_it->predicates.size(); i++)
+	{
+		unordered_map<string, unordered_set<string> >::iterator pit = _shard.predicate_keys.find(_it->predicates[i]);
+		if (pit == _shard.predicate_keys.end())
+			continue;
+		pit->second.erase(_it->key);
+		if (pit->second.empty())
+			_shard.predicate_keys.erase(pit);
 	}
+	_shard.bytes -= _it->bytes;
+	_shard.index.erase(_it->key);
+	_shard.lru.erase(_it);
+}
+
+bool QueryCache::tryCaching(const Patterns &triple_pattern, const TempResult &temp_result, int eva_time, unsigned long long _generation)
+{
+	if (this->capacity == 0 || eva_time < MINIMAL_EVA_TIME_LIMIT)
+		return false;
 
 	int varnum = temp_result.id_varset.getVarsetSize();
+	unsigned long long ids_bytes = (unsigned long long)varnum * temp_result.result.size() * sizeof(unsigned);
+	if (ids_bytes > this->item_capacity)
+		return false;
+
+	Patterns minimal_repre;
+	map<string, string> minimal_mapping;
+
+	if (!this->getMinimalRepresentation(triple_pattern, minimal_repre, minimal_mapping))
+		return false;
 
 	Varset unordered_varset;
 	for (int i = 0; i < varnum; i++)
@@ -144,46 +236,33 @@ bool QueryCache::tryCaching(const Patterns &triple_pattern, const TempResult &te
 #endif
 	vector<int> unordered2ordered = unordered_varset.mapTo(ordered_varset);
 
-	if (cache.count(minimal_repre) == 0)
-	{
-		cache[minimal_repre] = map<vector<string>, pair<vector<unsigned>, int> >();
-	}
-
-	if (cache[minimal_repre].count(ordered_varset.vars) == 0)
-	{
-		cache[minimal_repre][ordered_varset.vars] = pair<vector<unsigned>, int>();
-	}
-
-	vector<unsigned> &cache_result = cache[minimal_repre][ordered_varset.vars].first;
-
-	cache_result.resize(varnum * (int)temp_result.result.size());
-
+	Entry entry;
+	entry.key = QueryCache::patternKey(minimal_repre, ordered_varset.vars);
+	entry.ids.resize(varnum * (int)temp_result.result.size());
 	for (int i = 0; i < (int)temp_result.result.size(); i++)
 		for (int j = 0; j < varnum; j++)
-			cache_result[i * varnum + unordered2ordered[j]] = temp_result.result[i].id[j];
+			entry.ids[i * varnum + unordered2ordered[j]] = temp_result.result[i].id[j];
 
-	cache[minimal_repre][ordered_varset.vars].second = ++time_now;
-	lru.push(make_pair(time_now, make_pair(minimal_repre, ordered_varset.vars)));
-	total_memory_used += temp_result_memory_used;
-
-	if (time_now >= (int)1e9)
+	set<string> predicates;
+	entry.all_predicates = false;
+	for (int i = 0; i < (int)minimal_repre.size(); i++)
 	{
-		time_now = 0;
-
-		for (map<Patterns, map<vector<string>, pair<vector<unsigned>, int> > >::iterator i = cache.begin(); i != cache.end(); i++)
-			for (map<vector<string>, pair<vector<unsigned>, int> >::iterator j = i->second.begin(); j != i->second.end(); j++)
-				j->second.second = time_now;
+		if (minimal_repre[i].predicate.value[0] == '?')
+			entry.all_predicates = true;
+		else
+			predicates.insert(minimal_repre[i].predicate.value);
 	}
+	entry.predicates.assign(predicates.begin(), predicates.end());
+	entry.bytes = ids_bytes + entry.key.length() + QueryCache::ENTRY_OVERHEAD;
 
-	return true;
+	return this->insert(entry, _generation);
 }
 
-//NOTICE: in this function we also modify some contents, so we must use mutex instead of rwlock
 bool QueryCache::checkCached(const Patterns &triple_pattern, const Varset &varset, TempResult &temp_result)
 {
-	//this->query_cache_lock.lock();
-	lock_guard<mutex> lck(this->query_cache_lock);  //when quit this scope the lock will be released
-	//query_cache_lock.lock();
+	if (this->capacity == 0)
+		return false;
+
 	Patterns minimal_repre;
 	map<string, string> minimal_mapping;
 
@@ -205,43 +284,181 @@ bool QueryCache::checkCached(const Patterns &triple_pattern, const Varset &varse
 #endif
 	vector<int> unordered2ordered = unordered_varset.mapTo(ordered_varset);
 
-	if (cache.count(minimal_repre) != 0)
+	string key = QueryCache::patternKey(minimal_repre, ordered_varset.vars);
+	vector<unsigned> cache_result;
 	{
-		if (cache[minimal_repre].count(ordered_varset.vars) != 0)
+		Shard& s = this->shard(key);
+		lock_guard<mutex> lck(s.lock);
+		unordered_map<string, list<Entry>::iterator>::iterator it = s.index.find(key);
+		if (it == s.index.end())
 		{
-			vector<unsigned> &cache_result = cache[minimal_repre][ordered_varset.vars].first;
+			s.pattern_misses++;
+			return false;
+		}
+		s.pattern_hits++;
+		s.lru.splice(s.lru.begin(), s.lru, it->second);
+		cache_result = it->second->ids;
+	}
 
-			temp_result.id_varset = varset;
+	temp_result.id_varset = varset;
 
-			temp_result.result.resize((int)cache_result.size() / varnum);
-			for (int i = 0; i < (int)temp_result.result.size(); i++)
-			{
-				unsigned *v = new unsigned [varnum];
+	temp_result.result.resize(varnum == 0 ? 0 : (int)cache_result.size() / varnum);
+	for (int i = 0; i < (int)temp_result.result.size(); i++)
+	{
+		unsigned *v = temp_result.newRow(varnum);
 
-				for (int j = 0; j < varnum; j++)
-					v[j] = cache_result[i * varnum + unordered2ordered[j]];
+		for (int j = 0; j < varnum; j++)
+			v[j] = cache_result[i * varnum + unordered2ordered[j]];
 
-				temp_result.result[i].id = v;
-			}
+		temp_result.result[i].id = v;
+	}
+
+	return true;
+}
 
-			time_now = min(time_now + 1, (int)1e9);
-			cache[minimal_repre][ordered_varset.vars].second = time_now;
+bool
+QueryCache::tryCachingResult(const string &_key, const vector<string> &_predicates, bool _all_predicates,
+	ResultSet &_result_set, int _eva_time, unsigned long long _generation)
+{
+	if (this->capacity == 0 || _eva_time < MINIMAL_RESULT_EVA_TIME_LIMIT || _result_set.checkUseStream())
+		return false;
+	if (_result_set.ansNum > 0 && _result_set.answer == NULL)
+		return false;
 
-			return true;
+	unsigned long long value_num = (unsigned long long)_result_set.ansNum * _result_set.select_var_num;
+	unsigned long long bytes = (value_num + _result_set.select_var_num) * sizeof(string) + _key.length() + QueryCache::ENTRY_OVERHEAD;
+	if (bytes > this->item_capacity)
+		return false;
+
+	shared_ptr<Result> result = make_shared<Result>();
+	result->var_name.assign(_result_set.var_name, _result_set.var_name + _result_set.select_var_num);
+	result->true_select_var_num = _result_set.true_select_var_num;
+	result->ans_num = _result_set.ansNum;
+	result->answer.reserve(value_num);
+	for (unsigned i = 0; i < _result_set.ansNum; i++)
+		for (int j = 0; j < _result_set.select_var_num; j++)
+		{
+			result->answer.push_back(_result_set.answer[i][j]);
+			bytes += result->answer.back().length();
 		}
+	if (bytes > this->item_capacity)
+		return false;
+	result->output_offset = _result_set.output_offset;
+	result->output_limit = _result_set.output_limit;
+
+	Entry entry;
+	entry.key = "R" + _key;
+	entry.result = result;
+	entry.predicates = _predicates;
+	entry.all_predicates = _all_predicates;
+	entry.bytes = bytes;
+	return this->insert(entry, _generation);
+}
+
+bool
+QueryCache::checkCachedResult(const string &_key, ResultSet &_result_set)
+{
+	if (this->capacity == 0)
+		return false;
+
+	string key = "R" + _key;
+	shared_ptr<const Result> result;
+	{
+		Shard& s = this->shard(key);
+		lock_guard<mutex> lck(s.lock);
+		unordered_map<string, list<Entry>::iterator>::iterator it = s.index.find(key);
+		if (it == s.index.end())
+		{
+			s.result_misses++;
+			return false;
+		}
+		s.result_hits++;
+		s.lru.splice(s.lru.begin(), s.lru, it->second);
+		result = it->second->result;
 	}
 
-	return false;
+	//the rows are laid out as getFinalResult() does
+	_result_set.setVar(result->var_name);
+	_result_set.true_select_var_num = result->true_select_var_num;
+	_result_set.ansNum = result->ans_num;
+	_result_set.answer = new string*[result->ans_num];
+	_result_set.delete_another_way = 1;
+	if (result->ans_num > 0)
+	{
+		string *t = new string[result->answer.size()];
+		for (size_t i = 0; i < result->answer.size(); i++)
+			t[i] = result->answer[i];
+		for (unsigned i = 0; i < result->ans_num; i++)
+			_result_set.answer[i] = t + (size_t)i * result->var_name.size();
+	}
+	_result_set.setOutputOffsetLimit(result->output_offset, result->output_limit);
+	return true;
+}
+
+void
+QueryCache::invalidate(const vector<string> &_predicates)
+{
+	if (_predicates.empty())
+		return;
+	//a result being computed now is not cached, see insert()
+	this->generation++;
+	for (unsigned i = 0; i < QueryCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		lock_guard<mutex> lck(s.lock);
+		if (s.lru.empty())
+			continue;
+		vector<string> keys(s.all_predicate_keys.begin(), s.all_predicate_keys.end());
+		for (int j = 0; j < (int)_predicates.size(); j++)
+		{
+			unordered_map<string, unordered_set<string> >::iterator pit = s.predicate_keys.find(_predicates[j]);
+			if (pit != s.predicate_keys.end())
+				keys.insert(keys.end(), pit->second.begin(), pit->second.end());
+		}
+		for (int j = 0; j < (int)keys.size(); j++)
+		{
+			//an entry of several of the predicates is listed for each
+			unordered_map<string, list<Entry>::iterator>::iterator it = s.index.find(keys[j]);
+			if (it == s.index.end())
+				continue;
+			this->erase(s, it->second);
+			s.invalidations++;
+		}
+	}
 }
 
 void QueryCache::clear()
 {
-	lock_guard<mutex> lck(this->query_cache_lock);  //when quit this scope the 
-	//query_cache_lock.lock();
-	time_now = 0;
-	total_memory_used = 0;
-
-	cache.clear();
-	while (!lru.empty())
-		lru.pop();
+	this->generation++;
+	for (unsigned i = 0; i < QueryCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		lock_guard<mutex> lck(s.lock);
+		s.invalidations += s.lru.size();
+		s.lru.clear();
+		s.index.clear();
+		s.predicate_keys.clear();
+		s.all_predicate_keys.clear();
+		s.bytes = 0;
+	}
+}
+
+void
+QueryCache::getStats(Stats &_stats)
+{
+	memset(&_stats, 0, sizeof(Stats));
+	_stats.capacity = this->capacity;
+	for (unsigned i = 0; i < QueryCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		lock_guard<mutex> lck(s.lock);
+		_stats.pattern_hits += s.pattern_hits;
+		_stats.pattern_misses += s.pattern_misses;
+		_stats.result_hits += s.result_hits;
+		_stats.result_misses += s.result_misses;
+		_stats.evictions += s.evictions;
+		_stats.invalidations += s.invalidations;
+		_stats.entries += s.lru.size();
+		_stats.bytes += s.bytes;
+	}
 }
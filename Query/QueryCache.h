@@ -3,7 +3,7 @@
 # Author: Hao, Cui
 # Mail: prospace@bupt.edu.cn
 # Last Modified: 2017-04-06
-# Description: 
+# Description:
 =============================================================================*/
 
 #ifndef _QUERY_QUERYCACHE_H
@@ -12,36 +12,113 @@
 #include "../Util/Util.h"
 #include "QueryTree.h"
 #include "TempResult.h"
+#include "ResultSet.h"
 #include "Varset.h"
 
+//The results of basic graph patterns(as IDs, keyed by the patterns with the variables renamed in
+//a canonical way) and of whole SELECT/ASK queries(as strings, keyed by the normalized query text).
+//The entries are split among shards by key, each with its own lock and LRU list, and bounded
+//together by query_cache_size(in init.conf). Each entry keeps the predicates it was computed
+//from, so an update drops only the entries of the predicates it changed, and the entries of
+//patterns with a variable predicate.
 class QueryCache
 {
-	private:
-		const int TRIPLE_NUM_LIMIT = 30;
-		const int VAR_NUM_LIMIT = 8;
-		const int MINIMAL_EVA_TIME_LIMIT = 100;
-		const long long ITEM_MEMORY_LIMIT = 1000000LL;
-		const long long TOTAL_MEMORY_LIMIT = 100000000LL;
+	public:
+		struct Stats
+		{
+			unsigned long long pattern_hits;
+			unsigned long long pattern_misses;
+			unsigned long long result_hits;
+			unsigned long long result_misses;
+			unsigned long long evictions;
+			unsigned long long invalidations;
+			unsigned long long entries;
+			unsigned long long bytes;
+			unsigned long long capacity;
+		};
+
+		QueryCache();
+		~QueryCache();
+
+		//results computed since _generation(got before the query began) are only cached if no
+		//update happened in between, since they may miss it
+		unsigned long long getGeneration() const { return this->generation; }
 
-		mutex query_cache_lock;
+		bool tryCaching(const std::vector<QueryTree::GroupPattern::Pattern> &triple_pattern, const TempResult &temp_result, int eva_time, unsigned long long _generation);
+		bool checkCached(const std::vector<QueryTree::GroupPattern::Pattern> &triple_pattern, const Varset &varset, TempResult &temp_result);
 
-		int time_now;
-		long long total_memory_used;
+		//_all_predicates is set if the query may read any predicate, see QueryTree::getPredicates()
+		bool tryCachingResult(const std::string &_key, const std::vector<std::string> &_predicates, bool _all_predicates,
+			ResultSet &_result_set, int _eva_time, unsigned long long _generation);
+		bool checkCachedResult(const std::string &_key, ResultSet &_result_set);
 
+		//drop the entries computed from the triples of these predicates
+		void invalidate(const std::vector<std::string> &_predicates);
+		void clear();
+		void getStats(Stats &_stats);
+
+	private:
 		typedef std::vector<QueryTree::GroupPattern::Pattern> Patterns;
-		typedef std::pair<int, std::pair<Patterns, std::vector<std::string> > > LRUStruct;
 
-		std::map<Patterns, std::map<std::vector<std::string>, std::pair<std::vector<unsigned>, int> > > cache;
-		std::priority_queue<LRUStruct, std::vector<LRUStruct>, std::greater<LRUStruct> > lru;
+		static const unsigned SHARD_NUM = 16;
+		static const int TRIPLE_NUM_LIMIT = 30;
+		static const int VAR_NUM_LIMIT = 8;
+		static const int MINIMAL_EVA_TIME_LIMIT = 100;
+		static const int MINIMAL_RESULT_EVA_TIME_LIMIT = 10;
+		//bookkeeping bytes counted for each entry
+		static const unsigned ENTRY_OVERHEAD = 128;
 
-		bool getMinimalRepresentation(const Patterns &triple_pattern, Patterns &minimal_repre, std::map<std::string, std::string> &minimal_mapping);
+		struct Result
+		{
+			std::vector<std::string> var_name;
+			int true_select_var_num;
+			unsigned ans_num;
+			std::vector<std::string> answer;	//row by row
+			int output_offset, output_limit;
+		};
 
-	public:
-		QueryCache():time_now(0), total_memory_used(0){}
+		struct Entry
+		{
+			std::string key;
+			std::vector<unsigned> ids;	//of a pattern, row by row in the order of the vars in the key
+			std::shared_ptr<const Result> result;	//of a query
+			std::vector<std::string> predicates;
+			bool all_predicates;
+			unsigned long long bytes;
+		};
 
-		bool tryCaching(const Patterns &triple_pattern, const TempResult &temp_result, int eva_time);
-		bool checkCached(const Patterns &triple_pattern, const Varset &varset, TempResult &temp_result);
-		void clear();
+		struct Shard
+		{
+			std::mutex lock;
+			//most recently used first
+			std::list<Entry> lru;
+			std::unordered_map<std::string, std::list<Entry>::iterator> index;
+			//the keys of the entries of each predicate, and of those of any predicate
+			std::unordered_map<std::string, std::unordered_set<std::string> > predicate_keys;
+			std::unordered_set<std::string> all_predicate_keys;
+			unsigned long long bytes;
+			unsigned long long pattern_hits;
+			unsigned long long pattern_misses;
+			unsigned long long result_hits;
+			unsigned long long result_misses;
+			unsigned long long evictions;
+			unsigned long long invalidations;
+		};
+
+		QueryCache(const QueryCache&);
+		QueryCache& operator=(const QueryCache&);
+
+		Shard& shard(const std::string &_key);
+		bool getMinimalRepresentation(const Patterns &triple_pattern, Patterns &minimal_repre, std::map<std::string, std::string> &minimal_mapping);
+		static std::string patternKey(const Patterns &_minimal_repre, const std::vector<std::string> &_vars);
+		//insert(or replace) the entry unless the data changed since _generation
+		bool insert(Entry &_entry, unsigned long long _generation);
+		void erase(Shard &_shard, std::list<Entry>::iterator _it);
+
+		Shard* shards;
+		unsigned long long capacity;
+		unsigned long long item_capacity;
+		std::atomic<unsigned long long> generation;
 };
 
 #endif // _QUERY_QUERYCACHE_H
@@ -1021,6 +1021,236 @@ bool QueryTree::checkSelectAggregateFunctionGroupByValid()
 	return true;
 }
 
+static void visitCompTreeTerms(QueryTree::CompTreeNode &node, const function<void(string&)> &func)
+{
+	func(node.val);
+	func(node.path_args.src);
+	func(node.path_args.dst);
+	for (size_t i = 0; i < node.children.size(); i++)
+		visitCompTreeTerms(node.children[i], func);
+}
+
+static void visitGroupPatternTerms(QueryTree::GroupPattern &group_pattern, const function<void(string&)> &func)
+{
+	for (size_t i = 0; i < group_pattern.sub_group_pattern.size(); i++)
+	{
+		QueryTree::GroupPattern::SubGroupPattern &sub = group_pattern.sub_group_pattern[i];
+		if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Pattern_type)
+		{
+			func(sub.pattern.subject.value);
+			func(sub.pattern.predicate.value);
+			func(sub.pattern.object.value);
+		}
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Group_type)
+			visitGroupPatternTerms(sub.group_pattern, func);
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Union_type)
+		{
+			for (size_t j = 0; j < sub.unions.size(); j++)
+				visitGroupPatternTerms(sub.unions[j], func);
+		}
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Optional_type
+			|| sub.type == QueryTree::GroupPattern::SubGroupPattern::Minus_type)
+			visitGroupPatternTerms(sub.optional, func);
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Filter_type)
+			visitCompTreeTerms(sub.filter, func);
+	}
+}
+
+/**
+	Apply a function to each string of the query which may hold an RDF term:
+	the triples, filters, projected expressions and ORDER BY expressions,
+	and the patterns of updates. BIND expressions are kept as text, so they are
+	not visited.
+
+	@param _func the function to apply.
+*/
+void QueryTree::visitTerms(const function<void(string&)> &_func)
+{
+	visitGroupPatternTerms(this->group_pattern, _func);
+	visitGroupPatternTerms(this->insert_patterns, _func);
+	visitGroupPatternTerms(this->delete_patterns, _func);
+	for (size_t i = 0; i < this->projection.size(); i++)
+	{
+		_func(this->projection[i].path_args.src);
+		_func(this->projection[i].path_args.dst);
+		visitCompTreeTerms(this->projection[i].comp_tree_root, _func);
+	}
+	for (size_t i = 0; i < this->order_by.size(); i++)
+		visitCompTreeTerms(this->order_by[i].comp_tree_root, _func);
+}
+
+/**
+	Get the placeholders of a prepared statement, written as $name where a term
+	may appear. gStore takes variables only in the ?name form, so $name is left
+	for the placeholders.
+
+	@param _params the placeholders found, each once and sorted.
+*/
+void QueryTree::getParameters(vector<string> &_params)
+{
+	set<string> params;
+	this->visitTerms([&params](string &_str)
+	{
+		if (_str.length() > 1 && _str[0] == '$')
+			params.insert(_str);
+	});
+	_params.assign(params.begin(), params.end());
+}
+
+/**
+	Replace the placeholders of a prepared statement with RDF terms, in the form
+	of N-Triples: <iri>, "literal", "literal"@lang or "literal"^^<type>.
+
+	@param _terms the term of each placeholder, keyed by $name.
+	@return true if every placeholder is bound to a valid term, false otherwise.
+*/
+bool QueryTree::bindParameters(const map<string, string> &_terms)
+{
+	for (map<string, string>::const_iterator it = _terms.begin(); it != _terms.end(); ++it)
+	{
+		const string &term = it->second;
+		if (term.empty() || (term[0] != '<' && term[0] != '"') || (term[0] == '<' && term[term.length() - 1] != '>'))
+		{
+			printf("[ERROR]	%s is not an IRI or a literal for %s.\n", term.c_str(), it->first.c_str());
+			return false;
+		}
+	}
+
+	bool all_bound = true;
+	this->visitTerms([&](string &_str)
+	{
+		if (_str.length() <= 1 || _str[0] != '$')
+			return;
+		map<string, string>::const_iterator it = _terms.find(_str);
+		if (it == _terms.end())
+		{
+			printf("[ERROR]	The parameter %s is not bound.\n", _str.c_str());
+			all_bound = false;
+		}
+		else
+			_str = it->second;
+	});
+	return all_bound;
+}
+
+static void visitCompTreeNodes(QueryTree::CompTreeNode &node, const function<void(QueryTree::CompTreeNode&)> &func)
+{
+	func(node);
+	for (size_t i = 0; i < node.children.size(); i++)
+		visitCompTreeNodes(node.children[i], func);
+}
+
+static void visitGroupPatternCompTrees(QueryTree::GroupPattern &group_pattern, const function<void(QueryTree::CompTreeNode&)> &func)
+{
+	for (size_t i = 0; i < group_pattern.sub_group_pattern.size(); i++)
+	{
+		QueryTree::GroupPattern::SubGroupPattern &sub = group_pattern.sub_group_pattern[i];
+		if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Group_type)
+			visitGroupPatternCompTrees(sub.group_pattern, func);
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Union_type)
+		{
+			for (size_t j = 0; j < sub.unions.size(); j++)
+				visitGroupPatternCompTrees(sub.unions[j], func);
+		}
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Optional_type
+			|| sub.type == QueryTree::GroupPattern::SubGroupPattern::Minus_type)
+			visitGroupPatternCompTrees(sub.optional, func);
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Filter_type)
+			visitCompTreeNodes(sub.filter, func);
+	}
+}
+
+/**
+	Apply a function to each node of the expressions of the query: the filters,
+	projected expressions and ORDER BY expressions.
+
+	@param _func the function to apply.
+*/
+void QueryTree::visitCompTrees(const function<void(CompTreeNode&)> &_func)
+{
+	visitGroupPatternCompTrees(this->group_pattern, _func);
+	for (size_t i = 0; i < this->projection.size(); i++)
+		visitCompTreeNodes(this->projection[i].comp_tree_root, _func);
+	for (size_t i = 0; i < this->order_by.size(); i++)
+		visitCompTreeNodes(this->order_by[i].comp_tree_root, _func);
+}
+
+static bool getGroupPatternPredicates(QueryTree::GroupPattern &group_pattern, set<string> &predicates)
+{
+	bool bound = true;
+	for (size_t i = 0; i < group_pattern.sub_group_pattern.size(); i++)
+	{
+		QueryTree::GroupPattern::SubGroupPattern &sub = group_pattern.sub_group_pattern[i];
+		if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Pattern_type)
+		{
+			if (sub.pattern.predicate.value[0] == '?')
+				bound = false;
+			else
+				predicates.insert(sub.pattern.predicate.value);
+		}
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Group_type)
+			bound = getGroupPatternPredicates(sub.group_pattern, predicates) && bound;
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Union_type)
+		{
+			for (size_t j = 0; j < sub.unions.size(); j++)
+				bound = getGroupPatternPredicates(sub.unions[j], predicates) && bound;
+		}
+		else if (sub.type == QueryTree::GroupPattern::SubGroupPattern::Optional_type
+			|| sub.type == QueryTree::GroupPattern::SubGroupPattern::Minus_type)
+			bound = getGroupPatternPredicates(sub.optional, predicates) && bound;
+	}
+	return bound;
+}
+
+/**
+	Get the predicates of the triples which the results of the query are
+	computed from, so that a cached result is dropped only by the updates of
+	these predicates.
+
+	@param _predicates the predicates of the patterns and of the predicate sets
+	of path queries, each once and sorted.
+	@return false if the query may read the triples of any predicate: a pattern
+	has a variable predicate or a path query has no predicate set.
+*/
+bool QueryTree::getPredicates(vector<string> &_predicates)
+{
+	set<string> predicates;
+	bool bound = getGroupPatternPredicates(this->group_pattern, predicates);
+	auto add_path = [&](const PathArgs &_path_args)
+	{
+		if (_path_args.src.empty())
+			return;
+		if (_path_args.pred_set.empty())
+			bound = false;
+		predicates.insert(_path_args.pred_set.begin(), _path_args.pred_set.end());
+	};
+	for (size_t i = 0; i < this->projection.size(); i++)
+		add_path(this->projection[i].path_args);
+	this->visitCompTrees([&](CompTreeNode &_node) { add_path(_node.path_args); });
+	_predicates.assign(predicates.begin(), predicates.end());
+	return bound;
+}
+
+/**
+	Check whether the results of the query may differ when it is asked again
+	on the same data: it calls NOW() or a custom function.
+
+	@return true if the results may differ, false otherwise.
+*/
+bool QueryTree::checkNondeterministic()
+{
+	for (size_t i = 0; i < this->projection.size(); i++)
+		if (this->projection[i].aggregate_type == ProjectionVar::Custom_type)
+			return true;
+	bool nondeterministic = false;
+	this->visitCompTrees([&](CompTreeNode &_node)
+	{
+		if (_node.oprt == "NOW")
+			nondeterministic = true;
+	});
+	return nondeterministic;
+}
+
 /**
 	Print QueryTree.
 */
@@ -210,6 +210,7 @@ class QueryTree
 				SubGroupPattern(const SubGroupPattern& _sgp):type(_sgp.type)
 				{
 					pattern = _sgp.pattern;
+					group_pattern = _sgp.group_pattern;
 					unions = _sgp.unions;
 					optional = _sgp.optional;
 					filter = _sgp.filter;
@@ -275,6 +276,9 @@ class QueryTree
 			//only use patterns
 			GroupPattern insert_patterns, delete_patterns;
 
+			void visitTerms(const std::function<void(std::string&)> &_func);
+			void visitCompTrees(const std::function<void(CompTreeNode&)> &_func);
+
 		public:
 			QueryTree():
 				query_form(Select_Query), projection_modifier(Modifier_None), projection_asterisk(false), offset(0), limit(-1), update_type(Not_Update){}
@@ -319,6 +323,14 @@ class QueryTree
 			bool checkAtLeastOneAggregateFunction();
 			bool checkSelectAggregateFunctionGroupByValid();
 
+			// $name placeholders of prepared statements
+			void getParameters(std::vector<std::string> &_params);
+			bool bindParameters(const std::map<std::string, std::string> &_terms);
+
+			// what the results depend on, for the query cache
+			bool getPredicates(std::vector<std::string> &_predicates);
+			bool checkNondeterministic();
+
 			void print();
 };
 
@@ -154,8 +154,14 @@ string
 ResultSet::to_JSON()
 {
 	stringstream _buf;
+	this->writeJSON(_buf);
+	return _buf.str();
+}
 
-	_buf << "{ \"head\": { \"link\": [], \"vars\": [";
+void
+ResultSet::writeJSON(ostream& _buf, const string& _status)
+{
+	_buf << "{ " << _status << "\"head\": { \"link\": [], \"vars\": [";
 	for (int i = 0; i < this->true_select_var_num; i++)
 	{
 		if (i != 0)
@@ -186,6 +192,8 @@ ResultSet::to_JSON()
               break;
 		}
 			
+		if (!_buf)
+			return;
 		if (this->useStream)
 		{
             bp = this->stream->read();
@@ -312,8 +320,257 @@ ResultSet::to_JSON()
 	_buf << "\n\t\t]\n";
 	_buf << "\t}\n";
 	_buf << "}\n";
+}
 
-	return _buf.str();
+//the name of the i-th variable without ? or $
+string
+ResultSet::varName(int _i)
+{
+	const string& name = this->var_name[_i];
+	if (!name.empty() && (name[0] == '?' || name[0] == '$'))
+		return name.substr(1);
+	return name;
+}
+
+//the index of the first row to visit with nextRow()
+long long
+ResultSet::firstRow()
+{
+	if (this->useStream)
+	{
+		this->resetStream();
+		return 0;
+	}
+	return this->output_offset;
+}
+
+//read the next row within output_offset and output_limit into _row
+bool
+ResultSet::nextRow(long long& _i, vector<string>& _row)
+{
+	_row.resize(this->true_select_var_num);
+	while (_i < (long long)this->ansNum)
+	{
+		if (this->output_limit != -1 && _i >= (long long)this->output_offset + this->output_limit)
+			return false;
+		const Bstr* bp = NULL;
+		if (this->useStream)
+			bp = this->stream->read();
+		long long cur = _i++;
+		if (cur < this->output_offset)
+			continue;
+		for (int j = 0; j < this->true_select_var_num; j++)
+		{
+			if (this->useStream)
+				_row[j] = bp[j].getStr();
+			else
+				_row[j] = this->answer[cur][j];
+		}
+		return true;
+	}
+	return false;
+}
+
+//split a term into its type in SPARQL results("uri", "literal" or "bnode"),
+//value, datatype and language tag
+static void
+splitTerm(const string& _term, string& _type, string& _value, string& _datatype, string& _lang)
+{
+	_datatype.clear();
+	_lang.clear();
+	if (_term.size() >= 2 && _term[0] == '<' && _term[_term.size() - 1] == '>')
+	{
+		_type = "uri";
+		_value = _term.substr(1, _term.size() - 2);
+	}
+	else if (_term.compare(0, 2, "_:") == 0)
+	{
+		_type = "bnode";
+		_value = _term.substr(2);
+	}
+	else if (!_term.empty() && _term[0] == '"')
+	{
+		_type = "literal";
+		size_t quote = _term.rfind('"');
+		if (quote == 0)
+		{
+			_value = _term.substr(1);
+			return;
+		}
+		_value = _term.substr(1, quote - 1);
+		string suffix = _term.substr(quote + 1);
+		if (suffix.compare(0, 3, "^^<") == 0 && suffix[suffix.size() - 1] == '>')
+			_datatype = suffix.substr(3, suffix.size() - 4);
+		else if (!suffix.empty() && suffix[0] == '@')
+			_lang = suffix.substr(1);
+	}
+	else
+	{
+		_type = "literal";
+		_value = _term;
+	}
+}
+
+static void
+writeJSONString(ostream& _out, const string& _s)
+{
+	_out << '"';
+	for (size_t i = 0; i < _s.size(); i++)
+	{
+		char c = _s[i];
+		switch (c)
+		{
+		case '"':
+			_out << "\\\"";
+			break;
+		case '\\':
+			_out << "\\\\";
+			break;
+		case '\n':
+			_out << "\\n";
+			break;
+		case '\r':
+			_out << "\\r";
+			break;
+		case '\t':
+			_out << "\\t";
+			break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char hex[8];
+				sprintf(hex, "\\u%04x", (unsigned char)c);
+				_out << hex;
+			}
+			else
+				_out << c;
+		}
+	}
+	_out << '"';
+}
+
+static void
+writeCSVField(ostream& _out, const string& _s)
+{
+	if (_s.find_first_of(",\"\r\n") == string::npos)
+	{
+		_out << _s;
+		return;
+	}
+	_out << '"';
+	for (size_t i = 0; i < _s.size(); i++)
+	{
+		if (_s[i] == '"')
+			_out << "\"\"";
+		else
+			_out << _s[i];
+	}
+	_out << '"';
+}
+
+//SPARQL 1.1 Query Results JSON Format
+void
+ResultSet::writeSparqlJSON(ostream& _out)
+{
+	_out << "{\"head\": {\"vars\": [";
+	for (int i = 0; i < this->true_select_var_num; i++)
+	{
+		if (i != 0)
+			_out << ", ";
+		writeJSONString(_out, this->varName(i));
+	}
+	_out << "]},\n\"results\": {\"bindings\": [";
+
+	vector<string> row;
+	string type, value, datatype, lang;
+	bool first = true;
+	for (long long i = this->firstRow(); _out && this->nextRow(i, row); )
+	{
+		_out << (first ? "\n{" : ",\n{");
+		first = false;
+		bool first_var = true;
+		for (int j = 0; j < this->true_select_var_num; j++)
+		{
+			//unbound
+			if (row[j].empty())
+				continue;
+			splitTerm(row[j], type, value, datatype, lang);
+			if (!first_var)
+				_out << ", ";
+			first_var = false;
+			writeJSONString(_out, this->varName(j));
+			_out << ": {\"type\": \"" << type << "\", \"value\": ";
+			writeJSONString(_out, value);
+			if (!datatype.empty())
+			{
+				_out << ", \"datatype\": ";
+				writeJSONString(_out, datatype);
+			}
+			if (!lang.empty())
+			{
+				_out << ", \"xml:lang\": ";
+				writeJSONString(_out, lang);
+			}
+			_out << "}";
+		}
+		_out << "}";
+	}
+	_out << "\n]}}\n";
+}
+
+//SPARQL 1.1 Query Results CSV Format, values without their types
+void
+ResultSet::writeCSV(ostream& _out)
+{
+	for (int i = 0; i < this->true_select_var_num; i++)
+	{
+		if (i != 0)
+			_out << ",";
+		writeCSVField(_out, this->varName(i));
+	}
+	_out << "\r\n";
+
+	vector<string> row;
+	string type, value, datatype, lang;
+	for (long long i = this->firstRow(); _out && this->nextRow(i, row); )
+	{
+		for (int j = 0; j < this->true_select_var_num; j++)
+		{
+			if (j != 0)
+				_out << ",";
+			if (row[j].empty())
+				continue;
+			splitTerm(row[j], type, value, datatype, lang);
+			writeCSVField(_out, type == "bnode" ? "_:" + value : value);
+		}
+		_out << "\r\n";
+	}
+}
+
+//SPARQL 1.1 Query Results TSV Format, terms in N-Triples syntax
+void
+ResultSet::writeTSV(ostream& _out)
+{
+	for (int i = 0; i < this->true_select_var_num; i++)
+	{
+		if (i != 0)
+			_out << "\t";
+		_out << "?" << this->varName(i);
+	}
+	_out << "\n";
+
+	vector<string> row;
+	for (long long i = this->firstRow(); _out && this->nextRow(i, row); )
+	{
+		for (int j = 0; j < this->true_select_var_num; j++)
+		{
+			if (j != 0)
+				_out << "\t";
+			if (!row[j].empty())
+				_out << Util::node2string(row[j].c_str());
+		}
+		_out << "\n";
+	}
 }
 
 void
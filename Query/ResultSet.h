@@ -18,6 +18,10 @@ class ResultSet
 private:
 	Stream* stream;
 	bool useStream;
+
+	std::string varName(int _i);
+	long long firstRow();
+	bool nextRow(long long& _i, std::vector<std::string>& _row);
 public:
 	int select_var_num;	// Include order by keys
 	int true_select_var_num;	// Exclude order by keys
@@ -41,6 +45,13 @@ public:
 	std::string to_str();
 	//convert to JSON string
 	std::string to_JSON();
+	//write the JSON of to_JSON() row by row, _status(JSON members each followed
+	//by a comma) is put at the front of the object; stops if _out fails
+	void writeJSON(std::ostream& _out, const std::string& _status = "");
+	//writers of the SPARQL 1.1 query results formats, row by row
+	void writeSparqlJSON(std::ostream& _out);
+	void writeCSV(std::ostream& _out);
+	void writeTSV(std::ostream& _out);
 	void output(FILE* _fp);		//output all results using Stream
 	void setVar(const std::vector<std::string> & _var_names);
 
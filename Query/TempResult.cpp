@@ -15,13 +15,32 @@ Varset TempResult::getAllVarset()
 	return this->id_varset + this->str_varset;
 }
 
+unsigned* TempResult::newRow(int cols)
+{
+	if (this->arena == NULL)
+		this->arena = make_shared<Arena>();
+	return this->arena->allocIDs(cols);
+}
+
+void TempResult::adoptRows(const vector<unsigned*> &rows, shared_ptr<Arena> owner)
+{
+	if (owner != NULL)
+		this->shared_arenas.push_back(owner);
+	this->result.reserve(this->result.size() + rows.size());
+	for (int i = 0; i < (int)rows.size(); i++)
+	{
+		this->result.push_back(ResultPair());
+		this->result.back().id = rows[i];
+	}
+}
+
 void TempResult::release()
 {
 	for (int i = 0; i < (int)this->result.size(); i++)
-	{
-		delete[] result[i].id;
 		vector<string>().swap(result[i].str);
-	}
+	//the id rows go with the arenas(if no other TempResult shares them)
+	this->arena.reset();
+	this->shared_arenas.clear();
 }
 
 int TempResult::compareRow(const ResultPair &x, const int x_id_cols, const vector<int> &x_pos,
@@ -128,7 +147,7 @@ void TempResult::convertId2Str(Varset convert_varset, StringIndex *stringindex,
 
 	for (int i = 0; i < (int)this->result.size(); i++)
 	{
-		unsigned *v = new unsigned [new_id_cols];
+		unsigned *v = this->newRow(new_id_cols);
 
 		for (int k = 0; k < this_id_cols; k++)
 			if (this2new_id_pos[k] != -1)
@@ -147,7 +166,6 @@ void TempResult::convertId2Str(Varset convert_varset, StringIndex *stringindex,
 				this->result[i].str.push_back(str);
 			}
 
-		delete[] this->result[i].id;
 		this->result[i].id = v;
 	}
 
@@ -182,7 +200,7 @@ void TempResult::doJoin(TempResult &x, TempResult &r)
 
 				if (r_id_cols > 0)
 				{
-					r.result.back().id = new unsigned [r_id_cols];
+					r.result.back().id = r.newRow(r_id_cols);
 					unsigned *v = r.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
@@ -222,7 +240,7 @@ void TempResult::doJoin(TempResult &x, TempResult &r)
 
 				if (r_id_cols > 0)
 				{
-					r.result.back().id = new unsigned [r_id_cols];
+					r.result.back().id = r.newRow(r_id_cols);
 					unsigned *v = r.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
@@ -265,7 +283,7 @@ void TempResult::doUnion(TempResult &r)
 
 		if (r_id_cols > 0)
 		{
-			r.result.back().id = new unsigned [r_id_cols];
+			r.result.back().id = r.newRow(r_id_cols);
 			unsigned *v = r.result.back().id;
 
 			for (int k = 0; k < this_id_cols; k++)
@@ -338,7 +356,7 @@ void TempResult::doOptional(vector<bool> &binding, TempResult &x, TempResult &rn
 
 				if (ra_id_cols > 0)
 				{
-					ra.result.back().id = new unsigned [ra_id_cols];
+					ra.result.back().id = ra.newRow(ra_id_cols);
 					unsigned *v = ra.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
@@ -370,7 +388,7 @@ void TempResult::doOptional(vector<bool> &binding, TempResult &x, TempResult &rn
 
 				if (rn_id_cols > 0)
 				{
-					rn.result.back().id = new unsigned [rn_id_cols];
+					rn.result.back().id = rn.newRow(rn_id_cols);
 					unsigned *v = rn.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
@@ -411,7 +429,7 @@ void TempResult::doMinus(TempResult &x, TempResult &r)
 
 			if (r_id_cols > 0)
 			{
-				r.result.back().id = new unsigned [r_id_cols];
+				r.result.back().id = r.newRow(r_id_cols);
 				unsigned *v = r.result.back().id;
 
 				for (int k = 0; k < this_id_cols; k++)
@@ -444,7 +462,7 @@ void TempResult::doMinus(TempResult &x, TempResult &r)
 
 				if (r_id_cols > 0)
 				{
-					r.result.back().id = new unsigned [r_id_cols];
+					r.result.back().id = r.newRow(r_id_cols);
 					unsigned *v = r.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
@@ -1636,7 +1654,7 @@ void TempResult::doFilter(const QueryTree::CompTreeNode &filter, TempResult &r,
 
 			if (r_id_cols > 0)
 			{
-				r.result.back().id = new unsigned [r_id_cols];
+				r.result.back().id = r.newRow(r_id_cols);
 				unsigned *v = r.result.back().id;
 
 				for (int k = 0; k < this_id_cols; k++)
@@ -1929,7 +1947,7 @@ void TempResultSet::doProjection1(Varset &proj, TempResultSet &r, StringIndex *s
 
 				if (r_id_cols > 0)
 				{
-					r.results[0].result.back().id = new unsigned [r_id_cols];
+					r.results[0].result.back().id = r.results[0].newRow(r_id_cols);
 					unsigned *v = r.results[0].result.back().id;
 
 					for (int k = 0; k < r_id_cols; k++)
@@ -1993,7 +2011,7 @@ void TempResultSet::doDistinct1(TempResultSet &r)
 
 				if (r_id_cols > 0)
 				{
-					r_results0.result.back().id = new unsigned [r_id_cols];
+					r_results0.result.back().id = r_results0.newRow(r_id_cols);
 					unsigned *v = r_results0.result.back().id;
 
 					for (int k = 0; k < this_id_cols; k++)
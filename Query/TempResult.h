@@ -15,6 +15,7 @@
 #include "RegexExpression.h"
 #include "Varset.h"
 #include "../Util/EvalMultitypeValue.h"
+#include "../Util/Arena.h"
 
 class TempResult
 {
@@ -29,9 +30,15 @@ class TempResult
 
 		Varset id_varset, str_varset;
 		std::vector<ResultPair> result;
+		//the id rows live in arena, or in the arenas of the BasicQuery results taken
+		//over by adoptRows(), so they are never freed one by one
+		std::shared_ptr<Arena> arena;
+		std::vector<std::shared_ptr<Arena> > shared_arenas;
 
 		Varset getAllVarset();
 
+		unsigned* newRow(int cols);
+		void adoptRows(const std::vector<unsigned*> &rows, std::shared_ptr<Arena> owner);
 		void release();
 
 		static int compareRow(const ResultPair &x, const int x_id_cols, const std::vector<int> &x_pos,
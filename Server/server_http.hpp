@@ -76,6 +76,14 @@ namespace SimpleWeb {
                 return streambuf.size();
             }
 
+            /// Write what has been buffered to the socket now, blocking, so that a long
+            /// response can be sent in pieces. Returns false if the write failed.
+            bool flush_now() {
+                boost::system::error_code ec;
+                boost::asio::write(*socket, streambuf, ec);
+                return !ec;
+            }
+
             /// If true, force server to close the connection after the response have been sent.
             ///
             /// This is useful when implementing a HTTP/1.0-server sending content
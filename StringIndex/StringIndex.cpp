@@ -11,6 +11,23 @@
 #include <unistd.h>
 using namespace std;
 
+//scratch buffers of each thread, see StringIndexFile::decode
+static thread_local unique_ptr<char[]> read_buffer;
+static thread_local unsigned read_buffer_size = 0;
+static thread_local unique_ptr<char[]> uncompress_buffer;
+
+void StringIndexFile::decode(const char *value, unsigned length, string *str, bool real)
+{
+	if (real && this->trie != NULL)
+	{
+		if (!uncompress_buffer)
+			uncompress_buffer.reset(new char[MAX_BLOCK_SIZE * 4]);
+		this->trie->Uncompress(value, length, *str, uncompress_buffer.get());
+	}
+	else
+		str->assign(value, length);
+}
+
 void StringIndexFile::setNum(unsigned _num)
 {
 	this->num = _num;
@@ -113,40 +130,22 @@ bool StringIndexFile::randomAccess(unsigned id, string *str, bool real)
 
 	long offset = (*this->index_table)[id].offset;
 	unsigned length = (*this->index_table)[id].length;
-	//if(id == 9)
-	//{
-	//cout<<"check: "<<offset<<" "<<length<<endl;
-	//}
-
-	allocBuffer(length);
-
-	//DEBUG: here a bug exists if we use pread instead of fread, the details are in BUG_StringIndex_pread of docs/BUGS.md
-	fseek(this->value_file, offset, SEEK_SET);
-	fread(this->buffer, sizeof(char), length, this->value_file);
-	//pread(fileno(value_file), this->buffer, sizeof(char)*length, offset);
-	this->buffer[length] = '\0';
-
-	if (real)
-		trie->Uncompress(this->buffer, length, *str, this->UncompressBuffer);
-	else
-		*str = buffer;
-
-	//*str = string(this->buffer);
-
-	//if(id == 9)
-	//{
-	//cout<<"check: "<<*str<<endl;
-	//}
 
-	//	if (real)
-	//	{
-	//		*str = trie->Uncompress(*str, str->length());//Uncompresss
-	//	}
-	//if(id == 9)
-	//{
-	//cout<<"check: "<<*str<<endl;
-	//}
+	if (this->Mmap != NULL && this->Mmap != MAP_FAILED && offset + (long)length <= this->mmapLength)
+	{
+		this->decode(this->Mmap + offset, length, str, real);
+		return true;
+	}
 
+	//NOTICE: the shared buffer used with fread was the cause of BUG_StringIndex_pread
+	if (read_buffer_size < length + 1)
+	{
+		read_buffer_size = max(length + 1, 4096u);
+		read_buffer.reset(new char[read_buffer_size]);
+	}
+	if (pread(fileno(this->value_file), read_buffer.get(), length, offset) != (ssize_t)length)
+		return false;
+	this->decode(read_buffer.get(), length, str, real);
 	return true;
 }
 
@@ -263,7 +262,7 @@ void StringIndexFile::trySequenceAccess(std::vector<StringIndexFile::AccessReque
 			offset = (*this->index_table)[id].offset;
 			length = (*this->index_table)[id].length;
 
-			this->trie->Uncompress(&Mmap[offset], length, *(base + requestVector[pos].off_str), UncompressBuffer);
+			this->decode(&Mmap[offset], length, base + requestVector[pos].off_str, true);
 		}
 	
 
@@ -404,6 +403,15 @@ void StringIndex::load()
 	cout<<"literal has loaded successfully!"<<endl;
 	this->predicate.load();
 	cout<<"predicate has loaded successfully!"<<endl;
+
+	//in MB, 0 disables the cache
+	string cache_size = Util::getConfigureValue("string_cache_size");
+	if (cache_size.empty())
+		cache_size = "64";
+	delete this->cache;
+	this->cache = NULL;
+	if (atoll(cache_size.c_str()) > 0)
+		this->cache = new StringCache((unsigned long long)atoll(cache_size.c_str()) << 20);
 }
 
 bool
@@ -432,8 +440,14 @@ StringIndex::searchBuffer(unsigned _id, string* _str)
 
 bool StringIndex::randomAccess(unsigned id, string *str, bool is_entity_or_literal, bool real)
 {
-	if (id < 0) return false;
-
+	latch.lockShared();
+	bool cached = real && this->cache != NULL;
+	if (cached && this->cache->get(StringIndex::cacheKey(id, is_entity_or_literal), *str))
+	{
+		latch.unlock();
+		return true;
+	}
+	bool ret;
 	if (is_entity_or_literal)
 	{
 		//if(searchBuffer(id, str))
@@ -445,17 +459,51 @@ bool StringIndex::randomAccess(unsigned id, string *str, bool is_entity_or_liter
 
 		if (id < Util::LITERAL_FIRST_ID)
 		{
-			return this->entity.randomAccess(id, str, real);
+			ret = this->entity.randomAccess(id, str, real);
 		}
 		else
 		{
-			return this->literal.randomAccess(id - Util::LITERAL_FIRST_ID, str, real);
+			ret = this->literal.randomAccess(id - Util::LITERAL_FIRST_ID, str, real);
 		}
 	}
 	else
 	{
-		return this->predicate.randomAccess(id, str, real);
+		ret = this->predicate.randomAccess(id, str, real);
 	}
+	if (cached && ret)
+		this->cache->put(StringIndex::cacheKey(id, is_entity_or_literal), *str);
+	latch.unlock();
+	return ret;
+}
+
+unsigned StringIndex::batchAccess(const unsigned *ids, unsigned num, string *strs, bool is_entity_or_literal, bool real)
+{
+	unsigned found = 0;
+	latch.lockShared();
+	bool cached = real && this->cache != NULL;
+	for (unsigned i = 0; i < num; i++)
+	{
+		if (cached && this->cache->get(StringIndex::cacheKey(ids[i], is_entity_or_literal), strs[i]))
+		{
+			found++;
+			continue;
+		}
+		bool ret;
+		if (!is_entity_or_literal)
+			ret = this->predicate.randomAccess(ids[i], strs + i, real);
+		else if (ids[i] < Util::LITERAL_FIRST_ID)
+			ret = this->entity.randomAccess(ids[i], strs + i, real);
+		else
+			ret = this->literal.randomAccess(ids[i] - Util::LITERAL_FIRST_ID, strs + i, real);
+		if (ret)
+		{
+			found++;
+			if (cached)
+				this->cache->put(StringIndex::cacheKey(ids[i], is_entity_or_literal), strs[i]);
+		}
+	}
+	latch.unlock();
+	return found;
 }
 void 
 StringIndex::addRequest(unsigned id, unsigned off_base, bool is_entity_or_literal)
@@ -486,9 +534,32 @@ StringIndex::addRequest(unsigned id, unsigned off_base, bool is_entity_or_litera
 void StringIndex::trySequenceAccess(std::vector<StringIndexFile::AccessRequest>* requestVector,string *base, bool real, pthread_t tidp)
 {
 	latch.lockShared();
-	this->entity.trySequenceAccess(requestVector[0], base,real, tidp);
-	this->literal.trySequenceAccess(requestVector[1],base, real, tidp);
-	this->predicate.trySequenceAccess(requestVector[2],base, real,  tidp);
+	if (!real || this->cache == NULL)
+	{
+		this->entity.trySequenceAccess(requestVector[0], base,real, tidp);
+		this->literal.trySequenceAccess(requestVector[1],base, real, tidp);
+		this->predicate.trySequenceAccess(requestVector[2],base, real,  tidp);
+		latch.unlock();
+		return;
+	}
+
+	//answer what we can from the cache, and read only the misses from the files
+	StringIndexFile* files[3] = { &this->entity, &this->literal, &this->predicate };
+	unsigned id_base[3] = { 0, Util::LITERAL_FIRST_ID, 0 };
+	for (int k = 0; k < 3; k++)
+	{
+		std::vector<StringIndexFile::AccessRequest> misses;
+		for (unsigned i = 0; i < requestVector[k].size(); i++)
+		{
+			const StringIndexFile::AccessRequest& r = requestVector[k][i];
+			if (!this->cache->get(StringIndex::cacheKey(r.id + id_base[k], k != 2), base[r.off_str]))
+				misses.push_back(r);
+		}
+		files[k]->trySequenceAccess(misses, base, real, tidp);
+		for (unsigned i = 0; i < misses.size(); i++)
+			if (!base[misses[i].off_str].empty())
+				this->cache->put(StringIndex::cacheKey(misses[i].id + id_base[k], k != 2), base[misses[i].off_str]);
+	}
 	latch.unlock();
 }
 
@@ -527,6 +598,8 @@ void StringIndex::change(std::vector<unsigned> &ids, KVstore &kv_store, bool is_
 
 		for (unsigned i = 0; i < ids.size(); i++)
 		{
+			if (this->cache != NULL)
+				this->cache->erase(StringIndex::cacheKey(ids[i], true));
 			if (ids[i] < Util::LITERAL_FIRST_ID)
 				this->entity.change(ids[i], kv_store);
 			else
@@ -540,7 +613,11 @@ void StringIndex::change(std::vector<unsigned> &ids, KVstore &kv_store, bool is_
 		if (this->predicate.mmapLength != 0)
 			munmap(this->predicate.Mmap, this->predicate.mmapLength);
 		for (unsigned i = 0; i < ids.size(); i++)
+		{
+			if (this->cache != NULL)
+				this->cache->erase(StringIndex::cacheKey(ids[i], false));
 			this->predicate.change(ids[i], kv_store);
+		}
 		this->predicate.flush_file();
 	}
 	latch.unlock();
@@ -558,6 +635,8 @@ void StringIndex::disable(std::vector<unsigned> &ids, bool is_entity_or_literal)
 
 		for (unsigned i = 0; i < ids.size(); i++)
 		{
+			if (this->cache != NULL)
+				this->cache->erase(StringIndex::cacheKey(ids[i], true));
 			if (ids[i] < Util::LITERAL_FIRST_ID)
 				this->entity.disable(ids[i]);
 			else
@@ -571,9 +650,47 @@ void StringIndex::disable(std::vector<unsigned> &ids, bool is_entity_or_literal)
 		if (this->predicate.mmapLength != 0)
 			munmap(this->predicate.Mmap, this->predicate.mmapLength);
 		for (unsigned i = 0; i < ids.size(); i++)
+		{
+			if (this->cache != NULL)
+				this->cache->erase(StringIndex::cacheKey(ids[i], false));
 			this->predicate.disable(ids[i]);
+		}
 		this->predicate.flush_file();
 	}
 	latch.unlock();
 }
 
+unsigned StringIndex::warmCache(const std::vector<unsigned> &ids, bool is_entity_or_literal)
+{
+	if (this->cache == NULL)
+		return 0;
+	unsigned warmed = 0;
+	string str;
+	latch.lockShared();
+	for (unsigned i = 0; i < ids.size(); i++)
+	{
+		bool ret;
+		if (!is_entity_or_literal)
+			ret = this->predicate.randomAccess(ids[i], &str);
+		else if (ids[i] < Util::LITERAL_FIRST_ID)
+			ret = this->entity.randomAccess(ids[i], &str);
+		else
+			ret = this->literal.randomAccess(ids[i] - Util::LITERAL_FIRST_ID, &str);
+		if (!ret)
+			continue;
+		//one shard is full, the rest are likely to be soon
+		if (!this->cache->warm(StringIndex::cacheKey(ids[i], is_entity_or_literal), str))
+			break;
+		warmed++;
+	}
+	latch.unlock();
+	return warmed;
+}
+
+bool StringIndex::getCacheStats(StringCache::Stats &stats)
+{
+	if (this->cache == NULL)
+		return false;
+	this->cache->getStats(stats);
+	return true;
+}
@@ -13,6 +13,7 @@
 #include "../Util/Util.h"
 #include "../Util/SpinLock.h"
 #include "../Util/Latch.h"
+#include "../Util/StringCache.h"
 
 class StringIndexFile
 {
@@ -43,13 +44,10 @@ class StringIndexFile
 		};
 		std::vector<IndexInfo>* index_table;
 
-		unsigned buffer_size;
+		//decode the stored value into *str, the scratch buffers are of the
+		//calling thread so that concurrent reads share nothing
+		void decode(const char *value, unsigned length, std::string *str, bool real);
 
-		char *buffer;
-		char *UncompressBuffer;
-
-		
-		
 //		std::string dictionary_path;
 		string *base;
 	public:
@@ -105,7 +103,7 @@ class StringIndexFile
 			request.reserve(capcity);
 		}
 
-		StringIndexFile(StringIndexFileType _type, std::string _dir, unsigned _num):type(_type), num(_num), empty_offset(0), index_file(NULL), value_file(NULL), buffer_size(0), buffer(NULL)
+		StringIndexFile(StringIndexFileType _type, std::string _dir, unsigned _num):type(_type), num(_num), empty_offset(0), index_file(NULL), value_file(NULL), trie(NULL)
 		{
 			if (this->type == Entity)
 				this->loc = _dir + "/entity_";
@@ -116,7 +114,6 @@ class StringIndexFile
 			this->index_table = new std::vector<IndexInfo>;
 			Mmap = NULL;
 			mmapLength = 0;
-			UncompressBuffer = new char[MAX_BLOCK_SIZE*4];
 			//dictionary_path = _dir + "/../dictionary.dc";
 			//trie = new Trie;
 		}
@@ -126,12 +123,9 @@ class StringIndexFile
 				fclose(this->index_file);
 			if (this->value_file != NULL)
 				fclose(this->value_file);
-			if (this->buffer != NULL)
-				delete[] this->buffer;
 			delete this->index_table;	 
 			if (mmapLength != 0)
 				munmap(Mmap, mmapLength);
-			delete[] UncompressBuffer;
 //			if (this->trie != NULL)
 //				delete trie;
 		}
@@ -149,22 +143,8 @@ class StringIndexFile
 		void save(KVstore &kv_store);
 		void load();
 		static void *thread_read(void * argv);
-		inline void allocBuffer(unsigned length)
-		{
-			if (this->buffer_size <= length)
-			{
-				delete[] this->buffer;
-				this->buffer_size = length + 1;
-				this->buffer = new char[this->buffer_size];
-			}
-		}
-
-		inline void emptyBuffer()
-		{
-			this->buffer_size = 0;
-			this->buffer = NULL;
-		}
-
+		//reads the mapping if the value file is mapped, else pread, safe to call
+		//concurrently as long as the file is not changed
 		bool randomAccess(unsigned id, std::string *str, bool real = true);
 
 		inline void addRequest(unsigned id, unsigned off_base)
@@ -191,15 +171,26 @@ class StringIndex
 		// spinlock AccessLock;
 		Latch latch;
 		//atomic_flag spinlock = ATOMIC_FLAG_INIT ;
+		//decoded strings of hot ids(string_cache_size in init.conf), NULL if disabled
+		StringCache* cache;
+
+		static unsigned long long cacheKey(unsigned id, bool is_entity_or_literal)
+		{
+			return is_entity_or_literal ? id : (1ULL << 32) | id;
+		}
 	public:
 //		Trie *trie;
 		void SetTrie(Trie* trie);
 		vector<StringIndexFile*> get_three_StringIndexFile();
 		StringIndex(std::string _dir, unsigned _entity_num = 0, unsigned _literal_num = 0, unsigned _predicate_num = 0):
-			entity(StringIndexFile::Entity, _dir, _entity_num), literal(StringIndexFile::Literal, _dir, _literal_num), predicate(StringIndexFile::Predicate, _dir, _predicate_num)
+			entity(StringIndexFile::Entity, _dir, _entity_num), literal(StringIndexFile::Literal, _dir, _literal_num), predicate(StringIndexFile::Predicate, _dir, _predicate_num), cache(NULL)
 		{
 //			trie = entity.trie;
 		}
+		~StringIndex()
+		{
+			delete this->cache;
+		}
 
 		void clear()
 		{
@@ -213,13 +204,6 @@ class StringIndex
 			//nothing to do here
 		}
 
-		void emptyBuffer()
-		{
-			entity.emptyBuffer();
-			literal.emptyBuffer();
-			predicate.emptyBuffer();
-		}
-
 		void setBuffer(Buffer* _ebuf, Buffer* _lbuf)
 		{
 			this->entity_buffer = _ebuf;
@@ -236,10 +220,18 @@ class StringIndex
 		void load();
 
 		bool randomAccess(unsigned id, std::string *str, bool is_entity_or_literal = true, bool real = true);
+		//convert _num ids to strings taking the latch once, any number of threads
+		//may call it concurrently, return the number of valid ids(the strings of
+		//invalid ones are left unchanged)
+		unsigned batchAccess(const unsigned *ids, unsigned num, std::string *strs, bool is_entity_or_literal = true, bool real = true);
 		void addRequest(unsigned id, unsigned off_base, bool is_entity_or_literal = true);
 		void trySequenceAccess(std::vector<StringIndexFile::AccessRequest>* requestVectors,string *base, bool real = true, pthread_t tidp = -1);
 		void change(std::vector<unsigned> &ids, KVstore &kv_store, bool is_entity_or_literal = true);
 		void disable(std::vector<unsigned> &ids, bool is_entity_or_literal = true);
+		//decode the given ids into the cache, stop when it is full,
+		//return the number of strings cached
+		unsigned warmCache(const std::vector<unsigned> &ids, bool is_entity_or_literal = true);
+		bool getCacheStats(StringCache::Stats &stats);
 };
 
 #endif // _STRING_INDEX_H
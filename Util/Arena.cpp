@@ -0,0 +1,102 @@
+#include "Arena.h"
+
+using namespace std;
+
+Arena::Arena(size_t _chunk_size)
+{
+	this->chunk_size = _chunk_size;
+	this->cur = NULL;
+	this->left = 0;
+	this->used = 0;
+	this->reserved = 0;
+}
+
+Arena::~Arena()
+{
+	for (size_t i = 0; i < this->chunks.size(); ++i)
+		free(this->chunks[i]);
+}
+
+void*
+Arena::alloc(size_t _size)
+{
+	_size = (_size + Arena::ALIGN - 1) & ~(Arena::ALIGN - 1);
+	if (_size == 0)
+		_size = Arena::ALIGN;
+	this->used += _size;
+	if (_size <= this->left)
+	{
+		void* p = this->cur;
+		this->cur += _size;
+		this->left -= _size;
+		return p;
+	}
+
+	if (_size > this->chunk_size / 4)
+	{
+		//a big one gets its own chunk, placed before the current chunk so the
+		//free space there is not wasted
+		char* p = (char*)malloc(_size);
+		if (p == NULL)
+		{
+			cout << "error: arena out of memory" << endl;
+			return NULL;
+		}
+		this->reserved += _size;
+		if (this->chunks.empty())
+			this->chunks.push_back(p);
+		else
+			this->chunks.insert(this->chunks.end() - 1, p);
+		return p;
+	}
+
+	char* p = (char*)malloc(this->chunk_size);
+	if (p == NULL)
+	{
+		cout << "error: arena out of memory" << endl;
+		return NULL;
+	}
+	this->reserved += this->chunk_size;
+	this->chunks.push_back(p);
+	this->cur = p + _size;
+	this->left = this->chunk_size - _size;
+	return p;
+}
+
+void
+Arena::clear()
+{
+	//keep the current normal sized chunk(always the last one), big ones are not worth keeping
+	char* keep = NULL;
+	if (this->cur != NULL)
+		keep = this->chunks.back();
+	for (size_t i = 0; i < this->chunks.size(); ++i)
+		if (this->chunks[i] != keep)
+			free(this->chunks[i]);
+	this->chunks.clear();
+	this->used = 0;
+	if (keep == NULL)
+	{
+		this->cur = NULL;
+		this->left = 0;
+		this->reserved = 0;
+	}
+	else
+	{
+		this->chunks.push_back(keep);
+		this->cur = keep;
+		this->left = this->chunk_size;
+		this->reserved = this->chunk_size;
+	}
+}
+
+void
+Arena::swap(Arena& _other)
+{
+	std::swap(this->chunk_size, _other.chunk_size);
+	this->chunks.swap(_other.chunks);
+	std::swap(this->cur, _other.cur);
+	std::swap(this->left, _other.left);
+	std::swap(this->used, _other.used);
+	std::swap(this->reserved, _other.reserved);
+}
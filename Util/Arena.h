@@ -0,0 +1,41 @@
+#ifndef _UTIL_ARENA_H
+#define _UTIL_ARENA_H
+
+#include "Util.h"
+
+//A bump allocator for the intermediate results of one query: memory is taken
+//from large chunks and never freed one by one, only all together by clear().
+//Requests larger than a chunk get a chunk of their own.
+//NOTICE: not thread safe, use one arena per thread or lock outside.
+class Arena
+{
+public:
+	static const size_t CHUNK_SIZE = 1 << 20;
+	static const size_t ALIGN = 8;
+
+	Arena(size_t _chunk_size = CHUNK_SIZE);
+	~Arena();
+
+	void* alloc(size_t _size);
+	unsigned* allocIDs(size_t _n) { return (unsigned*)this->alloc(sizeof(unsigned) * _n); }
+	//release all memory, the first chunk is kept for reuse
+	void clear();
+	void swap(Arena& _other);
+
+	//bytes handed out, and bytes taken from the system
+	size_t getUsed() const { return this->used; }
+	size_t getReserved() const { return this->reserved; }
+
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	size_t chunk_size;
+	std::vector<char*> chunks;
+	char* cur;
+	size_t left;
+	size_t used;
+	size_t reserved;
+};
+
+#endif //_UTIL_ARENA_H
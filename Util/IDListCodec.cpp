@@ -0,0 +1,298 @@
+#include "IDListCodec.h"
+
+using namespace std;
+
+unsigned
+IDListCodec::maxEncodedLen(unsigned _n)
+{
+	//header + first id + one width word per block/tail + the ids themselves
+	return _n + _n / BLOCK_LEN + 3;
+}
+
+bool
+IDListCodec::useSIMD()
+{
+#ifdef __SSE2__
+	return true;
+#else
+	return false;
+#endif
+}
+
+unsigned
+IDListCodec::bitWidth(const unsigned* _vals, unsigned _n)
+{
+	unsigned acc = 0;
+	for (unsigned i = 0; i < _n; ++i)
+		acc |= _vals[i];
+	unsigned b = 0;
+	while (b < 32 && (acc >> b) != 0)
+		++b;
+	return b;
+}
+
+void
+IDListCodec::packBlock(const unsigned* _in, unsigned _b, unsigned* _out)
+{
+	memset(_out, 0, sizeof(unsigned) * 4 * _b);
+	if (_b == 0)
+		return;
+	for (unsigned j = 0; j < 4; ++j)
+	{
+		for (unsigned i = 0; i < BLOCK_LEN / 4; ++i)
+		{
+			unsigned v = _in[4 * i + j];
+			unsigned pos = i * _b;
+			unsigned k = pos >> 5, s = pos & 31;
+			_out[4 * k + j] |= v << s;
+			if (s + _b > 32)
+				_out[4 * (k + 1) + j] |= v >> (32 - s);
+		}
+	}
+}
+
+void
+IDListCodec::unpackBlock(const unsigned* _in, unsigned _b, unsigned* _prev, unsigned* _out)
+{
+	if (_b == 0)
+	{
+		for (unsigned i = 0; i < BLOCK_LEN; ++i)
+			_out[i] = _prev == NULL ? 0 : _prev[i & 3];
+		return;
+	}
+	unsigned mask = _b == 32 ? ~0u : (1u << _b) - 1;
+#ifdef __SSE2__
+	__m128i vmask = _mm_set1_epi32((int)mask);
+	__m128i vprev = _prev == NULL ? _mm_setzero_si128() : _mm_loadu_si128((const __m128i*)_prev);
+	for (unsigned i = 0; i < BLOCK_LEN / 4; ++i)
+	{
+		unsigned pos = i * _b;
+		unsigned k = pos >> 5, s = pos & 31;
+		__m128i w = _mm_loadu_si128((const __m128i*)(_in + 4 * k));
+		__m128i v = _mm_srl_epi32(w, _mm_cvtsi32_si128(s));
+		if (s + _b > 32)
+		{
+			__m128i w2 = _mm_loadu_si128((const __m128i*)(_in + 4 * (k + 1)));
+			v = _mm_or_si128(v, _mm_sll_epi32(w2, _mm_cvtsi32_si128(32 - s)));
+		}
+		v = _mm_and_si128(v, vmask);
+		if (_prev != NULL)
+		{
+			vprev = _mm_add_epi32(vprev, v);
+			v = vprev;
+		}
+		_mm_storeu_si128((__m128i*)(_out + 4 * i), v);
+	}
+	if (_prev != NULL)
+		_mm_storeu_si128((__m128i*)_prev, vprev);
+#else
+	for (unsigned i = 0; i < BLOCK_LEN / 4; ++i)
+	{
+		unsigned pos = i * _b;
+		unsigned k = pos >> 5, s = pos & 31;
+		for (unsigned j = 0; j < 4; ++j)
+		{
+			unsigned v = _in[4 * k + j] >> s;
+			if (s + _b > 32)
+				v |= _in[4 * (k + 1) + j] << (32 - s);
+			v &= mask;
+			if (_prev != NULL)
+			{
+				_prev[j] += v;
+				v = _prev[j];
+			}
+			_out[4 * i + j] = v;
+		}
+	}
+#endif
+}
+
+void
+IDListCodec::packTail(const unsigned* _in, unsigned _n, unsigned _b, unsigned* _out)
+{
+	unsigned words = (_n * _b + 31) / 32;
+	memset(_out, 0, sizeof(unsigned) * words);
+	if (_b == 0)
+		return;
+	for (unsigned i = 0; i < _n; ++i)
+	{
+		unsigned pos = i * _b;
+		unsigned k = pos >> 5, s = pos & 31;
+		_out[k] |= _in[i] << s;
+		if (s + _b > 32)
+			_out[k + 1] |= _in[i] >> (32 - s);
+	}
+}
+
+void
+IDListCodec::unpackTail(const unsigned* _in, unsigned _n, unsigned _b, unsigned* _out)
+{
+	if (_b == 0)
+	{
+		memset(_out, 0, sizeof(unsigned) * _n);
+		return;
+	}
+	unsigned mask = _b == 32 ? ~0u : (1u << _b) - 1;
+	for (unsigned i = 0; i < _n; ++i)
+	{
+		unsigned pos = i * _b;
+		unsigned k = pos >> 5, s = pos & 31;
+		unsigned v = _in[k] >> s;
+		if (s + _b > 32)
+			v |= _in[k + 1] << (32 - s);
+		_out[i] = v & mask;
+	}
+}
+
+unsigned
+IDListCodec::encode(const unsigned* _list, unsigned _n, bool _sorted, unsigned* _out)
+{
+	if (_n > MAX_LIST_LEN)
+		return 0;
+	if (_sorted)
+	{
+		for (unsigned i = 1; i < _n; ++i)
+		{
+			if (_list[i] < _list[i - 1])
+			{
+				_sorted = false;
+				break;
+			}
+		}
+	}
+
+	unsigned* p = _out + 1;
+	unsigned prev4[4] = { 0, 0, 0, 0 };
+	if (_sorted && _n > 0)
+	{
+		*p++ = _list[0];
+		prev4[0] = prev4[1] = prev4[2] = prev4[3] = _list[0];
+	}
+
+	unsigned d[BLOCK_LEN];
+	unsigned full = _n / BLOCK_LEN;
+	for (unsigned blk = 0; blk < full; ++blk)
+	{
+		const unsigned* in = _list + blk * BLOCK_LEN;
+		for (unsigned i = 0; i < BLOCK_LEN; ++i)
+		{
+			if (_sorted)
+			{
+				d[i] = in[i] - prev4[i & 3];
+				prev4[i & 3] = in[i];
+			}
+			else
+				d[i] = in[i];
+		}
+		unsigned b = IDListCodec::bitWidth(d, BLOCK_LEN);
+		*p++ = b;
+		IDListCodec::packBlock(d, b, p);
+		p += 4 * b;
+	}
+
+	unsigned rest = _n - full * BLOCK_LEN;
+	if (rest > 0)
+	{
+		const unsigned* in = _list + full * BLOCK_LEN;
+		unsigned prev = full > 0 ? in[-1] : _list[0];
+		for (unsigned i = 0; i < rest; ++i)
+		{
+			if (_sorted)
+			{
+				d[i] = in[i] - prev;
+				prev = in[i];
+			}
+			else
+				d[i] = in[i];
+		}
+		unsigned b = IDListCodec::bitWidth(d, rest);
+		*p++ = b;
+		IDListCodec::packTail(d, rest, b, p);
+		p += (rest * b + 31) / 32;
+	}
+
+	unsigned len = p - _out;
+	if (len >= _n + 1)
+	{
+		_out[0] = _n | (MODE_RAW << 30);
+		memcpy(_out + 1, _list, sizeof(unsigned) * _n);
+		return _n + 1;
+	}
+	_out[0] = _n | ((_sorted ? MODE_SORTED : MODE_UNSORTED) << 30);
+	return len;
+}
+
+unsigned
+IDListCodec::decodedLen(const unsigned* _run)
+{
+	return _run[0] & MAX_LIST_LEN;
+}
+
+unsigned
+IDListCodec::encodedLen(const unsigned* _run)
+{
+	unsigned n = _run[0] & MAX_LIST_LEN;
+	unsigned mode = _run[0] >> 30;
+	if (mode == MODE_RAW)
+		return n + 1;
+
+	const unsigned* p = _run + 1;
+	if (mode == MODE_SORTED && n > 0)
+		++p;
+	unsigned full = n / BLOCK_LEN;
+	for (unsigned blk = 0; blk < full; ++blk)
+		p += 1 + 4 * (*p);
+	unsigned rest = n - full * BLOCK_LEN;
+	if (rest > 0)
+		p += 1 + (rest * (*p) + 31) / 32;
+	return p - _run;
+}
+
+unsigned
+IDListCodec::decode(const unsigned* _run, unsigned* _out)
+{
+	unsigned n = _run[0] & MAX_LIST_LEN;
+	unsigned mode = _run[0] >> 30;
+	if (mode == MODE_RAW)
+	{
+		memcpy(_out, _run + 1, sizeof(unsigned) * n);
+		return n + 1;
+	}
+
+	bool sorted = mode == MODE_SORTED;
+	const unsigned* p = _run + 1;
+	unsigned prev4[4] = { 0, 0, 0, 0 };
+	unsigned first = 0;
+	if (sorted && n > 0)
+	{
+		first = *p++;
+		prev4[0] = prev4[1] = prev4[2] = prev4[3] = first;
+	}
+
+	unsigned full = n / BLOCK_LEN;
+	for (unsigned blk = 0; blk < full; ++blk)
+	{
+		unsigned b = *p++;
+		IDListCodec::unpackBlock(p, b, sorted ? prev4 : NULL, _out + blk * BLOCK_LEN);
+		p += 4 * b;
+	}
+
+	unsigned rest = n - full * BLOCK_LEN;
+	if (rest > 0)
+	{
+		unsigned b = *p++;
+		unsigned* out = _out + full * BLOCK_LEN;
+		IDListCodec::unpackTail(p, rest, b, out);
+		p += (rest * b + 31) / 32;
+		if (sorted)
+		{
+			unsigned prev = full > 0 ? out[-1] : first;
+			for (unsigned i = 0; i < rest; ++i)
+			{
+				prev += out[i];
+				out[i] = prev;
+			}
+		}
+	}
+	return p - _run;
+}
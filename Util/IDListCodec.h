@@ -0,0 +1,58 @@
+#ifndef _UTIL_IDLISTCODEC_H
+#define _UTIL_IDLISTCODEC_H
+
+#include "Util.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//STRUCT of an encoded run(all in unsigned words):
+//word0: list length | (mode << 30)
+//MODE_RAW:      the ids as they are
+//MODE_SORTED:   the first id, then full blocks of BLOCK_LEN ids, then a tail
+//MODE_UNSORTED: full blocks of BLOCK_LEN ids, then a tail
+//
+//A full block is its bit width b followed by 4*b words. The 128 values are split
+//into 4 interleaved lanes(value i goes to lane i%4), and each lane is bit packed
+//into b words stored at positions j, j+4, j+8 ..., so 4 values can be unpacked at
+//a time with SSE2. In sorted mode the value of id i is (id[i] - id[i-4]), so the
+//decoder only needs one vector add per 4 ids instead of a serial prefix sum.
+//The tail(less than BLOCK_LEN ids) is its bit width followed by plain bit packing
+//of (id[i] - id[i-1]) in sorted mode, or of the ids in unsorted mode.
+//
+//The encoder falls back to MODE_RAW if packing does not save any space.
+class IDListCodec
+{
+public:
+	static const unsigned BLOCK_LEN = 128;
+	static const unsigned MODE_RAW = 0;
+	static const unsigned MODE_SORTED = 1;
+	static const unsigned MODE_UNSORTED = 2;
+	static const unsigned MAX_LIST_LEN = (1u << 30) - 1;
+
+	//the words needed by the output buffer of encode()
+	static unsigned maxEncodedLen(unsigned _n);
+	//encode _list into _out, return the words written(0 if _n is too long)
+	//if _sorted is true but the list is not ordered, it is encoded as unsorted
+	static unsigned encode(const unsigned* _list, unsigned _n, bool _sorted, unsigned* _out);
+	//number of ids in the run
+	static unsigned decodedLen(const unsigned* _run);
+	//number of words occupied by the run
+	static unsigned encodedLen(const unsigned* _run);
+	//decode the run into _out, which must hold decodedLen(_run) ids
+	//return the words consumed
+	static unsigned decode(const unsigned* _run, unsigned* _out);
+	//whether the block decoder is vectorized in this build
+	static bool useSIMD();
+
+private:
+	static unsigned bitWidth(const unsigned* _vals, unsigned _n);
+	static void packBlock(const unsigned* _in, unsigned _b, unsigned* _out);
+	//_prev holds the last 4 decoded ids in sorted mode, NULL in unsorted mode
+	static void unpackBlock(const unsigned* _in, unsigned _b, unsigned* _prev, unsigned* _out);
+	static void packTail(const unsigned* _in, unsigned _n, unsigned _b, unsigned* _out);
+	static void unpackTail(const unsigned* _in, unsigned _n, unsigned _b, unsigned* _out);
+};
+
+#endif //_UTIL_IDLISTCODEC_H
@@ -0,0 +1,154 @@
+#include "IDTable.h"
+
+using namespace std;
+
+IDTable::IDTable(unsigned _col_num)
+{
+	this->col_num = _col_num;
+	this->row_num = 0;
+}
+
+void
+IDTable::reset(unsigned _col_num)
+{
+	this->col_num = _col_num;
+	this->row_num = 0;
+	this->chunks.clear();
+	this->arena.clear();
+}
+
+void
+IDTable::swap(IDTable& _other)
+{
+	std::swap(this->col_num, _other.col_num);
+	std::swap(this->row_num, _other.row_num);
+	this->chunks.swap(_other.chunks);
+	this->arena.swap(_other.arena);
+}
+
+unsigned*
+IDTable::reserveRow()
+{
+	if (this->row_num == (unsigned long)this->chunks.size() * CHUNK_ROWS)
+		this->chunks.push_back(this->arena.allocIDs((size_t)CHUNK_ROWS * this->col_num));
+	return this->chunks[this->row_num / CHUNK_ROWS];
+}
+
+void
+IDTable::getRow(unsigned long _row, unsigned* _out) const
+{
+	const unsigned* chunk = this->chunks[_row / CHUNK_ROWS] + _row % CHUNK_ROWS;
+	for (unsigned c = 0; c < this->col_num; ++c)
+		_out[c] = chunk[c * CHUNK_ROWS];
+}
+
+void
+IDTable::appendRow(const unsigned* _row)
+{
+	unsigned* chunk = this->reserveRow() + this->row_num % CHUNK_ROWS;
+	for (unsigned c = 0; c < this->col_num; ++c)
+		chunk[c * CHUNK_ROWS] = _row[c];
+	this->row_num++;
+}
+
+void
+IDTable::appendColumn(const unsigned* _vals, unsigned long _n)
+{
+	while (_n > 0)
+	{
+		unsigned* chunk = this->reserveRow();
+		unsigned off = this->row_num % CHUNK_ROWS;
+		unsigned long k = CHUNK_ROWS - off;
+		if (k > _n)
+			k = _n;
+		memcpy(chunk + off, _vals, sizeof(unsigned) * k);
+		_vals += k;
+		_n -= k;
+		this->row_num += k;
+	}
+}
+
+void
+IDTable::appendExtend(const IDTable& _src, unsigned long _row, const unsigned* _vals, unsigned _n)
+{
+	unsigned src_cols = _src.col_num;
+	const unsigned* src_chunk = _src.chunks[_row / CHUNK_ROWS] + _row % CHUNK_ROWS;
+	while (_n > 0)
+	{
+		//fill the run of rows that fits in the current chunk column by column
+		unsigned* chunk = this->reserveRow();
+		unsigned off = this->row_num % CHUNK_ROWS;
+		unsigned k = CHUNK_ROWS - off;
+		if (k > _n)
+			k = _n;
+		for (unsigned c = 0; c < src_cols; ++c)
+		{
+			unsigned v = src_chunk[c * CHUNK_ROWS];
+			unsigned* col = chunk + c * CHUNK_ROWS + off;
+			for (unsigned i = 0; i < k; ++i)
+				col[i] = v;
+		}
+		memcpy(chunk + src_cols * CHUNK_ROWS + off, _vals, sizeof(unsigned) * k);
+		_vals += k;
+		_n -= k;
+		this->row_num += k;
+	}
+}
+
+void
+IDTable::append(const IDTable& _src)
+{
+	unsigned long r = 0;
+	while (r < _src.row_num)
+	{
+		//copy the longest run that is inside one chunk of both tables
+		const unsigned* from = _src.chunks[r / CHUNK_ROWS];
+		unsigned from_off = r % CHUNK_ROWS;
+		unsigned* to = this->reserveRow();
+		unsigned to_off = this->row_num % CHUNK_ROWS;
+		unsigned long k = CHUNK_ROWS - (from_off > to_off ? from_off : to_off);
+		if (k > _src.row_num - r)
+			k = _src.row_num - r;
+		for (unsigned c = 0; c < this->col_num; ++c)
+			memcpy(to + c * CHUNK_ROWS + to_off, from + c * CHUNK_ROWS + from_off, sizeof(unsigned) * k);
+		r += k;
+		this->row_num += k;
+	}
+}
+
+void
+IDTable::filter(const vector<bool>& _keep)
+{
+	unsigned long w = 0;
+	for (unsigned long r = 0; r < this->row_num; ++r)
+	{
+		if (!_keep[r])
+			continue;
+		if (w != r)
+		{
+			const unsigned* from = this->chunks[r / CHUNK_ROWS] + r % CHUNK_ROWS;
+			unsigned* to = this->chunks[w / CHUNK_ROWS] + w % CHUNK_ROWS;
+			for (unsigned c = 0; c < this->col_num; ++c)
+				to[c * CHUNK_ROWS] = from[c * CHUNK_ROWS];
+		}
+		++w;
+	}
+	this->row_num = w;
+	//the emptied chunks stay in the arena until reset
+	this->chunks.resize((w + CHUNK_ROWS - 1) / CHUNK_ROWS);
+}
+
+void
+IDTable::project(const vector<unsigned>& _cols, IDTable& _out) const
+{
+	_out.reset(_cols.size());
+	for (unsigned long r = 0; r < this->row_num; r += CHUNK_ROWS)
+	{
+		unsigned k = this->row_num - r < CHUNK_ROWS ? this->row_num - r : CHUNK_ROWS;
+		const unsigned* from = this->chunks[r / CHUNK_ROWS];
+		unsigned* to = _out.reserveRow();
+		for (unsigned c = 0; c < _cols.size(); ++c)
+			memcpy(to + c * CHUNK_ROWS, from + _cols[c] * CHUNK_ROWS, sizeof(unsigned) * k);
+		_out.row_num += k;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef _UTIL_IDTABLE_H
+#define _UTIL_IDTABLE_H
+
+#include "Util.h"
+#include "Arena.h"
+
+//A table of ids with a fixed number of columns, used for the intermediate results
+//of join. Rows are stored in chunks of CHUNK_ROWS, and inside a chunk column by
+//column, so extending or scanning one column touches contiguous memory.
+//All chunks come from the arena of the table, so rows cost no malloc and the
+//whole table is released at once.
+class IDTable
+{
+public:
+	static const unsigned CHUNK_ROWS = 1024;
+
+	IDTable(unsigned _col_num = 0);
+
+	//drop all rows and their memory, and set the number of columns
+	void reset(unsigned _col_num);
+	void swap(IDTable& _other);
+
+	unsigned getColNum() const { return this->col_num; }
+	unsigned long size() const { return this->row_num; }
+	bool empty() const { return this->row_num == 0; }
+	size_t getMemoryUsed() const { return this->arena.getUsed(); }
+
+	unsigned get(unsigned long _row, unsigned _col) const
+	{
+		return this->chunks[_row / CHUNK_ROWS][_col * CHUNK_ROWS + _row % CHUNK_ROWS];
+	}
+	void set(unsigned long _row, unsigned _col, unsigned _val)
+	{
+		this->chunks[_row / CHUNK_ROWS][_col * CHUNK_ROWS + _row % CHUNK_ROWS] = _val;
+	}
+	//copy one row into _out, which holds getColNum() ids
+	void getRow(unsigned long _row, unsigned* _out) const;
+
+	void appendRow(const unsigned* _row);
+	//append _n rows with one column, this table must have only one column
+	void appendColumn(const unsigned* _vals, unsigned long _n);
+	//append _n rows, each is row _row of _src followed by one of _vals
+	//this table must have one more column than _src
+	void appendExtend(const IDTable& _src, unsigned long _row, const unsigned* _vals, unsigned _n);
+	//append all rows of _src, which has the same columns
+	void append(const IDTable& _src);
+	//keep the rows whose _keep is true, in place and in order
+	void filter(const std::vector<bool>& _keep);
+	//reset _out to the columns _cols of all rows of this table
+	void project(const std::vector<unsigned>& _cols, IDTable& _out) const;
+
+private:
+	IDTable(const IDTable&);
+	IDTable& operator=(const IDTable&);
+
+	//make room for one more row, and return the chunk it goes into
+	unsigned* reserveRow();
+
+	unsigned col_num;
+	unsigned long row_num;
+	std::vector<unsigned*> chunks;
+	Arena arena;
+};
+
+#endif //_UTIL_IDTABLE_H
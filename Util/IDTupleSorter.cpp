@@ -0,0 +1,195 @@
+#include "IDTupleSorter.h"
+
+using namespace std;
+
+IDTupleSorter::IDTupleSorter(const string& _run_prefix, unsigned long long _memory_budget, Compare _cmp, unsigned _parallelism)
+{
+	this->run_prefix = _run_prefix;
+	this->capacity = max((unsigned long long)IDTupleSorter::MIN_RUN_BUFFER, _memory_budget / sizeof(ID_TUPLE));
+	this->cmp = _cmp;
+	this->parallelism = _parallelism == 0 ? max(1U, thread::hardware_concurrency()) : _parallelism;
+	this->buffer_pos = 0;
+	this->finished = false;
+	this->has_last = false;
+	this->output_num = 0;
+}
+
+IDTupleSorter::~IDTupleSorter()
+{
+	for (unsigned i = 0; i < this->runs.size(); ++i)
+	{
+		if (this->runs[i].fp != NULL)
+			fclose(this->runs[i].fp);
+		remove(this->runs[i].file.c_str());
+	}
+}
+
+void
+IDTupleSorter::sortBuffer()
+{
+	if (this->parallelism > 1)
+	{
+		omp_set_num_threads(this->parallelism);
+		__gnu_parallel::sort(this->buffer.begin(), this->buffer.end(), this->cmp);
+	}
+	else
+		sort(this->buffer.begin(), this->buffer.end(), this->cmp);
+}
+
+bool
+IDTupleSorter::spill()
+{
+	this->sortBuffer();
+	Run run;
+	run.file = this->run_prefix + Util::int2string(this->runs.size());
+	run.fp = fopen(run.file.c_str(), "wb+");
+	run.pos = 0;
+	if (run.fp == NULL)
+	{
+		cout << "unable to create run " << run.file << " @IDTupleSorter::spill" << endl;
+		return false;
+	}
+	this->runs.push_back(run);
+	//drop the duplicates in the run already
+	size_t num = this->buffer.empty() ? 0 : 1;
+	for (size_t i = 1; i < this->buffer.size(); ++i)
+	{
+		if (!Util::equal(this->buffer[i], this->buffer[num - 1]))
+			this->buffer[num++] = this->buffer[i];
+	}
+	if (fwrite(this->buffer.data(), sizeof(ID_TUPLE), num, run.fp) != num)
+	{
+		cout << "unable to write run " << run.file << " @IDTupleSorter::spill" << endl;
+		return false;
+	}
+	this->buffer.clear();
+	return true;
+}
+
+bool
+IDTupleSorter::add(const ID_TUPLE& _tuple)
+{
+	//grow by doubling up to the budget
+	if (this->buffer.size() == this->buffer.capacity())
+		this->buffer.reserve(min(this->capacity, max((size_t)IDTupleSorter::MIN_RUN_BUFFER, 2 * this->buffer.size())));
+	this->buffer.push_back(_tuple);
+	if (this->buffer.size() == this->capacity)
+		return this->spill();
+	return true;
+}
+
+bool
+IDTupleSorter::addFile(const string& _file)
+{
+	FILE* fp = fopen(_file.c_str(), "rb");
+	if (fp == NULL)
+	{
+		cout << "unable to open " << _file << " @IDTupleSorter::addFile" << endl;
+		return false;
+	}
+	fseeko(fp, 0, SEEK_END);
+	unsigned long long remain = ftello(fp) / sizeof(ID_TUPLE);
+	rewind(fp);
+	bool ok = true;
+	while (ok && remain > 0)
+	{
+		//read straight into the free part of the buffer
+		size_t old_size = this->buffer.size();
+		size_t read_num = min((unsigned long long)(this->capacity - old_size), remain);
+		this->buffer.resize(old_size + read_num);
+		read_num = fread(&this->buffer[old_size], sizeof(ID_TUPLE), read_num, fp);
+		this->buffer.resize(old_size + read_num);
+		if (read_num == 0)
+			break;
+		remain -= read_num;
+		if (this->buffer.size() == this->capacity)
+			ok = this->spill();
+	}
+	fclose(fp);
+	return ok;
+}
+
+bool
+IDTupleSorter::fill(Run& _run)
+{
+	_run.buffer.resize(_run.buffer.capacity());
+	size_t read_num = fread(_run.buffer.data(), sizeof(ID_TUPLE), _run.buffer.size(), _run.fp);
+	_run.buffer.resize(read_num);
+	_run.pos = 0;
+	return read_num > 0;
+}
+
+bool
+IDTupleSorter::finish()
+{
+	if (this->runs.empty())
+	{
+		this->sortBuffer();
+		this->finished = true;
+		return true;
+	}
+	if (!this->buffer.empty() && !this->spill())
+		return false;
+	vector<ID_TUPLE>().swap(this->buffer);
+
+	//each run reads through its share of the budget
+	size_t run_buffer = max((size_t)IDTupleSorter::MIN_RUN_BUFFER, this->capacity / this->runs.size());
+	for (unsigned i = 0; i < this->runs.size(); ++i)
+	{
+		Run& run = this->runs[i];
+		rewind(run.fp);
+		run.buffer.reserve(run_buffer);
+		if (this->fill(run))
+			this->heap.push_back(i);
+	}
+	make_heap(this->heap.begin(), this->heap.end(), [this](unsigned a, unsigned b)
+	{
+		return this->cmp(this->runs[b].buffer[this->runs[b].pos], this->runs[a].buffer[this->runs[a].pos]);
+	});
+	this->finished = true;
+	return true;
+}
+
+bool
+IDTupleSorter::nextMerged(ID_TUPLE& _tuple)
+{
+	if (this->runs.empty())
+	{
+		if (this->buffer_pos == this->buffer.size())
+			return false;
+		_tuple = this->buffer[this->buffer_pos++];
+		return true;
+	}
+	if (this->heap.empty())
+		return false;
+	auto greater = [this](unsigned a, unsigned b)
+	{
+		return this->cmp(this->runs[b].buffer[this->runs[b].pos], this->runs[a].buffer[this->runs[a].pos]);
+	};
+	pop_heap(this->heap.begin(), this->heap.end(), greater);
+	Run& run = this->runs[this->heap.back()];
+	_tuple = run.buffer[run.pos++];
+	if (run.pos < run.buffer.size() || this->fill(run))
+		push_heap(this->heap.begin(), this->heap.end(), greater);
+	else
+		this->heap.pop_back();
+	return true;
+}
+
+bool
+IDTupleSorter::next(ID_TUPLE& _tuple)
+{
+	if (!this->finished)
+		return false;
+	while (this->nextMerged(_tuple))
+	{
+		if (!this->has_last || !Util::equal(_tuple, this->last))
+		{
+			this->last = _tuple;
+			this->has_last = true;
+			this->output_num++;
+			return true;
+		}
+	}
+	return false;
+}
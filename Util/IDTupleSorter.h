@@ -0,0 +1,88 @@
+#ifndef _UTIL_IDTUPLESORTER_H
+#define _UTIL_IDTUPLESORTER_H
+
+#include "Util.h"
+
+//ID tuples read one at a time, i.e. by the builders of subID2values/objID2values/preID2values
+class IDTupleReader
+{
+public:
+	virtual ~IDTupleReader() {}
+	//false when there are no more tuples
+	virtual bool next(ID_TUPLE& _tuple) = 0;
+};
+
+class IDTupleArrayReader : public IDTupleReader
+{
+public:
+	IDTupleArrayReader(const ID_TUPLE* _tuples, TYPE_TRIPLE_NUM _num) : tuples(_tuples), num(_num), pos(0) {}
+	bool next(ID_TUPLE& _tuple)
+	{
+		if (this->pos == this->num)
+			return false;
+		_tuple = this->tuples[this->pos++];
+		return true;
+	}
+
+private:
+	const ID_TUPLE* tuples;
+	TYPE_TRIPLE_NUM num;
+	TYPE_TRIPLE_NUM pos;
+};
+
+//Sorts the ID tuples of a build within a memory budget: the tuples added are kept in a buffer of
+//the budget, which is sorted and spilled to a run file whenever it is full. After finish(), next()
+//gives the tuples in order without duplicates, from the buffer if nothing was spilled or else by
+//merging the runs, each read through its share of the budget.
+class IDTupleSorter : public IDTupleReader
+{
+public:
+	typedef bool (*Compare)(const ID_TUPLE&, const ID_TUPLE&);
+
+	//the runs are _run_prefix + number, sorted with _parallelism threads(0 for all cores)
+	IDTupleSorter(const std::string& _run_prefix, unsigned long long _memory_budget, Compare _cmp, unsigned _parallelism);
+	~IDTupleSorter();	//removes the runs
+
+	bool add(const ID_TUPLE& _tuple);
+	//add all the tuples in a file of ID_TUPLE, as written by the build
+	bool addFile(const std::string& _file);
+	bool finish();
+	bool next(ID_TUPLE& _tuple);
+
+	unsigned getRunNum() const { return this->runs.size(); }
+	TYPE_TRIPLE_NUM getOutputNum() const { return this->output_num; }	//Tuples given by next() so far
+
+private:
+	static const size_t MIN_RUN_BUFFER = 4096;	//Tuples read from a run at a time, at least
+
+	struct Run
+	{
+		FILE* fp;
+		std::string file;
+		std::vector<ID_TUPLE> buffer;
+		size_t pos;
+	};
+
+	IDTupleSorter(const IDTupleSorter&);
+	IDTupleSorter& operator=(const IDTupleSorter&);
+
+	void sortBuffer();
+	bool spill();
+	bool fill(Run& _run);
+	bool nextMerged(ID_TUPLE& _tuple);
+
+	std::string run_prefix;
+	size_t capacity;	//Tuples in the buffer
+	Compare cmp;
+	unsigned parallelism;
+	std::vector<ID_TUPLE> buffer;
+	size_t buffer_pos;
+	std::vector<Run> runs;
+	std::vector<unsigned> heap;	//Runs by their current tuple, the smallest at the front
+	bool finished;
+	bool has_last;
+	ID_TUPLE last;
+	TYPE_TRIPLE_NUM output_num;
+};
+
+#endif //_UTIL_IDTUPLESORTER_H
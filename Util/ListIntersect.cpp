@@ -0,0 +1,264 @@
+#include "ListIntersect.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIST_INTERSECT_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+int ListIntersect::kernel = ListIntersect::detectKernel();
+
+#ifdef LIST_INTERSECT_X86
+//shuffle tables to pack the matched lanes to the front, indexed by the match mask
+struct IntersectTables
+{
+	unsigned char sse[16][16];
+	unsigned avx2[256][8];
+
+	IntersectTables()
+	{
+		for (unsigned mask = 0; mask < 16; ++mask)
+		{
+			unsigned k = 0;
+			memset(sse[mask], 0x80, 16);
+			for (unsigned lane = 0; lane < 4; ++lane)
+			{
+				if (mask & (1u << lane))
+				{
+					for (unsigned b = 0; b < 4; ++b)
+						sse[mask][4 * k + b] = 4 * lane + b;
+					++k;
+				}
+			}
+		}
+		for (unsigned mask = 0; mask < 256; ++mask)
+		{
+			unsigned k = 0;
+			for (unsigned lane = 0; lane < 8; ++lane)
+				if (mask & (1u << lane))
+					avx2[mask][k++] = lane;
+			for (; k < 8; ++k)
+				avx2[mask][k] = 0;
+		}
+	}
+};
+static IntersectTables intersect_tables;
+#endif
+
+int
+ListIntersect::detectKernel()
+{
+#ifdef LIST_INTERSECT_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return ListIntersect::KERNEL_AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return ListIntersect::KERNEL_SSE;
+#endif
+	return ListIntersect::KERNEL_SCALAR;
+}
+
+void
+ListIntersect::setKernel(int _kernel)
+{
+	int best = ListIntersect::detectKernel();
+	ListIntersect::kernel = _kernel < best ? _kernel : best;
+}
+
+int
+ListIntersect::getKernel()
+{
+	return ListIntersect::kernel;
+}
+
+const char*
+ListIntersect::kernelName(int _kernel)
+{
+	switch (_kernel)
+	{
+	case ListIntersect::KERNEL_AVX2:
+		return "avx2";
+	case ListIntersect::KERNEL_SSE:
+		return "sse4";
+	default:
+		return "scalar";
+	}
+}
+
+unsigned
+ListIntersect::intersect(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	if (_na == 0 || _nb == 0)
+		return 0;
+	if (_na > _nb)
+	{
+		swap(_a, _b);
+		swap(_na, _nb);
+	}
+	//now _a is the shorter one
+	if (_nb / _na >= ListIntersect::GALLOP_RATIO)
+		return ListIntersect::intersectGallop(_a, _na, _b, _nb, _out);
+
+	switch (ListIntersect::kernel)
+	{
+	case ListIntersect::KERNEL_AVX2:
+		return ListIntersect::intersectAVX2(_a, _na, _b, _nb, _out);
+	case ListIntersect::KERNEL_SSE:
+		return ListIntersect::intersectSSE(_a, _na, _b, _nb, _out);
+	default:
+		return ListIntersect::intersectScalar(_a, _na, _b, _nb, _out);
+	}
+}
+
+unsigned
+ListIntersect::mergeTail(const unsigned* _a, unsigned _i, unsigned _na, const unsigned* _b, unsigned _j, unsigned _nb, unsigned* _out, unsigned _c)
+{
+	while (_i < _na && _j < _nb)
+	{
+		unsigned x = _a[_i], y = _b[_j];
+		if (x == y)
+			_out[_c++] = x;
+		//branch free advance, both move on equal
+		_i += (x <= y);
+		_j += (y <= x);
+	}
+	return _c;
+}
+
+unsigned
+ListIntersect::intersectScalar(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	return ListIntersect::mergeTail(_a, 0, _na, _b, 0, _nb, _out, 0);
+}
+
+unsigned
+ListIntersect::intersectGallop(const unsigned* _small, unsigned _ns, const unsigned* _large, unsigned _nl, unsigned* _out)
+{
+	unsigned c = 0, pos = 0;
+	for (unsigned i = 0; i < _ns && pos < _nl; ++i)
+	{
+		unsigned x = _small[i];
+		//find a range (lo, hi] with _large[lo] < x <= _large[hi] by doubling the step
+		if (_large[pos] < x)
+		{
+			unsigned lo = pos, step = 1;
+			unsigned hi = pos + step;
+			while (hi < _nl && _large[hi] < x)
+			{
+				lo = hi;
+				step <<= 1;
+				hi = pos + step;
+			}
+			if (hi >= _nl)
+				hi = _nl;
+			pos = lower_bound(_large + lo + 1, _large + hi, x) - _large;
+			if (pos == _nl)
+				break;
+		}
+		if (_large[pos] == x)
+			_out[c++] = x;
+	}
+	return c;
+}
+
+#ifdef LIST_INTERSECT_X86
+
+__attribute__((target("sse4.2")))
+unsigned
+ListIntersect::intersectSSE(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	unsigned i = 0, j = 0, c = 0;
+	unsigned st_a = _na & ~3u, st_b = _nb & ~3u;
+	unsigned cap = _na < _nb ? _na : _nb;
+	while (i < st_a && j < st_b)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i*)(_a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(_b + j));
+		//compare each lane of va with all lanes of vb
+		__m128i cmp = _mm_cmpeq_epi32(va, vb);
+		cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+		cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+		cmp = _mm_or_si128(cmp, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+		int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+		if (mask != 0)
+		{
+			__m128i packed = _mm_shuffle_epi8(va, _mm_loadu_si128((const __m128i*)intersect_tables.sse[mask]));
+			unsigned cnt = __builtin_popcount(mask);
+			if (c + 4 <= cap)
+				_mm_storeu_si128((__m128i*)(_out + c), packed);
+			else
+			{
+				unsigned tmp[4];
+				_mm_storeu_si128((__m128i*)tmp, packed);
+				memcpy(_out + c, tmp, sizeof(unsigned) * cnt);
+			}
+			c += cnt;
+		}
+		unsigned a_max = _a[i + 3], b_max = _b[j + 3];
+		i += (a_max <= b_max) << 2;
+		j += (b_max <= a_max) << 2;
+	}
+	return ListIntersect::mergeTail(_a, i, _na, _b, j, _nb, _out, c);
+}
+
+__attribute__((target("avx2")))
+unsigned
+ListIntersect::intersectAVX2(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	unsigned i = 0, j = 0, c = 0;
+	unsigned st_a = _na & ~7u, st_b = _nb & ~7u;
+	unsigned cap = _na < _nb ? _na : _nb;
+	while (i < st_a && j < st_b)
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i*)(_a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(_b + j));
+		//rotate vb inside the 128-bit halves, then swap the halves and rotate again,
+		//so all 64 pairs are compared with only one cross lane permute
+		__m256i vs = _mm256_permute2x128_si256(vb, vb, 1);
+		__m256i cmp = _mm256_cmpeq_epi32(va, vb);
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, vs));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(0, 3, 2, 1))));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(1, 0, 3, 2))));
+		cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, _mm256_shuffle_epi32(vs, _MM_SHUFFLE(2, 1, 0, 3))));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+		if (mask != 0)
+		{
+			__m256i idx = _mm256_loadu_si256((const __m256i*)intersect_tables.avx2[mask]);
+			__m256i packed = _mm256_permutevar8x32_epi32(va, idx);
+			unsigned cnt = __builtin_popcount(mask);
+			if (c + 8 <= cap)
+				_mm256_storeu_si256((__m256i*)(_out + c), packed);
+			else
+			{
+				unsigned tmp[8];
+				_mm256_storeu_si256((__m256i*)tmp, packed);
+				memcpy(_out + c, tmp, sizeof(unsigned) * cnt);
+			}
+			c += cnt;
+		}
+		unsigned a_max = _a[i + 7], b_max = _b[j + 7];
+		i += (a_max <= b_max) << 3;
+		j += (b_max <= a_max) << 3;
+	}
+	return ListIntersect::mergeTail(_a, i, _na, _b, j, _nb, _out, c);
+}
+
+#else
+
+unsigned
+ListIntersect::intersectSSE(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	return ListIntersect::intersectScalar(_a, _na, _b, _nb, _out);
+}
+
+unsigned
+ListIntersect::intersectAVX2(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out)
+{
+	return ListIntersect::intersectScalar(_a, _na, _b, _nb, _out);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _UTIL_LISTINTERSECT_H
+#define _UTIL_LISTINTERSECT_H
+
+#include "Util.h"
+
+//Intersection kernels for sorted id lists without duplicates, used by IDList and
+//Util::intersect. The SIMD kernels compare a block of one list with a block of
+//the other in all pairs(4x4 with SSE4, 8x8 with AVX2), and pack the matched ids
+//with a shuffle table. When one list is much longer than the other, the short
+//one is galloped(exponential search) into the long one instead.
+//The kernel is chosen at runtime by the cpu features, so one binary runs everywhere.
+class ListIntersect
+{
+public:
+	static const int KERNEL_SCALAR = 0;
+	static const int KERNEL_SSE = 1;
+	static const int KERNEL_AVX2 = 2;
+	//gallop when the longer list is at least this times the shorter one
+	static const unsigned GALLOP_RATIO = 128;
+
+	//write the common ids into _out(with room for min(_na, _nb) ids, not aliasing
+	//the inputs) in increasing order, return the number of them
+	static unsigned intersect(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out);
+
+	//the best kernel supported by this cpu
+	static int detectKernel();
+	//force a kernel(downgraded to a supported one), mainly for benchmarks
+	static void setKernel(int _kernel);
+	static int getKernel();
+	static const char* kernelName(int _kernel);
+
+	//the kernels, callable directly by benchmarks
+	static unsigned intersectScalar(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out);
+	static unsigned intersectGallop(const unsigned* _small, unsigned _ns, const unsigned* _large, unsigned _nl, unsigned* _out);
+	static unsigned intersectSSE(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out);
+	static unsigned intersectAVX2(const unsigned* _a, unsigned _na, const unsigned* _b, unsigned _nb, unsigned* _out);
+
+private:
+	static int kernel;
+	//scalar merge from position _i/_j, appending to _out[_c]
+	static unsigned mergeTail(const unsigned* _a, unsigned _i, unsigned _na, const unsigned* _b, unsigned _j, unsigned _nb, unsigned* _out, unsigned _c);
+};
+
+#endif //_UTIL_LISTINTERSECT_H
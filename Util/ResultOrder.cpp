@@ -0,0 +1,186 @@
+#include "ResultOrder.h"
+
+using namespace std;
+
+ResultOrder::ResultOrder(const vector<bool>& _desc, unsigned _row_num)
+{
+	this->key_num = _desc.size();
+	this->row_num = _row_num;
+	this->desc = _desc;
+	this->keys.assign((size_t)_row_num * this->key_num, 0);
+	//value 0 is unbound, the default of every key
+	this->addValue("");
+}
+
+unsigned
+ResultOrder::addValue(const string& _term)
+{
+	unordered_map<string, unsigned>::iterator it = this->value_index.find(_term);
+	if (it != this->value_index.end())
+		return it->second;
+
+	Value value;
+	value.kind = Unbound;
+	value.num = 0;
+	if (!_term.empty())
+	{
+		EvalMultitypeValue emv;
+		emv.term_value = _term;
+		emv.deduceTypeValue();
+		switch (emv.datatype)
+		{
+		case EvalMultitypeValue::xsd_boolean:
+			if (emv.bool_value.getValue() == 2)
+			{
+				value.kind = OtherLiteral;
+				value.str = _term;
+			}
+			else
+			{
+				value.kind = Boolean;
+				value.num = emv.bool_value.getValue();
+			}
+			break;
+		case EvalMultitypeValue::xsd_integer:
+			value.kind = Numeric;
+			value.num = emv.int_value;
+			break;
+		case EvalMultitypeValue::xsd_decimal:
+		case EvalMultitypeValue::xsd_float:
+			value.kind = Numeric;
+			value.num = emv.flt_value;
+			break;
+		case EvalMultitypeValue::xsd_double:
+			value.kind = Numeric;
+			value.num = emv.dbl_value;
+			break;
+		case EvalMultitypeValue::xsd_datetime:
+			value.kind = DateTime;
+			value.date = emv.dt_value.date;
+			break;
+		case EvalMultitypeValue::xsd_string:
+			value.kind = String;
+			value.str = emv.str_value;
+			break;
+		case EvalMultitypeValue::literal:
+			//literals with a language tag are not comparable as strings
+			value.kind = emv.isSimpleLiteral() ? String : OtherLiteral;
+			value.str = emv.isSimpleLiteral() ? emv.str_value : _term;
+			break;
+		default:
+			value.kind = Term;
+			value.str = _term;
+		}
+	}
+
+	unsigned index = this->values.size();
+	this->values.push_back(value);
+	this->value_index[_term] = index;
+	return index;
+}
+
+int
+ResultOrder::compare(const Value& _a, const Value& _b)
+{
+	if (_a.kind != _b.kind)
+		return _a.kind < _b.kind ? -1 : 1;
+	switch (_a.kind)
+	{
+	case Unbound:
+		return 0;
+	case Boolean:
+	case Numeric:
+		return _a.num < _b.num ? -1 : (_b.num < _a.num ? 1 : 0);
+	case DateTime:
+		return _a.date < _b.date ? -1 : (_b.date < _a.date ? 1 : 0);
+	default:
+		return _a.str.compare(_b.str);
+	}
+}
+
+bool
+ResultOrder::less(unsigned _a, unsigned _b) const
+{
+	const unsigned* a = &this->keys[(size_t)_a * this->key_num];
+	const unsigned* b = &this->keys[(size_t)_b * this->key_num];
+	for (unsigned i = 0; i < this->key_num; ++i)
+	{
+		if (a[i] == b[i])
+			continue;
+		int ret = ResultOrder::compare(this->values[a[i]], this->values[b[i]]);
+		if (ret != 0)
+			return this->desc[i] ? ret > 0 : ret < 0;
+	}
+	//the earlier row first, so the order is total and the same as a stable sort
+	return _a < _b;
+}
+
+void
+ResultOrder::order(unsigned long long _k, unsigned _parallelism, vector<unsigned>& _rows) const
+{
+	auto cmp = [this](unsigned _a, unsigned _b) { return this->less(_a, _b); };
+	_rows.clear();
+
+	if (_k < this->row_num)
+	{
+		//a heap of the first _k rows so far, with the last of them on top
+		_rows.reserve(_k);
+		for (unsigned row = 0; row < this->row_num && _k > 0; ++row)
+		{
+			if (_rows.size() < _k)
+			{
+				_rows.push_back(row);
+				push_heap(_rows.begin(), _rows.end(), cmp);
+			}
+			else if (this->less(row, _rows.front()))
+			{
+				pop_heap(_rows.begin(), _rows.end(), cmp);
+				_rows.back() = row;
+				push_heap(_rows.begin(), _rows.end(), cmp);
+			}
+		}
+		sort_heap(_rows.begin(), _rows.end(), cmp);
+		return;
+	}
+
+	_rows.resize(this->row_num);
+	for (unsigned row = 0; row < this->row_num; ++row)
+		_rows[row] = row;
+	unsigned worker_num = _parallelism == 0 ? max(1U, thread::hardware_concurrency()) : _parallelism;
+	unsigned part_num = min(worker_num, max(1U, this->row_num / ResultOrder::MIN_PARTITION_ROWS));
+	if (part_num <= 1)
+	{
+		sort(_rows.begin(), _rows.end(), cmp);
+		return;
+	}
+
+	//sort the partitions in parallel, then merge them pairwise, the pairs of a round in parallel
+	WorkStealingPool pool(part_num);
+	vector<size_t> bounds(part_num + 1);
+	for (unsigned i = 0; i <= part_num; ++i)
+		bounds[i] = (size_t)this->row_num * i / part_num;
+	pool.run(part_num, [&](unsigned _worker, unsigned long _part)
+	{
+		sort(_rows.begin() + bounds[_part], _rows.begin() + bounds[_part + 1], cmp);
+	});
+	vector<unsigned> merged(this->row_num);
+	while (bounds.size() > 2)
+	{
+		size_t pair_num = bounds.size() / 2;
+		pool.run(pair_num, [&](unsigned _worker, unsigned long _pair)
+		{
+			size_t begin = bounds[2 * _pair];
+			size_t mid = bounds[2 * _pair + 1];
+			size_t end = 2 * _pair + 2 < bounds.size() ? bounds[2 * _pair + 2] : mid;
+			merge(_rows.begin() + begin, _rows.begin() + mid, _rows.begin() + mid, _rows.begin() + end,
+				merged.begin() + begin, cmp);
+		});
+		_rows.swap(merged);
+		vector<size_t> next_bounds;
+		for (size_t i = 0; i < bounds.size(); i += 2)
+			next_bounds.push_back(bounds[i]);
+		if (next_bounds.back() != bounds.back())
+			next_bounds.push_back(bounds.back());
+		bounds.swap(next_bounds);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef _UTIL_RESULTORDER_H
+#define _UTIL_RESULTORDER_H
+
+#include "Util.h"
+#include "EvalMultitypeValue.h"
+#include "WorkStealingPool.h"
+
+//Orders the rows of a result for ORDER BY by their key values. Each distinct value is typed once
+//when added(instead of in every comparison as ResultCmp in Stream), and rows refer to values by
+//index, so only the key columns need decoding. order() keeps the first K rows in a bounded heap
+//if K is less than the rows, or sorts all of them in parallel partitions that are then merged.
+//Ties keep the order of the rows, as the stable sort of Stream does.
+class ResultOrder
+{
+public:
+	//_desc[i] for key i
+	ResultOrder(const std::vector<bool>& _desc, unsigned _row_num);
+
+	//the index of the value of an RDF term, "" if unbound
+	unsigned addValue(const std::string& _term);
+	void setKey(unsigned _row, unsigned _key, unsigned _value) { this->keys[(size_t)_row * this->key_num + _key] = _value; }
+
+	//the first min(_k, rows) rows in order, sorted with _parallelism threads(0 for all cores)
+	void order(unsigned long long _k, unsigned _parallelism, std::vector<unsigned>& _rows) const;
+
+	unsigned getValueNum() const { return this->values.size(); }
+
+private:
+	//values of different kinds are ordered by kind, unbound first as in SPARQL, and then
+	//within a kind in the way EvalMultitypeValue compares them
+	enum Kind { Unbound = 0, Term, Boolean, Numeric, DateTime, String, OtherLiteral };
+	struct Value
+	{
+		Kind kind;
+		double num;
+		std::vector<int> date;
+		std::string str;
+	};
+	static const unsigned MIN_PARTITION_ROWS = 1 << 14;
+
+	static int compare(const Value& _a, const Value& _b);
+	bool less(unsigned _a, unsigned _b) const;
+
+	unsigned key_num;
+	unsigned row_num;
+	std::vector<bool> desc;
+	std::vector<unsigned> keys;	//Value index of each key, row by row
+	std::vector<Value> values;
+	std::unordered_map<std::string, unsigned> value_index;
+};
+
+#endif //_UTIL_RESULTORDER_H
@@ -20,7 +20,7 @@ struct spinlock {
   }
 
   bool try_lock(){
-    return pthread_spin_trylock(&_lock);
+    return pthread_spin_trylock(&_lock) == 0;
   }
   void unlock(){
     pthread_spin_unlock(&_lock);
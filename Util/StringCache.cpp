@@ -0,0 +1,215 @@
+#include "StringCache.h"
+
+using namespace std;
+
+StringCache::StringCache(unsigned long long _capacity)
+{
+	this->shard_capacity = _capacity / StringCache::SHARD_NUM;
+	//about one counter per entry that fits, assuming short strings
+	unsigned width = 64;
+	while (width < this->shard_capacity / (StringCache::ENTRY_OVERHEAD + 32) && width < (1U << 24))
+		width <<= 1;
+	this->shards = new Shard[StringCache::SHARD_NUM];
+	for (unsigned i = 0; i < StringCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		s.bytes = 0;
+		s.sketch_width = width;
+		s.sketch.assign((size_t)width * StringCache::SKETCH_DEPTH / 2, 0);
+		s.additions = 0;
+		s.hits = s.misses = s.rejections = s.evictions = 0;
+	}
+}
+
+StringCache::~StringCache()
+{
+	delete[] this->shards;
+}
+
+StringCache::Shard&
+StringCache::shard(unsigned long long _key) const
+{
+	return this->shards[StringCache::hash(_key, 0) >> 58];
+}
+
+unsigned long long
+StringCache::hash(unsigned long long _key, unsigned _row)
+{
+	//splitmix64 with a different seed for each row
+	unsigned long long x = _key + 0x9E3779B97F4A7C15ULL * (_row + 1);
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+void
+StringCache::increment(Shard& _shard, unsigned long long _key)
+{
+	for (unsigned r = 0; r < StringCache::SKETCH_DEPTH; ++r)
+	{
+		size_t pos = (size_t)r * _shard.sketch_width + (StringCache::hash(_key, r + 1) & (_shard.sketch_width - 1));
+		unsigned char& b = _shard.sketch[pos >> 1];
+		unsigned shift = (pos & 1) * 4;
+		if (((b >> shift) & 0xF) < 15)
+			b += 1 << shift;
+	}
+	//age: halve all the counters
+	if (++_shard.additions >= 10ULL * _shard.sketch_width)
+	{
+		for (size_t i = 0; i < _shard.sketch.size(); ++i)
+			_shard.sketch[i] = (_shard.sketch[i] >> 1) & 0x77;
+		_shard.additions /= 2;
+	}
+}
+
+unsigned
+StringCache::frequency(const Shard& _shard, unsigned long long _key) const
+{
+	unsigned freq = 15;
+	for (unsigned r = 0; r < StringCache::SKETCH_DEPTH; ++r)
+	{
+		size_t pos = (size_t)r * _shard.sketch_width + (StringCache::hash(_key, r + 1) & (_shard.sketch_width - 1));
+		unsigned c = (_shard.sketch[pos >> 1] >> ((pos & 1) * 4)) & 0xF;
+		if (c < freq)
+			freq = c;
+	}
+	return freq;
+}
+
+bool
+StringCache::get(unsigned long long _key, string& _str)
+{
+	Shard& s = this->shard(_key);
+	s.lock.lock();
+	this->increment(s, _key);
+	unordered_map<unsigned long long, list<Entry>::iterator>::iterator it = s.index.find(_key);
+	if (it == s.index.end())
+	{
+		s.misses++;
+		s.lock.unlock();
+		return false;
+	}
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+	_str = it->second->str;
+	s.hits++;
+	s.lock.unlock();
+	return true;
+}
+
+void
+StringCache::insert(Shard& _shard, unsigned long long _key, const string& _str)
+{
+	_shard.lru.push_front(Entry());
+	_shard.lru.front().key = _key;
+	_shard.lru.front().str = _str;
+	_shard.index[_key] = _shard.lru.begin();
+	_shard.bytes += _str.size() + StringCache::ENTRY_OVERHEAD;
+}
+
+void
+StringCache::evict(Shard& _shard)
+{
+	Entry& victim = _shard.lru.back();
+	_shard.bytes -= victim.str.size() + StringCache::ENTRY_OVERHEAD;
+	_shard.index.erase(victim.key);
+	_shard.lru.pop_back();
+	_shard.evictions++;
+}
+
+void
+StringCache::put(unsigned long long _key, const string& _str)
+{
+	unsigned long long size = _str.size() + StringCache::ENTRY_OVERHEAD;
+	if (size > this->shard_capacity)
+		return;
+	Shard& s = this->shard(_key);
+	s.lock.lock();
+	if (s.index.find(_key) != s.index.end())
+	{
+		s.lock.unlock();
+		return;
+	}
+	//the candidate must be more frequent than every victim it pushes out
+	unsigned freq = this->frequency(s, _key);
+	unsigned long long freed = 0;
+	list<Entry>::reverse_iterator victim = s.lru.rbegin();
+	while (s.bytes - freed + size > this->shard_capacity)
+	{
+		if (this->frequency(s, victim->key) >= freq)
+		{
+			s.rejections++;
+			s.lock.unlock();
+			return;
+		}
+		freed += victim->str.size() + StringCache::ENTRY_OVERHEAD;
+		++victim;
+	}
+	while (s.bytes + size > this->shard_capacity)
+		this->evict(s);
+	this->insert(s, _key, _str);
+	s.lock.unlock();
+}
+
+bool
+StringCache::warm(unsigned long long _key, const string& _str)
+{
+	Shard& s = this->shard(_key);
+	s.lock.lock();
+	bool ok = s.bytes + _str.size() + StringCache::ENTRY_OVERHEAD <= this->shard_capacity;
+	if (ok && s.index.find(_key) == s.index.end())
+	{
+		this->insert(s, _key, _str);
+		//as if it was asked for once
+		this->increment(s, _key);
+	}
+	s.lock.unlock();
+	return ok;
+}
+
+void
+StringCache::erase(unsigned long long _key)
+{
+	Shard& s = this->shard(_key);
+	s.lock.lock();
+	unordered_map<unsigned long long, list<Entry>::iterator>::iterator it = s.index.find(_key);
+	if (it != s.index.end())
+	{
+		s.bytes -= it->second->str.size() + StringCache::ENTRY_OVERHEAD;
+		s.lru.erase(it->second);
+		s.index.erase(it);
+	}
+	s.lock.unlock();
+}
+
+void
+StringCache::clear()
+{
+	for (unsigned i = 0; i < StringCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		s.lock.lock();
+		s.lru.clear();
+		s.index.clear();
+		s.bytes = 0;
+		s.lock.unlock();
+	}
+}
+
+void
+StringCache::getStats(Stats& _stats) const
+{
+	memset(&_stats, 0, sizeof(Stats));
+	_stats.capacity = this->shard_capacity * StringCache::SHARD_NUM;
+	for (unsigned i = 0; i < StringCache::SHARD_NUM; ++i)
+	{
+		Shard& s = this->shards[i];
+		s.lock.lock();
+		_stats.hits += s.hits;
+		_stats.misses += s.misses;
+		_stats.rejections += s.rejections;
+		_stats.evictions += s.evictions;
+		_stats.entries += s.index.size();
+		_stats.bytes += s.bytes;
+		s.lock.unlock();
+	}
+}
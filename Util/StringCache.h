@@ -0,0 +1,84 @@
+#ifndef _UTIL_STRINGCACHE_H
+#define _UTIL_STRINGCACHE_H
+
+#include "Util.h"
+#include "SpinLock.h"
+
+//A bounded cache of decoded strings with TinyLFU admission, used in front of
+//StringIndex. The keys are split among shards, each with its own lock, an LRU
+//list of entries and a count-min sketch of 4-bit counters that estimates how
+//often each key is asked for. When the shard is full a new string is only
+//admitted if it is asked for more often than the LRU victim, so the long tail
+//of one-off strings in big results does not flush the popular ones. The sketch
+//is halved every 10 * entries accesses so old popularity fades.
+class StringCache
+{
+public:
+	struct Stats
+	{
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long rejections;
+		unsigned long long evictions;
+		unsigned long long entries;
+		unsigned long long bytes;
+		unsigned long long capacity;
+	};
+
+	//_capacity is in bytes, counting the strings and the bookkeeping
+	StringCache(unsigned long long _capacity);
+	~StringCache();
+
+	bool get(unsigned long long _key, std::string& _str);
+	//a miss is counted in the sketch by get(), put() decides the admission
+	void put(unsigned long long _key, const std::string& _str);
+	//insert with no admission check, false when the shard is full
+	bool warm(unsigned long long _key, const std::string& _str);
+	void erase(unsigned long long _key);
+	void clear();
+	void getStats(Stats& _stats) const;
+
+private:
+	static const unsigned SHARD_NUM = 64;
+	static const unsigned SKETCH_DEPTH = 4;
+	//bookkeeping bytes counted for each entry
+	static const unsigned ENTRY_OVERHEAD = 64;
+
+	struct Entry
+	{
+		unsigned long long key;
+		std::string str;
+	};
+
+	struct Shard
+	{
+		spinlock lock;
+		//most recently used first
+		std::list<Entry> lru;
+		std::unordered_map<unsigned long long, std::list<Entry>::iterator> index;
+		unsigned long long bytes;
+		//SKETCH_DEPTH rows of sketch_width 4-bit counters, two in a byte
+		std::vector<unsigned char> sketch;
+		unsigned sketch_width;
+		unsigned long long additions;
+		unsigned long long hits;
+		unsigned long long misses;
+		unsigned long long rejections;
+		unsigned long long evictions;
+	};
+
+	StringCache(const StringCache&);
+	StringCache& operator=(const StringCache&);
+
+	Shard& shard(unsigned long long _key) const;
+	static unsigned long long hash(unsigned long long _key, unsigned _row);
+	void increment(Shard& _shard, unsigned long long _key);
+	unsigned frequency(const Shard& _shard, unsigned long long _key) const;
+	void insert(Shard& _shard, unsigned long long _key, const std::string& _str);
+	void evict(Shard& _shard);
+
+	Shard* shards;
+	unsigned long long shard_capacity;
+};
+
+#endif //_UTIL_STRINGCACHE_H
@@ -9,6 +9,7 @@
 =============================================================================*/
 
 #include "Util.h"
+#include "ListIntersect.h"
 
 
 using namespace std;
@@ -144,6 +145,14 @@ Util::configure()
 	Util::global_config["thread_maxium"] = "1000";
 	//TODO:to be recoverable
 	Util::global_config["operation_logs"] = "true";
+	Util::global_config["leapfrog_join"] = "true";
+	Util::global_config["query_parallelism"] = "1";
+	Util::global_config["value_mmap"] = "false";
+	Util::global_config["string_cache_size"] = "64";
+	Util::global_config["neighbor_cache_size"] = "256";
+	Util::global_config["ppr_walk_index"] = "false";
+	Util::global_config["build_parallelism"] = "1";
+	Util::global_config["build_memory"] = "0";
 
 #ifdef DEBUG
 	fprintf(stderr, "profile: %s\n", profile.c_str());
@@ -1524,104 +1533,17 @@ Util::logarithm(double _a, double _b)
 void
 Util::intersect(unsigned*& _id_list, unsigned& _id_list_len, const unsigned* _list1, unsigned _len1, const unsigned* _list2, unsigned _len2)
 {
-	vector<unsigned> res;
-	//cout<<"intersect prevar: "<<_len1<<"   "<<_len2<<endl;
-	if(_list1 == NULL || _len1 == 0 || _list2 == NULL || _len2 == 0)
+	_id_list = NULL;
+	_id_list_len = 0;
+	if(_list1 != NULL && _len1 > 0 && _list2 != NULL && _len2 > 0)
 	{
-		_id_list = NULL;
-		_id_list_len = 0;
-	}
-
-	//when size is almost the same, intersect O(n)
-	//when one size is small ratio, search in the larger one O(mlogn)
-	//
-	//n>0 m=nk(0<k<1) 
-	//compare n(k+1) and nklogn: k0 = log(n/2)2 requiring that n>2
-	//k<=k0 binary search; k>k0 intersect
-	int method = -1; //0: intersect 1: search in list1 2: search in list2
-	unsigned n = _len1;
-	double k = 0;
-	if(n < _len2)
-	{
-		k = (double)n / (double)_len2;
-		n = _len2;
-		method = 2;
-	}
-	else
-	{
-		k = (double)_len2 / (double)n;
-		method = 1;
-	}
-	if(n <= 2)
-		method = 0;
-	else
-	{
-		double limit = Util::logarithm(n/2, 2);
-		if(k > limit)
-			method = 0;
-	}
-
-	switch(method)
-	{
-	case 0:
-	{   //this bracket is needed if vars are defined in case
-		unsigned id_i = 0;
-		unsigned num = _len1;
-		for(unsigned i = 0; i < num; ++i)
-		{
-			unsigned can_id = _list1[i];
-			while((id_i < _len2) && (_list2[id_i] < can_id))
-			{
-				id_i ++;
-			}
-
-			if(id_i == _len2)
-			{
-				break;
-			}
-
-			if(can_id == _list2[id_i])
-			{
-				res.push_back(can_id);
-				id_i ++;
-			}
-		}
-		break;
-	}
-	case 1:
-	{
-		for(unsigned i = 0; i < _len2; ++i)
-		{
-			if(Util::bsearch_int_uporder(_list2[i], _list1, _len1) != INVALID)
-				res.push_back(_list2[i]);
-		}
-		break;
-	}
-	case 2:
-	{
-		unsigned m = _len1, i;
-		for(i = 0; i < m; ++i)
-		{
-			unsigned t = _list1[i];
-			if(Util::bsearch_int_uporder(t, _list2, _len2) != INVALID)
-				res.push_back(t);
-		}
-		break;
-	}
-	default:
-		cerr << "no such method in Util::intersect()" << endl;
-		break;
-	}
-
-	_id_list_len = res.size();
-
-	if (_id_list_len == 0) {
-		_id_list = NULL;
-	}
-	else {
-		_id_list = new unsigned[_id_list_len];
-		for (unsigned i = 0; i < _id_list_len; ++i)
-			_id_list[i] = res[i];
+		//ListIntersect chooses among SIMD merge and galloping by the size ratio
+		unsigned* res = new unsigned[_len1 < _len2 ? _len1 : _len2];
+		_id_list_len = ListIntersect::intersect(_list1, _len1, _list2, _len2, res);
+		if (_id_list_len == 0)
+			delete[] res;
+		else
+			_id_list = res;
 	}
 	delete[] _list1;
 	delete[] _list2;
@@ -543,6 +543,21 @@ public:
 	}
 };
 
+//how the values of an IVArray/ISArray are laid out in blocks, see gcompact
+struct ValueLayout
+{
+	unsigned block_size;
+	unsigned long long values;
+	unsigned long long value_bytes;
+	//blocks used by the values, and the runs of adjacent blocks among them(one
+	//seek each when reading)
+	unsigned long long blocks;
+	unsigned long long runs;
+	unsigned long long file_blocks;
+	unsigned long long free_blocks;
+	unsigned long long free_extents;
+};
+
 class IVBlockInfo
 {
 public:
@@ -0,0 +1,158 @@
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(unsigned _worker_num)
+{
+	if (_worker_num == 0)
+		_worker_num = thread::hardware_concurrency();
+	if (_worker_num == 0)
+		_worker_num = 1;
+	this->worker_num = _worker_num;
+	this->ranges = new Range[_worker_num];
+	this->func = NULL;
+	this->generation = 0;
+	this->running = 0;
+	this->stop = false;
+	this->steal_num = 0;
+	for (unsigned i = 1; i < _worker_num; ++i)
+		this->threads.push_back(thread(&WorkStealingPool::workerLoop, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		lock_guard<mutex> lk(this->mtx);
+		this->stop = true;
+	}
+	this->start_cv.notify_all();
+	for (unsigned i = 0; i < this->threads.size(); ++i)
+		this->threads[i].join();
+	delete[] this->ranges;
+}
+
+void
+WorkStealingPool::run(unsigned long _task_num, const Task& _func)
+{
+	if (_task_num == 0)
+		return;
+	unsigned n = this->worker_num;
+	for (unsigned i = 0; i < n; ++i)
+	{
+		this->ranges[i].begin = _task_num * i / n;
+		this->ranges[i].end = _task_num * (i + 1) / n;
+	}
+	this->steal_num = 0;
+	this->func = &_func;
+	if (n > 1)
+	{
+		{
+			lock_guard<mutex> lk(this->mtx);
+			this->running = n - 1;
+			this->generation++;
+		}
+		this->start_cv.notify_all();
+	}
+
+	this->work(0);
+
+	if (n > 1)
+	{
+		unique_lock<mutex> lk(this->mtx);
+		while (this->running > 0)
+			this->done_cv.wait(lk);
+	}
+	this->func = NULL;
+}
+
+void
+WorkStealingPool::workerLoop(unsigned _id)
+{
+	unsigned long seen = 0;
+	while (true)
+	{
+		{
+			unique_lock<mutex> lk(this->mtx);
+			while (!this->stop && this->generation == seen)
+				this->start_cv.wait(lk);
+			if (this->stop)
+				return;
+			seen = this->generation;
+		}
+		this->work(_id);
+		{
+			lock_guard<mutex> lk(this->mtx);
+			if (--this->running == 0)
+				this->done_cv.notify_one();
+		}
+	}
+}
+
+void
+WorkStealingPool::work(unsigned _id)
+{
+	Range& own = this->ranges[_id];
+	while (true)
+	{
+		own.lock.lock();
+		if (own.begin < own.end)
+		{
+			unsigned long task = own.begin++;
+			own.lock.unlock();
+			(*this->func)(_id, task);
+			continue;
+		}
+		own.lock.unlock();
+		if (!this->steal(_id))
+			break;
+	}
+}
+
+bool
+WorkStealingPool::steal(unsigned _id)
+{
+	while (true)
+	{
+		//pick the victim with the most tasks left, the sizes are read without lock
+		//and checked again after locking
+		unsigned victim = _id;
+		unsigned long most = 0;
+		for (unsigned i = 0; i < this->worker_num; ++i)
+		{
+			if (i == _id)
+				continue;
+			unsigned long b = this->ranges[i].begin.load(memory_order_relaxed);
+			unsigned long e = this->ranges[i].end.load(memory_order_relaxed);
+			if (e > b && e - b > most)
+			{
+				most = e - b;
+				victim = i;
+			}
+		}
+		if (victim == _id)
+			return false;
+
+		Range& from = this->ranges[victim];
+		unsigned long b = 0, e = 0;
+		from.lock.lock();
+		if (from.begin < from.end)
+		{
+			//take the back half, at least one task
+			unsigned long mid = from.begin + (from.end - from.begin) / 2;
+			b = mid;
+			e = from.end;
+			from.end = mid;
+		}
+		from.lock.unlock();
+		if (b == e)
+			continue;
+
+		Range& own = this->ranges[_id];
+		own.lock.lock();
+		own.begin = b;
+		own.end = e;
+		own.lock.unlock();
+		this->steal_num += e - b;
+		return true;
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef _UTIL_WORKSTEALINGPOOL_H
+#define _UTIL_WORKSTEALINGPOOL_H
+
+#include "Util.h"
+#include "SpinLock.h"
+
+//A fork-join pool for data parallel loops over many small tasks(morsels).
+//run() splits the task range evenly among the workers, each worker takes tasks
+//from the front of its own range, and when it runs out it steals the back half
+//of the largest remaining range of another worker, so skewed morsels do not
+//leave threads idle. The calling thread works as worker 0.
+class WorkStealingPool
+{
+public:
+	//the task function gets the worker id(0 to getWorkerNum()-1) and the task id
+	typedef std::function<void(unsigned, unsigned long)> Task;
+
+	//_worker_num 0 means the number of cores
+	WorkStealingPool(unsigned _worker_num);
+	~WorkStealingPool();
+
+	unsigned getWorkerNum() const { return this->worker_num; }
+	//run _func on tasks 0 to _task_num-1, return when all are done
+	//NOTICE: only one run() at a time, do not call it from a task
+	void run(unsigned long _task_num, const Task& _func);
+	//number of tasks taken from other workers in the last run()
+	unsigned long getStealNum() const { return this->steal_num; }
+
+private:
+	struct Range
+	{
+		//changed under lock, atomic only to be peeked without lock by thieves
+		spinlock lock;
+		std::atomic<unsigned long> begin;
+		std::atomic<unsigned long> end;
+	};
+
+	WorkStealingPool(const WorkStealingPool&);
+	WorkStealingPool& operator=(const WorkStealingPool&);
+
+	void workerLoop(unsigned _id);
+	void work(unsigned _id);
+	bool steal(unsigned _id);
+
+	unsigned worker_num;
+	std::vector<std::thread> threads;
+	Range* ranges;
+	const Task* func;
+
+	std::mutex mtx;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	unsigned long generation;
+	unsigned running;
+	bool stop;
+	std::atomic<unsigned long> steal_num;
+};
+
+#endif //_UTIL_WORKSTEALINGPOOL_H
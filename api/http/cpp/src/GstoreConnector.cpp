@@ -515,6 +515,59 @@ void GstoreConnector::fquery(std::string db_name, std::string format, std::strin
 	return;
 }
 
+std::string GstoreConnector::prepare(std::string db_name, std::string sparql, std::string request_type)
+{
+	std::string res;
+	if (request_type == "GET")
+	{
+		std::string strUrl = this->Url + "?operation=prepare&username=" + this->username + "&password=" + this->password + "&db_name=" + db_name + "&sparql=" + sparql;
+		this->Get(strUrl, res);
+	}
+	else if (request_type == "POST")
+	{
+		std::string strPost = "{\"operation\": \"prepare\", \"username\": \"" + this->username + "\", \"password\": \"" + this->password + "\", \"db_name\": \"" + db_name + "\", \"sparql\": \"" + sparql + "\"}";
+		this->Post(this->Url, strPost, res);
+	}
+	return res;
+}
+
+//the terms are mostly quoted literals, so the params are escaped as JSON strings
+static std::string jsonString(const std::string& str)
+{
+	std::string ret = "\"";
+	for (size_t i = 0; i < str.length(); ++i)
+	{
+		if (str[i] == '"' || str[i] == '\\')
+			ret += '\\';
+		ret += str[i];
+	}
+	return ret + "\"";
+}
+
+std::string GstoreConnector::execute(std::string db_name, std::string format, std::string stmt_id, const std::map<std::string, std::string>& params, std::string request_type)
+{
+	std::string strParams = "{";
+	for (std::map<std::string, std::string>::const_iterator it = params.begin(); it != params.end(); ++it)
+	{
+		if (it != params.begin())
+			strParams += ", ";
+		strParams += jsonString(it->first) + ": " + jsonString(it->second);
+	}
+	strParams += "}";
+	std::string res;
+	if (request_type == "GET")
+	{
+		std::string strUrl = this->Url + "?operation=execute&username=" + this->username + "&password=" + this->password + "&db_name=" + db_name + "&format=" + format + "&stmt_id=" + stmt_id + "&params=" + strParams;
+		this->Get(strUrl, res);
+	}
+	else if (request_type == "POST")
+	{
+		std::string strPost = "{\"operation\": \"execute\", \"username\": \"" + this->username + "\", \"password\": \"" + this->password + "\", \"db_name\": \"" + db_name + "\", \"format\": \"" + format + "\", \"stmt_id\": \"" + stmt_id + "\", \"params\": " + strParams + "}";
+		this->Post(this->Url, strPost, res);
+	}
+	return res;
+}
+
 std::string GstoreConnector::exportDB(std::string db_name, std::string db_path, std::string request_type)
 {
 	std::string res;
@@ -18,6 +18,7 @@
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <map>
 
 #define defaultServerIP "127.0.0.1"
 #define defaultServerPort 9000
@@ -93,6 +94,10 @@ public:
 	std::string restore(std::string db_name, std::string backup_path, std::string request_type = "GET");
 	std::string query(std::string db_name, std::string format, std::string sparql, std::string request_type = "GET");
 	void fquery(std::string db_name, std::string format, std::string sparql, std::string filename, std::string request_type = "GET");
+	//prepared statements: sparql has $name placeholders, and params gives the RDF term of each one at execution,
+	//i.e. {"$name", "<http://example.org/a>"} or {"$age", "\"30\"^^<http://www.w3.org/2001/XMLSchema#integer>"}
+	std::string prepare(std::string db_name, std::string sparql, std::string request_type = "GET");
+	std::string execute(std::string db_name, std::string format, std::string stmt_id, const std::map<std::string, std::string>& params, std::string request_type = "GET");
 	std::string exportDB(std::string db_name, std::string db_path, std::string request_type = "GET");
 	std::string login(std::string request_type = "GET");
 	std::string check(std::string request_type = "GET");
@@ -16,11 +16,11 @@ num_ans=(8 0 4 1)
 small_ans=(2 2 1 27 1 1 1 4 1 5 5)
 triple_num=(1988 99550 29 25 31)
 
-#gbuild
-echo "gbuild......"
+#gbuild, the arguments are passed to gbuild(i.e. "-c 1" to compress the id lists)
+gbuild(){
 for i in 0 1 2 3
 do
-	${op[0]} ${db[$i]} ${path}${db[$i]}"/"${db[$i]}".nt" > "1.txt" 2>&1
+	${op[0]} -db ${db[$i]} -f ${path}${db[$i]}"/"${db[$i]}".nt" "$@" > "1.txt" 2>&1
 	"rm" "1.txt"
 	if test -e ${db[$i]}.db/success.txt
 	then
@@ -31,6 +31,9 @@ do
 		exit
 	fi
 done
+}
+echo "gbuild......"
+gbuild
 
 #gadd and gsub
 # First sub all triples from the database, then add back
@@ -39,10 +42,10 @@ for i in 0 1 2 3
 do
 	for j in 3 2
 	do
-        	${op[$j]} ${db[$i]} ${path}${db[$i]}"/"${db[$i]}".nt" > "1.txt"
+        	${op[$j]} -db ${db[$i]} -f ${path}${db[$i]}"/"${db[$i]}".nt" > "1.txt"
 		"rm" "1.txt"
 	done
-	${op[1]} ${db[$i]} ${path}"all.sql" > "1.txt"
+	${op[1]} -db ${db[$i]} -q ${path}"all.sql" > "1.txt"
 	ans=$(grep "There has answer" 1.txt)
 	if [ ${ans:18:${#ans}-18} -ne ${triple_num[$i]} ]
 	then
@@ -60,7 +63,7 @@ gquery(){
 for i in 0 1 2 3 4 5 6 7
 do
 	echo "${op[1]} ${db[0]} ${path}${db[0]}/${db[0]}${bbug_sql[$i]}.sql"
-	${op[1]} ${db[0]} ${path}${db[0]}"/"${db[0]}${bbug_sql[$i]}".sql" > "1.txt" 
+	${op[1]} -db ${db[0]} -q ${path}${db[0]}"/"${db[0]}${bbug_sql[$i]}".sql" > "1.txt" 
 	if [ ${bbug_ans[$i]} -ne -1 ]
 	then
 		ans=$(grep "There has answer" 1.txt)
@@ -78,7 +81,7 @@ done
 for i in 0 1 2 3 4 5 6 7 8 9 10
 do
     echo "${op[1]} ${db[1]} ${path}${db[1]}/${db[1]}${lubm_sql[$i]}.sql"
-    ${op[1]} ${db[1]} ${path}${db[1]}"/"${db[1]}${lubm_sql[$i]}".sql" > "1.txt"
+    ${op[1]} -db ${db[1]} -q ${path}${db[1]}"/"${db[1]}${lubm_sql[$i]}".sql" > "1.txt"
 	ans=$(grep "There has answer" 1.txt)
 	if [ ${ans:18:${#ans}-18} -ne ${lubm_ans[$i]} ]
 	then
@@ -93,7 +96,7 @@ done
 for i in 0 1 2 3
 do
         echo "${op[1]} ${db[2]} ${path}${db[2]}/${db[2]}${num_sql[$i]}"
-        ${op[1]} ${db[2]} ${path}${db[2]}"/"${db[2]}${num_sql[$i]}".sql" > "1.txt"
+        ${op[1]} -db ${db[2]} -q ${path}${db[2]}"/"${db[2]}${num_sql[$i]}".sql" > "1.txt"
         ans=$(grep "There has answer" 1.txt)
         if [ ${ans:18:${#ans}-18} -ne ${num_ans[$i]} ]
         then
@@ -108,7 +111,7 @@ done
 for i in 0 1 2 3 4 5 6 7 8 9 10
 do
         echo "${op[1]} ${db[3]} ${path}${db[3]}/${db[3]}${small_sql[$i]}"
-        ${op[1]} ${db[3]} ${path}${db[3]}"/"${db[3]}${small_sql[$i]}".sql" > "1.txt"
+        ${op[1]} -db ${db[3]} -q ${path}${db[3]}"/"${db[3]}${small_sql[$i]}".sql" > "1.txt"
         ans=$(grep "There has answer" 1.txt)
         if [ ${ans:18:${#ans}-18} -ne ${small_ans[$i]} ]
         then
@@ -123,9 +126,9 @@ done
 echo "gquery......"
 gquery
 
-${op[2]} ${db[3]} ${path}${db[3]}"/small_add.nt" > "1.txt"
+${op[2]} -db ${db[3]} -f ${path}${db[3]}"/small_add.nt" > "1.txt"
 "rm" "1.txt"
-${op[1]} ${db[3]} ${path}"all.sql" > "1.txt"
+${op[1]} -db ${db[3]} -q ${path}"all.sql" > "1.txt"
 ans=$(grep "There has answer" 1.txt)
 if [ ${ans:18:${#ans}-18} -ne ${triple_num[4]} ]
 then
@@ -135,9 +138,9 @@ then
 fi
 "rm" "1.txt"
 
-${op[3]} ${db[3]} ${path}${db[3]}"/small_add.nt" > "1.txt"
+${op[3]} -db ${db[3]} -f ${path}${db[3]}"/small_add.nt" > "1.txt"
 "rm" "1.txt"
-${op[1]} ${db[3]} ${path}"all.sql" > "1.txt"
+${op[1]} -db ${db[3]} -q ${path}"all.sql" > "1.txt"
 ans=$(grep "There has answer" 1.txt)
 if [ ${ans:18:${#ans}-18} -ne ${triple_num[3]} ]
 then
@@ -148,10 +151,10 @@ fi
 "rm" "1.txt"
 
 #gdrop
-echo "gdrop......"
+gdrop(){
 for i in 0 1 2 3
 do
-	${op[4]} ${db[$i]} > "1.txt" 2>&1
+	${op[4]} -db ${db[$i]} > "1.txt" 2>&1
 	"rm" "1.txt"
 	if test -e ${db[$i]}.db
 	then
@@ -159,5 +162,16 @@ do
 		exit
 	fi
 done
+}
+echo "gdrop......"
+gdrop
+
+#the same queries on the databases with the id lists compressed
+echo "gbuild -c 1......"
+gbuild -c 1
+echo "gquery on compressed id lists......"
+gquery
+echo "gdrop......"
+gdrop
 
 echo "Test passed!"
\ No newline at end of file
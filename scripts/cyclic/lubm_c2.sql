@@ -0,0 +1,9 @@
+select ?x ?y ?z where
+{
+?x	<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#Student>.
+?y	<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#Faculty>.
+?z	<http://www.w3.org/1999/02/22-rdf-syntax-ns#type>	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#Course>.
+?x	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#advisor>	?y.
+?y	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#teacherOf>	?z.
+?x	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#takesCourse>	?z.
+}
@@ -0,0 +1,6 @@
+select ?x ?y ?z where
+{
+?x	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#memberOf>	?z.
+?y	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#worksFor>	?z.
+?x	<http://www.lehigh.edu/~zhp2/2004/0401/univ-bench.owl#advisor>	?y.
+}
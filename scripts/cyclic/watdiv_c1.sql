@@ -0,0 +1,8 @@
+select ?u ?p ?r where
+{
+?u	<http://db.uwaterloo.ca/~galuc/wsdbm/likes>	?p.
+?r	<http://purl.org/goodrelations/offers>	?o.
+?o	<http://purl.org/goodrelations/includes>	?p.
+?u	<http://db.uwaterloo.ca/~galuc/wsdbm/follows>	?f.
+?f	<http://db.uwaterloo.ca/~galuc/wsdbm/likes>	?p.
+}
@@ -0,0 +1,6 @@
+select ?a ?b ?c where
+{
+?a	<http://db.uwaterloo.ca/~galuc/wsdbm/follows>	?b.
+?b	<http://db.uwaterloo.ca/~galuc/wsdbm/follows>	?c.
+?a	<http://db.uwaterloo.ca/~galuc/wsdbm/friendOf>	?c.
+}
@@ -0,0 +1,7 @@
+select ?a ?b ?c ?d where
+{
+?a	<http://db.uwaterloo.ca/~galuc/wsdbm/friendOf>	?b.
+?b	<http://db.uwaterloo.ca/~galuc/wsdbm/friendOf>	?c.
+?c	<http://db.uwaterloo.ca/~galuc/wsdbm/friendOf>	?d.
+?d	<http://db.uwaterloo.ca/~galuc/wsdbm/friendOf>	?a.
+}
@@ -0,0 +1,39 @@
+#!/bin/bash
+# compare leapfrog-join with multi-join on cyclic queries of LUBM and WatDiv
+# usage: scripts/cyclic_test.sh [lubm_db] [watdiv_db]
+# the databases must be built before, i.e. bin/gbuild -db lubm -f lubm.nt
+# run it in the root directory of gStore, init.conf is restored at the end
+# queries: scripts/cyclic/lubm_c*.sql(LUBM Q2, Q9 and a memberOf-worksFor-advisor triangle)
+#          scripts/cyclic/watdiv_c*.sql(user-product-retailer cycle, follows/friendOf triangle, 4-cycle)
+
+lubm_db=${1:-lubm}
+watdiv_db=${2:-watdiv}
+query_dir=scripts/cyclic
+log_dir=cyclic_result
+mkdir -p $log_dir
+
+cp init.conf init.conf.bak
+run()
+{
+	db=$1
+	query=$2
+	name=$(basename $query .sql)
+	for mode in true false
+	do
+		sed -i '/^leapfrog_join/d' init.conf
+		echo "leapfrog_join = $mode" >> init.conf
+		bin/gquery -db $db -q $query > $log_dir/$name.$mode.txt 2>&1
+		time_used=$(grep "Total time used" $log_dir/$name.$mode.txt | tail -n 1)
+		result=$(grep "Final result size" $log_dir/$name.$mode.txt | tail -n 1)
+		echo -e "$name\tleapfrog=$mode\t$time_used\t$result"
+	done
+}
+
+if [ -d $lubm_db.db ]; then
+	for q in $query_dir/lubm_c*.sql; do run $lubm_db $q; done
+fi
+if [ -d $watdiv_db.db ]; then
+	for q in $query_dir/watdiv_c*.sql; do run $watdiv_db $q; done
+fi
+mv init.conf.bak init.conf
+echo "cyclic queries tested"
@@ -0,0 +1,152 @@
+/*
+  This benchmark compares the intersection kernels of ListIntersect with the
+  previous IDList::intersectList(merge or binary search chosen by a size ratio).
+  Usage: scripts/intersect_bench [short_len] [rounds]
+  It runs a set of size ratios and densities, and checks that all kernels agree.
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../Util/ListIntersect.h"
+
+using namespace std;
+
+//the former IDList::intersectList(), kept here as the baseline
+static unsigned
+legacy_intersect(const unsigned* _list1, unsigned _len1, const unsigned* _list2, unsigned _len2, unsigned* _out)
+{
+	int method = -1;
+	unsigned n = _len1;
+	double k = 0;
+	if (n < _len2)
+	{
+		k = (double)n / (double)_len2;
+		n = _len2;
+		method = 2;
+	}
+	else
+	{
+		k = (double)_len2 / (double)n;
+		method = 1;
+	}
+	if (n <= 2)
+		method = 0;
+	else
+	{
+		double limit = Util::logarithm(n / 2, 2);
+		if (k > limit)
+			method = 0;
+	}
+
+	unsigned c = 0;
+	if (method == 0)
+	{
+		unsigned id_i = 0;
+		for (unsigned i = 0; i < _len1; ++i)
+		{
+			unsigned can_id = _list1[i];
+			while (id_i < _len2 && _list2[id_i] < can_id)
+				id_i++;
+			if (id_i == _len2)
+				break;
+			if (can_id == _list2[id_i])
+			{
+				_out[c++] = can_id;
+				id_i++;
+			}
+		}
+	}
+	else if (method == 1)
+	{
+		for (unsigned i = 0; i < _len2; ++i)
+			if (Util::bsearch_int_uporder(_list2[i], _list1, _len1) != INVALID)
+				_out[c++] = _list2[i];
+	}
+	else
+	{
+		for (unsigned i = 0; i < _len1; ++i)
+			if (Util::bsearch_int_uporder(_list1[i], _list2, _len2) != INVALID)
+				_out[c++] = _list1[i];
+	}
+	return c;
+}
+
+static void
+gen_list(vector<unsigned>& _list, unsigned _len, unsigned _range, mt19937& _rng)
+{
+	_list.clear();
+	for (unsigned i = 0; i < _len; ++i)
+		_list.push_back(_rng() % _range);
+	sort(_list.begin(), _list.end());
+	_list.erase(unique(_list.begin(), _list.end()), _list.end());
+}
+
+typedef unsigned (*IntersectFunc)(const unsigned*, unsigned, const unsigned*, unsigned, unsigned*);
+
+static double
+run(IntersectFunc _func, const vector<unsigned>& _a, const vector<unsigned>& _b, vector<unsigned>& _out, unsigned _rounds, unsigned& _num)
+{
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for (unsigned r = 0; r < _rounds; ++r)
+		_num = _func(&_a[0], _a.size(), &_b[0], _b.size(), &_out[0]);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	return chrono::duration_cast<chrono::microseconds>(end - begin).count() / (double)_rounds;
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned short_len = argc > 1 ? atoi(argv[1]) : 10000;
+	unsigned rounds = argc > 2 ? atoi(argv[2]) : 100;
+	unsigned ratios[] = { 1, 4, 16, 64, 256 };
+	//density: the id range is this times the long list length
+	unsigned densities[] = { 2, 16 };
+	mt19937 rng(2021);
+
+	cout << "detected kernel: " << ListIntersect::kernelName(ListIntersect::detectKernel()) << endl;
+	cout << "ratio\tdensity\tshort\tlong\tresult\tlegacy(us)\tscalar\tgallop\tsse4\tavx2\tauto" << endl;
+	for (unsigned ri = 0; ri < sizeof(ratios) / sizeof(unsigned); ++ri)
+	{
+		for (unsigned di = 0; di < sizeof(densities) / sizeof(unsigned); ++di)
+		{
+			vector<unsigned> a, b;
+			unsigned long_len = short_len * ratios[ri];
+			gen_list(a, short_len, long_len * densities[di], rng);
+			gen_list(b, long_len, long_len * densities[di], rng);
+			vector<unsigned> out(a.size() < b.size() ? a.size() : b.size());
+			vector<unsigned> ref;
+
+			IntersectFunc funcs[] = { legacy_intersect, ListIntersect::intersectScalar, ListIntersect::intersectGallop,
+				ListIntersect::intersectSSE, ListIntersect::intersectAVX2, ListIntersect::intersect };
+			cout << ratios[ri] << "\t" << densities[di] << "\t" << a.size() << "\t" << b.size();
+			double cost[6];
+			unsigned num = 0;
+			for (unsigned f = 0; f < 6; ++f)
+			{
+				//skip the kernels this cpu can not run
+				if ((f == 3 && ListIntersect::detectKernel() < ListIntersect::KERNEL_SSE) ||
+					(f == 4 && ListIntersect::detectKernel() < ListIntersect::KERNEL_AVX2))
+				{
+					cost[f] = -1;
+					continue;
+				}
+				cost[f] = run(funcs[f], a, b, out, rounds, num);
+				if (f == 0)
+				{
+					ref.assign(out.begin(), out.begin() + num);
+					cout << "\t" << num;
+				}
+				else if (num != ref.size() || !equal(ref.begin(), ref.end(), out.begin()))
+					cout << endl << "error: kernel " << f << " differs from the legacy one" << endl;
+			}
+			for (unsigned f = 0; f < 6; ++f)
+				cout << "\t" << cost[f];
+			cout << endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*
+  This benchmark measures concurrent IVArray::search throughput through the
+  sharded CLOCK value cache.
+  Usage: scripts/ivarray_bench [key_num] [cache_mb] [reads_per_thread] [max_threads]
+  It builds an array of key_num values(16 to 512 bytes) in ./ivarray_bench_tmp,
+  reopens it with a cache of cache_mb MB, and runs 1, 2, 4, ... max_threads
+  readers with a skewed key distribution(90% of reads go to 10% of the keys).
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../KVstore/IVArray/IVArray.h"
+
+using namespace std;
+
+static const string BENCH_DIR = "ivarray_bench_tmp";
+
+static void
+reader(IVArray* _array, unsigned _key_num, unsigned long _reads, unsigned _seed, unsigned long& _bytes)
+{
+	mt19937 rng(_seed);
+	unsigned hot = _key_num / 10 > 0 ? _key_num / 10 : 1;
+	_bytes = 0;
+	for (unsigned long i = 0; i < _reads; ++i)
+	{
+		unsigned key = rng() % 10 < 9 ? rng() % hot : rng() % _key_num;
+		char* str = NULL;
+		unsigned long len = 0;
+		if (_array->search(key, str, len))
+		{
+			_bytes += len;
+			delete[] str;
+		}
+	}
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned key_num = argc > 1 ? atoi(argv[1]) : 1000000;
+	unsigned long long cache_mb = argc > 2 ? atoi(argv[2]) : 64;
+	unsigned long reads = argc > 3 ? atol(argv[3]) : 2000000;
+	unsigned max_threads = argc > 4 ? atoi(argv[4]) : thread::hardware_concurrency();
+	if (max_threads == 0)
+		max_threads = 1;
+
+	Util::create_dir(BENCH_DIR);
+	mt19937 rng(2021);
+	IVArray* array = new IVArray(BENCH_DIR, "bench", "build", cache_mb << 20, key_num);
+	for (unsigned key = 0; key < key_num; ++key)
+	{
+		unsigned long len = 16 + rng() % 497;
+		char* str = new char[len];
+		memset(str, key & 0xff, len);
+		array->insert(key, str, len);
+	}
+	array->save();
+	delete array;
+
+	array = new IVArray(BENCH_DIR, "bench", "open", cache_mb << 20);
+	cout << "keys: " << key_num << ", cache: " << cache_mb << "MB, reads per thread: " << reads << endl;
+	cout << "threads\tMreads/s\thits\tmisses\tevictions" << endl;
+	for (unsigned n = 1; n <= max_threads; n *= 2)
+	{
+		unsigned long long hits0, misses0, evictions0;
+		array->getCacheStats(hits0, misses0, evictions0);
+		vector<thread> threads;
+		vector<unsigned long> bytes(n);
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		for (unsigned t = 0; t < n; ++t)
+			threads.push_back(thread(reader, array, key_num, reads, 7 * t + 1, ref(bytes[t])));
+		for (unsigned t = 0; t < n; ++t)
+			threads[t].join();
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double sec = chrono::duration_cast<chrono::microseconds>(end - begin).count() / 1e6;
+
+		unsigned long long hits, misses, evictions;
+		array->getCacheStats(hits, misses, evictions);
+		cout << n << "\t" << n * reads / sec / 1e6 << "\t" << hits - hits0 << "\t" << misses - misses0
+			<< "\t" << evictions - evictions0 << endl;
+	}
+	delete array;
+
+	string cmd = "rm -rf " + BENCH_DIR;
+	system(cmd.c_str());
+	return 0;
+}
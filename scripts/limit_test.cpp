@@ -0,0 +1,95 @@
+/*=============================================================================
+# Filename: limit_test.cpp
+# Author: gStore
+# Last Modified: 2026-10-18
+# Description: used to test the rows of a query with LIMIT, which are joined only until there are enough
+=============================================================================*/
+
+#include "../Util/Util.h"
+#include "../Database/Database.h"
+
+using namespace std;
+
+typedef vector<string> row;
+
+//the rows of the query, false if any is repeated
+bool run_query(Database* _db, const string& _query, set<row>& _rows, unsigned& _num)
+{
+	ResultSet _rs;
+	FILE* ofp = NULL;
+	_db->query(_query, _rs, ofp);
+	_num = _rs.ansNum;
+	for (unsigned i = 0; i < _rs.ansNum; i++)
+	{
+		row r(_rs.answer[i], _rs.answer[i] + _rs.true_select_var_num);
+		if (!_rows.insert(r).second)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char * argv[])
+{
+	Util util;
+	string db_name = "limit_test";
+	string db_path = "limit_test.nt";
+	string cmd = "rm -r " + db_name + ".db " + db_path;
+
+	//x-p-y-q-z chains, many rows of ?x to join ?y then ?z for, in several morsels
+	ofstream f(db_path.c_str());
+	for (int i = 0; i < 3000; i++)
+		f << "<x" << i << "> <p> <y" << i % 500 << "> ." << endl;
+	for (int i = 0; i < 500; i++)
+	{
+		f << "<y" << i << "> <q> <z" << i % 50 << "> ." << endl;
+		f << "<y" << i << "> <q> \"z" << (i + 1) % 50 << "\" ." << endl;
+	}
+	f.close();
+
+	//build database
+	Database* db = new Database(db_name);
+	if (!db->build(db_path))
+	{
+		cerr << db_name + ".db is built failed." << endl;
+		delete db;
+		system(cmd.c_str());
+		return -1;
+	}
+	delete db;
+	db = new Database(db_name);
+	db->load();
+
+	string bgp = "select ?x ?y ?z where{?x <p> ?y. ?y <q> ?z.}";
+	set<row> all_rows;
+	unsigned all_num;
+	if (!run_query(db, bgp, all_rows, all_num) || all_num != 6000)
+	{
+		cerr << "The query without LIMIT has " << all_num << " rows, 6000 expected." << endl;
+		delete db;
+		system(cmd.c_str());
+		return -1;
+	}
+
+	unsigned limits[] = { 1, 10, 1500, 5999, 7000 };
+	for (unsigned i = 0; i < sizeof(limits) / sizeof(limits[0]); i++)
+	{
+		set<row> rows;
+		unsigned num;
+		bool flag = run_query(db, bgp + " LIMIT " + Util::int2string(limits[i]), rows, num);
+		flag = flag && num == min(limits[i], all_num);
+		for (set<row>::iterator it = rows.begin(); flag && it != rows.end(); it++)
+			flag = all_rows.count(*it) > 0;
+		if (!flag)
+		{
+			cerr << "The query with LIMIT " << limits[i] << " has wrong rows." << endl;
+			delete db;
+			system(cmd.c_str());
+			return -1;
+		}
+	}
+
+	delete db;
+	system(cmd.c_str());
+	cerr << "Limit test passed." << endl;
+	return 0;
+}
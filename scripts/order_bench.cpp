@@ -0,0 +1,119 @@
+/*
+  This benchmark compares the ways to order a big result for ORDER BY.
+  Usage: scripts/order_bench [row_num] [parallelism]
+  It builds a result of row_num rows: an IRI, an integer literal with many
+  duplicates and a string literal, ordered by the integer descending and then
+  by the IRI, and reports the time of:
+    stream: the rows written to a Stream and sorted there, as ORDER BY did
+            before, the first rows read back
+    sort: ResultOrder sorting all rows with 1 thread and with parallelism
+          threads(0 for all cores)
+    top-k: ResultOrder keeping the first 20 and 10000 rows in a bounded heap
+  The keys of the rows given by each way are checked to be the same.
+*/
+#include <iostream>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../Util/Stream.h"
+#include "../Util/ResultOrder.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static long
+elapsed(Clock::time_point _begin)
+{
+	return chrono::duration_cast<chrono::milliseconds>(Clock::now() - _begin).count();
+}
+
+//the key values are added while timing, as GeneralEvaluation does after decoding them
+static void
+runOrder(vector<string*>& _rows, unsigned long long _k, unsigned _parallelism, vector<unsigned>& _order, const char* _name)
+{
+	Clock::time_point begin = Clock::now();
+	vector<bool> desc;
+	desc.push_back(true);
+	desc.push_back(false);
+	ResultOrder result_order(desc, _rows.size());
+	for (unsigned i = 0; i < _rows.size(); ++i)
+	{
+		result_order.setKey(i, 0, result_order.addValue(_rows[i][1]));
+		result_order.setKey(i, 1, result_order.addValue(_rows[i][0]));
+	}
+	long add_ms = elapsed(begin);
+	result_order.order(_k, _parallelism, _order);
+	cout << _name << "\t" << elapsed(begin) << "\t" << add_ms << "\t" << _order.size() << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned row_num = argc > 1 ? atoi(argv[1]) : 1000000;
+	unsigned parallelism = argc > 2 ? atoi(argv[2]) : 0;
+	const unsigned col_num = 3;
+
+	vector<string*> rows(row_num);
+	srand(1);
+	for (unsigned i = 0; i < row_num; ++i)
+	{
+		rows[i] = new string[col_num];
+		rows[i][0] = "<http://example.org/resource/r" + Util::int2string(rand() % row_num) + ">";
+		rows[i][1] = "\"" + Util::int2string(rand() % (row_num / 10 + 1)) + "\"^^<http://www.w3.org/2001/XMLSchema#integer>";
+		rows[i][2] = "\"name " + Util::int2string(i) + "\"";
+	}
+	cout << "rows: " << row_num << endl;
+	cout << "way\tms\tkeys ms\trows" << endl;
+
+	//the first rows of the stream, to check the others against
+	const unsigned check_num = 10000;
+	vector<string*> expected;
+	{
+		Clock::time_point begin = Clock::now();
+		vector<unsigned> keys;
+		keys.push_back(1);
+		keys.push_back(0);
+		vector<bool> desc;
+		desc.push_back(true);
+		desc.push_back(false);
+		Stream stream(keys, desc, row_num, col_num, true);
+		for (unsigned i = 0; i < row_num; ++i)
+			for (unsigned j = 0; j < col_num; ++j)
+				stream.write(rows[i][j].c_str(), rows[i][j].length());
+		stream.setEnd();
+		for (unsigned i = 0; i < row_num && i < check_num; ++i)
+		{
+			const Bstr* bp = stream.read();
+			string* row = new string[2];
+			row[0] = string(bp[0].getStr(), bp[0].getLen());
+			row[1] = string(bp[1].getStr(), bp[1].getLen());
+			expected.push_back(row);
+		}
+		cout << "stream\t" << elapsed(begin) << "\t-\t" << row_num << endl;
+	}
+
+	vector<unsigned> order;
+	unsigned long long ks[] = { row_num, row_num, 20, 10000 };
+	unsigned threads[] = { 1, parallelism, parallelism, parallelism };
+	const char* names[] = { "sort 1", "sort n", "top-20", "top-10000" };
+	for (unsigned t = 0; t < 4; ++t)
+	{
+		runOrder(rows, ks[t], threads[t], order, names[t]);
+		for (unsigned i = 0; i < order.size() && i < expected.size(); ++i)
+		{
+			//rows with the same keys may be in another order in the stream, so only keys are checked
+			string* row = rows[order[i]];
+			if (row[0] != expected[i][0] || row[1] != expected[i][1])
+			{
+				cout << names[t] << ": row " << i << " differs from the stream" << endl;
+				break;
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < row_num; ++i)
+		delete[] rows[i];
+	for (unsigned i = 0; i < expected.size(); ++i)
+		delete[] expected[i];
+	return 0;
+}
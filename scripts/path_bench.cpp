@@ -0,0 +1,174 @@
+/*
+  This benchmark compares the path queries of PathQueryHandler on a graph.
+  Usage: scripts/path_bench db_name|graph_file [pair_num] [k] [max_threads]
+  The graph is the CSR of a built database(i.e. LUBM or WatDiv), or a graph
+  file in the format of PathQueryHandler::inputGraph. pair_num random pairs
+  of a subject and an object are queried with all predicates, directed, by:
+    map-bfs: shortestPath0 and kHopReachableTest, BFS with std::map routes
+    frontier-bfs: shortestPath and kHopReachable, the bitmap-frontier BFS, with
+                  1, 2, 4, ... max_threads threads(query_parallelism)
+  reporting the average time per query and the number of paths or reachable
+  pairs found, which must be the same in all the modes.
+  Then kHopReachable is asked for all the pairs of the sources x the targets,
+  as for the bindings of a SPARQL query, one pair at a time and in one
+  batchDistance(the multi-source BFS), reporting the total time.
+*/
+#include <iostream>
+#include <random>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../Database/Database.h"
+#include "../Query/PathQueryHandler.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static double
+elapsedMs(Clock::time_point _begin)
+{
+	return chrono::duration_cast<chrono::microseconds>(Clock::now() - _begin).count() / 1000.0;
+}
+
+static void
+run(CSR* _csr, const string& _mode, unsigned _threads, const vector<pair<int, int> >& _pairs, int _k, const vector<int>& _preds)
+{
+	Util::global_config["query_parallelism"] = Util::int2string(_threads);
+	PathQueryHandler handler(_csr);
+	bool frontier = _mode == "frontier-bfs";
+	unsigned long total_len = 0, found = 0, reachable = 0;
+	Clock::time_point begin = Clock::now();
+	for (unsigned i = 0; i < _pairs.size(); ++i)
+	{
+		vector<int> path = frontier ? handler.shortestPath(_pairs[i].first, _pairs[i].second, true, _preds)
+			: handler.shortestPath0(_pairs[i].first, _pairs[i].second, true, _preds);
+		if (!path.empty())
+		{
+			found++;
+			total_len += path.size() / 2;
+		}
+	}
+	double path_ms = elapsedMs(begin);
+	begin = Clock::now();
+	for (unsigned i = 0; i < _pairs.size(); ++i)
+	{
+		bool res = frontier ? handler.kHopReachable(_pairs[i].first, _pairs[i].second, true, _k, _preds)
+			: handler.kHopReachableTest(_pairs[i].first, _pairs[i].second, true, _k, _preds);
+		if (res)
+			reachable++;
+	}
+	double reach_ms = elapsedMs(begin);
+	cout << _mode << "\t" << _threads << "\t" << path_ms / _pairs.size() << "\t" << reach_ms / _pairs.size()
+		<< "\t" << found << "(" << total_len << " hops)\t" << reachable << endl;
+}
+
+static void
+runBatch(CSR* _csr, unsigned _threads, const vector<pair<int, int> >& _pairs, int _k, const vector<int>& _preds)
+{
+	Util::global_config["query_parallelism"] = Util::int2string(_threads);
+	PathQueryHandler handler(_csr);
+	vector<int> uids, vids;
+	for (unsigned i = 0; i < _pairs.size(); ++i)
+	{
+		uids.push_back(_pairs[i].first);
+		vids.push_back(_pairs[i].second);
+	}
+	unsigned long reachable = 0;
+	Clock::time_point begin = Clock::now();
+	for (unsigned i = 0; i < uids.size(); ++i)
+	{
+		for (unsigned j = 0; j < vids.size(); ++j)
+		{
+			if (handler.kHopReachable(uids[i], vids[j], true, _k, _preds))
+				reachable++;
+		}
+	}
+	cout << "pairwise	" << elapsedMs(begin) << "	" << reachable << endl;
+
+	reachable = 0;
+	begin = Clock::now();
+	vector<int> dist;
+	handler.batchDistance(uids, vids, true, _k, _preds, dist);
+	for (unsigned i = 0; i < dist.size(); ++i)
+	{
+		if (dist[i] != -1)
+			reachable++;
+	}
+	cout << "batch	" << elapsedMs(begin) << "	" << reachable << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: " << argv[0] << " db_name|graph_file [pair_num] [k] [max_threads]" << endl;
+		return 0;
+	}
+	Util util;
+	string name = argv[1];
+	unsigned pair_num = argc > 2 ? atoi(argv[2]) : 100;
+	int k = argc > 3 ? atoi(argv[3]) : 3;
+	unsigned max_threads = argc > 4 ? atoi(argv[4]) : thread::hardware_concurrency();
+	if (max_threads == 0)
+		max_threads = 1;
+
+	CSR* csr = NULL;
+	Database* db = NULL;
+	if (Util::file_exist(name) && !Util::dir_exist(name))
+	{
+		csr = new CSR[2];
+		PathQueryHandler(csr).inputGraph(name);
+	}
+	else
+	{
+		if (name.length() > 3 && name.substr(name.length() - 3, 3) == ".db")
+			name = name.substr(0, name.length() - 3);
+		db = new Database(name);
+		if (!db->load(true))
+		{
+			cout << "failed to load " << name << endl;
+			return 0;
+		}
+		csr = db->csr;
+	}
+
+	vector<int> preds;
+	unsigned long edge_num = 0;
+	for (unsigned p = 0; p < csr[0].pre_num; ++p)
+	{
+		preds.push_back(p);
+		edge_num += csr[0].adjacency_list[p].size();
+	}
+	//a subject and an object of random predicates, so most pairs are in the graph
+	mt19937 rng(2021);
+	vector<pair<int, int> > pairs;
+	for (unsigned i = 0; i < 1000 * pair_num && pairs.size() < pair_num; ++i)
+	{
+		unsigned p1 = rng() % csr[0].pre_num, p2 = rng() % csr[0].pre_num;
+		if (csr[0].id2vid[p1].empty() || csr[1].id2vid[p2].empty())
+			continue;
+		pairs.push_back(make_pair(csr[0].id2vid[p1][rng() % csr[0].id2vid[p1].size()],
+			csr[1].id2vid[p2][rng() % csr[1].id2vid[p2].size()]));
+	}
+	if (pairs.empty())
+	{
+		cout << "the graph has no edges" << endl;
+		return 0;
+	}
+
+	cout << "predicates: " << preds.size() << ", edges: " << edge_num << ", pairs: " << pairs.size() << ", k: " << k << endl;
+	cout << "mode\tthreads\tshortestPath ms\tkHopReachable ms\tpaths found\treachable" << endl;
+	run(csr, "map-bfs", 1, pairs, k, preds);
+	for (unsigned t = 1; t <= max_threads; t *= 2)
+		run(csr, "frontier-bfs", t, pairs, k, preds);
+	cout << endl << pairs.size() << " x " << pairs.size() << " pairs, threads: " << max_threads << endl;
+	cout << "mode	ms	reachable" << endl;
+	runBatch(csr, max_threads, pairs, k, preds);
+
+	if (db != NULL)
+		delete db;
+	else
+		delete[] csr;
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+  This benchmark compares the Personalized PageRank queries of PathQueryHandler.
+  Usage: scripts/ppr_bench db_name|graph_file [query_num] [ret_num] [max_threads]
+  The graph is the CSR of a built database(i.e. LUBM or WatDiv), or a graph
+  file in the format of PathQueryHandler::inputGraph. The top ret_num vertices
+  by PPR from query_num random sources with out-edges are asked with all
+  predicates, by:
+    sequential: SSPPR0, the single-threaded FORA on iMaps and hash maps
+    parallel: SSPPR, with 1, 2, 4, ... max_threads threads(query_parallelism)
+    index: SSPPR with max_threads threads after buildPPRWalkIndex
+  reporting the average time per query and the accuracy: the share of the
+  exact top ret_num found(by power iteration) and the average relative error
+  of their estimated PPR.
+*/
+#include <iostream>
+#include <random>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../Database/Database.h"
+#include "../Query/PathQueryHandler.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const double ALPHA = 0.2;
+
+static double
+elapsedMs(Clock::time_point _begin)
+{
+	return chrono::duration_cast<chrono::microseconds>(Clock::now() - _begin).count() / 1000.0;
+}
+
+//PPR from _src by power iteration, walking back to _src at vertices without out-edges like SSPPR
+static void
+exactPPR(CSR* _csr, unsigned _bound, int _src, vector<double>& _ppr)
+{
+	vector<double> next(_bound);
+	vector<unsigned> degree(_bound, 0);
+	for (unsigned p = 0; p < _csr[0].pre_num; ++p)
+	{
+		for (unsigned i = 0; i < _csr[0].id2vid[p].size(); ++i)
+			degree[_csr[0].id2vid[p][i]] += _csr[0].getDegree(i, p);
+	}
+	_ppr.assign(_bound, 0);
+	_ppr[_src] = 1;
+	for (int iter = 0; iter < 200; ++iter)
+	{
+		fill(next.begin(), next.end(), 0);
+		next[_src] = ALPHA;
+		for (unsigned v = 0; v < _bound; ++v)
+		{
+			if (_ppr[v] > 0 && degree[v] == 0)
+				next[_src] += (1 - ALPHA) * _ppr[v];
+		}
+		for (unsigned p = 0; p < _csr[0].pre_num; ++p)
+		{
+			for (unsigned i = 0; i < _csr[0].id2vid[p].size(); ++i)
+			{
+				unsigned v = _csr[0].id2vid[p][i];
+				if (_ppr[v] == 0)
+					continue;
+				double push = (1 - ALPHA) * _ppr[v] / degree[v];
+				for (unsigned j = _csr[0].offset_list[p][i]; j < _csr[0].offset_list[p][i + 1]; ++j)
+					next[_csr[0].adjacency_list[p][j]] += push;
+			}
+		}
+		double diff = 0;
+		for (unsigned v = 0; v < _bound; ++v)
+			diff += fabs(next[v] - _ppr[v]);
+		_ppr.swap(next);
+		if (diff < 1e-9)
+			break;
+	}
+}
+
+struct Accuracy
+{
+	double precision;
+	double error;
+	Accuracy() : precision(0), error(0) {}
+};
+
+static void
+check(const vector<pair<int, double> >& _exact, const vector<pair<int, double> >& _topk, Accuracy& _acc)
+{
+	map<int, double> found(_topk.begin(), _topk.end());
+	unsigned hit = 0;
+	double error = 0;
+	for (unsigned i = 0; i < _exact.size(); ++i)
+	{
+		map<int, double>::iterator it = found.find(_exact[i].first);
+		if (it != found.end())
+			hit++;
+		error += fabs((it == found.end() ? 0 : it->second) - _exact[i].second) / _exact[i].second;
+	}
+	_acc.precision += (double)hit / _exact.size();
+	_acc.error += error / _exact.size();
+}
+
+static void
+run(CSR* _csr, const string& _mode, unsigned _threads, const vector<int>& _srcs, int _ret_num,
+	const vector<int>& _preds, const vector<vector<pair<int, double> > >& _exact)
+{
+	Util::global_config["query_parallelism"] = Util::int2string(_threads);
+	PathQueryHandler handler(_csr);
+	if (_mode == "index")
+	{
+		Clock::time_point begin = Clock::now();
+		handler.buildPPRWalkIndex(_preds);
+		cout << "index built in " << elapsedMs(begin) << " ms" << endl;
+	}
+	double ms = 0;
+	Accuracy acc;
+	for (unsigned i = 0; i < _srcs.size(); ++i)
+	{
+		vector<pair<int, double> > topk;
+		Clock::time_point begin = Clock::now();
+		if (_mode == "sequential")
+			handler.SSPPR0(_srcs[i], _ret_num, -1, _preds, topk);
+		else
+			handler.SSPPR(_srcs[i], _ret_num, -1, _preds, topk);
+		ms += elapsedMs(begin);
+		check(_exact[i], topk, acc);
+	}
+	cout << _mode << "\t" << _threads << "\t" << ms / _srcs.size() << "\t" << acc.precision / _srcs.size()
+		<< "\t" << acc.error / _srcs.size() << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: " << argv[0] << " db_name|graph_file [query_num] [ret_num] [max_threads]" << endl;
+		return 0;
+	}
+	Util util;
+	string name = argv[1];
+	unsigned query_num = argc > 2 ? atoi(argv[2]) : 20;
+	int ret_num = argc > 3 ? atoi(argv[3]) : 10;
+	unsigned max_threads = argc > 4 ? atoi(argv[4]) : thread::hardware_concurrency();
+	if (max_threads == 0)
+		max_threads = 1;
+
+	CSR* csr = NULL;
+	Database* db = NULL;
+	if (Util::file_exist(name) && !Util::dir_exist(name))
+	{
+		csr = new CSR[2];
+		PathQueryHandler(csr).inputGraph(name);
+	}
+	else
+	{
+		if (name.length() > 3 && name.substr(name.length() - 3, 3) == ".db")
+			name = name.substr(0, name.length() - 3);
+		db = new Database(name);
+		if (!db->load(true))
+		{
+			cout << "failed to load " << name << endl;
+			return 0;
+		}
+		csr = db->csr;
+	}
+
+	vector<int> preds;
+	unsigned long edge_num = 0;
+	unsigned bound = 0;
+	for (unsigned p = 0; p < csr[0].pre_num; ++p)
+	{
+		preds.push_back(p);
+		edge_num += csr[0].adjacency_list[p].size();
+		for (int j = 0; j < 2; ++j)
+		{
+			if (!csr[j].id2vid[p].empty())
+				bound = max(bound, csr[j].id2vid[p][csr[j].id2vid[p].size() - 1] + 1);
+		}
+	}
+	//subjects of random predicates
+	mt19937 rng(2021);
+	vector<int> srcs;
+	for (unsigned i = 0; i < 1000 * query_num && srcs.size() < query_num; ++i)
+	{
+		unsigned p = rng() % csr[0].pre_num;
+		if (csr[0].id2vid[p].empty())
+			continue;
+		unsigned index = rng() % csr[0].id2vid[p].size();
+		if (csr[0].getDegree(index, p) > 0)
+			srcs.push_back(csr[0].id2vid[p][index]);
+	}
+	if (srcs.empty())
+	{
+		cout << "the graph has no edges" << endl;
+		return 0;
+	}
+
+	vector<vector<pair<int, double> > > exact(srcs.size());
+	vector<double> ppr;
+	for (unsigned i = 0; i < srcs.size(); ++i)
+	{
+		exactPPR(csr, bound, srcs[i], ppr);
+		for (unsigned v = 0; v < bound; ++v)
+		{
+			if (ppr[v] > 0)
+				exact[i].push_back(make_pair(v, ppr[v]));
+		}
+		size_t num = min((size_t)ret_num, exact[i].size());
+		partial_sort(exact[i].begin(), exact[i].begin() + num, exact[i].end(),
+			[](const pair<int, double>& l, const pair<int, double>& r) { return l.second > r.second; });
+		exact[i].resize(num);
+	}
+
+	cout << "predicates: " << preds.size() << ", edges: " << edge_num << ", queries: " << srcs.size()
+		<< ", top " << ret_num << endl;
+	cout << "mode\tthreads\tms\tprecision\trelative error" << endl;
+	run(csr, "sequential", 1, srcs, ret_num, preds, exact);
+	for (unsigned t = 1; t <= max_threads; t *= 2)
+		run(csr, "parallel", t, srcs, ret_num, preds, exact);
+	run(csr, "index", max_threads, srcs, ret_num, preds, exact);
+
+	if (db != NULL)
+		delete db;
+	else
+		delete[] csr;
+	return 0;
+}
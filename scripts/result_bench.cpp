@@ -0,0 +1,174 @@
+/*
+  This benchmark compares the serialization of a big result in ghttp.
+  Usage: scripts/result_bench [row_num] [col_num]
+  It builds a ResultSet of row_num rows(IRIs and literals) and sends it to
+  /dev/null in each mode, each in a forked process, reporting the time, the
+  time to the first byte and the peak memory on top of the ResultSet itself:
+    buffered: to_JSON(), parsed and pretty-printed again with rapidjson to add
+              the status members, as ghttp did before
+    json, sparql-json, csv, tsv: written row by row in 64KB chunks
+*/
+#include <iostream>
+#include <chrono>
+#include <sys/wait.h>
+#include "../Util/Util.h"
+#include "../Query/ResultSet.h"
+#include "../tools/rapidjson/document.h"
+#include "../tools/rapidjson/prettywriter.h"
+#include "../tools/rapidjson/stringbuffer.h"
+
+using namespace std;
+using namespace rapidjson;
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+typedef chrono::steady_clock Clock;
+
+//writes to a file in chunks like ChunkedStreamBuf in ghttp, remembering
+//when the first byte went out
+class SinkBuf : public streambuf
+{
+public:
+	SinkBuf(int _fd) : fd(_fd), bytes(0), first_write(false)
+	{
+		this->buffer.resize(CHUNK_SIZE);
+		this->setp(&this->buffer[0], &this->buffer[0] + CHUNK_SIZE);
+	}
+	void send(const char* _data, size_t _len)
+	{
+		if (!this->first_write)
+		{
+			this->first_byte = Clock::now();
+			this->first_write = true;
+		}
+		write(this->fd, _data, _len);
+		this->bytes += _len;
+	}
+	int fd;
+	unsigned long long bytes;
+	bool first_write;
+	Clock::time_point first_byte;
+
+protected:
+	int overflow(int c)
+	{
+		this->sync();
+		if (c != traits_type::eof())
+		{
+			*this->pptr() = (char)c;
+			this->pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+	int sync()
+	{
+		if (this->pptr() > this->pbase())
+			this->send(this->pbase(), this->pptr() - this->pbase());
+		this->setp(&this->buffer[0], &this->buffer[0] + CHUNK_SIZE);
+		return 0;
+	}
+
+private:
+	vector<char> buffer;
+};
+
+static long
+readStatusKB(const char* _field)
+{
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+	{
+		if (line.compare(0, strlen(_field), _field) == 0)
+			return atol(line.c_str() + strlen(_field) + 1);
+	}
+	return 0;
+}
+
+static void
+run(ResultSet& _rs, const string& _mode)
+{
+	//reset the peak to what is resident now
+	ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+	clear_refs.close();
+	long base_kb = readStatusKB("VmRSS:");
+
+	int fd = open("/dev/null", O_WRONLY);
+	SinkBuf sink(fd);
+	ostream out(&sink);
+	Clock::time_point begin = Clock::now();
+	string status = "\"StatusCode\": 0, \"StatusMsg\": \"success\", ";
+	if (_mode == "buffered")
+	{
+		string json = _rs.to_JSON();
+		Document doc;
+		Document::AllocatorType& allocator = doc.GetAllocator();
+		doc.Parse(json.c_str());
+		doc.AddMember("StatusCode", 0, allocator);
+		doc.AddMember("StatusMsg", "success", allocator);
+		StringBuffer buffer;
+		PrettyWriter<StringBuffer> writer(buffer);
+		doc.Accept(writer);
+		string res = buffer.GetString();
+		sink.send(res.c_str(), res.length());
+	}
+	else if (_mode == "json")
+		_rs.writeJSON(out, status);
+	else if (_mode == "sparql-json")
+		_rs.writeSparqlJSON(out);
+	else if (_mode == "csv")
+		_rs.writeCSV(out);
+	else
+		_rs.writeTSV(out);
+	out.flush();
+	Clock::time_point end = Clock::now();
+	close(fd);
+
+	cout << _mode << "\t" << chrono::duration_cast<chrono::milliseconds>(end - begin).count()
+		<< "\t" << chrono::duration_cast<chrono::milliseconds>(sink.first_byte - begin).count()
+		<< "\t" << (readStatusKB("VmHWM:") - base_kb) / 1024 << "\t" << sink.bytes / (1 << 20) << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned row_num = argc > 1 ? atoi(argv[1]) : 1000000;
+	int col_num = argc > 2 ? atoi(argv[2]) : 3;
+
+	vector<string> vars;
+	for (int j = 0; j < col_num; ++j)
+		vars.push_back("?v" + Util::int2string(j));
+	ResultSet rs;
+	rs.setVar(vars);
+	rs.true_select_var_num = col_num;
+	rs.ansNum = row_num;
+	rs.answer = new string*[row_num];
+	for (unsigned i = 0; i < row_num; ++i)
+	{
+		rs.answer[i] = new string[col_num];
+		for (int j = 0; j < col_num; ++j)
+		{
+			if (j % 2 == 0)
+				rs.answer[i][j] = "<http://example.org/resource/r" + Util::int2string(i * col_num + j) + ">";
+			else
+				rs.answer[i][j] = "\"a literal, \"quoted\" " + Util::int2string(i) + "\"@en";
+		}
+	}
+
+	cout << "rows: " << row_num << ", columns: " << col_num << endl;
+	cout << "mode\tms\tfirst byte ms\tpeak MB\tMB sent" << endl;
+	const char* modes[] = { "buffered", "json", "sparql-json", "csv", "tsv" };
+	for (unsigned m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+	{
+		cout.flush();
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			run(rs, modes[m]);
+			_exit(0);
+		}
+		waitpid(pid, NULL, 0);
+	}
+	return 0;
+}
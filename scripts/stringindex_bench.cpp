@@ -0,0 +1,121 @@
+/*
+  This benchmark measures concurrent ID to string conversion through
+  StringIndex::batchAccess.
+  Usage: scripts/stringindex_bench [string_num] [batches_per_thread] [max_threads]
+  It writes entity and literal string files of string_num strings(20 to 200
+  bytes) in ./stringindex_bench_tmp, and converts batches of 1024 random IDs
+  with 1, 2, 4, ... max_threads readers, reading with pread and then from the
+  mapping, each compared with the readers serialized by a mutex as before.
+*/
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "../Util/Util.h"
+#include "../StringIndex/StringIndex.h"
+
+using namespace std;
+
+static const string BENCH_DIR = "stringindex_bench_tmp";
+static const unsigned BATCH_SIZE = 1024;
+
+static void
+writeFile(const string& _prefix, unsigned _num, mt19937& _rng)
+{
+	FILE* index = fopen((BENCH_DIR + "/" + _prefix + "index").c_str(), "wb");
+	FILE* value = fopen((BENCH_DIR + "/" + _prefix + "value").c_str(), "wb");
+	fwrite(&_num, sizeof(unsigned), 1, index);
+	long offset = 0;
+	string str;
+	for (unsigned i = 0; i < _num; ++i)
+	{
+		unsigned length = 20 + _rng() % 181;
+		str.assign(length, 'a' + i % 26);
+		fwrite(&offset, sizeof(long), 1, index);
+		fwrite(&length, sizeof(unsigned), 1, index);
+		fwrite(str.c_str(), sizeof(char), length, value);
+		offset += length;
+	}
+	fclose(index);
+	fclose(value);
+}
+
+static void
+reader(StringIndex* _index, mutex* _lock, unsigned _num, unsigned long _batches, unsigned _seed, unsigned long& _bytes)
+{
+	mt19937 rng(_seed);
+	vector<unsigned> ids(BATCH_SIZE);
+	vector<string> strs(BATCH_SIZE);
+	_bytes = 0;
+	for (unsigned long b = 0; b < _batches; ++b)
+	{
+		for (unsigned i = 0; i < BATCH_SIZE; ++i)
+		{
+			unsigned id = rng() % _num;
+			ids[i] = rng() % 2 == 0 ? id : Util::LITERAL_FIRST_ID + id;
+		}
+		if (_lock != NULL)
+			_lock->lock();
+		_index->batchAccess(&ids[0], BATCH_SIZE, &strs[0]);
+		if (_lock != NULL)
+			_lock->unlock();
+		for (unsigned i = 0; i < BATCH_SIZE; ++i)
+			_bytes += strs[i].length();
+	}
+}
+
+static void
+run(StringIndex* _index, const char* _mode, bool _serialized, unsigned _num, unsigned long _batches, unsigned _max_threads)
+{
+	mutex lock;
+	for (unsigned n = 1; n <= _max_threads; n *= 2)
+	{
+		vector<thread> threads;
+		vector<unsigned long> bytes(n);
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		for (unsigned t = 0; t < n; ++t)
+			threads.push_back(thread(reader, _index, _serialized ? &lock : NULL, _num, _batches, 7 * t + 1, ref(bytes[t])));
+		for (unsigned t = 0; t < n; ++t)
+			threads[t].join();
+		chrono::steady_clock::time_point end = chrono::steady_clock::now();
+		double sec = chrono::duration_cast<chrono::microseconds>(end - begin).count() / 1e6;
+		cout << _mode << (_serialized ? "(serialized)" : "") << "\t" << n << "\t"
+			<< n * _batches * BATCH_SIZE / sec / 1e6 << endl;
+	}
+}
+
+int
+main(int argc, char* argv[])
+{
+	unsigned num = argc > 1 ? atoi(argv[1]) : 1000000;
+	unsigned long batches = argc > 2 ? atol(argv[2]) : 1000;
+	unsigned max_threads = argc > 3 ? atoi(argv[3]) : thread::hardware_concurrency();
+	if (max_threads == 0)
+		max_threads = 1;
+
+	Util::create_dir(BENCH_DIR);
+	mt19937 rng(2021);
+	writeFile("entity_", num, rng);
+	writeFile("literal_", num, rng);
+	writeFile("predicate_", 1, rng);
+
+	//measure the reads themselves, not the string cache
+	Util::global_config["string_cache_size"] = "0";
+	StringIndex* index = new StringIndex(BENCH_DIR);
+	index->load();
+	cout << "strings: " << 2 * num << ", ids per batch: " << BATCH_SIZE << ", batches per thread: " << batches << endl;
+	cout << "mode\tthreads\tMids/s" << endl;
+	run(index, "pread", true, num, batches, max_threads);
+	run(index, "pread", false, num, batches, max_threads);
+
+	vector<StringIndexFile*> files = index->get_three_StringIndexFile();
+	for (unsigned i = 0; i < files.size(); ++i)
+		files[i]->flush_file();
+	run(index, "mmap", true, num, batches, max_threads);
+	run(index, "mmap", false, num, batches, max_threads);
+	delete index;
+
+	string cmd = "rm -rf " + BENCH_DIR;
+	system(cmd.c_str());
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*=============================================================================
+# Filename: wal_test.cpp
+# Author: gStore
+# Last Modified: 2026-10-18
+# Description: used to test the restore of a db from its update log(update.wal)
+=============================================================================*/
+
+#include "../Util/Util.h"
+#include "../Database/Database.h"
+#include "../Database/UpdateLog.h"
+
+using namespace std;
+
+//triple information
+typedef std::tuple<string, string, string> triple;
+
+std::set<triple> expected_triples;
+std::set<triple> db_triples;
+
+TripleWithObjType make_triple(const string& _s, const string& _p, const string& _o)
+{
+	TripleWithObjType::ObjectType type = _o[0] == '"' ? TripleWithObjType::Literal : TripleWithObjType::Entity;
+	return TripleWithObjType(_s, _p, _o, type);
+}
+
+//log the triples and apply them to the expected ones if they must be redone
+bool log_triples(UpdateLog& _log, UpdateLog::RecordType _type, unsigned long long _txn_id, const vector<TripleWithObjType>& _triples, bool _redo)
+{
+	if (_redo)
+	{
+		for (size_t i = 0; i < _triples.size(); i++)
+		{
+			triple t(_triples[i].subject, _triples[i].predicate, _triples[i].object);
+			if (_type == UpdateLog::Insert)
+				expected_triples.insert(t);
+			else
+				expected_triples.erase(t);
+		}
+	}
+	return _log.append(_type, _txn_id, &_triples[0], _triples.size());
+}
+
+void print()
+{
+	cerr << "expected_triples:" << endl;
+	for (std::set<triple>::iterator it = expected_triples.begin(); it != expected_triples.end(); it++)
+		cerr << std::get<0>(*it) << " " << std::get<1>(*it) << " " << std::get<2>(*it) << endl;
+	cerr << "db_triples:" << endl;
+	for (std::set<triple>::iterator it = db_triples.begin(); it != db_triples.end(); it++)
+		cerr << std::get<0>(*it) << " " << std::get<1>(*it) << " " << std::get<2>(*it) << endl;
+}
+
+int main(int argc, char * argv[])
+{
+	Util util;
+	string db_name = "wal_test";
+	string db_path = "data/update_test.nt";
+	string cmd = "rm -r " + db_name + ".db";
+
+	//build database
+	Database* db = new Database(db_name);
+	if (!db->build(db_path))
+	{
+		cerr << db_name + ".db is built failed." << endl;
+		delete db;
+		system(cmd.c_str());
+		return -1;
+	}
+	delete db;
+	expected_triples.insert(triple("<s0>", "<p0>", "<o0>"));
+
+	//write the log as a server would, the db is not loaded
+	string log_path = Util::global_config["db_home"] + "/" + db_name + Util::global_config["db_suffix"];
+	UpdateLog* log = new UpdateLog();
+	if (!log->open(log_path + "/update.wal", log_path + "/update_since_backup.wal"))
+	{
+		cerr << "Failed to open the update log." << endl;
+		delete log;
+		system(cmd.c_str());
+		return -1;
+	}
+	bool flag = true;
+	vector<TripleWithObjType> triples, removed;
+	for (int i = 0; i < 200; i++)
+	{
+		string o = i % 2 ? "<wo" + Util::int2string(i) + ">" : "\"wo" + Util::int2string(i) + "\"";
+		triples.push_back(make_triple("<ws" + Util::int2string(i) + ">", "<wp" + Util::int2string(i % 7) + ">", o));
+		if (i % 3 == 0)
+			removed.push_back(triples.back());
+	}
+	removed.push_back(make_triple("<s0>", "<p0>", "<o0>"));
+	//updates not in a transaction
+	flag = flag && log_triples(*log, UpdateLog::Insert, 0, triples, true);
+	flag = flag && log_triples(*log, UpdateLog::Remove, 0, removed, true);
+	//an aborted transaction
+	flag = flag && log_triples(*log, UpdateLog::Insert, 5, vector<TripleWithObjType>(1, make_triple("<ta>", "<tp>", "<to>")), false);
+	flag = flag && log_triples(*log, UpdateLog::Remove, 5, vector<TripleWithObjType>(1, triples[1]), false);
+	flag = flag && log->append(UpdateLog::Abort, 5);
+	//a transaction not committed before the restart, whose id is used again after it
+	flag = flag && log_triples(*log, UpdateLog::Insert, 6, vector<TripleWithObjType>(1, make_triple("<tu>", "<tp>", "<to>")), false);
+	//a transaction committed before the restart
+	flag = flag && log_triples(*log, UpdateLog::Insert, 7, vector<TripleWithObjType>(1, make_triple("<tc>", "<tp>", "<to>")), true);
+	flag = flag && log->append(UpdateLog::Commit, 7);
+	log->close();
+
+	//restart, which marks the log
+	flag = flag && log->open(log_path + "/update.wal", log_path + "/update_since_backup.wal");
+	//a transaction committed after the restart
+	flag = flag && log_triples(*log, UpdateLog::Insert, 6, vector<TripleWithObjType>(1, make_triple("<tr>", "<tp>", "\"to\"")), true);
+	flag = flag && log_triples(*log, UpdateLog::Remove, 6, vector<TripleWithObjType>(1, triples[1]), true);
+	flag = flag && log->append(UpdateLog::Commit, 6);
+	//a triple removed and inserted again
+	flag = flag && log_triples(*log, UpdateLog::Insert, 0, vector<TripleWithObjType>(1, triples[3]), true);
+	//a transaction not committed before the crash
+	flag = flag && log_triples(*log, UpdateLog::Insert, 8, vector<TripleWithObjType>(1, make_triple("<tn>", "<tp>", "<to>")), false);
+	//a record torn by the crash
+	flag = flag && log_triples(*log, UpdateLog::Insert, 0, vector<TripleWithObjType>(1, make_triple("<tt>", "<tp>", "<to>")), false);
+	log->close();
+	delete log;
+	if (!flag)
+	{
+		cerr << "Failed to write the update log." << endl;
+		system(cmd.c_str());
+		return -1;
+	}
+
+	//crash in the middle of the last record
+	string wal = log_path + "/update.wal";
+	struct stat st;
+	if (stat(wal.c_str(), &st) != 0 || st.st_size <= 3 || truncate(wal.c_str(), st.st_size - 3) != 0)
+	{
+		cerr << "Failed to truncate the update log." << endl;
+		system(cmd.c_str());
+		return -1;
+	}
+	vector<UpdateLog::Record> records;
+	if (!UpdateLog::read(wal, records, 0) || records.size() != 14)
+	{
+		cerr << "Update log read " << records.size() << " records, 14 expected." << endl;
+		system(cmd.c_str());
+		return -1;
+	}
+
+	//restore the db from the log
+	db = new Database(db_name);
+	if (!db->restore())
+	{
+		cerr << "Failed to restore " << db_name << ".db." << endl;
+		delete db;
+		system(cmd.c_str());
+		return -1;
+	}
+	string query = "select ?s ?p ?o where{?s ?p ?o.}";
+	ResultSet _rs;
+	FILE* ofp = NULL;
+	db->query(query, _rs, ofp);
+	for (unsigned i = 0; i < _rs.ansNum; i++)
+		db_triples.insert(triple(_rs.answer[i][0], _rs.answer[i][1], _rs.answer[i][2]));
+	delete db;
+	system(cmd.c_str());
+
+	if (db_triples != expected_triples)
+	{
+		cerr << "Update log restore exists errors." << endl;
+		print();
+		return -1;
+	}
+	cerr << "Update log restore passed." << endl;
+	return 0;
+}